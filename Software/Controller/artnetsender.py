@@ -0,0 +1,86 @@
+#!/usr/bin/env python
+# Art-Net test source. Sends ArtDmx to a controller with a slow sine fade on
+# the selected slots and reports the controller's ArtPollReply.
+#
+# Enable Art-Net on the controller's config page and run for example:
+#   python artnetsender.py 192.168.1.50 --universe 0 --slots 1 2 3 4 --fps 44
+# Receive statistics are available at http://<controller>/artnet
+import argparse
+import math
+import socket
+import struct
+import time
+
+ARTNET_PORT = 6454
+ARTNET_ID = b"Art-Net\x00"
+OP_POLL = 0x2000
+OP_POLL_REPLY = 0x2100
+OP_DMX = 0x5000
+PROTOCOL_VERSION = 14
+
+
+def art_dmx(universe, sequence, data):
+    # Length must be even, 2-512
+    if len(data) % 2:
+        data = data + b"\x00"
+    return ARTNET_ID + struct.pack("<H", OP_DMX) + struct.pack(">H", PROTOCOL_VERSION) + \
+        struct.pack("<BBH", sequence, 0, universe) + struct.pack(">H", len(data)) + data
+
+
+def art_poll():
+    return ARTNET_ID + struct.pack("<H", OP_POLL) + struct.pack(">H", PROTOCOL_VERSION) + b"\x00\x00"
+
+
+def poll(sock, host):
+    sock.sendto(art_poll(), (host, ARTNET_PORT))
+    sock.settimeout(1)
+    try:
+        reply, address = sock.recvfrom(1024)
+    except socket.timeout:
+        print("No ArtPollReply from %s" % host)
+        return
+    finally:
+        sock.settimeout(None)
+    if reply[:8] == ARTNET_ID and struct.unpack("<H", reply[8:10])[0] == OP_POLL_REPLY:
+        short_name = reply[26:44].split(b"\x00")[0].decode("ascii", "replace")
+        node_report = reply[108:172].split(b"\x00")[0].decode("ascii", "replace")
+        print("ArtPollReply from %s: %s (%s)" % (address[0], short_name, node_report))
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Send Art-Net DMX to a controller.")
+    parser.add_argument("host")
+    parser.add_argument("--universe", type=int, default=0)
+    parser.add_argument("--slots", type=int, nargs="+", default=[1, 2, 3, 4], help="Slots to fade, 1-512")
+    parser.add_argument("--fps", type=float, default=44)
+    parser.add_argument("--period", type=float, default=4, help="Seconds per fade cycle")
+    parser.add_argument("--duration", type=float, default=0, help="Seconds to send, 0 = until stopped")
+    args = parser.parse_args()
+
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.bind(("", ARTNET_PORT))
+    poll(sock, args.host)
+
+    size = max(args.slots)
+    sequence = 1
+    frames = 0
+    start = time.monotonic()
+    next_frame = start
+    while args.duration == 0 or time.monotonic() - start < args.duration:
+        now = time.monotonic()
+        level = int((math.sin((now - start) * 2 * math.pi / args.period) + 1) * 127.5)
+        data = bytearray(size)
+        for slot in args.slots:
+            data[slot - 1] = level
+        sock.sendto(art_dmx(args.universe, sequence, bytes(data)), (args.host, ARTNET_PORT))
+        sequence = sequence % 255 + 1  # 0 disables sequence checking
+        frames += 1
+        next_frame += 1 / args.fps
+        time.sleep(max(0, next_frame - time.monotonic()))
+
+    elapsed = time.monotonic() - start
+    print("Sent %d frames in %.1f s (%.1f fps)" % (frames, elapsed, frames / elapsed))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,99 @@
+#!/usr/bin/env python
+# Channel command throughput, batch REST API against one MQTT message per channel.
+#
+# REST: POSTs batches of commands to http://<controller>/api/channels for a
+# while and counts the commands applied, as JSON or in the binary format.
+# MQTT: publishes one {"brightness": n} per channel to the command topics and
+# waits until the state topic of the last channel reports the last level, so
+# that the time includes the controller working through its queue.
+#   python channelbench.py 192.168.1.50 --channels 1 2 3 4 --seconds 30
+#   python channelbench.py 192.168.1.50 --channels 1 2 3 4 --binary
+#   python channelbench.py 192.168.1.50 --channels 1 2 3 4 --mqtt 192.168.1.10 --count 400
+import argparse
+import json
+import struct
+import threading
+import time
+import urllib.request
+
+
+def post(host, body, content_type, timeout=5):
+    request = urllib.request.Request("http://%s/api/channels" % host, data=body, headers={"Content-Type": content_type})
+    with urllib.request.urlopen(request, timeout=timeout) as response:
+        return json.loads(response.read())
+
+
+def rest_bench(host, channels, universe, seconds, binary):
+    requests = 0
+    applied = 0
+    level = 1
+    end = time.time() + seconds
+    while time.time() < end:
+        if binary:
+            body = b"".join(struct.pack("<HBHH", channel, universe, level * 257, 0) for channel in channels)
+            result = post(host, body, "application/octet-stream")
+        else:
+            body = json.dumps([{"channel": channel, "universe": universe, "level": level} for channel in channels]).encode()
+            result = post(host, body, "application/json")
+        requests += 1
+        applied += result["applied"]
+        level = level % 255 + 1
+    print("REST %s: %d requests, %d commands in %d s = %.0f requests/s, %.0f commands/s" % (
+        "binary" if binary else "JSON", requests, applied, seconds, requests / seconds, applied / seconds))
+
+
+def mqtt_bench(broker, base_topic, hostname, channels, count):
+    import paho.mqtt.client as mqtt  # Only needed with --mqtt
+    topics = ["%slight/%s/channel%d" % (base_topic, hostname, channel) for channel in channels]
+    last_level = 200
+    done = threading.Event()
+
+    def on_message(client, userdata, message):
+        state = json.loads(message.payload)
+        if state.get("brightness") == last_level and state.get("state") == "ON":
+            done.set()
+
+    client = mqtt.Client()
+    client.on_message = on_message
+    client.connect(broker)
+    client.subscribe(topics[-1] + "/state")
+    client.loop_start()
+    # Start from a known level so that the last command is a change
+    client.publish(topics[-1] + "/cmd", json.dumps({"brightness": 1}))
+    time.sleep(3)
+
+    start = time.time()
+    for i in range(count):
+        level = last_level if i >= count - len(topics) else i % 199 + 1
+        client.publish(topics[i % len(topics)] + "/cmd", json.dumps({"brightness": level}), qos=1)
+    sent = time.time() - start
+    applied = done.wait(120)
+    total = time.time() - start
+    client.loop_stop()
+    if not applied:
+        print("MQTT: the last command was not applied within 120 s")
+        return
+    print("MQTT: %d commands published in %.2f s, last applied after %.2f s = %.0f commands/s" % (count, sent, total, count / total))
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Compare channel command throughput of the REST batch API and MQTT.")
+    parser.add_argument("host")
+    parser.add_argument("--channels", type=int, nargs="+", required=True, help="DMX channels of enabled controller channels")
+    parser.add_argument("--universe", type=int, default=1)
+    parser.add_argument("--seconds", type=int, default=30)
+    parser.add_argument("--binary", action="store_true", help="Send the compact binary body instead of JSON")
+    parser.add_argument("--mqtt", help="MQTT broker, benchmark the MQTT command topics instead")
+    parser.add_argument("--base-topic", default="homeassistant/")
+    parser.add_argument("--hostname", default="lman", help="Host name of the controller, part of the topics")
+    parser.add_argument("--count", type=int, default=400, help="MQTT commands to send")
+    args = parser.parse_args()
+
+    if args.mqtt:
+        mqtt_bench(args.mqtt, args.base_topic, args.hostname, args.channels, args.count)
+    else:
+        rest_bench(args.host, args.channels, args.universe, args.seconds, args.binary)
+
+
+if __name__ == "__main__":
+    main()
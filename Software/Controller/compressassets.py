@@ -0,0 +1,82 @@
+Import("env")
+import gzip
+import hashlib
+import os
+import re
+import shutil
+
+# Build a copy of the data directory where all web assets are gzipped and
+# tagged with a content hash. The LittleFS image is then built from this copy.
+# The web server serves the .gz files with Content-Encoding: gzip and uses the
+# hashes from the "/etags" manifest as ETag.
+
+COMPRESSED_EXTENSIONS = (".html", ".css", ".js")
+HASH_LENGTH = 16
+
+source_dir = env.subst("$PROJECT_DATA_DIR")
+build_dir = os.path.join(env.subst("$PROJECT_BUILD_DIR"), env.subst("$PIOENV"), "data")
+
+
+def content_hash(data):
+    return hashlib.sha256(data).hexdigest()[:HASH_LENGTH]
+
+
+def write_gzip(path, data):
+    # mtime=0 so that an unchanged asset always produces the same file
+    with open(path, "wb") as f:
+        with gzip.GzipFile(filename="", mode="wb", fileobj=f, compresslevel=9, mtime=0) as gz:
+            gz.write(data)
+
+
+def build_compressed_data_dir():
+    if os.path.isdir(build_dir):
+        shutil.rmtree(build_dir)
+    os.makedirs(build_dir)
+
+    assets = {}
+    for root, dirs, files in os.walk(source_dir):
+        for name in files:
+            source_path = os.path.join(root, name)
+            web_path = "/" + os.path.relpath(source_path, source_dir).replace(os.sep, "/")
+            with open(source_path, "rb") as f:
+                assets[web_path] = f.read()
+
+    # Static files first, the html files reference them by hash.
+    etags = {}
+    for web_path, data in assets.items():
+        if web_path.endswith(COMPRESSED_EXTENSIONS) and not web_path.endswith(".html"):
+            etags[web_path] = content_hash(data)
+
+    def tag_reference(match):
+        path = match.group(2)
+        if path in etags:
+            return '%s="%s?v=%s"' % (match.group(1), path, etags[path])
+        return match.group(0)
+
+    raw_size = 0
+    compressed_size = 0
+    for web_path, data in assets.items():
+        target_path = os.path.join(build_dir, web_path.lstrip("/"))
+        os.makedirs(os.path.dirname(target_path), exist_ok=True)
+        if not web_path.endswith(COMPRESSED_EXTENSIONS):
+            with open(target_path, "wb") as f:
+                f.write(data)
+            continue
+
+        if web_path.endswith(".html"):
+            data = re.sub(r'(href|src)="(/static/[^"?]+)"', tag_reference, data.decode("utf-8")).encode("utf-8")
+            etags[web_path] = content_hash(data)
+
+        write_gzip(target_path + ".gz", data)
+        raw_size += len(data)
+        compressed_size += os.path.getsize(target_path + ".gz")
+
+    with open(os.path.join(build_dir, "etags"), "w") as f:
+        for web_path in sorted(etags):
+            f.write("%s %s\n" % (web_path, etags[web_path]))
+
+    print("Compressed web assets: %d bytes -> %d bytes" % (raw_size, compressed_size))
+
+
+build_compressed_data_dir()
+env.Replace(PROJECT_DATA_DIR=build_dir)
@@ -24,6 +24,9 @@ function connectWebSocket() {
                     $("#channel" + (i + 1) + "_enabled").prop("checked", json_data["channels"][i]["enabled"]);
                     $("#channel" + (i + 1) + "_name").val(json_data["channels"][i]["name"]);
                     $("#channel" + (i + 1) + "_channel").val(json_data["channels"][i]["channel"]);
+                    $("#channel" + (i + 1) + "_universe").val(json_data["channels"][i]["universe"]);
+                    $("#channel" + (i + 1) + "_fine").prop("checked", json_data["channels"][i]["fine"]);
+                    $("#channel" + (i + 1) + "_type").val(json_data["channels"][i]["type"]);
                     $("#channel" + (i + 1) + "_output_slider").data("channel", json_data["channels"][i]["channel"]);
                     $("#channel" + (i + 1) + "_min").val(json_data["channels"][i]["min"]);
                     $("#channel" + (i + 1) + "_max").val(json_data["channels"][i]["max"]);
@@ -37,6 +40,52 @@ function connectWebSocket() {
             for (let i = 0; i < 4; i++) {
                 $("#button" + (i + 1) + "_enabled").prop("checked", json_data["buttons"][i]["enabled"]);
                 $("#button" + (i + 1) + "_channel").val(json_data["buttons"][i]["channel"]);
+                $("#button" + (i + 1) + "_scene").val(json_data["buttons"][i]["scene"]);
+            }
+        }
+        if ("scenes" in json_data) {
+            for (let i = 0; i < 4; i++) {
+                var scene = json_data["scenes"][i];
+                $("#scene" + (i + 1) + "_enabled").prop("checked", scene["enabled"]);
+                $("#scene" + (i + 1) + "_name").val(scene["name"]);
+                $("#scene" + (i + 1) + "_fadeTime").val(scene["fadeTime"]);
+                for (let c = 0; c < 4; c++) {
+                    // null = channel is not part of the scene
+                    $("#scene" + (i + 1) + "_level" + (c + 1)).val(scene["levels"][c] === null ? "" : scene["levels"][c]);
+                }
+            }
+        }
+        if ("groups" in json_data) {
+            for (let i = 0; i < 4; i++) {
+                var group = json_data["groups"][i];
+                $("#group" + (i + 1) + "_enabled").prop("checked", group["enabled"]);
+                $("#group" + (i + 1) + "_name").val(group["name"]);
+                $("#group" + (i + 1) + "_fadeTime").val(group["fadeTime"]);
+                for (let c = 0; c < 4; c++) {
+                    $("#group" + (i + 1) + "_channel" + (c + 1)).prop("checked", group["channels"].includes(c + 1));
+                }
+            }
+        }
+        if ("schedules" in json_data) {
+            for (let i = 0; i < 8; i++) {
+                var schedule = json_data["schedules"][i];
+                var prefix = "#schedule" + (i + 1);
+                $(prefix + "_enabled").prop("checked", schedule["enabled"]);
+                $(prefix + "_name").val(schedule["name"]);
+                $(prefix + "_trigger").val(schedule["trigger"]).change();
+                // Minutes after midnight as HH:MM
+                var hours = Math.floor(schedule["time"] / 60);
+                var minutes = schedule["time"] % 60;
+                $(prefix + "_time").val(String(hours).padStart(2, "0") + ":" + String(minutes).padStart(2, "0"));
+                $(prefix + "_offset").val(schedule["offset"]);
+                $(prefix + "_level").val(schedule["level"]);
+                $(prefix + "_fadeTime").val(schedule["fadeTime"]);
+                for (let d = 0; d < 7; d++) {
+                    $(prefix + "_day" + d).prop("checked", schedule["days"].includes(d));
+                }
+                for (let c = 0; c < 4; c++) {
+                    $(prefix + "_channel" + (c + 1)).prop("checked", schedule["channels"].includes(c + 1));
+                }
             }
         }
 
@@ -88,8 +137,10 @@ function connectWebSocket() {
                     $("#home_assistant_connection_error").removeClass("hidden");
                     $("#home_assistant_status").prop("class", "tag is-danger");
                 }
-            } else if (index == "log_level") {
-                $("#log_level").val(value).change();
+            } else if (index == "log_level" || index == "dmx_merge_mode") {
+                $(`#${index}`).val(value).change();
+            } else if (index == "artnet_enabled" || index == "e131_enabled" || index == "mqtt_raw_enabled" || index == "log_serial") {
+                $(`#${index}`).prop("checked", value);
             } else {
                 if ($(`#${index}`).length) {
                     $(`#${index}`).val(value);
@@ -113,6 +164,10 @@ function connectWebSocket() {
     };
 }
 
+function recallScene(scene) {
+    socket.send(JSON.stringify({ "scene": scene }));
+}
+
 function sendLightUpdateFromSlider(slider) {
     var message = {
         "channel": $(slider).data('channel'),
@@ -121,6 +176,14 @@ function sendLightUpdateFromSlider(slider) {
     socket.send(JSON.stringify(message));
 }
 
+function loadScheduleStatus() {
+    $.get("/schedule", function (data) {
+        $("#schedule_local_time").html(data["time_valid"] ? data["local_time"] : "Not set");
+        $("#schedule_sunrise").html(data["sunrise"] || "-");
+        $("#schedule_sunset").html(data["sunset"] || "-");
+    });
+}
+
 // Websocket timeout handler
 function connectionMonitor() {
     // Do a simple HTTP GET request to check if the device is reachable
@@ -258,6 +321,7 @@ $(document).ready(function () {
     $('#mqtt_auth').change(handleMqttUsernamePasswordVisibilityState);
     connectWebSocket();
     setTimeout(connectionMonitor, 1000);
+    loadScheduleStatus();
 
     $('#config').submit(function (event) {
         const valid_ids = [
@@ -25,75 +25,148 @@ function connectionMonitor() {
     setTimeout(connectionMonitor, 1000);  
 }
 
-function performFirmwareUpload() {
-    // Do a check to see if the file names are valid
-    firmwareFileName = $('#firmware_file').prop('files')[0]["name"];
-    spiffsFileName = $('#spiffs_file').prop('files')[0]["name"];
-
-    if(!firmwareFileName.startsWith("firmware") || !firmwareFileName.endsWith(".bin")) {
-        $("#update_error_text").html("Invalid firmware filename. Firmware file name must start with 'firmware' and end with '.bin'");
-        $("#update_error").show();
-        $("#update_progress").hide();
-        $("#firmware_update_modal").addClass("is-active");
-        return;
-    } else if(!spiffsFileName.startsWith("littlefs") || !spiffsFileName.endsWith(".bin")) {
-        $("#update_error_text").html("Invalid LittleFS filename. Firmware file name must start with 'littlefs' and end with '.bin'");
-        $("#update_error").show();
-        $("#update_progress").hide();
-        $("#firmware_update_modal").addClass("is-active");
-        return;
+// Size of each request when uploading an image. An interrupted upload is resumed from the last received chunk.
+const UPLOAD_CHUNK_SIZE = 65536;
+const UPLOAD_MAX_RETRIES = 5;
+// Time to let the device write its buffers to flash when it could not take a whole chunk
+const UPLOAD_BUSY_DELAY = 100;
+
+function connectUpdateSocket() {
+    var socket = new WebSocket(`ws://${window.location.host}/update_data`);
+    socket.onmessage = function (event) {
+        showUpdateStatus(JSON.parse(event.data));
+    };
+}
+
+function showUpdateStatus(status) {
+    if (status["size"] > 0) {
+        var percent = Math.floor((status["written"] / status["size"]) * 100);
+        $("#firmware_update_progress").prop("value", percent);
+        $("#firmware_update_progress").html(`${percent}%`);
     }
+    $("#update_status_text").html(`${status["image"]}: ${status["state"]}`);
+}
 
-    $("#update_progress").show();
-    $("#update_error").hide();
+function showUpdateError(text) {
+    $("#update_error_text").html(text);
+    $("#update_error").show();
+    $("#update_progress").hide();
     $("#firmware_update_modal").addClass("is-active");
+}
 
+function uploadChunk(upload, offset, retries, done, fail) {
+    if (offset >= upload.file.size) {
+        done();
+        return;
+    }
+
+    var url = `/ota?image=${upload.image}&offset=${offset}&size=${upload.file.size}`;
+    if (offset == 0 && upload.sha256) {
+        url += `&sha256=${upload.sha256}`;
+    }
     $.ajax({
-        // Your server script to process the upload
-        url: '/update',
+        url: url,
         type: 'POST',
-    
-        // Form data
-        data: new FormData($('form')[0]),
-    
-        // Tell jQuery not to process data or worry about content-type
-        // You *must* include these options!
+        data: upload.file.slice(offset, offset + UPLOAD_CHUNK_SIZE),
         cache: false,
-        contentType: false,
+        contentType: 'application/octet-stream',
         processData: false,
-    
-        // Custom XMLHttpRequest
-        xhr: function () {
-          var myXhr = $.ajaxSettings.xhr();
-          if (myXhr.upload) {
-            // For handling the progress of the upload
-            myXhr.upload.addEventListener('progress', function (e) {
-              if (e.lengthComputable) {
-                var percent = Math.floor((e.loaded / e.total) * 100);
-                $("#firmware_update_progress").prop("value", percent);
-                $("#firmware_update_progress").html(`${percent}%`);
-              }
-            }, false);
-          }
-          return myXhr;
+        success: function (status) {
+            uploadChunk(upload, status["received"], 0, done, fail);
         },
+        error: function (data, textStatus, errorThrown) {
+            if (data.status == 409) {
+                // Chunk did not continue where the device is, resume from where it is.
+                uploadChunk(upload, data.responseJSON["received"], retries + 1, done, fail);
+            } else if (data.status == 503) {
+                // The flash writes fell behind, the device took the chunk up to "received".
+                setTimeout(function () {
+                    uploadChunk(upload, data.responseJSON["received"], retries, done, fail);
+                }, UPLOAD_BUSY_DELAY);
+            } else if (data.status == 500) {
+                fail(data.responseJSON ? data.responseJSON["error"] : errorThrown);
+            } else if (retries >= UPLOAD_MAX_RETRIES) {
+                fail(textStatus + ": " + errorThrown);
+            } else {
+                // Connection lost, ask the device where to resume from.
+                setTimeout(function () {
+                    $.get("/ota", function (status) {
+                        var resumeAt = status["state"] == "receiving" && status["image"] == upload.image ? status["received"] : 0;
+                        uploadChunk(upload, resumeAt, retries + 1, done, fail);
+                    }).fail(function () {
+                        uploadChunk(upload, offset, retries + 1, done, fail);
+                    });
+                }, 1000);
+            }
+        }
+    });
+}
 
-        success: function() {
-            // Update completed without errors. Do a reboot
-            window.location = "/reboot";
-        },
-        error: function(data, textStatus, errorThrown) {
-            $("#update_error_text").html(textStatus + ": " + errorThrown)
-            $("#update_error").show();
-            $("#update_progress").hide();
-            console.log("Update failed");
-            console.log(data);
+function waitForFlashWrite(done, fail) {
+    $.get("/ota", function (status) {
+        showUpdateStatus(status);
+        if (status["state"] == "done") {
+            done();
+        } else if (status["state"] == "failed") {
+            fail(status["error"]);
+        } else {
+            setTimeout(function () { waitForFlashWrite(done, fail); }, 500);
         }
-      });
+    }).fail(function () {
+        setTimeout(function () { waitForFlashWrite(done, fail); }, 500);
+    });
+}
+
+function performUploads(uploads) {
+    if (uploads.length == 0) {
+        // Update completed without errors. Do a reboot
+        window.location = "/reboot";
+        return;
+    }
+
+    var upload = uploads.shift();
+    uploadChunk(upload, 0, 0, function () {
+        waitForFlashWrite(function () {
+            performUploads(uploads);
+        }, showUpdateError);
+    }, showUpdateError);
+}
+
+function performFirmwareUpload() {
+    var uploads = [];
+    var firmwareFile = $('#firmware_file').prop('files')[0];
+    var spiffsFile = $('#spiffs_file').prop('files')[0];
+
+    // Do a check to see if the file names are valid
+    if (firmwareFile) {
+        if (!firmwareFile["name"].startsWith("firmware") || !firmwareFile["name"].endsWith(".bin")) {
+            showUpdateError("Invalid firmware filename. Firmware file name must start with 'firmware' and end with '.bin'");
+            return;
+        }
+        uploads.push({ file: firmwareFile, image: "firmware", sha256: $("#firmware_sha256").val().trim() });
+    }
+    if (spiffsFile) {
+        if (!spiffsFile["name"].startsWith("littlefs") || !spiffsFile["name"].endsWith(".bin")) {
+            showUpdateError("Invalid LittleFS filename. Firmware file name must start with 'littlefs' and end with '.bin'");
+            return;
+        }
+        uploads.push({ file: spiffsFile, image: "littlefs", sha256: $("#spiffs_sha256").val().trim() });
+    }
+    if (uploads.length == 0) {
+        showUpdateError("No file selected.");
+        return;
+    }
+
+    $("#update_progress").show();
+    $("#update_error").hide();
+    $("#firmware_update_modal").addClass("is-active");
+    performUploads(uploads);
 }
 
 // A $( document ).ready() block.
 $(document).ready(function() {
+    connectUpdateSocket();
+
     $("#firmware_file").change(function() {
         firmwareFileSize = $('#firmware_file').prop('files')[0]["size"];
         $("#firmware_file_name").html($('#firmware_file').prop('files')[0]["name"]);
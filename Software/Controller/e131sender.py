@@ -0,0 +1,92 @@
+#!/usr/bin/env python
+# sACN (E1.31) test source. Sends a sine fade on the selected slots, by
+# default to the multicast group of the universe. Run two instances with
+# different --priority to test source arbitration and stop the higher one to
+# see the failover after 2.5 s.
+#
+#   python e131sender.py --universe 1 --priority 100 --stats 192.168.1.50
+#
+# With --stats the controller's receive statistics (parse and merge time per
+# packet) are printed when done.
+import argparse
+import json
+import math
+import socket
+import struct
+import time
+import urllib.request
+import uuid
+
+E131_PORT = 5568
+ACN_ID = b"ASC-E1.17\x00\x00\x00"
+
+
+def flags_length(length):
+    return struct.pack(">H", 0x7000 | length)
+
+
+def data_packet(cid, source_name, priority, sequence, universe, levels, terminate=False):
+    dmp = b"\x02\xa1" + struct.pack(">HHH", 0, 1, len(levels) + 1) + b"\x00" + levels
+    dmp = flags_length(len(dmp) + 2) + dmp
+    options = 0x40 if terminate else 0
+    framing = struct.pack(">I", 0x00000002) + source_name.encode("utf-8")[:63].ljust(64, b"\x00") + \
+        struct.pack(">BHBBH", priority, 0, sequence, options, universe) + dmp
+    framing = flags_length(len(framing) + 2) + framing
+    root = struct.pack(">I", 0x00000004) + cid + framing
+    root = flags_length(len(root) + 2) + root
+    return struct.pack(">HH", 0x0010, 0x0000) + ACN_ID + root
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Send sACN DMX.")
+    parser.add_argument("--host", help="Send unicast to this host instead of multicast")
+    parser.add_argument("--universe", type=int, default=1)
+    parser.add_argument("--priority", type=int, default=100)
+    parser.add_argument("--name", default="e131sender")
+    parser.add_argument("--slots", type=int, nargs="+", default=[1, 2, 3, 4], help="Slots to fade, 1-512")
+    parser.add_argument("--fps", type=float, default=44)
+    parser.add_argument("--period", type=float, default=4, help="Seconds per fade cycle")
+    parser.add_argument("--duration", type=float, default=10, help="Seconds to send, 0 = until stopped")
+    parser.add_argument("--stats", metavar="CONTROLLER", help="Print the receive statistics of this controller when done")
+    args = parser.parse_args()
+
+    cid = uuid.uuid4().bytes
+    if args.host:
+        destination = (args.host, E131_PORT)
+    else:
+        destination = ("239.255.%d.%d" % (args.universe >> 8, args.universe & 0xFF), E131_PORT)
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    sock.setsockopt(socket.IPPROTO_IP, socket.IP_MULTICAST_TTL, 1)
+
+    size = max(args.slots)
+    sequence = 0
+    frames = 0
+    start = time.monotonic()
+    next_frame = start
+    try:
+        while args.duration == 0 or time.monotonic() - start < args.duration:
+            now = time.monotonic()
+            level = int((math.sin((now - start) * 2 * math.pi / args.period) + 1) * 127.5)
+            levels = bytearray(size)
+            for slot in args.slots:
+                levels[slot - 1] = level
+            sock.sendto(data_packet(cid, args.name, args.priority, sequence, args.universe, bytes(levels)), destination)
+            sequence = (sequence + 1) % 256
+            frames += 1
+            next_frame += 1 / args.fps
+            time.sleep(max(0, next_frame - time.monotonic()))
+    except KeyboardInterrupt:
+        pass
+
+    # Tell the receivers that this source is gone so they do not wait for the timeout
+    sock.sendto(data_packet(cid, args.name, args.priority, sequence, args.universe, bytes(size), terminate=True), destination)
+    elapsed = time.monotonic() - start
+    print("Sent %d frames to %s in %.1f s (%.1f fps)" % (frames, destination[0], elapsed, frames / elapsed))
+
+    if args.stats:
+        with urllib.request.urlopen("http://%s/e131" % args.stats, timeout=5) as response:
+            print(json.dumps(json.load(response), indent=4))
+
+
+if __name__ == "__main__":
+    main()
@@ -6,5 +6,13 @@
 #define PIN_BUTTON_4 16
 
 #define PIN_DMX_DATA 17
+#define PIN_DMX_DATA_2 4
 
-#define PIN_FACTORY_RESET 19
\ No newline at end of file
+#define PIN_FACTORY_RESET 19
+// RDM needs DE and /RE of the DMX line driver on a GPIO and its RO connected to the ESP. On the controller board
+// DE and /RE of U2 are pulled high and RO is not connected, so it can only send. Boards reworked for RDM, with
+// DE and /RE lifted off R1 onto IO32 and RO wired to IO33, are built with env:esp32_rdm.
+#ifdef LMAN_BOARD_RDM
+#define PIN_DMX_DIRECTION 32
+#define PIN_DMX_RX 33
+#endif
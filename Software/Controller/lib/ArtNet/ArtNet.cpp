@@ -0,0 +1,153 @@
+#include <ArtNet.h>
+#include <LMANLog.h>
+#include <DMXMerger.h>
+#include <LMANConfig.h>
+#include <WiFi.h>
+
+static const char ARTNET_ID[8] = {'A', 'r', 't', '-', 'N', 'e', 't', 0};
+
+// Make space for variables in memory
+ArtNetReceiver *ArtNetReceiver::instance;
+
+bool ArtNetReceiver::init()
+{
+    if (this->_started)
+    {
+        return true;
+    }
+    ArtNetReceiver::instance = this;
+    if (!this->_udp.listen(ARTNET_PORT))
+    {
+        LOG_ERROR("Failed to listen for Art-Net on port ", ARTNET_PORT);
+        return false;
+    }
+    this->_udp.onPacket([](AsyncUDPPacket &packet)
+                        { ArtNetReceiver::instance->_handlePacket(packet); });
+    this->_started = true;
+    LOG_INFO("Listening for Art-Net universe ", LOG_BOLD, LMANConfig::instance->artnet_universe);
+    return true;
+}
+
+void ArtNetReceiver::_handlePacket(AsyncUDPPacket &packet)
+{
+    // The packet is read straight from the received buffer, nothing is copied before the merge.
+    const uint8_t *data = packet.data();
+    size_t length = packet.length();
+    if (length < 10 || memcmp(data, ARTNET_ID, sizeof(ARTNET_ID)) != 0)
+    {
+        return;
+    }
+
+    uint16_t opCode = data[8] | (data[9] << 8);
+    if (opCode == ARTNET_OP_DMX)
+    {
+        this->_handleDmx(data, length);
+    }
+    else if (opCode == ARTNET_OP_POLL)
+    {
+        this->_sendPollReply(packet);
+    }
+}
+
+void ArtNetReceiver::_handleDmx(const uint8_t *data, size_t length)
+{
+    unsigned long start = micros();
+    if (length < ARTNET_DMX_HEADER_SIZE || ((data[10] << 8) | data[11]) < ARTNET_PROTOCOL_VERSION)
+    {
+        return;
+    }
+
+    uint16_t universe = (data[15] << 8) | data[14];
+    if (universe != LMANConfig::instance->artnet_universe)
+    {
+        this->_otherUniverse++;
+        return;
+    }
+
+    // Sequence 0 means the sender does not use sequence numbers
+    uint8_t sequence = data[12];
+    if (sequence != 0 && this->_lastSequence != 0)
+    {
+        int8_t delta = sequence - this->_lastSequence;
+        if (delta <= 0 && delta > -20)
+        {
+            this->_outOfOrder++;
+            return;
+        }
+    }
+    this->_lastSequence = sequence;
+
+    uint16_t slots = (data[16] << 8) | data[17];
+    if (slots > length - ARTNET_DMX_HEADER_SIZE)
+    {
+        slots = length - ARTNET_DMX_HEADER_SIZE;
+    }
+    DMXMerger::instance->writeNetwork(data + ARTNET_DMX_HEADER_SIZE, slots, ARTNET_TIMEOUT);
+
+    this->_packets++;
+    this->_lastProcessingTime = micros() - start;
+    if (this->_lastProcessingTime > this->_maxProcessingTime)
+    {
+        this->_maxProcessingTime = this->_lastProcessingTime;
+    }
+    this->_updateRate();
+}
+
+void ArtNetReceiver::_sendPollReply(AsyncUDPPacket &packet)
+{
+    ArtPollReply reply;
+    memset(&reply, 0, sizeof(reply));
+    memcpy(reply.id, ARTNET_ID, sizeof(ARTNET_ID));
+    reply.opCode = ARTNET_OP_POLL_REPLY;
+    IPAddress ip = WiFi.localIP();
+    for (int i = 0; i < 4; i++)
+    {
+        reply.ip[i] = ip[i];
+        reply.bindIp[i] = ip[i];
+    }
+    reply.port = ARTNET_PORT;
+    uint16_t universe = LMANConfig::instance->artnet_universe;
+    reply.netSwitch = (universe >> 8) & 0x7F;
+    reply.subSwitch = (universe >> 4) & 0x0F;
+    reply.swOut[0] = universe & 0x0F;
+    reply.numPortsLo = 1;
+    reply.portTypes[0] = 0x80; // Output from Art-Net to DMX512
+    reply.goodOutput[0] = DMXMerger::instance->isNetworkActive() ? 0x80 : 0x00;
+    reply.status2 = 0x08; // Supports 15 bit port addresses
+    strncpy(reply.shortName, LMANConfig::instance->wifi_hostname.c_str(), sizeof(reply.shortName) - 1);
+    strncpy(reply.longName, "DMX512 Controller", sizeof(reply.longName) - 1);
+    snprintf(reply.nodeReport, sizeof(reply.nodeReport), "#0001 [%04u] OK", (unsigned int)(this->_packets % 10000));
+    WiFi.macAddress(reply.mac);
+    reply.bindIndex = 1;
+    this->_udp.writeTo((uint8_t *)&reply, sizeof(reply), packet.remoteIP(), ARTNET_PORT);
+}
+
+void ArtNetReceiver::_updateRate()
+{
+    unsigned long now = millis();
+    if (now - this->_lastRateUpdate >= 1000)
+    {
+        this->_packetsPerSecond = ((this->_packets - this->_packetsAtLastRate) * 1000) / (now - this->_lastRateUpdate);
+        this->_packetsAtLastRate = this->_packets;
+        this->_lastRateUpdate = now;
+        LOG_TRACE("Art-Net: ", this->_packetsPerSecond, " packets/s, processing ", this->_lastProcessingTime, " us");
+    }
+}
+
+size_t ArtNetReceiver::getStatusJson(char *buffer, size_t size)
+{
+    if (millis() - this->_lastRateUpdate > 2000)
+    {
+        this->_packetsPerSecond = 0; // No packets received recently
+    }
+    return snprintf(buffer, size, "{\"enabled\":%s,\"universe\":%u,\"active\":%s,\"packets\":%u,\"packets_per_second\":%u,\"out_of_order\":%u,\"other_universe\":%u,\"processing_us\":%u,\"max_processing_us\":%u}",
+                    this->_started ? "true" : "false",
+                    (unsigned int)LMANConfig::instance->artnet_universe,
+                    DMXMerger::instance->isNetworkActive() ? "true" : "false",
+                    (unsigned int)this->_packets,
+                    (unsigned int)this->_packetsPerSecond,
+                    (unsigned int)this->_outOfOrder,
+                    (unsigned int)this->_otherUniverse,
+                    (unsigned int)this->_lastProcessingTime,
+                    (unsigned int)this->_maxProcessingTime);
+}
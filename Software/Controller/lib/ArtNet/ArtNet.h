@@ -0,0 +1,96 @@
+#ifndef LMAN_ARTNET
+#define LMAN_ARTNET
+
+#include <Arduino.h>
+#include <AsyncUDP.h>
+
+#define ARTNET_PORT 6454
+#define ARTNET_OP_POLL 0x2000
+#define ARTNET_OP_POLL_REPLY 0x2100
+#define ARTNET_OP_DMX 0x5000
+/// @brief Lowest protocol version accepted
+#define ARTNET_PROTOCOL_VERSION 14
+/// @brief Time (in ms) without ArtDmx before local levels are output again
+#define ARTNET_TIMEOUT 10000
+/// @brief Offset of the DMX data in an ArtDmx packet
+#define ARTNET_DMX_HEADER_SIZE 18
+
+/// @brief ArtPollReply as defined by the Art-Net 4 specification
+struct __attribute__((packed)) ArtPollReply
+{
+    char id[8];
+    uint16_t opCode;
+    uint8_t ip[4];
+    uint16_t port;
+    uint8_t versInfoHi;
+    uint8_t versInfoLo;
+    uint8_t netSwitch;
+    uint8_t subSwitch;
+    uint8_t oemHi;
+    uint8_t oem;
+    uint8_t ubeaVersion;
+    uint8_t status1;
+    uint16_t estaMan;
+    char shortName[18];
+    char longName[64];
+    char nodeReport[64];
+    uint8_t numPortsHi;
+    uint8_t numPortsLo;
+    uint8_t portTypes[4];
+    uint8_t goodInput[4];
+    uint8_t goodOutput[4];
+    uint8_t swIn[4];
+    uint8_t swOut[4];
+    uint8_t swVideo;
+    uint8_t swMacro;
+    uint8_t swRemote;
+    uint8_t spare[3];
+    uint8_t style;
+    uint8_t mac[6];
+    uint8_t bindIp[4];
+    uint8_t bindIndex;
+    uint8_t status2;
+    uint8_t filler[26];
+};
+
+/// @brief Receives ArtDmx for the configured universe and merges it into the DMX output through DMXMerger.
+/// Answers ArtPoll so that consoles can discover the controller.
+class ArtNetReceiver
+{
+public:
+    /// @brief Start listening for Art-Net. Does nothing if already started.
+    /// @return True if listening
+    bool init();
+    /// @brief The instance of the receiver started with .init();
+    static ArtNetReceiver *instance;
+    /// @brief Describe the receive statistics as JSON
+    /// @param buffer The buffer to write to
+    /// @param size The size of the buffer
+    /// @return The length of the written JSON
+    size_t getStatusJson(char *buffer, size_t size);
+
+private:
+    void _handlePacket(AsyncUDPPacket &packet);
+    void _handleDmx(const uint8_t *data, size_t length);
+    void _sendPollReply(AsyncUDPPacket &packet);
+    /// @brief Calculate packets/s once every second
+    void _updateRate();
+    AsyncUDP _udp;
+    bool _started = false;
+    uint8_t _lastSequence = 0;
+
+    /// @brief ArtDmx packets merged into the output
+    uint32_t _packets = 0;
+    /// @brief ArtDmx packets dropped as out of order
+    uint32_t _outOfOrder = 0;
+    /// @brief ArtDmx packets for other universes
+    uint32_t _otherUniverse = 0;
+    uint32_t _packetsAtLastRate = 0;
+    unsigned long _lastRateUpdate = 0;
+    uint16_t _packetsPerSecond = 0;
+    /// @brief Time (in us) from receiving a packet until it is in the output buffer
+    uint32_t _lastProcessingTime = 0;
+    uint32_t _maxProcessingTime = 0;
+};
+
+#endif
@@ -0,0 +1,246 @@
+#include <Color.h>
+#include <string.h>
+
+const uint8_t FIXTURE_SLOTS[FIXTURE_TYPE_COUNT] = {1, 3, 4, 2};
+const char *const COLOR_MODE_NAMES[COLOR_MODE_COUNT] = {"hs", "rgb", "rgbw", "color_temp"};
+
+// Red, green and blue of a black body at the warm and cold end, color temperatures are blended between them.
+static const uint8_t WARM_RGB[3] = {255, 166, 87};
+static const uint8_t COLD_RGB[3] = {255, 249, 251};
+
+bool Color::operator==(const Color &other) const
+{
+    return this->mode == other.mode && this->hue == other.hue && this->saturation == other.saturation &&
+           this->mireds == other.mireds && memcmp(this->rgbw, other.rgbw, sizeof(this->rgbw)) == 0;
+}
+
+/// @brief Scale a level by a 16 bit brightness, 65535 = 1.0
+static inline uint8_t scale(uint8_t value, uint16_t level)
+{
+    return ((uint32_t)value * level + 0x8000) >> 16;
+}
+
+/// @brief Blend two values, position 65535 = to
+static inline int32_t blend(int32_t from, int32_t to, uint16_t position)
+{
+    return from + ((to - from) * (int64_t)position) / 65535;
+}
+
+/// @brief Position of a color temperature between the warm (0) and cold (255) white
+static inline uint8_t coldFraction(uint16_t mireds)
+{
+    if (mireds >= FIXTURE_WARM_MIREDS)
+    {
+        return 0;
+    }
+    if (mireds <= FIXTURE_COLD_MIREDS)
+    {
+        return 255;
+    }
+    return (FIXTURE_WARM_MIREDS - mireds) * 255 / (FIXTURE_WARM_MIREDS - FIXTURE_COLD_MIREDS);
+}
+
+void colorToRgb(const Color &color, uint8_t *rgb)
+{
+    switch (color.mode)
+    {
+    case COLOR_MODE_RGB:
+        memcpy(rgb, color.rgbw, 3);
+        break;
+    case COLOR_MODE_RGBW:
+        for (uint8_t i = 0; i < 3; i++)
+        {
+            uint16_t value = color.rgbw[i] + color.rgbw[3];
+            rgb[i] = value > 255 ? 255 : value;
+        }
+        break;
+    case COLOR_MODE_COLOR_TEMP:
+    {
+        uint8_t cold = coldFraction(color.mireds);
+        for (uint8_t i = 0; i < 3; i++)
+        {
+            rgb[i] = WARM_RGB[i] + ((COLD_RGB[i] - WARM_RGB[i]) * cold) / 255;
+        }
+        break;
+    }
+    default:
+    {
+        // Six sectors of the color wheel, in each one component rises or falls while the others are at the top or bottom
+        uint32_t position = (uint32_t)color.hue * 6;
+        uint8_t sector = position >> 16;
+        uint8_t fraction = position >> 8;
+        uint8_t bottom = 255 - color.saturation;
+        uint8_t falling = 255 - (color.saturation * fraction) / 255;
+        uint8_t rising = 255 - (color.saturation * (255 - fraction)) / 255;
+        switch (sector)
+        {
+        case 0:
+            rgb[0] = 255, rgb[1] = rising, rgb[2] = bottom;
+            break;
+        case 1:
+            rgb[0] = falling, rgb[1] = 255, rgb[2] = bottom;
+            break;
+        case 2:
+            rgb[0] = bottom, rgb[1] = 255, rgb[2] = rising;
+            break;
+        case 3:
+            rgb[0] = bottom, rgb[1] = falling, rgb[2] = 255;
+            break;
+        case 4:
+            rgb[0] = rising, rgb[1] = bottom, rgb[2] = 255;
+            break;
+        default:
+            rgb[0] = 255, rgb[1] = bottom, rgb[2] = falling;
+            break;
+        }
+        break;
+    }
+    }
+}
+
+void colorRgbToHs(const uint8_t *rgb, uint16_t &hue, uint8_t &saturation)
+{
+    uint8_t max = rgb[0] > rgb[1] ? (rgb[0] > rgb[2] ? rgb[0] : rgb[2]) : (rgb[1] > rgb[2] ? rgb[1] : rgb[2]);
+    uint8_t min = rgb[0] < rgb[1] ? (rgb[0] < rgb[2] ? rgb[0] : rgb[2]) : (rgb[1] < rgb[2] ? rgb[1] : rgb[2]);
+    int32_t delta = max - min;
+    if (delta == 0)
+    {
+        hue = 0;
+        saturation = 0;
+        return;
+    }
+    saturation = delta * 255 / max;
+    int32_t position;
+    if (max == rgb[0])
+    {
+        position = ((int32_t)rgb[1] - rgb[2]) * 65536 / (6 * delta);
+    }
+    else if (max == rgb[1])
+    {
+        position = 65536 / 3 + ((int32_t)rgb[2] - rgb[0]) * 65536 / (6 * delta);
+    }
+    else
+    {
+        position = 2 * 65536 / 3 + ((int32_t)rgb[0] - rgb[1]) * 65536 / (6 * delta);
+    }
+    // Negative positions wrap around to the end of the wheel
+    hue = (uint16_t)position;
+}
+
+Color colorInterpolate(const Color &from, const Color &to, uint16_t position)
+{
+    if (position == 0)
+    {
+        return from;
+    }
+    if (position == 65535)
+    {
+        return to;
+    }
+    Color result;
+    if (from.mode == COLOR_MODE_COLOR_TEMP && to.mode == COLOR_MODE_COLOR_TEMP)
+    {
+        // Mireds are close to evenly spaced for the eye, Kelvin are not
+        result.mode = COLOR_MODE_COLOR_TEMP;
+        result.mireds = blend(from.mireds, to.mireds, position);
+        return result;
+    }
+    if ((from.mode == COLOR_MODE_HS || from.mode == COLOR_MODE_RGB) && (to.mode == COLOR_MODE_HS || to.mode == COLOR_MODE_RGB))
+    {
+        uint16_t fromHue = from.hue, toHue = to.hue;
+        uint8_t fromSaturation = from.saturation, toSaturation = to.saturation;
+        if (from.mode == COLOR_MODE_RGB)
+        {
+            colorRgbToHs(from.rgbw, fromHue, fromSaturation);
+        }
+        if (to.mode == COLOR_MODE_RGB)
+        {
+            colorRgbToHs(to.rgbw, toHue, toSaturation);
+        }
+        // White has no hue, fade the saturation only instead of sweeping through the wheel
+        if (fromSaturation == 0)
+        {
+            fromHue = toHue;
+        }
+        else if (toSaturation == 0)
+        {
+            toHue = fromHue;
+        }
+        result.mode = COLOR_MODE_HS;
+        result.hue = fromHue + blend(0, (int16_t)(toHue - fromHue), position);
+        result.saturation = blend(fromSaturation, toSaturation, position);
+        return result;
+    }
+    uint8_t fromRgbw[4] = {0, 0, 0, 0};
+    uint8_t toRgbw[4] = {0, 0, 0, 0};
+    if (from.mode == COLOR_MODE_RGBW)
+    {
+        memcpy(fromRgbw, from.rgbw, 4);
+    }
+    else
+    {
+        colorToRgb(from, fromRgbw);
+    }
+    if (to.mode == COLOR_MODE_RGBW)
+    {
+        memcpy(toRgbw, to.rgbw, 4);
+    }
+    else
+    {
+        colorToRgb(to, toRgbw);
+    }
+    result.mode = COLOR_MODE_RGBW;
+    for (uint8_t i = 0; i < 4; i++)
+    {
+        result.rgbw[i] = blend(fromRgbw[i], toRgbw[i], position);
+    }
+    return result;
+}
+
+void colorRender(const Color *colors, const uint8_t *types, const uint16_t *levels, uint8_t *slots, uint16_t count)
+{
+    for (uint16_t i = 0; i < count; i++)
+    {
+        const Color &color = colors[i];
+        uint8_t *out = slots + i * FIXTURE_MAX_SLOTS;
+        uint8_t full[FIXTURE_MAX_SLOTS] = {0, 0, 0, 0};
+        switch (types[i])
+        {
+        case FIXTURE_RGB:
+            colorToRgb(color, full);
+            break;
+        case FIXTURE_RGBW:
+            if (color.mode == COLOR_MODE_RGBW)
+            {
+                memcpy(full, color.rgbw, 4);
+            }
+            else
+            {
+                // The part all three colors share is sent to the white LEDs
+                colorToRgb(color, full);
+                uint8_t white = full[0] < full[1] ? (full[0] < full[2] ? full[0] : full[2]) : (full[1] < full[2] ? full[1] : full[2]);
+                full[0] -= white;
+                full[1] -= white;
+                full[2] -= white;
+                full[3] = white;
+            }
+            break;
+        case FIXTURE_CCT:
+        {
+            // Warm and cold add up to full so that the brightness stays the same across the range
+            Color white;
+            uint8_t cold = coldFraction(color.mode == COLOR_MODE_COLOR_TEMP ? color.mireds : white.mireds);
+            full[0] = 255 - cold;
+            full[1] = cold;
+            break;
+        }
+        default:
+            full[0] = 255;
+            break;
+        }
+        for (uint8_t slot = 0; slot < FIXTURE_MAX_SLOTS; slot++)
+        {
+            out[slot] = scale(full[slot], levels[i]);
+        }
+    }
+}
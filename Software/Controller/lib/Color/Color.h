@@ -0,0 +1,75 @@
+#ifndef LMAN_COLOR
+#define LMAN_COLOR
+
+#include <stdint.h>
+
+/// @brief Color temperature of the warm white LEDs of tunable white fixtures, 2700 K
+#define FIXTURE_WARM_MIREDS 370
+/// @brief Color temperature of the cold white LEDs of tunable white fixtures, 6500 K
+#define FIXTURE_COLD_MIREDS 153
+/// @brief Most slots a fixture uses
+#define FIXTURE_MAX_SLOTS 4
+
+/// @brief What is connected to a channel. Stored in ChannelConfig::type.
+enum FixtureType : uint8_t
+{
+    /// @brief A single dimmer slot, two for 16 bit channels
+    FIXTURE_DIMMER = 0,
+    /// @brief Red, green and blue slots
+    FIXTURE_RGB,
+    /// @brief Red, green, blue and white slots
+    FIXTURE_RGBW,
+    /// @brief Tunable white, warm and cold white slots
+    FIXTURE_CCT,
+    FIXTURE_TYPE_COUNT,
+};
+
+/// @brief The number of consecutive slots of each fixture type
+extern const uint8_t FIXTURE_SLOTS[FIXTURE_TYPE_COUNT];
+
+/// @brief How a color was set, the Home Assistant color mode it is reported in
+enum ColorMode : uint8_t
+{
+    COLOR_MODE_HS = 0,
+    COLOR_MODE_RGB,
+    COLOR_MODE_RGBW,
+    COLOR_MODE_COLOR_TEMP,
+    COLOR_MODE_COUNT,
+};
+
+/// @brief The color mode names, as used by Home Assistant
+extern const char *const COLOR_MODE_NAMES[COLOR_MODE_COUNT];
+
+/// @brief A color at full brightness. The brightness is the level of the channel. Only the fields of the mode are used.
+struct Color
+{
+    uint8_t mode = COLOR_MODE_HS;
+    /// @brief Hue, a full uint16_t range is 360 degrees
+    uint16_t hue = 0;
+    uint8_t saturation = 0;
+    /// @brief Color temperature in mireds (1000000 / K)
+    uint16_t mireds = (FIXTURE_WARM_MIREDS + FIXTURE_COLD_MIREDS) / 2;
+    /// @brief Red, green, blue and white for COLOR_MODE_RGB and COLOR_MODE_RGBW
+    uint8_t rgbw[4] = {0, 0, 0, 0};
+
+    bool operator==(const Color &other) const;
+    bool operator!=(const Color &other) const { return !(*this == other); }
+};
+
+/// @brief Convert a color to red, green and blue at full brightness, hue and saturation to the largest component of 255
+void colorToRgb(const Color &color, uint8_t *rgb);
+/// @brief Find the hue and saturation of a red, green and blue color
+void colorRgbToHs(const uint8_t *rgb, uint16_t &hue, uint8_t &saturation);
+/// @brief Blend two colors. Hue takes the shorter way around the color wheel and color temperatures are blended in mireds,
+/// so that the steps look even. Other mixes are blended per component.
+/// @param position 0 = from, 65535 = to
+Color colorInterpolate(const Color &from, const Color &to, uint16_t position);
+/// @brief Calculate the slot levels of many fixtures in one pass
+/// @param colors The color of each fixture
+/// @param types The FixtureType of each fixture
+/// @param levels The 16 bit brightness of each fixture
+/// @param slots FIXTURE_MAX_SLOTS levels per fixture, of which the first FIXTURE_SLOTS[type] are set
+/// @param count The number of fixtures
+void colorRender(const Color *colors, const uint8_t *types, const uint16_t *levels, uint8_t *slots, uint16_t count);
+
+#endif
@@ -0,0 +1,174 @@
+#include <DMXMerger.h>
+#include <LMANLog.h>
+#include <LMANConfig.h>
+
+// Make space for variables in memory
+DMXMerger *DMXMerger::instance;
+
+void DMXMerger::init(DMXOutput *dmx, TaskHandle_t *dmxSendTask)
+{
+    if (!DMXMerger::instance)
+    {
+        DMXMerger::instance = this;
+    }
+    this->_dmx = dmx;
+    this->_dmx->setFrameLock(&this->_mux);
+    this->_dmxSendTask = dmxSendTask;
+    this->_updateSlotCount();
+}
+
+void DMXMerger::setLocalSlotCount(uint16_t slotCount)
+{
+    this->_localSlotCount = slotCount > DMX_UNIVERSE_SIZE ? DMX_UNIVERSE_SIZE : slotCount;
+    this->_updateSlotCount();
+    this->notifySendTask();
+}
+
+void DMXMerger::_updateSlotCount()
+{
+    this->_dmx->setSlotCount(this->getSlotCount());
+}
+
+uint8_t DMXMerger::_merge(uint16_t slot, uint8_t mode)
+{
+    if (!this->_networkActive)
+    {
+        return this->_local[slot];
+    }
+    if (mode == DMX_MERGE_LTP)
+    {
+        return this->_networkOwnsSlot[slot] ? this->_network[slot] : this->_local[slot];
+    }
+    return this->_network[slot] > this->_local[slot] ? this->_network[slot] : this->_local[slot];
+}
+
+void DMXMerger::writeLocal(uint16_t slot, uint8_t value)
+{
+    if (slot < 1 || slot > DMX_UNIVERSE_SIZE)
+    {
+        return;
+    }
+    uint8_t mode = LMANConfig::instance->dmx_merge_mode;
+    portENTER_CRITICAL(&this->_mux);
+    this->_writeLocal(slot, value, mode);
+    portEXIT_CRITICAL(&this->_mux);
+}
+
+void DMXMerger::writeLocal16(uint16_t slot, uint16_t value)
+{
+    uint8_t values[2] = {(uint8_t)(value >> 8), (uint8_t)(value & 0xFF)};
+    this->writeLocalSlots(slot, values, 2);
+}
+
+void DMXMerger::writeLocalSlots(uint16_t slot, const uint8_t *values, uint8_t count)
+{
+    if (slot < 1 || slot + count - 1 > DMX_UNIVERSE_SIZE)
+    {
+        return;
+    }
+    uint8_t mode = LMANConfig::instance->dmx_merge_mode;
+    portENTER_CRITICAL(&this->_mux);
+    for (uint8_t i = 0; i < count; i++)
+    {
+        this->_writeLocal(slot + i, values[i], mode);
+    }
+    portEXIT_CRITICAL(&this->_mux);
+}
+
+void DMXMerger::_writeLocal(uint16_t slot, uint8_t value, uint8_t mode)
+{
+    if (this->_local[slot] != value)
+    {
+        this->_networkOwnsSlot[slot] = false;
+    }
+    this->_local[slot] = value;
+    this->_dmx->write(slot, this->_merge(slot, mode));
+}
+
+void DMXMerger::writeNetwork(const uint8_t *data, uint16_t length, uint16_t timeout)
+{
+    this->writeNetworkSlots(1, data, length, timeout);
+}
+
+void DMXMerger::writeNetworkSlots(uint16_t slot, const uint8_t *data, uint16_t count, uint16_t timeout)
+{
+    if (slot < 1 || slot > DMX_UNIVERSE_SIZE)
+    {
+        return;
+    }
+    if (count > DMX_UNIVERSE_SIZE - slot + 1)
+    {
+        count = DMX_UNIVERSE_SIZE - slot + 1;
+    }
+    uint16_t last = slot + count - 1;
+    uint8_t mode = LMANConfig::instance->dmx_merge_mode;
+    bool wasActive = this->_networkActive;
+    portENTER_CRITICAL(&this->_mux);
+    this->_networkActive = true;
+    for (uint16_t i = 0; i < count; i++)
+    {
+        uint8_t value = data[i];
+        // A new source takes all slots, after that only the slots it changes
+        if (!wasActive || this->_network[slot + i] != value)
+        {
+            this->_networkOwnsSlot[slot + i] = true;
+        }
+        this->_network[slot + i] = value;
+        this->_dmx->write(slot + i, this->_merge(slot + i, mode));
+    }
+    this->_lastNetworkData = millis();
+    this->_networkTimeout = timeout;
+    // A source that sends fewer slots than before leaves the rest at the last level it sent
+    if (last > this->_networkSlotCount)
+    {
+        this->_networkSlotCount = last;
+    }
+    portEXIT_CRITICAL(&this->_mux);
+    this->_updateSlotCount();
+
+    if (!wasActive)
+    {
+        LOG_INFO("Network DMX source active, merging ", mode == DMX_MERGE_LTP ? "LTP" : "HTP");
+    }
+    this->notifySendTask();
+}
+
+void DMXMerger::checkNetworkTimeout()
+{
+    if (!this->_networkActive || millis() - this->_lastNetworkData < this->_networkTimeout)
+    {
+        return;
+    }
+
+    LOG_WARNING("Network DMX source timed out, output local levels.");
+    portENTER_CRITICAL(&this->_mux);
+    this->_networkActive = false;
+    for (uint16_t slot = 1; slot <= this->_networkSlotCount; slot++)
+    {
+        this->_network[slot] = 0;
+        this->_networkOwnsSlot[slot] = false;
+        this->_dmx->write(slot, this->_local[slot]);
+    }
+    this->_networkSlotCount = 0;
+    portEXIT_CRITICAL(&this->_mux);
+    this->_updateSlotCount();
+    this->notifySendTask();
+}
+
+void DMXMerger::notifySendTask()
+{
+    if (this->_dmxSendTask && *this->_dmxSendTask)
+    {
+        xTaskNotifyGive(*this->_dmxSendTask);
+    }
+}
+
+bool DMXMerger::isNetworkActive()
+{
+    return this->_networkActive;
+}
+
+uint16_t DMXMerger::getSlotCount()
+{
+    return this->_networkSlotCount > this->_localSlotCount ? this->_networkSlotCount : this->_localSlotCount;
+}
@@ -0,0 +1,88 @@
+#ifndef LMAN_DMX_MERGER
+#define LMAN_DMX_MERGER
+
+#include <Arduino.h>
+#include <DMXOutput.h>
+
+/// @brief How network and local levels are combined. Stored in LMANConfig::dmx_merge_mode.
+enum DMXMergeMode : uint8_t
+{
+    /// @brief Highest takes precedence, output the highest of the network and local level
+    DMX_MERGE_HTP = 0,
+    /// @brief Latest takes precedence, output the level that changed last
+    DMX_MERGE_LTP = 1,
+};
+
+/// @brief Merges levels from the local controls (LightManager) with levels received over the network
+/// (Art-Net, sACN, raw MQTT) into the buffer that is sent on the DMX bus. Sizes the output to the highest slot either of them uses.
+class DMXMerger
+{
+public:
+    /// @brief Initialize the merger
+    /// @param dmx The DMX handler that holds the output buffer
+    /// @param dmxSendTask The task that sends the DMX buffer, notified on changes
+    void init(DMXOutput *dmx, TaskHandle_t *dmxSendTask);
+    /// @brief The first merger started with .init(), the one of universe 1. Art-Net and sACN levels are merged into it.
+    static DMXMerger *instance;
+    /// @brief Set the level of a slot from the local controls
+    /// @param slot The DMX slot, 1-512
+    /// @param value The level
+    void writeLocal(uint16_t slot, uint8_t value);
+    /// @brief Set a 16 bit level from the local controls, the coarse level on slot and the fine level on slot + 1.
+    /// Both are written under the frame lock of the output, so that no frame is sent with only one of them changed.
+    /// @param slot The DMX slot of the coarse level, 1-511
+    /// @param value The 16 bit level
+    void writeLocal16(uint16_t slot, uint16_t value);
+    /// @brief Set the levels of consecutive slots from the local controls in one step, for fixtures that span several slots
+    /// @param slot The first DMX slot
+    /// @param values The levels
+    /// @param count The number of slots
+    void writeLocalSlots(uint16_t slot, const uint8_t *values, uint8_t count);
+    /// @brief Set the highest slot used by the local controls
+    void setLocalSlotCount(uint16_t slotCount);
+    /// @brief Merge received network levels into the output. The output grows to the number of received levels.
+    /// @param data The levels, starting at slot 1
+    /// @param length The number of levels in data
+    /// @param timeout Time (in ms) without network data before local levels are output again
+    void writeNetwork(const uint8_t *data, uint16_t length, uint16_t timeout);
+    /// @brief Merge received network levels of consecutive slots into the output, for sources that only send part of the universe.
+    /// Slots before the first one keep the network level they had.
+    /// @param slot The first DMX slot, 1-512
+    /// @param data The levels
+    /// @param count The number of levels in data, cut off at slot 512
+    /// @param timeout Time (in ms) without network data before local levels are output again
+    void writeNetworkSlots(uint16_t slot, const uint8_t *data, uint16_t count, uint16_t timeout);
+    /// @brief Drop the network levels if none have been received within the timeout. Called by the DMX send task.
+    void checkNetworkTimeout();
+    /// @brief Wether network levels are currently merged into the output
+    bool isNetworkActive();
+    /// @brief The number of slots that are output, the highest of the local and network slot count
+    uint16_t getSlotCount();
+    /// @brief Wake the task that sends this merger's output
+    void notifySendTask();
+
+private:
+    /// @brief Calculate the output level of a slot. Must be called with _mux held.
+    uint8_t _merge(uint16_t slot, uint8_t mode);
+    /// @brief Set the local level of a slot and update the output. Must be called with _mux held.
+    void _writeLocal(uint16_t slot, uint8_t value, uint8_t mode);
+    /// @brief Resize the output to the slots in use
+    void _updateSlotCount();
+    DMXOutput *_dmx;
+    TaskHandle_t *_dmxSendTask;
+    uint16_t _localSlotCount = 0;
+    /// @brief Number of levels in the last network packet, 0 while no network source is active
+    uint16_t _networkSlotCount = 0;
+    uint8_t _local[DMX_UNIVERSE_SIZE + 1] = {0};
+    uint8_t _network[DMX_UNIVERSE_SIZE + 1] = {0};
+    /// @brief For LTP, true if the network changed the slot after the local controls did
+    bool _networkOwnsSlot[DMX_UNIVERSE_SIZE + 1] = {false};
+    volatile bool _networkActive = false;
+    volatile unsigned long _lastNetworkData = 0;
+    volatile uint16_t _networkTimeout = 0;
+    /// @brief Guards the layers and the output buffer. Network data arrives on the lwIP task, local levels on LightManager tasks,
+    /// the send task copies the frame under it.
+    portMUX_TYPE _mux = portMUX_INITIALIZER_UNLOCKED;
+};
+
+#endif
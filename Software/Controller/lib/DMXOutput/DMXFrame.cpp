@@ -0,0 +1,56 @@
+#include <DMXFrame.h>
+
+void DMXFrame::setSlotCount(uint16_t slotCount)
+{
+    if (slotCount < DMX_MIN_SLOTS)
+    {
+        slotCount = DMX_MIN_SLOTS;
+    }
+    else if (slotCount > DMX_UNIVERSE_SIZE)
+    {
+        slotCount = DMX_UNIVERSE_SIZE;
+    }
+    this->_slotCount = slotCount;
+}
+
+uint16_t DMXFrame::getSlotCount()
+{
+    return this->_slotCount;
+}
+
+void DMXFrame::write(uint16_t slot, uint8_t value)
+{
+    if (slot >= 1 && slot <= DMX_UNIVERSE_SIZE)
+    {
+        this->_data[slot] = value;
+    }
+}
+
+uint8_t DMXFrame::read(uint16_t slot)
+{
+    if (slot >= 1 && slot <= DMX_UNIVERSE_SIZE)
+    {
+        return this->_data[slot];
+    }
+    return 0;
+}
+
+const uint8_t *DMXFrame::data()
+{
+    return this->_data;
+}
+
+uint16_t DMXFrame::length()
+{
+    return this->_slotCount + 1;
+}
+
+uint32_t DMXFrame::getFrameTime()
+{
+    return (DMX_BREAK_BITS + DMX_MAB_BITS) * DMX_BIT_TIME + this->length() * DMX_SLOT_TIME;
+}
+
+uint16_t DMXFrame::getMaxFrameRate()
+{
+    return 1000000UL / this->getFrameTime();
+}
@@ -0,0 +1,51 @@
+#ifndef LMAN_DMX_FRAME
+#define LMAN_DMX_FRAME
+
+#include <stdint.h>
+
+/// @brief The number of slots in a DMX universe
+#define DMX_UNIVERSE_SIZE 512
+#define DMX_BAUD_RATE 250000
+/// @brief Time of one bit in us
+#define DMX_BIT_TIME 4
+/// @brief Time of one slot in us: start bit, 8 data bits and 2 stop bits
+#define DMX_SLOT_TIME (11 * DMX_BIT_TIME)
+/// @brief Length of the break in bit times. 100 us, DMX512-A requires at least 92 us from a transmitter.
+#define DMX_BREAK_BITS 25
+/// @brief Length of the mark after break in bit times. 16 us, DMX512-A requires at least 12 us.
+#define DMX_MAB_BITS 4
+/// @brief Shortest frame in slots. With break and MAB it takes the 1204 us DMX512-A requires from break to break.
+#define DMX_MIN_SLOTS 24
+/// @brief Start code of a frame with dimmer levels
+#define DMX_START_CODE 0x00
+
+/// @brief The levels of one DMX frame and its timing on the line. Has no hardware dependencies so that it can be tested on the host.
+class DMXFrame
+{
+public:
+    /// @brief Set the number of slots that are sent. Padded to DMX_MIN_SLOTS, at most 512.
+    void setSlotCount(uint16_t slotCount);
+    uint16_t getSlotCount();
+    /// @brief Set the level of a slot. Slots past the slot count keep their level and are sent once the frame grows.
+    /// @param slot The slot, 1-512
+    /// @param value The level
+    void write(uint16_t slot, uint8_t value);
+    /// @brief Read the level of a slot
+    /// @param slot The slot, 1-512
+    /// @return The level, 0 for slots outside of the universe
+    uint8_t read(uint16_t slot);
+    /// @brief The start code followed by the levels, as sent on the line
+    const uint8_t *data();
+    /// @brief The number of bytes in data(), the start code and all slots
+    uint16_t length();
+    /// @brief Time from the start of the break until the last stop bit of the frame in us
+    uint32_t getFrameTime();
+    /// @brief The highest number of frames per second this frame can be sent at
+    uint16_t getMaxFrameRate();
+
+private:
+    uint16_t _slotCount = DMX_MIN_SLOTS;
+    uint8_t _data[DMX_UNIVERSE_SIZE + 1] = {DMX_START_CODE};
+};
+
+#endif
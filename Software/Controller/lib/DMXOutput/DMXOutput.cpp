@@ -0,0 +1,240 @@
+#include <DMXOutput.h>
+#include <LMANLog.h>
+#include <LMANConfig.h>
+
+DMXOutput *DMXOutput::instances[DMX_OUTPUT_COUNT];
+
+bool DMXOutput::init(uint8_t universe, uart_port_t port, int txPin)
+{
+    DMXOutput::instances[universe - 1] = this;
+    this->_universe = universe;
+    this->_port = port;
+
+    uart_config_t config = {};
+    config.baud_rate = DMX_BAUD_RATE;
+    config.data_bits = UART_DATA_8_BITS;
+    config.parity = UART_PARITY_DISABLE;
+    config.stop_bits = UART_STOP_BITS_2;
+    config.flow_ctrl = UART_HW_FLOWCTRL_DISABLE;
+    config.source_clk = UART_SCLK_APB;
+    esp_err_t err = uart_param_config(port, &config);
+    if (err == ESP_OK)
+    {
+        err = uart_set_pin(port, txPin, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE);
+    }
+    if (err == ESP_OK)
+    {
+        // The RX buffer must be larger than the FIFO even though nothing is received.
+        err = uart_driver_install(port, 256, DMX_OUTPUT_TX_BUFFER_SIZE, 0, NULL, 0);
+    }
+    if (err == ESP_OK)
+    {
+        // The idle time after the break that ends each frame is the mark after break of the next one.
+        err = uart_set_tx_idle_num(port, DMX_MAB_BITS);
+    }
+    if (err != ESP_OK)
+    {
+        LOG_ERROR("Failed to set up DMX output ", LOG_BOLD, universe, LOG_RESET_DECORATIONS, ": ", LOG_BOLD, esp_err_to_name(err));
+        return false;
+    }
+    this->_initialized = true;
+    this->update();
+    return true;
+}
+
+bool DMXOutput::initRdm(int directionPin, int rxPin)
+{
+    if (!this->_initialized)
+    {
+        return false;
+    }
+    esp_err_t err = uart_set_pin(this->_port, UART_PIN_NO_CHANGE, rxPin, UART_PIN_NO_CHANGE, UART_PIN_NO_CHANGE);
+    if (err != ESP_OK)
+    {
+        LOG_ERROR("Failed to set up RDM on DMX output ", LOG_BOLD, this->_universe, LOG_RESET_DECORATIONS, ": ", LOG_BOLD, esp_err_to_name(err));
+        return false;
+    }
+    pinMode(directionPin, OUTPUT);
+    digitalWrite(directionPin, HIGH);
+    this->_directionPin = directionPin;
+    return true;
+}
+
+size_t DMXOutput::transact(const uint8_t *request, size_t length, uint8_t *response, size_t size)
+{
+    if (this->_directionPin < 0)
+    {
+        return 0;
+    }
+    // The break that ends the current frame is the break of the request.
+    uart_wait_tx_done(this->_port, pdMS_TO_TICKS(DMX_OUTPUT_WAIT_TIME));
+    uart_write_bytes(this->_port, request, length);
+    uart_wait_tx_done(this->_port, pdMS_TO_TICKS(DMX_OUTPUT_WAIT_TIME));
+
+    digitalWrite(this->_directionPin, LOW);
+    // Anything the receiver picked up while it was disabled is noise.
+    uart_flush_input(this->_port);
+    int received = uart_read_bytes(this->_port, response, size, pdMS_TO_TICKS(DMX_RDM_RESPONSE_TIME));
+    digitalWrite(this->_directionPin, HIGH);
+    this->_sendBreak();
+
+    if (received <= 0)
+    {
+        return 0;
+    }
+    // The break before a response is received as a null byte, discovery responses have no break.
+    size_t start = 0;
+    while (start < (size_t)received && response[start] == 0)
+    {
+        start++;
+    }
+    memmove(response, response + start, received - start);
+    return received - start;
+}
+
+void DMXOutput::_sendBreak()
+{
+    uart_set_line_inverse(this->_port, UART_SIGNAL_TXD_INV);
+    delayMicroseconds(DMX_BREAK_BITS * DMX_BIT_TIME);
+    uart_set_line_inverse(this->_port, UART_SIGNAL_INV_DISABLE);
+    delayMicroseconds(DMX_MAB_BITS * DMX_BIT_TIME);
+}
+
+void DMXOutput::setFrameLock(portMUX_TYPE *lock)
+{
+    this->_frameLock = lock;
+}
+
+void DMXOutput::write(uint16_t slot, uint8_t value)
+{
+    this->_frame.write(slot, value);
+}
+
+uint8_t DMXOutput::read(uint16_t slot)
+{
+    return this->_frame.read(slot);
+}
+
+void DMXOutput::update()
+{
+    if (!this->_initialized)
+    {
+        return;
+    }
+    // Levels written before the shrink was requested are in this frame, the next one can be shorter.
+    bool shrink = this->_shrinkPending;
+    // Waits on the driver's semaphore until the previous frame and its break are out, so frames are never queued behind each other.
+    uart_wait_tx_done(this->_port, pdMS_TO_TICKS(DMX_OUTPUT_WAIT_TIME));
+
+    uint32_t now = micros();
+    if (this->_frameCount > 0)
+    {
+        this->_frameInterval.add(now - this->_lastFrameStart);
+    }
+    this->_lastFrameStart = now;
+    // Levels are written from other tasks and cores while the frame is sent. The copy is taken under their lock,
+    // so that slots written together, like the coarse and fine level of a 16 bit channel, are sent in the same frame.
+    if (this->_frameLock)
+    {
+        portENTER_CRITICAL(this->_frameLock);
+    }
+    uint16_t length = this->_frame.length();
+    memcpy(this->_sendBuffer, this->_frame.data(), length);
+    if (this->_frameLock)
+    {
+        portEXIT_CRITICAL(this->_frameLock);
+    }
+    // The data is copied to the driver's ring buffer, the break follows the last slot.
+    uart_write_bytes_with_break(this->_port, this->_sendBuffer, length, DMX_BREAK_BITS);
+    if (shrink)
+    {
+        this->_shrinkPending = false;
+        this->_frame.setSlotCount(this->_slotCount);
+    }
+
+    this->_frameCount++;
+    this->_frameRateCount++;
+    if (millis() - this->_frameRateStart >= 1000)
+    {
+        this->_frameRate = this->_frameRateCount;
+        this->_frameRateCount = 0;
+        this->_frameRateStart = millis();
+    }
+}
+
+void DMXOutput::setSlotCount(uint16_t slotCount)
+{
+    if (slotCount == this->_slotCount)
+    {
+        return;
+    }
+    this->_slotCount = slotCount;
+    if (slotCount >= this->_frame.getSlotCount())
+    {
+        this->_frame.setSlotCount(slotCount);
+    }
+    else
+    {
+        this->_shrinkPending = true;
+    }
+    LOG_INFO("DMX output ", LOG_BOLD, this->_universe, LOG_RESET_DECORATIONS, " uses ", LOG_BOLD, slotCount, LOG_RESET_DECORATIONS, " slots.");
+}
+
+uint16_t DMXOutput::getSlotCount()
+{
+    return this->_slotCount;
+}
+
+uint32_t DMXOutput::getKeepaliveTime()
+{
+    uint8_t rate = LMANConfig::instance->dmx_min_frame_rate;
+    if (rate < 1)
+    {
+        rate = 1;
+    }
+    else if (rate > this->_frame.getMaxFrameRate())
+    {
+        // Faster than the frame allows means back to back frames
+        return 0;
+    }
+    return 1000 / rate;
+}
+
+uint32_t DMXOutput::getFrameTime()
+{
+    return this->_frame.getFrameTime();
+}
+
+uint16_t DMXOutput::getFrameRate()
+{
+    // The rate of an output that stopped sending is 0, not the rate from before it stopped.
+    if (millis() - this->_frameRateStart >= 2000)
+    {
+        return 0;
+    }
+    return this->_frameRate;
+}
+
+void DMXOutput::resetTiming()
+{
+    this->_frameInterval.reset();
+}
+
+size_t DMXOutput::getStatusJson(char *buffer, size_t size)
+{
+    int length = snprintf(buffer, size, "{\"universe\":%u,\"slots\":%u,\"frame_slots\":%u,\"frames\":%u,\"frame_rate\":%u,\"min_frame_rate\":%u,\"max_frame_rate\":%u,\"frame_time\":%u,\"interval\":",
+                          this->_universe, this->_slotCount, this->_frame.getSlotCount(), (unsigned)this->_frameCount, this->getFrameRate(), LMANConfig::instance->dmx_min_frame_rate, this->_frame.getMaxFrameRate(), (unsigned)this->_frame.getFrameTime());
+    if (length <= 0 || (size_t)length >= size)
+    {
+        return 0;
+    }
+    size_t intervalLength = this->_frameInterval.toJson(buffer + length, size - length);
+    if (intervalLength == 0 || length + intervalLength + 1 >= size)
+    {
+        return 0;
+    }
+    length += intervalLength;
+    buffer[length++] = '}';
+    buffer[length] = '\0';
+    return length;
+}
@@ -0,0 +1,99 @@
+#ifndef LMAN_DMX_OUTPUT
+#define LMAN_DMX_OUTPUT
+
+#include <Arduino.h>
+#include <DMXFrame.h>
+#include <LMANTasks.h>
+#include <RDM.h>
+#include <driver/uart.h>
+
+/// @brief Number of DMX outputs (universes), each on its own UART. UART0 is left to the serial log.
+#define DMX_OUTPUT_COUNT 2
+static_assert(TASK_SEND_DMX_2 - TASK_SEND_DMX_1 + 1 == DMX_OUTPUT_COUNT && TIMING_DMX_LATENCY_1 - TIMING_DMX_FRAME_1 == DMX_OUTPUT_COUNT, "One send task and timing per DMX output");
+
+/// @brief Longest time in ms update() waits for the previous frame, a full universe takes 23 ms
+#define DMX_OUTPUT_WAIT_TIME 50
+/// @brief Size of the driver's transmit ring buffer, holds a full frame so that update() never waits for the FIFO
+#define DMX_OUTPUT_TX_BUFFER_SIZE 1024
+/// @brief Time in ms to wait for an RDM response. Responders must start within 2 ms, one more tick covers the tick rounding.
+#define DMX_RDM_RESPONSE_TIME 3
+
+/// @brief DMX transmitter on an ESP32 UART. Breaks are generated by the UART and the slots are fed to the FIFO
+/// from the driver's interrupt, so no CPU time is spent while a frame is on the line.
+/// With a line driver that can be turned around it is also the transport for RDM requests between frames.
+class DMXOutput : public RDMTransport
+{
+public:
+    /// @brief The initialized outputs, by universe - 1
+    static DMXOutput *instances[DMX_OUTPUT_COUNT];
+
+    /// @brief Set up the UART and send a first frame so that every following frame is preceded by a break
+    /// @param universe The universe sent on this output, 1-DMX_OUTPUT_COUNT
+    /// @param port The UART to use
+    /// @param txPin The GPIO connected to the line driver
+    /// @return True if the UART driver was installed
+    bool init(uint8_t universe, uart_port_t port, int txPin);
+    /// @brief Receive RDM responses. Needs a line driver with the direction on a GPIO.
+    /// @param directionPin The GPIO connected to DE and /RE of the line driver, high while sending
+    /// @param rxPin The GPIO connected to RO of the line driver
+    /// @return True if the RX pin could be set
+    bool initRdm(int directionPin, int rxPin);
+    /// @brief Send an RDM request after the current frame and wait for the response. Must be called from the task that calls update().
+    size_t transact(const uint8_t *request, size_t length, uint8_t *response, size_t size) override;
+    /// @brief Set the number of slots in use. Shorter frames are padded to DMX_MIN_SLOTS.
+    /// The frame grows straight away, it shrinks after one more full frame so that levels just written to the dropped slots are sent.
+    void setSlotCount(uint16_t slotCount);
+    /// @brief Set the lock the writers of the levels hold, update() takes it to copy the frame. Set by DMXMerger::init().
+    void setFrameLock(portMUX_TYPE *lock);
+    /// @brief Set the level of a slot for the next frame. Hold the frame lock to write several slots into the same frame.
+    /// @param slot The slot, 1-512
+    /// @param value The level
+    void write(uint16_t slot, uint8_t value);
+    /// @brief Read the level of a slot
+    uint8_t read(uint16_t slot);
+    /// @brief Send the current levels. Blocks the calling task (without using CPU) while the previous frame is still being sent.
+    void update();
+    /// @brief The number of slots in use
+    uint16_t getSlotCount();
+    /// @brief Time in ms after which the last frame is sent again if nothing changed, from LMANConfig::dmx_min_frame_rate.
+    /// The line stays in mark after break between frames, which DMX512-A limits to 1 s.
+    uint32_t getKeepaliveTime();
+    /// @brief Time in us a frame takes on the line
+    uint32_t getFrameTime();
+    /// @brief Frames sent in the last full second
+    uint16_t getFrameRate();
+    /// @brief Restart the frame interval measurement
+    void resetTiming();
+    /// @brief Describe the output as JSON
+    /// @param buffer The buffer to write to
+    /// @param size The size of the buffer
+    /// @return The length of the written JSON
+    size_t getStatusJson(char *buffer, size_t size);
+
+private:
+    /// @brief Send a break and mark after break by inverting the idle line, for the frame following an RDM response
+    void _sendBreak();
+    DMXFrame _frame;
+    /// @brief Held by the writers of _frame, nullptr if there is no merger
+    portMUX_TYPE *_frameLock = nullptr;
+    /// @brief The frame on the line, copied from _frame under _frameLock
+    uint8_t _sendBuffer[DMX_UNIVERSE_SIZE + 1];
+    uint8_t _universe = 0;
+    uart_port_t _port = UART_NUM_2;
+    bool _initialized = false;
+    /// @brief The direction GPIO for RDM, -1 if RDM is not supported
+    int _directionPin = -1;
+    uint16_t _slotCount = 0;
+    volatile bool _shrinkPending = false;
+    uint32_t _frameCount = 0;
+    /// @brief Frames in the current second, copied to _frameRate when it ends
+    uint16_t _frameRateCount = 0;
+    uint16_t _frameRate = 0;
+    unsigned long _frameRateStart = 0;
+    /// @brief micros() when the last frame was queued
+    uint32_t _lastFrameStart = 0;
+    /// @brief Time between the starts of two frames on the line
+    TaskTiming _frameInterval;
+};
+
+#endif
@@ -0,0 +1,254 @@
+#include <E131.h>
+#include <LMANLog.h>
+#include <DMXMerger.h>
+#include <LMANConfig.h>
+
+static const uint8_t E131_ACN_ID[12] = {'A', 'S', 'C', '-', 'E', '1', '.', '1', '7', 0, 0, 0};
+
+// Offsets in an E1.31 data packet
+#define E131_ACN_ID_OFFSET 4
+#define E131_ROOT_VECTOR_OFFSET 18
+#define E131_CID_OFFSET 22
+#define E131_FRAMING_VECTOR_OFFSET 40
+#define E131_PRIORITY_OFFSET 108
+#define E131_SEQUENCE_OFFSET 111
+#define E131_OPTIONS_OFFSET 112
+#define E131_UNIVERSE_OFFSET 113
+#define E131_DMP_VECTOR_OFFSET 117
+#define E131_PROPERTY_COUNT_OFFSET 123
+
+#define E131_VECTOR_ROOT_DATA 0x00000004
+#define E131_VECTOR_DATA_PACKET 0x00000002
+#define E131_VECTOR_DMP_SET_PROPERTY 0x02
+
+static inline uint16_t readU16(const uint8_t *data)
+{
+    return (data[0] << 8) | data[1];
+}
+
+static inline uint32_t readU32(const uint8_t *data)
+{
+    return ((uint32_t)data[0] << 24) | ((uint32_t)data[1] << 16) | ((uint32_t)data[2] << 8) | data[3];
+}
+
+// Make space for variables in memory
+E131Receiver *E131Receiver::instance;
+
+bool E131Receiver::init()
+{
+    if (this->_started)
+    {
+        return true;
+    }
+    E131Receiver::instance = this;
+    uint16_t universe = LMANConfig::instance->e131_universe;
+    IPAddress group(239, 255, universe >> 8, universe & 0xFF);
+    if (!this->_udp.listenMulticast(group, E131_PORT))
+    {
+        LOG_ERROR("Failed to join sACN multicast group ", group.toString().c_str());
+        return false;
+    }
+    this->_udp.onPacket([](AsyncUDPPacket &packet)
+                        { E131Receiver::instance->_handlePacket(packet); });
+    this->_started = true;
+    LOG_INFO("Listening for sACN universe ", LOG_BOLD, universe, LOG_RESET_DECORATIONS, " on ", group.toString().c_str());
+    return true;
+}
+
+void E131Receiver::_handlePacket(AsyncUDPPacket &packet)
+{
+    unsigned long start = micros();
+    // Parsed in place from the received buffer
+    const uint8_t *data = packet.data();
+    size_t length = packet.length();
+    if (length <= E131_START_CODE_OFFSET ||
+        memcmp(data + E131_ACN_ID_OFFSET, E131_ACN_ID, sizeof(E131_ACN_ID)) != 0 ||
+        readU32(data + E131_ROOT_VECTOR_OFFSET) != E131_VECTOR_ROOT_DATA ||
+        readU32(data + E131_FRAMING_VECTOR_OFFSET) != E131_VECTOR_DATA_PACKET ||
+        data[E131_DMP_VECTOR_OFFSET] != E131_VECTOR_DMP_SET_PROPERTY ||
+        readU16(data + E131_UNIVERSE_OFFSET) != LMANConfig::instance->e131_universe)
+    {
+        this->_invalid++;
+        return;
+    }
+
+    uint8_t options = data[E131_OPTIONS_OFFSET];
+    // Only null start code packets hold levels, per-slot priorities (0xDD) are not supported
+    if ((options & E131_OPTION_PREVIEW) || data[E131_START_CODE_OFFSET] != 0)
+    {
+        return;
+    }
+
+    // Frees the slots of lost sources for new ones
+    this->_expireSources();
+    E131Source *source = this->_findSource(data + E131_CID_OFFSET);
+    if (!source)
+    {
+        this->_tooManySources++;
+        return;
+    }
+
+    uint8_t sequence = data[E131_SEQUENCE_OFFSET];
+    if (source->active)
+    {
+        int8_t delta = sequence - source->lastSequence;
+        if (delta <= 0 && delta > -20)
+        {
+            this->_outOfOrder++;
+            return;
+        }
+    }
+
+    if (options & E131_OPTION_STREAM_TERMINATED)
+    {
+        LOG_INFO("sACN source stopped sending.");
+        source->active = false;
+        this->_output();
+        return;
+    }
+
+    if (!source->active)
+    {
+        LOG_INFO("New sACN source with priority ", data[E131_PRIORITY_OFFSET]);
+        memcpy(source->cid, data + E131_CID_OFFSET, sizeof(source->cid));
+        source->active = true;
+    }
+    source->lastSequence = sequence;
+    source->lastPacket = millis();
+    source->priority = data[E131_PRIORITY_OFFSET];
+
+    // The property count includes the start code
+    uint16_t slots = readU16(data + E131_PROPERTY_COUNT_OFFSET) - 1;
+    if (slots > length - E131_START_CODE_OFFSET - 1)
+    {
+        slots = length - E131_START_CODE_OFFSET - 1;
+    }
+    if (slots > sizeof(source->levels))
+    {
+        slots = sizeof(source->levels);
+    }
+    memcpy(source->levels, data + E131_START_CODE_OFFSET + 1, slots);
+    source->slots = slots;
+    this->_packets++;
+    this->_output();
+
+    this->_lastProcessingTime = micros() - start;
+    if (this->_lastProcessingTime > this->_maxProcessingTime)
+    {
+        this->_maxProcessingTime = this->_lastProcessingTime;
+    }
+}
+
+void E131Receiver::_expireSources()
+{
+    unsigned long now = millis();
+    for (E131Source &source : this->_sources)
+    {
+        if (source.active && now - source.lastPacket > E131_SOURCE_TIMEOUT)
+        {
+            LOG_WARNING("sACN source with priority ", source.priority, " timed out.");
+            source.active = false;
+        }
+    }
+}
+
+E131Source *E131Receiver::_findSource(const uint8_t *cid)
+{
+    E131Source *free = nullptr;
+    for (E131Source &source : this->_sources)
+    {
+        if (source.active && memcmp(source.cid, cid, sizeof(source.cid)) == 0)
+        {
+            return &source;
+        }
+        if (!source.active && !free)
+        {
+            free = &source;
+        }
+    }
+    return free;
+}
+
+void E131Receiver::_output()
+{
+    // A silent source must not keep its priority, so every source is checked, not only the sender of this packet
+    this->_expireSources();
+    E131Source *winner = nullptr;
+    uint8_t winners = 0;
+    for (E131Source &source : this->_sources)
+    {
+        if (!source.active)
+        {
+            continue;
+        }
+        if (!winner || source.priority > winner->priority)
+        {
+            winner = &source;
+            winners = 1;
+        }
+        else if (source.priority == winner->priority)
+        {
+            winners++;
+        }
+    }
+
+    if (!winner)
+    {
+        return; // DMXMerger falls back to local levels after the timeout
+    }
+    if (winners == 1)
+    {
+        DMXMerger::instance->writeNetwork(winner->levels, winner->slots, E131_SOURCE_TIMEOUT);
+        return;
+    }
+
+    uint16_t slots = 0;
+    memset(this->_merged, 0, sizeof(this->_merged));
+    for (E131Source &source : this->_sources)
+    {
+        if (!source.active || source.priority != winner->priority)
+        {
+            continue;
+        }
+        for (uint16_t i = 0; i < source.slots; i++)
+        {
+            if (source.levels[i] > this->_merged[i])
+            {
+                this->_merged[i] = source.levels[i];
+            }
+        }
+        if (source.slots > slots)
+        {
+            slots = source.slots;
+        }
+    }
+    DMXMerger::instance->writeNetwork(this->_merged, slots, E131_SOURCE_TIMEOUT);
+}
+
+size_t E131Receiver::getStatusJson(char *buffer, size_t size)
+{
+    uint8_t sources = 0;
+    uint8_t priority = 0;
+    for (E131Source &source : this->_sources)
+    {
+        if (source.active && millis() - source.lastPacket <= E131_SOURCE_TIMEOUT)
+        {
+            sources++;
+            if (source.priority > priority)
+            {
+                priority = source.priority;
+            }
+        }
+    }
+    return snprintf(buffer, size, "{\"enabled\":%s,\"universe\":%u,\"sources\":%u,\"priority\":%u,\"packets\":%u,\"out_of_order\":%u,\"invalid\":%u,\"too_many_sources\":%u,\"processing_us\":%u,\"max_processing_us\":%u}",
+                    this->_started ? "true" : "false",
+                    (unsigned int)LMANConfig::instance->e131_universe,
+                    (unsigned int)sources,
+                    (unsigned int)priority,
+                    (unsigned int)this->_packets,
+                    (unsigned int)this->_outOfOrder,
+                    (unsigned int)this->_invalid,
+                    (unsigned int)this->_tooManySources,
+                    (unsigned int)this->_lastProcessingTime,
+                    (unsigned int)this->_maxProcessingTime);
+}
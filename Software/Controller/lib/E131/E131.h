@@ -0,0 +1,75 @@
+#ifndef LMAN_E131
+#define LMAN_E131
+
+#include <Arduino.h>
+#include <AsyncUDP.h>
+
+#define E131_PORT 5568
+/// @brief Offset of the start code in a data packet, the DMX data follows it
+#define E131_START_CODE_OFFSET 125
+/// @brief Time (in ms) without data before a source is considered lost (E1.31 network data loss)
+#define E131_SOURCE_TIMEOUT 2500
+/// @brief The number of sources that are tracked at the same time. Packets from further sources are dropped.
+#define E131_MAX_SOURCES 4
+#define E131_OPTION_PREVIEW 0x80
+#define E131_OPTION_STREAM_TERMINATED 0x40
+
+/// @brief A sender of the configured universe
+struct E131Source
+{
+    bool active = false;
+    /// @brief Component identifier, unique per sender
+    uint8_t cid[16];
+    uint8_t priority;
+    uint8_t lastSequence;
+    unsigned long lastPacket;
+    uint16_t slots;
+    uint8_t levels[512];
+};
+
+/// @brief Receives sACN (E1.31) for the configured universe over multicast and merges it into the DMX output
+/// through DMXMerger. When several sources send, the one with the highest priority is output. Sources with the
+/// same priority are merged HTP. A source that stops sending is dropped after E131_SOURCE_TIMEOUT.
+class E131Receiver
+{
+public:
+    /// @brief Join the multicast group of the configured universe. Does nothing if already started.
+    /// @return True if listening
+    bool init();
+    /// @brief The instance of the receiver started with .init();
+    static E131Receiver *instance;
+    /// @brief Describe the receive statistics as JSON
+    /// @param buffer The buffer to write to
+    /// @param size The size of the buffer
+    /// @return The length of the written JSON
+    size_t getStatusJson(char *buffer, size_t size);
+
+private:
+    void _handlePacket(AsyncUDPPacket &packet);
+    /// @brief Drop every source that has not sent for E131_SOURCE_TIMEOUT
+    void _expireSources();
+    /// @brief Find the source with the given CID or a free slot for it
+    /// @return The source, nullptr if all slots are in use
+    E131Source *_findSource(const uint8_t *cid);
+    /// @brief Output the levels of the winning sources. Expires the sources first, so a silent source cannot win.
+    void _output();
+    AsyncUDP _udp;
+    bool _started = false;
+    E131Source _sources[E131_MAX_SOURCES];
+    /// @brief HTP merge of sources with the same priority
+    uint8_t _merged[512];
+
+    /// @brief Data packets accepted
+    uint32_t _packets = 0;
+    /// @brief Data packets dropped as out of order
+    uint32_t _outOfOrder = 0;
+    /// @brief Data packets dropped as not valid E1.31 or for another universe
+    uint32_t _invalid = 0;
+    /// @brief Data packets dropped as all source slots were in use
+    uint32_t _tooManySources = 0;
+    /// @brief Time (in us) to parse a packet and merge it into the output buffer
+    uint32_t _lastProcessingTime = 0;
+    uint32_t _maxProcessingTime = 0;
+};
+
+#endif
@@ -0,0 +1,133 @@
+#include <Effects.h>
+#include <string.h>
+
+#define EFFECT_BREATHE_PERIOD 4000
+#define EFFECT_BREATHE_DEPTH 200
+#define EFFECT_CANDLE_PERIOD 1000
+#define EFFECT_CANDLE_DEPTH 110
+#define EFFECT_CHASE_PERIOD 2000
+#define EFFECT_STROBE_PERIOD 100
+/// @brief Part of the strobe period (of 256) the light is on
+#define EFFECT_STROBE_DUTY 40
+
+const char *const EFFECT_NAMES[EFFECT_COUNT] = {"none", "breathe", "candle", "chase", "strobe"};
+
+// (1 - cos(x)) / 2 over one period scaled to 0-255, starts and ends at 0.
+static const uint8_t SINE_TABLE[256] = {
+      0,   0,   0,   0,   1,   1,   1,   2,   2,   3,   4,   5,   5,   6,   7,   9,
+     10,  11,  12,  14,  15,  17,  18,  20,  21,  23,  25,  27,  29,  31,  33,  35,
+     37,  40,  42,  44,  47,  49,  52,  54,  57,  59,  62,  65,  67,  70,  73,  76,
+     79,  82,  85,  88,  90,  93,  97, 100, 103, 106, 109, 112, 115, 118, 121, 124,
+    127, 131, 134, 137, 140, 143, 146, 149, 152, 155, 158, 162, 165, 167, 170, 173,
+    176, 179, 182, 185, 188, 190, 193, 196, 198, 201, 203, 206, 208, 211, 213, 215,
+    218, 220, 222, 224, 226, 228, 230, 232, 234, 235, 237, 238, 240, 241, 243, 244,
+    245, 246, 248, 249, 250, 250, 251, 252, 253, 253, 254, 254, 254, 255, 255, 255,
+    255, 255, 255, 255, 254, 254, 254, 253, 253, 252, 251, 250, 250, 249, 248, 246,
+    245, 244, 243, 241, 240, 238, 237, 235, 234, 232, 230, 228, 226, 224, 222, 220,
+    218, 215, 213, 211, 208, 206, 203, 201, 198, 196, 193, 190, 188, 185, 182, 179,
+    176, 173, 170, 167, 165, 162, 158, 155, 152, 149, 146, 143, 140, 137, 134, 131,
+    128, 124, 121, 118, 115, 112, 109, 106, 103, 100,  97,  93,  90,  88,  85,  82,
+     79,  76,  73,  70,  67,  65,  62,  59,  57,  54,  52,  49,  47,  44,  42,  40,
+     37,  35,  33,  31,  29,  27,  25,  23,  21,  20,  18,  17,  15,  14,  12,  11,
+     10,   9,   7,   6,   5,   5,   4,   3,   2,   2,   1,   1,   1,   0,   0,   0,
+};
+
+EffectType effectFromName(const char *name)
+{
+    for (uint8_t i = 0; i < EFFECT_COUNT; i++)
+    {
+        if (strcmp(name, EFFECT_NAMES[i]) == 0)
+        {
+            return (EffectType)i;
+        }
+    }
+    return EFFECT_NONE;
+}
+
+void effectStart(EffectState &state, uint8_t type, uint16_t period, uint32_t seed)
+{
+    if (period == 0)
+    {
+        switch (type)
+        {
+        case EFFECT_BREATHE:
+            period = EFFECT_BREATHE_PERIOD;
+            break;
+        case EFFECT_CANDLE:
+            period = EFFECT_CANDLE_PERIOD;
+            break;
+        case EFFECT_CHASE:
+            period = EFFECT_CHASE_PERIOD;
+            break;
+        default:
+            period = EFFECT_STROBE_PERIOD;
+            break;
+        }
+    }
+    state.type = type;
+    state.phase = 0;
+    state.phaseStep = 0xFFFFFFFFUL / period;
+    state.random = seed != 0 ? seed : 1;
+    state.flicker = 0;
+}
+
+/// @brief Scale a level by a factor where 65535 = 1.0
+static inline uint16_t scale(uint16_t level, uint16_t factor)
+{
+    return ((uint32_t)level * (factor + 1)) >> 16;
+}
+
+/// @brief SINE_TABLE at a phase, interpolated between the entries and scaled to 0-65280
+static inline uint16_t sine(uint32_t phase)
+{
+    uint8_t index = phase >> 24;
+    uint8_t next = index + 1;
+    uint8_t fraction = phase >> 16;
+    return (SINE_TABLE[index] << 8) + (int16_t)(SINE_TABLE[next] - SINE_TABLE[index]) * fraction;
+}
+
+uint16_t effectStep(EffectState &state, uint16_t level, uint16_t elapsed)
+{
+    state.phase += state.phaseStep * elapsed;
+    switch (state.type)
+    {
+    case EFFECT_BREATHE:
+        // Starts at the level, dips EFFECT_BREATHE_DEPTH/255 of it halfway through the period
+        return scale(level, 65535 - ((EFFECT_BREATHE_DEPTH * (uint32_t)sine(state.phase)) >> 8));
+    case EFFECT_CANDLE:
+    {
+        // A new random target about every 1/16th of the period, the flicker follows it smoothly
+        if ((state.phase >> 28) != ((state.phase - state.phaseStep * elapsed) >> 28))
+        {
+            state.random ^= state.random << 13;
+            state.random ^= state.random >> 17;
+            state.random ^= state.random << 5;
+        }
+        int16_t target = state.random & 0xFF;
+        state.flicker += (target - state.flicker) / 4;
+        return scale(level, 65535 - EFFECT_CANDLE_DEPTH * state.flicker);
+    }
+    case EFFECT_CHASE:
+        // The period is divided in chaseCount steps, the channel is on during its own step
+        return ((uint64_t)state.phase * state.chaseCount) >> 32 == state.chaseIndex ? level : 0;
+    case EFFECT_STROBE:
+        return (state.phase >> 24) < EFFECT_STROBE_DUTY ? level : 0;
+    default:
+        return level;
+    }
+}
+
+void effectRender(EffectState *states, const uint16_t *levels, uint16_t *output, uint16_t count, uint16_t elapsed)
+{
+    for (uint16_t i = 0; i < count; i++)
+    {
+        output[i] = effectStep(states[i], levels[i], elapsed);
+    }
+}
+
+uint16_t levelInterpolate(uint16_t from, uint16_t to, uint32_t elapsed, uint32_t fadeTime)
+{
+    // 64 bit, a fade over the full range longer than 32 s overflows 32 bits
+    int32_t delta = (int32_t)to - from;
+    return from + (delta * (int64_t)elapsed) / fadeTime;
+}
@@ -0,0 +1,79 @@
+#ifndef LMAN_EFFECTS
+#define LMAN_EFFECTS
+
+#include <stdint.h>
+
+/// @brief Time in ms between effect frames, about one DMX frame at full universe size
+#define EFFECT_FRAME_TIME 23
+
+enum EffectType : uint8_t
+{
+    EFFECT_NONE = 0,
+    /// @brief Slow sine fade between the level and EFFECT_BREATHE_DEPTH below it
+    EFFECT_BREATHE,
+    /// @brief Pseudo-random flicker below the level
+    EFFECT_CANDLE,
+    /// @brief Only one of the channels running chase is on at a time, moving across them
+    EFFECT_CHASE,
+    /// @brief Short flashes at the level
+    EFFECT_STROBE,
+    EFFECT_COUNT,
+};
+
+/// @brief The effect names, as used in Home Assistant's effect_list
+extern const char *const EFFECT_NAMES[EFFECT_COUNT];
+
+/// @brief The running effect of one channel. Everything is fixed point so that a frame is a few integer operations per channel.
+/// Levels are 16 bit so that effects on 16 bit channels are as smooth as their output.
+struct EffectState
+{
+    uint8_t type = EFFECT_NONE;
+    /// @brief Position in the effect cycle, a full uint32_t range is one period
+    uint32_t phase = 0;
+    /// @brief Phase increment per ms
+    uint32_t phaseStep = 0;
+    /// @brief xorshift32 state for the candle effect, never 0
+    uint32_t random = 1;
+    /// @brief Low-passed random value for the candle effect
+    uint8_t flicker = 0;
+    /// @brief Position of the channel in the chase and the number of channels in it
+    uint8_t chaseIndex = 0;
+    uint8_t chaseCount = 1;
+};
+
+/// @brief Find an effect by name
+/// @param name The effect name
+/// @return The effect, EFFECT_NONE if the name is unknown
+EffectType effectFromName(const char *name);
+
+/// @brief Start an effect
+/// @param state The effect state to set up
+/// @param type The effect to run
+/// @param period The length of one effect cycle in ms, 0 for the default of the effect
+/// @param seed Seed for the pseudo-random effects, different per channel
+void effectStart(EffectState &state, uint8_t type, uint16_t period, uint32_t seed);
+
+/// @brief Advance an effect and calculate the output level
+/// @param state The effect state
+/// @param level The 16 bit level of the channel without effect
+/// @param elapsed Time since the last frame in ms
+/// @return The 16 bit output level
+uint16_t effectStep(EffectState &state, uint16_t level, uint16_t elapsed);
+
+/// @brief Advance the effects of many channels in one pass
+/// @param states The effect state of each channel
+/// @param levels The level of each channel without effect
+/// @param output The output level of each channel
+/// @param count The number of channels
+/// @param elapsed Time since the last frame in ms
+void effectRender(EffectState *states, const uint16_t *levels, uint16_t *output, uint16_t count, uint16_t elapsed);
+
+/// @brief The level at a point of a linear fade, as used by the scene fades
+/// @param from The 16 bit level at the start of the fade
+/// @param to The 16 bit level at the end of the fade
+/// @param elapsed Time since the start of the fade in ms, less than fadeTime
+/// @param fadeTime The length of the fade in ms, not 0
+/// @return The 16 bit level
+uint16_t levelInterpolate(uint16_t from, uint16_t to, uint32_t elapsed, uint32_t fadeTime);
+
+#endif
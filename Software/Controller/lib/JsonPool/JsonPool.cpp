@@ -0,0 +1,152 @@
+#include <JsonPool.h>
+#include <LMANConfig.h>
+#include <LMANLog.h>
+
+// One block size per document capacity in use, as ArduinoJson allocates the whole capacity at once. The counts are
+// the documents that can be alive at the same time: one per task of the MQTT client, the web server and the updater.
+JsonPoolClass JsonPool::_classes[JSON_POOL_CLASS_COUNT] = {
+    // MQTT commands, web socket commands
+    {256, 2, nullptr, 0, 0, 0},
+    // Home Assistant discovery, GET /channels, the update manifest
+    {1024, 3, nullptr, 0, 0, 0},
+    // The whole config, only built by the web server
+    {CONFIG_JSON_SIZE, 1, nullptr, 0, 0, 0},
+};
+uint32_t JsonPool::_fallbacks = 0;
+static portMUX_TYPE _poolMux = portMUX_INITIALIZER_UNLOCKED;
+
+void JsonPool::init()
+{
+    for (JsonPoolClass &poolClass : JsonPool::_classes)
+    {
+        if (!poolClass.arena)
+        {
+            poolClass.arena = (uint8_t *)malloc(poolClass.size * poolClass.count);
+            if (!poolClass.arena)
+            {
+                LOG_ERROR("Failed to allocate JSON pool blocks of ", LOG_BOLD, poolClass.size, LOG_RESET_DECORATIONS, " bytes.");
+            }
+        }
+    }
+}
+
+void *JsonPool::allocate(size_t size)
+{
+    portENTER_CRITICAL(&_poolMux);
+    for (JsonPoolClass &poolClass : JsonPool::_classes)
+    {
+        if (!poolClass.arena || size > poolClass.size)
+        {
+            continue;
+        }
+        for (uint8_t i = 0; i < poolClass.count; i++)
+        {
+            if (!(poolClass.usedMask & (1UL << i)))
+            {
+                poolClass.usedMask |= 1UL << i;
+                poolClass.allocations++;
+                uint8_t inUse = __builtin_popcount(poolClass.usedMask);
+                if (inUse > poolClass.peak)
+                {
+                    poolClass.peak = inUse;
+                }
+                portEXIT_CRITICAL(&_poolMux);
+                return poolClass.arena + i * poolClass.size;
+            }
+        }
+        // All blocks of this size are in use, try the next larger size.
+    }
+    JsonPool::_fallbacks++;
+    portEXIT_CRITICAL(&_poolMux);
+    return malloc(size);
+}
+
+JsonPoolClass *JsonPool::_findClass(void *pointer)
+{
+    for (JsonPoolClass &poolClass : JsonPool::_classes)
+    {
+        if (poolClass.arena && pointer >= poolClass.arena && pointer < poolClass.arena + poolClass.size * poolClass.count)
+        {
+            return &poolClass;
+        }
+    }
+    return nullptr;
+}
+
+void JsonPool::deallocate(void *pointer)
+{
+    JsonPoolClass *poolClass = JsonPool::_findClass(pointer);
+    if (!poolClass)
+    {
+        free(pointer);
+        return;
+    }
+    uint8_t block = ((uint8_t *)pointer - poolClass->arena) / poolClass->size;
+    portENTER_CRITICAL(&_poolMux);
+    poolClass->usedMask &= ~(1UL << block);
+    portEXIT_CRITICAL(&_poolMux);
+}
+
+void *JsonPool::reallocate(void *pointer, size_t size)
+{
+    JsonPoolClass *poolClass = JsonPool::_findClass(pointer);
+    if (!poolClass)
+    {
+        return realloc(pointer, size);
+    }
+    if (size <= poolClass->size)
+    {
+        // Still fits the block, only used by shrinkToFit().
+        return pointer;
+    }
+    void *newPointer = JsonPool::allocate(size);
+    if (newPointer)
+    {
+        memcpy(newPointer, pointer, poolClass->size);
+    }
+    JsonPool::deallocate(pointer);
+    return newPointer;
+}
+
+uint32_t JsonPool::getFallbacks()
+{
+    return JsonPool::_fallbacks;
+}
+
+size_t JsonPool::getStatusJson(char *buffer, size_t size)
+{
+    uint32_t freeHeap = ESP.getFreeHeap();
+    uint32_t largestBlock = ESP.getMaxAllocHeap();
+    int length = snprintf(buffer, size, "{\"heap\":{\"free\":%u,\"min_free\":%u,\"largest_block\":%u,\"fragmentation\":%u},\"fallbacks\":%u,\"classes\":[",
+                          (unsigned)freeHeap, (unsigned)ESP.getMinFreeHeap(), (unsigned)largestBlock, (unsigned)(freeHeap ? 100 - (largestBlock * 100) / freeHeap : 0), (unsigned)JsonPool::_fallbacks);
+    for (uint8_t i = 0; i < JSON_POOL_CLASS_COUNT && length > 0 && (size_t)length < size; i++)
+    {
+        JsonPoolClass &poolClass = JsonPool::_classes[i];
+        length += snprintf(buffer + length, size - length, "%s{\"size\":%u,\"count\":%u,\"in_use\":%u,\"peak\":%u,\"allocations\":%u}",
+                           i ? "," : "", (unsigned)poolClass.size, poolClass.count, __builtin_popcount(poolClass.usedMask), poolClass.peak, (unsigned)poolClass.allocations);
+    }
+    if (length > 0 && (size_t)length < size)
+    {
+        length += snprintf(buffer + length, size - length, "]}");
+    }
+    return length > 0 && (size_t)length < size ? length : 0;
+}
+
+void JsonPool::logStatus()
+{
+#if LMAN_LOG_LEVEL >= LMAN_LOG_LEVEL_INFO
+    uint32_t freeHeap = ESP.getFreeHeap();
+    uint32_t largestBlock = ESP.getMaxAllocHeap();
+    // Fragmentation as the part of the free heap that is not in the largest free block.
+    LOG_INFO("Heap free: ", LOG_BOLD, freeHeap, LOG_RESET_DECORATIONS, " B, min free: ", LOG_BOLD, ESP.getMinFreeHeap(), LOG_RESET_DECORATIONS, " B, largest block: ", LOG_BOLD, largestBlock,
+             LOG_RESET_DECORATIONS, " B, fragmentation: ", LOG_BOLD, freeHeap ? 100 - (largestBlock * 100) / freeHeap : 0, "%");
+    for (JsonPoolClass &poolClass : JsonPool::_classes)
+    {
+        LOG_INFO("JSON pool ", LOG_BOLD, poolClass.size, LOG_RESET_DECORATIONS, " B blocks: ", __builtin_popcount(poolClass.usedMask), "/", poolClass.count, " in use, peak ", poolClass.peak, ", ", poolClass.allocations, " allocations");
+    }
+    if (JsonPool::_fallbacks)
+    {
+        LOG_WARNING("JSON pool fell back to malloc ", LOG_BOLD, JsonPool::_fallbacks, LOG_RESET_DECORATIONS, " times.");
+    }
+#endif
+}
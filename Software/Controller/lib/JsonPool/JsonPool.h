@@ -0,0 +1,78 @@
+#ifndef LMAN_JSON_POOL
+#define LMAN_JSON_POOL
+
+#include <Arduino.h>
+#include <ArduinoJson.h>
+
+/// @brief The number of block sizes in the pool
+#define JSON_POOL_CLASS_COUNT 3
+/// @brief Time in ms between logs of the pool usage and heap fragmentation
+#define JSON_POOL_LOG_INTERVAL 600000
+
+/// @brief Usage of one block size of the pool
+struct JsonPoolClass
+{
+    /// @brief The size of each block
+    size_t size;
+    /// @brief The number of blocks
+    uint8_t count;
+    /// @brief Memory for all blocks, allocated once by JsonPool::init()
+    uint8_t *arena;
+    /// @brief Bit per block, set while in use
+    uint32_t usedMask;
+    /// @brief The highest number of blocks in use at the same time
+    uint8_t peak;
+    /// @brief The number of allocations served by this block size
+    uint32_t allocations;
+};
+
+/// @brief Fixed blocks for JSON documents, allocated once at boot so that building and parsing JSON
+/// does not fragment the heap. Requests that do not fit a free block fall back to malloc and are counted.
+class JsonPool
+{
+public:
+    /// @brief Allocate the blocks of the pool. Must be called before any PooledJsonDocument is created.
+    static void init();
+    /// @brief Get the smallest free block that fits, malloc if none is free
+    static void *allocate(size_t size);
+    /// @brief Return a block to the pool, or free it if it was not from the pool
+    static void deallocate(void *pointer);
+    static void *reallocate(void *pointer, size_t size);
+    /// @brief The number of allocations that did not fit a free block
+    static uint32_t getFallbacks();
+    /// @brief Describe the pool usage and the heap as JSON
+    /// @param buffer The buffer to write to
+    /// @param size The size of the buffer
+    /// @return The length of the written JSON
+    static size_t getStatusJson(char *buffer, size_t size);
+    /// @brief Log the pool usage and the heap fragmentation
+    static void logStatus();
+
+private:
+    /// @brief The block size a pointer belongs to, nullptr if not from the pool
+    static JsonPoolClass *_findClass(void *pointer);
+    static JsonPoolClass _classes[JSON_POOL_CLASS_COUNT];
+    static uint32_t _fallbacks;
+};
+
+/// @brief ArduinoJson allocator using the JsonPool
+struct JsonPoolAllocator
+{
+    void *allocate(size_t size)
+    {
+        return JsonPool::allocate(size);
+    }
+    void deallocate(void *pointer)
+    {
+        JsonPool::deallocate(pointer);
+    }
+    void *reallocate(void *pointer, size_t size)
+    {
+        return JsonPool::reallocate(pointer, size);
+    }
+};
+
+/// @brief Use instead of DynamicJsonDocument
+typedef BasicJsonDocument<JsonPoolAllocator> PooledJsonDocument;
+
+#endif
@@ -1,22 +1,210 @@
 #include <LMANConfig.h>
+#include <JsonPool.h>
 #include <LittleFS.h>
-#include <ArduLog.h>
+#include <LMANLog.h>
 #include <ArduinoJson.h>
 #include <FS.h>
+#include <rom/crc.h>
 
-std::string ChannelConfig::getBaseTopic()
+#define CONFIG_FILE "/config.bin"
+#define CONFIG_FILE_TMP "/config.bin.tmp"
+#define CONFIG_FILE_LEGACY_JSON "/config.json"
+#define CONFIG_MAGIC 0x4E414D4C // "LMAN"
+/// @brief Increase when fields are added to _serialize/_deserialize.
+#define CONFIG_VERSION 13
+
+struct __attribute__((packed)) ConfigFileHeader
+{
+    uint32_t magic;
+    uint16_t version;
+    uint16_t length;
+    /// @brief CRC32 of the payload following the header
+    uint32_t crc;
+};
+
+/// @brief Appends little-endian values to a byte buffer
+class ConfigWriter
+{
+public:
+    ConfigWriter(std::vector<uint8_t> &data) : _data(data) {}
+    void writeU8(uint8_t value)
+    {
+        this->_data.push_back(value);
+    }
+    void writeU16(uint16_t value)
+    {
+        this->_data.push_back(value & 0xFF);
+        this->_data.push_back(value >> 8);
+    }
+    void writeString(const std::string &value)
+    {
+        uint8_t length = value.length() > 255 ? 255 : value.length();
+        this->writeU8(length);
+        this->_data.insert(this->_data.end(), value.begin(), value.begin() + length);
+    }
+
+private:
+    std::vector<uint8_t> &_data;
+};
+
+/// @brief Reads values written by ConfigWriter. Reading past the end returns zeros and sets overflowed().
+class ConfigReader
 {
-    if (this->_baseTopic.empty())
+public:
+    ConfigReader(const uint8_t *data, size_t length) : _data(data), _length(length) {}
+    uint8_t readU8()
+    {
+        if (this->_position >= this->_length)
+        {
+            this->_overflowed = true;
+            return 0;
+        }
+        return this->_data[this->_position++];
+    }
+    uint16_t readU16()
+    {
+        uint16_t low = this->readU8();
+        return low | (this->readU8() << 8);
+    }
+    void readString(std::string &value)
+    {
+        uint8_t length = this->readU8();
+        if (this->_position + length > this->_length)
+        {
+            this->_overflowed = true;
+            return;
+        }
+        value.assign((const char *)this->_data + this->_position, length);
+        this->_position += length;
+    }
+    bool overflowed()
+    {
+        return this->_overflowed;
+    }
+
+private:
+    const uint8_t *_data;
+    size_t _length;
+    size_t _position = 0;
+    bool _overflowed = false;
+};
+
+std::string ChannelConfig::buildBaseTopic() const
+{
+    std::string baseTopic = LMANConfig::instance->home_assistant_base_topic;
+    baseTopic.append("light/");
+    baseTopic.append(LMANConfig::instance->wifi_hostname);
+    baseTopic.append("/");
+    baseTopic.append("channel");
+    baseTopic.append(std::to_string(this->channel));
+    // Channels on universe 1 keep the topics they had before there were more universes
+    if (this->universe > 1)
+    {
+        baseTopic.append("_u");
+        baseTopic.append(std::to_string(this->universe));
+    }
+    return baseTopic;
+}
+
+const std::string &ChannelConfig::getBaseTopic()
+{
+    if (this->_baseTopic.value.empty())
     {
         LOG_DEBUG("_baseTopic not set yet. Building!");
-        this->_baseTopic.append(LMANConfig::instance->home_assistant_base_topic);
-        this->_baseTopic.append("light/");
-        this->_baseTopic.append(LMANConfig::instance->wifi_hostname);
-        this->_baseTopic.append("/");
-        this->_baseTopic.append("channel");
-        this->_baseTopic.append(std::to_string(this->channel));
-    }
-    return this->_baseTopic;
+        this->_baseTopic.value = this->buildBaseTopic();
+        this->_stateTopic.value = this->_baseTopic.value + "/state";
+        this->_cmdTopic.value = this->_baseTopic.value + "/cmd";
+    }
+    return this->_baseTopic.value;
+}
+
+std::string SceneConfig::getBaseTopic(uint8_t index)
+{
+    std::string baseTopic = LMANConfig::instance->home_assistant_base_topic;
+    baseTopic.append("scene/");
+    baseTopic.append(LMANConfig::instance->wifi_hostname);
+    baseTopic.append("/scene");
+    baseTopic.append(std::to_string(index + 1));
+    return baseTopic;
+}
+
+const std::string &SceneConfig::getCmdTopic(uint8_t index)
+{
+    if (this->_cmdTopic.value.empty())
+    {
+        this->_cmdTopic.value = this->getBaseTopic(index);
+        this->_cmdTopic.value.append("/cmd");
+    }
+    return this->_cmdTopic.value;
+}
+
+std::string SceneConfig::getCfgTopic(uint8_t index)
+{
+    std::string cfgTopic = this->getBaseTopic(index);
+    cfgTopic.append("/config");
+    return cfgTopic;
+}
+
+std::string SceneConfig::getUniqueName(uint8_t index)
+{
+    std::string uniqueName = LMANConfig::instance->wifi_hostname;
+    uniqueName.append("-scene");
+    uniqueName.append(std::to_string(index + 1));
+    return uniqueName;
+}
+
+std::string GroupConfig::getBaseTopic(uint8_t index)
+{
+    std::string baseTopic = LMANConfig::instance->home_assistant_base_topic;
+    baseTopic.append("light/");
+    baseTopic.append(LMANConfig::instance->wifi_hostname);
+    baseTopic.append("/group");
+    baseTopic.append(std::to_string(index + 1));
+    return baseTopic;
+}
+
+const std::string &GroupConfig::getCmdTopic(uint8_t index)
+{
+    if (this->_cmdTopic.value.empty())
+    {
+        this->_cmdTopic.value = this->getBaseTopic(index);
+        this->_cmdTopic.value.append("/cmd");
+    }
+    return this->_cmdTopic.value;
+}
+
+const std::string &GroupConfig::getStateTopic(uint8_t index)
+{
+    if (this->_stateTopic.value.empty())
+    {
+        this->_stateTopic.value = this->getBaseTopic(index);
+        this->_stateTopic.value.append("/state");
+    }
+    return this->_stateTopic.value;
+}
+
+std::string GroupConfig::getCfgTopic(uint8_t index)
+{
+    std::string cfgTopic = this->getBaseTopic(index);
+    cfgTopic.append("/config");
+    return cfgTopic;
+}
+
+std::string GroupConfig::getUniqueName(uint8_t index)
+{
+    std::string uniqueName = LMANConfig::instance->wifi_hostname;
+    uniqueName.append("-group");
+    uniqueName.append(std::to_string(index + 1));
+    return uniqueName;
+}
+
+uint8_t ChannelConfig::getSlotCount() const
+{
+    if (this->type == FIXTURE_DIMMER || this->type >= FIXTURE_TYPE_COUNT)
+    {
+        return this->fine ? 2 : 1;
+    }
+    return FIXTURE_SLOTS[this->type];
 }
 
 std::string ChannelConfig::getUniqueName()
@@ -27,23 +215,21 @@ std::string ChannelConfig::getUniqueName()
     return uniqueName;
 }
 
-std::string ChannelConfig::getCmdTopic()
+const std::string &ChannelConfig::getCmdTopic()
 {
-    std::string cmdTopic = this->getBaseTopic();
-    cmdTopic.append("/cmd");
-    return cmdTopic;
+    this->getBaseTopic();
+    return this->_cmdTopic.value;
 }
 
-std::string ChannelConfig::getStateTopic()
+const std::string &ChannelConfig::getStateTopic()
 {
-    std::string stateTopic = this->getBaseTopic();
-    stateTopic.append("/state");
-    return stateTopic;
+    this->getBaseTopic();
+    return this->_stateTopic.value;
 }
 
 std::string ChannelConfig::getCfgTopic()
 {
-    std::string cfgTopic = this->getBaseTopic();
+    std::string cfgTopic = this->buildBaseTopic();
     cfgTopic.append("/config");
     return cfgTopic;
 }
@@ -57,6 +243,13 @@ std::string ChannelConfig::getAvailabilityTopic()
     return availabilityTopic;
 }
 
+void ChannelConfig::clearTopicCache()
+{
+    this->_baseTopic.value.clear();
+    this->_stateTopic.value.clear();
+    this->_cmdTopic.value.clear();
+}
+
 // LMANConfig
 // Give somewhere in memory for instance to exist
 LMANConfig *LMANConfig::instance;
@@ -79,29 +272,57 @@ bool LMANConfig::init()
 bool LMANConfig::loadFromLittleFS()
 {
     LOG_INFO("Loading config from LittleFS");
-    File configFile = LittleFS.open("/config.json");
-    if (!configFile)
+    unsigned long loadStart = micros();
+    bool loaded = false;
+    if (this->_loadBinary(CONFIG_FILE))
     {
-        LOG_ERROR("Failed to load config.json!");
-        return false;
+        loaded = true;
+    }
+    else if (this->_loadBinary(CONFIG_FILE_TMP))
+    {
+        // Power was lost after the new config was written but before it replaced the old one.
+        LOG_WARNING("Recovered config from ", LOG_BOLD, CONFIG_FILE_TMP);
+        LittleFS.rename(CONFIG_FILE_TMP, CONFIG_FILE);
+        loaded = true;
+    }
+    else if (LittleFS.exists(CONFIG_FILE_LEGACY_JSON))
+    {
+        LOG_WARNING("No binary config found. Importing ", LOG_BOLD, CONFIG_FILE_LEGACY_JSON);
+        File configFile = LittleFS.open(CONFIG_FILE_LEGACY_JSON);
+        PooledJsonDocument doc(CONFIG_JSON_SIZE);
+        DeserializationError error = deserializeJson(doc, configFile);
+        configFile.close();
+        if (error)
+        {
+            LOG_ERROR("Failed to deserialize ", CONFIG_FILE_LEGACY_JSON);
+        }
+        else
+        {
+            this->loadFromJson(doc);
+            loaded = this->saveToLittleFS();
+        }
+    }
+    else
+    {
+        LOG_ERROR("No config file found!");
     }
 
-    StaticJsonDocument<2048> doc;
-    DeserializationError error = deserializeJson(doc, configFile);
-    configFile.close();
-    if (error)
+    if (loaded)
     {
-        LOG_ERROR("Failed to deserialize config.json");
-        return false;
+        LOG_INFO("Setting logging level to ", LOG_BOLD, this->logging_level);
+        ArduLog::getInstance()->SetLogLevel(static_cast<ArduLogLevel>(this->logging_level));
+        LOG_INFO("Config data loaded in ", LOG_BOLD, micros() - loadStart, LOG_RESET_DECORATIONS, " us.");
     }
+    return loaded;
+}
 
+void LMANConfig::loadFromJson(JsonDocument &doc)
+{
     // Load config data
     this->wifi_hostname = doc["wifi_hostname"] | "LightManager";
     this->wifi_ssid = doc["wifi_ssid"] | "";
     this->wifi_psk = doc["wifi_psk"] | "";
     this->logging_level = doc["log_level"] | 4; // Set logging to debug if no level was read from file.
-    LOG_INFO("Setting logging level to ", LOG_BOLD, this->logging_level);
-    ArduLog::getInstance()->SetLogLevel(static_cast<ArduLogLevel>(this->logging_level));
 
     this->home_assistant_base_topic = doc["home_assistant_base_topic"] | "homeassistant/";
     this->home_assistant_state_change_wait = doc["home_assistant_state_change_wait"].as<uint16_t>();
@@ -110,16 +331,41 @@ bool LMANConfig::loadFromLittleFS()
     this->buttonPressMaxTime = doc["buttonPressMaxTime"] | 800;
 
     this->mqtt_server = doc["mqtt_server"] | "";
-    this->mqtt_port = doc["mqtt_port"].as<uint8_t>() | 1883;
+    this->mqtt_port = doc["mqtt_port"] | 1883;
     this->mqtt_username = doc["mqtt_username"] | "";
     this->mqtt_password = doc["mqtt_password"] | "";
 
+    this->update_url = doc["update_url"] | "";
+    this->update_poll_interval = doc["update_poll_interval"] | 0;
+    this->update_stagger = doc["update_stagger"] | 0;
+    this->update_littlefs_sha256 = doc["update_littlefs_sha256"] | "";
+
+    this->artnet_enabled = doc["artnet_enabled"] | false;
+    this->artnet_universe = doc["artnet_universe"] | 0;
+    this->dmx_merge_mode = doc["dmx_merge_mode"] | 0;
+    this->dmx_min_frame_rate = doc["dmx_min_frame_rate"] | 2;
+    this->e131_enabled = doc["e131_enabled"] | false;
+    this->e131_universe = doc["e131_universe"] | 1;
+    this->mqtt_raw_enabled = doc["mqtt_raw_enabled"] | false;
+    this->mqtt_raw_hold = doc["mqtt_raw_hold"] | 2000;
+    this->time_zone = doc["time_zone"] | "UTC0";
+    this->ntp_server = doc["ntp_server"] | "pool.ntp.org";
+    this->latitude = lroundf((doc["latitude"] | 0.0f) * 100);
+    this->longitude = lroundf((doc["longitude"] | 0.0f) * 100);
+
+    this->log_serial = doc["log_serial"] | true;
+    this->syslog_server = doc["syslog_server"] | "";
+    this->syslog_port = doc["syslog_port"] | 514;
+
     JsonArray channelArray = doc["channels"].as<JsonArray>();
-    for (int i = 0; i < channelArray.size(); i++)
+    for (int i = 0; i < channelArray.size() && i < sizeof(this->channelConfigs) / sizeof(ChannelConfig); i++)
     {
         uint8_t channel = channelArray[i]["channel"].as<uint8_t>();
         LOG_DEBUG("Loading channel ", LOG_BOLD, channel);
         this->channelConfigs[i].channel = channel;
+        this->channelConfigs[i].universe = channelArray[i]["universe"] | 1;
+        this->channelConfigs[i].fine = channelArray[i]["fine"] | false;
+        this->channelConfigs[i].type = channelArray[i]["type"] | FIXTURE_DIMMER;
         this->channelConfigs[i].name = channelArray[i]["name"] | "";
         this->channelConfigs[i].min = channelArray[i]["min"].as<uint8_t>();
         this->channelConfigs[i].max = channelArray[i]["max"].as<uint8_t>();
@@ -130,21 +376,95 @@ bool LMANConfig::loadFromLittleFS()
     }
 
     JsonArray btnConfigs = doc["buttons"].as<JsonArray>();
-    for (int i = 0; i < btnConfigs.size(); i++)
+    for (int i = 0; i < btnConfigs.size() && i < sizeof(this->buttonConfigs) / sizeof(ButtonConfig); i++)
     {
         LOG_INFO("Loading button ", LOG_BOLD, i);
         this->buttonConfigs[i].channel = btnConfigs[i]["channel"].as<uint8_t>();
         this->buttonConfigs[i].enabled = btnConfigs[i]["enabled"].as<uint8_t>() == 1;
+        this->buttonConfigs[i].scene = btnConfigs[i]["scene"] | 0;
     }
 
-    LOG_INFO("Config data loaded.");
-    return true;
+    JsonArray sceneArray = doc["scenes"].as<JsonArray>();
+    for (int i = 0; i < sizeof(this->sceneConfigs) / sizeof(SceneConfig); i++)
+    {
+        SceneConfig &scene = this->sceneConfigs[i];
+        JsonObject sceneJson = i < sceneArray.size() ? sceneArray[i].as<JsonObject>() : JsonObject();
+        scene.name = sceneJson["name"] | "";
+        scene.enabled = (sceneJson["enabled"] | 0) == 1;
+        scene.fadeTime = sceneJson["fadeTime"] | 1000;
+        scene.channels = 0;
+        JsonArray levels = sceneJson["levels"].as<JsonArray>();
+        for (int c = 0; c < sizeof(scene.levels); c++)
+        {
+            // null = channel is not part of the scene
+            if (c < levels.size() && !levels[c].isNull())
+            {
+                scene.channels |= 1 << c;
+                scene.levels[c] = levels[c].as<uint8_t>();
+            }
+            else
+            {
+                scene.levels[c] = 0;
+            }
+        }
+    }
+
+    JsonArray groupArray = doc["groups"].as<JsonArray>();
+    for (int i = 0; i < sizeof(this->groupConfigs) / sizeof(GroupConfig); i++)
+    {
+        GroupConfig &group = this->groupConfigs[i];
+        JsonObject groupJson = i < groupArray.size() ? groupArray[i].as<JsonObject>() : JsonObject();
+        group.name = groupJson["name"] | ("group" + std::to_string(i + 1)).c_str();
+        group.enabled = (groupJson["enabled"] | 0) == 1;
+        group.fadeTime = groupJson["fadeTime"] | 500;
+        group.channels = 0;
+        // Members are listed by channel number, 1-4
+        for (JsonVariant member : groupJson["channels"].as<JsonArray>())
+        {
+            uint8_t c = member.as<uint8_t>();
+            if (c >= 1 && c <= sizeof(this->channelConfigs) / sizeof(ChannelConfig))
+            {
+                group.channels |= 1 << (c - 1);
+            }
+        }
+    }
+
+    JsonArray scheduleArray = doc["schedules"].as<JsonArray>();
+    for (int i = 0; i < sizeof(this->scheduleConfigs) / sizeof(ScheduleConfig); i++)
+    {
+        ScheduleConfig &schedule = this->scheduleConfigs[i];
+        JsonObject scheduleJson = i < scheduleArray.size() ? scheduleArray[i].as<JsonObject>() : JsonObject();
+        schedule.name = scheduleJson["name"] | ("schedule" + std::to_string(i + 1)).c_str();
+        schedule.enabled = (scheduleJson["enabled"] | 0) == 1;
+        schedule.trigger = scheduleJson["trigger"] | SCHEDULE_TRIGGER_TIME;
+        schedule.time = scheduleJson["time"] | 0;
+        schedule.offset = scheduleJson["offset"] | 0;
+        schedule.level = scheduleJson["level"] | 0;
+        schedule.fadeTime = scheduleJson["fadeTime"] | 60;
+        // Weekdays are listed by number, 0 = Sunday. No list means every day.
+        schedule.days = scheduleJson.containsKey("days") ? 0 : 0x7F;
+        for (JsonVariant day : scheduleJson["days"].as<JsonArray>())
+        {
+            if (day.as<uint8_t>() < 7)
+            {
+                schedule.days |= 1 << day.as<uint8_t>();
+            }
+        }
+        schedule.channels = 0;
+        // Channels are listed by channel number, 1-4
+        for (JsonVariant member : scheduleJson["channels"].as<JsonArray>())
+        {
+            uint8_t c = member.as<uint8_t>();
+            if (c >= 1 && c <= sizeof(this->channelConfigs) / sizeof(ChannelConfig))
+            {
+                schedule.channels |= 1 << (c - 1);
+            }
+        }
+    }
 }
 
-bool LMANConfig::saveToLittleFS()
+void LMANConfig::toJson(JsonDocument &config_json)
 {
-    StaticJsonDocument<2048> config_json;
-
     config_json["wifi_hostname"] = this->wifi_hostname.c_str();
     config_json["wifi_ssid"] = this->wifi_ssid.c_str();
     config_json["wifi_psk"] = this->wifi_psk.c_str();
@@ -157,11 +477,33 @@ bool LMANConfig::saveToLittleFS()
     config_json["buttonPressMinTime"] = this->buttonPressMinTime;
     config_json["buttonPressMaxTime"] = this->buttonPressMaxTime;
     config_json["log_level"] = this->logging_level;
+    config_json["update_url"] = this->update_url;
+    config_json["update_poll_interval"] = this->update_poll_interval;
+    config_json["update_stagger"] = this->update_stagger;
+    config_json["update_littlefs_sha256"] = this->update_littlefs_sha256;
+    config_json["artnet_enabled"] = this->artnet_enabled;
+    config_json["artnet_universe"] = this->artnet_universe;
+    config_json["dmx_merge_mode"] = this->dmx_merge_mode;
+    config_json["dmx_min_frame_rate"] = this->dmx_min_frame_rate;
+    config_json["e131_enabled"] = this->e131_enabled;
+    config_json["e131_universe"] = this->e131_universe;
+    config_json["mqtt_raw_enabled"] = this->mqtt_raw_enabled;
+    config_json["mqtt_raw_hold"] = this->mqtt_raw_hold;
+    config_json["time_zone"] = this->time_zone;
+    config_json["ntp_server"] = this->ntp_server;
+    config_json["latitude"] = this->latitude / 100.0f;
+    config_json["longitude"] = this->longitude / 100.0f;
+    config_json["log_serial"] = this->log_serial;
+    config_json["syslog_server"] = this->syslog_server;
+    config_json["syslog_port"] = this->syslog_port;
 
     JsonArray channels = config_json.createNestedArray("channels");
     JsonObject channel1 = channels.createNestedObject();
     channel1["name"] = this->channelConfigs[0].name.c_str();
     channel1["channel"] = this->channelConfigs[0].channel;
+    channel1["universe"] = this->channelConfigs[0].universe;
+    channel1["fine"] = this->channelConfigs[0].fine;
+    channel1["type"] = this->channelConfigs[0].type;
     channel1["min"] = this->channelConfigs[0].min;
     channel1["max"] = this->channelConfigs[0].max;
     channel1["dimmingSpeed"] = this->channelConfigs[0].dimmingSpeed;
@@ -171,6 +513,9 @@ bool LMANConfig::saveToLittleFS()
     JsonObject channel2 = channels.createNestedObject();
     channel2["name"] = this->channelConfigs[1].name.c_str();
     channel2["channel"] = this->channelConfigs[1].channel;
+    channel2["universe"] = this->channelConfigs[1].universe;
+    channel2["fine"] = this->channelConfigs[1].fine;
+    channel2["type"] = this->channelConfigs[1].type;
     channel2["min"] = this->channelConfigs[1].min;
     channel2["max"] = this->channelConfigs[1].max;
     channel2["dimmingSpeed"] = this->channelConfigs[1].dimmingSpeed;
@@ -180,6 +525,9 @@ bool LMANConfig::saveToLittleFS()
     JsonObject channel3 = channels.createNestedObject();
     channel3["name"] = this->channelConfigs[2].name.c_str();
     channel3["channel"] = this->channelConfigs[2].channel;
+    channel3["universe"] = this->channelConfigs[2].universe;
+    channel3["fine"] = this->channelConfigs[2].fine;
+    channel3["type"] = this->channelConfigs[2].type;
     channel3["min"] = this->channelConfigs[2].min;
     channel3["max"] = this->channelConfigs[2].max;
     channel3["dimmingSpeed"] = this->channelConfigs[2].dimmingSpeed;
@@ -189,6 +537,9 @@ bool LMANConfig::saveToLittleFS()
     JsonObject channel4 = channels.createNestedObject();
     channel4["name"] = this->channelConfigs[3].name.c_str();
     channel4["channel"] = this->channelConfigs[3].channel;
+    channel4["universe"] = this->channelConfigs[3].universe;
+    channel4["fine"] = this->channelConfigs[3].fine;
+    channel4["type"] = this->channelConfigs[3].type;
     channel4["min"] = this->channelConfigs[3].min;
     channel4["max"] = this->channelConfigs[3].max;
     channel4["dimmingSpeed"] = this->channelConfigs[3].dimmingSpeed;
@@ -209,25 +560,610 @@ bool LMANConfig::saveToLittleFS()
     JsonObject button4 = buttons.createNestedObject();
     button4["enabled"] = this->buttonConfigs[3].enabled ? 1 : 0;
     button4["channel"] = this->buttonConfigs[3].channel;
+    for (int i = 0; i < sizeof(this->buttonConfigs) / sizeof(ButtonConfig); i++)
+    {
+        buttons[i]["scene"] = this->buttonConfigs[i].scene;
+    }
 
-    File config_file = LittleFS.open("/config.json", "w");
-    if (!config_file)
+    JsonArray scenes = config_json.createNestedArray("scenes");
+    for (SceneConfig &scene : this->sceneConfigs)
     {
-        LOG_ERROR("Failed to open 'config.json' for writing.");
+        JsonObject sceneJson = scenes.createNestedObject();
+        sceneJson["name"] = scene.name.c_str();
+        sceneJson["enabled"] = scene.enabled ? 1 : 0;
+        sceneJson["fadeTime"] = scene.fadeTime;
+        JsonArray levels = sceneJson.createNestedArray("levels");
+        for (int c = 0; c < sizeof(scene.levels); c++)
+        {
+            if (scene.channels & (1 << c))
+            {
+                levels.add(scene.levels[c]);
+            }
+            else
+            {
+                levels.add(nullptr);
+            }
+        }
     }
-    else if (serializeJson(config_json, config_file) == 0)
+
+    JsonArray groups = config_json.createNestedArray("groups");
+    for (GroupConfig &group : this->groupConfigs)
     {
-        LOG_ERROR("Failed to save config file.");
+        JsonObject groupJson = groups.createNestedObject();
+        groupJson["name"] = group.name.c_str();
+        groupJson["enabled"] = group.enabled ? 1 : 0;
+        groupJson["fadeTime"] = group.fadeTime;
+        JsonArray members = groupJson.createNestedArray("channels");
+        for (int c = 0; c < sizeof(this->channelConfigs) / sizeof(ChannelConfig); c++)
+        {
+            if (group.channels & (1 << c))
+            {
+                members.add(c + 1);
+            }
+        }
     }
-    else
+
+    JsonArray schedules = config_json.createNestedArray("schedules");
+    for (ScheduleConfig &schedule : this->scheduleConfigs)
+    {
+        JsonObject scheduleJson = schedules.createNestedObject();
+        scheduleJson["name"] = schedule.name.c_str();
+        scheduleJson["enabled"] = schedule.enabled ? 1 : 0;
+        scheduleJson["trigger"] = schedule.trigger;
+        scheduleJson["time"] = schedule.time;
+        scheduleJson["offset"] = schedule.offset;
+        scheduleJson["level"] = schedule.level;
+        scheduleJson["fadeTime"] = schedule.fadeTime;
+        JsonArray days = scheduleJson.createNestedArray("days");
+        for (int d = 0; d < 7; d++)
+        {
+            if (schedule.days & (1 << d))
+            {
+                days.add(d);
+            }
+        }
+        JsonArray members = scheduleJson.createNestedArray("channels");
+        for (int c = 0; c < sizeof(this->channelConfigs) / sizeof(ChannelConfig); c++)
+        {
+            if (schedule.channels & (1 << c))
+            {
+                members.add(c + 1);
+            }
+        }
+    }
+}
+
+bool LMANConfig::saveToLittleFS()
+{
+    std::vector<uint8_t> data;
+    this->_serialize(data);
+    uint32_t crc = crc32_le(0, data.data(), data.size());
+    if (crc == this->_savedCrc && LittleFS.exists(CONFIG_FILE))
     {
-        LOG_INFO("Saved config file.");
+        LOG_INFO("Config unchanged, will not write to flash.");
+        return true;
     }
-    config_file.close();
 
+    ConfigFileHeader header;
+    header.magic = CONFIG_MAGIC;
+    header.version = CONFIG_VERSION;
+    header.length = data.size();
+    header.crc = crc;
+
+    // Write the complete new config to a temporary file and then replace the old one.
+    // LittleFS renames are atomic, a power loss will always leave one valid file.
+    File configFile = LittleFS.open(CONFIG_FILE_TMP, "w");
+    if (!configFile)
+    {
+        LOG_ERROR("Failed to open ", CONFIG_FILE_TMP, " for writing.");
+        return false;
+    }
+    bool written = configFile.write((uint8_t *)&header, sizeof(header)) == sizeof(header) && configFile.write(data.data(), data.size()) == data.size();
+    configFile.close();
+    if (!written)
+    {
+        LOG_ERROR("Failed to write config file.");
+        LittleFS.remove(CONFIG_FILE_TMP);
+        return false;
+    }
+    if (!LittleFS.rename(CONFIG_FILE_TMP, CONFIG_FILE))
+    {
+        LOG_ERROR("Failed to replace config file.");
+        return false;
+    }
+
+    this->_savedCrc = crc;
+    LOG_INFO("Saved config file.");
     return true;
 }
 
+bool LMANConfig::_loadBinary(const char *path)
+{
+    File configFile = LittleFS.open(path);
+    if (!configFile)
+    {
+        return false;
+    }
+
+    ConfigFileHeader header;
+    std::vector<uint8_t> data;
+    bool read = configFile.read((uint8_t *)&header, sizeof(header)) == sizeof(header) && header.magic == CONFIG_MAGIC;
+    if (read)
+    {
+        data.resize(header.length);
+        read = configFile.read(data.data(), data.size()) == data.size();
+    }
+    configFile.close();
+
+    if (!read)
+    {
+        LOG_ERROR("Failed to read ", path);
+        return false;
+    }
+    if (crc32_le(0, data.data(), data.size()) != header.crc)
+    {
+        LOG_ERROR("CRC mismatch in ", path);
+        return false;
+    }
+    if (header.version > CONFIG_VERSION)
+    {
+        LOG_ERROR("Config version ", header.version, " in ", path, " is newer than supported version ", CONFIG_VERSION);
+        return false;
+    }
+    if (!this->_deserialize(data.data(), data.size(), header.version))
+    {
+        LOG_ERROR("Config in ", path, " is truncated.");
+        return false;
+    }
+    this->_savedCrc = header.crc;
+    return true;
+}
+
+void LMANConfig::_serialize(std::vector<uint8_t> &data)
+{
+    ConfigWriter writer(data);
+    writer.writeString(this->wifi_hostname);
+    writer.writeString(this->wifi_ssid);
+    writer.writeString(this->wifi_psk);
+    writer.writeU8(this->logging_level);
+    writer.writeString(this->home_assistant_base_topic);
+    writer.writeU16(this->home_assistant_state_change_wait);
+    writer.writeString(this->mqtt_server);
+    writer.writeU16(this->mqtt_port);
+    writer.writeString(this->mqtt_username);
+    writer.writeString(this->mqtt_password);
+    writer.writeU8(this->buttonPressMinTime);
+    writer.writeU16(this->buttonPressMaxTime);
+
+    for (ChannelConfig &channel : this->channelConfigs)
+    {
+        writer.writeString(channel.name);
+        writer.writeU8(channel.channel);
+        writer.writeU8(channel.min);
+        writer.writeU8(channel.max);
+        writer.writeU8(channel.dimmingSpeed);
+        writer.writeU16(channel.holdPeriod);
+        writer.writeU8(channel.autoDimmingSpeed);
+        writer.writeU8(channel.enabled);
+    }
+
+    for (ButtonConfig &button : this->buttonConfigs)
+    {
+        writer.writeU8(button.enabled);
+        writer.writeU8(button.channel);
+    }
+
+    // Version 2
+    writer.writeString(this->update_url);
+    writer.writeU16(this->update_poll_interval);
+    writer.writeU16(this->update_stagger);
+    writer.writeString(this->update_littlefs_sha256);
+
+    // Version 3
+    writer.writeU8(this->artnet_enabled);
+    writer.writeU16(this->artnet_universe);
+    writer.writeU8(this->dmx_merge_mode);
+
+    // Version 4
+    writer.writeU8(this->e131_enabled);
+    writer.writeU16(this->e131_universe);
+
+    // Version 5
+    for (SceneConfig &scene : this->sceneConfigs)
+    {
+        writer.writeString(scene.name);
+        writer.writeU8(scene.enabled);
+        writer.writeU8(scene.channels);
+        for (uint8_t level : scene.levels)
+        {
+            writer.writeU8(level);
+        }
+        writer.writeU16(scene.fadeTime);
+    }
+    for (ButtonConfig &button : this->buttonConfigs)
+    {
+        writer.writeU8(button.scene);
+    }
+
+    // Version 6
+    writer.writeU8(this->log_serial);
+    writer.writeString(this->syslog_server);
+    writer.writeU16(this->syslog_port);
+
+    // Version 7
+    writer.writeU8(this->dmx_min_frame_rate);
+
+    // Version 8
+    for (ChannelConfig &channel : this->channelConfigs)
+    {
+        writer.writeU8(channel.universe);
+    }
+
+    // Version 9
+    for (ChannelConfig &channel : this->channelConfigs)
+    {
+        writer.writeU8(channel.fine);
+    }
+
+    // Version 10
+    for (ChannelConfig &channel : this->channelConfigs)
+    {
+        writer.writeU8(channel.type);
+    }
+
+    // Version 11
+    for (GroupConfig &group : this->groupConfigs)
+    {
+        writer.writeString(group.name);
+        writer.writeU8(group.enabled);
+        writer.writeU8(group.channels);
+        writer.writeU16(group.fadeTime);
+    }
+
+    // Version 12
+    writer.writeU8(this->mqtt_raw_enabled);
+    writer.writeU16(this->mqtt_raw_hold);
+
+    // Version 13
+    writer.writeString(this->time_zone);
+    writer.writeString(this->ntp_server);
+    writer.writeU16(this->latitude);
+    writer.writeU16(this->longitude);
+    for (ScheduleConfig &schedule : this->scheduleConfigs)
+    {
+        writer.writeString(schedule.name);
+        writer.writeU8(schedule.enabled);
+        writer.writeU8(schedule.trigger);
+        writer.writeU16(schedule.time);
+        writer.writeU16(schedule.offset);
+        writer.writeU8(schedule.days);
+        writer.writeU8(schedule.channels);
+        writer.writeU8(schedule.level);
+        writer.writeU16(schedule.fadeTime);
+    }
+}
+
+bool LMANConfig::_deserialize(const uint8_t *data, size_t length, uint16_t version)
+{
+    ConfigReader reader(data, length);
+    reader.readString(this->wifi_hostname);
+    reader.readString(this->wifi_ssid);
+    reader.readString(this->wifi_psk);
+    this->logging_level = reader.readU8();
+    reader.readString(this->home_assistant_base_topic);
+    this->home_assistant_state_change_wait = reader.readU16();
+    reader.readString(this->mqtt_server);
+    this->mqtt_port = reader.readU16();
+    reader.readString(this->mqtt_username);
+    reader.readString(this->mqtt_password);
+    this->buttonPressMinTime = reader.readU8();
+    this->buttonPressMaxTime = reader.readU16();
+
+    for (ChannelConfig &channel : this->channelConfigs)
+    {
+        reader.readString(channel.name);
+        channel.channel = reader.readU8();
+        channel.min = reader.readU8();
+        channel.max = reader.readU8();
+        channel.dimmingSpeed = reader.readU8();
+        channel.holdPeriod = reader.readU16();
+        channel.autoDimmingSpeed = reader.readU8();
+        channel.enabled = reader.readU8() == 1;
+    }
+
+    for (ButtonConfig &button : this->buttonConfigs)
+    {
+        button.enabled = reader.readU8() == 1;
+        button.channel = reader.readU8();
+    }
+
+    if (version >= 2)
+    {
+        reader.readString(this->update_url);
+        this->update_poll_interval = reader.readU16();
+        this->update_stagger = reader.readU16();
+        reader.readString(this->update_littlefs_sha256);
+    }
+    else
+    {
+        this->update_url = "";
+        this->update_poll_interval = 0;
+        this->update_stagger = 0;
+        this->update_littlefs_sha256 = "";
+    }
+
+    if (version >= 3)
+    {
+        this->artnet_enabled = reader.readU8() == 1;
+        this->artnet_universe = reader.readU16();
+        this->dmx_merge_mode = reader.readU8();
+    }
+    else
+    {
+        this->artnet_enabled = false;
+        this->artnet_universe = 0;
+        this->dmx_merge_mode = 0;
+    }
+
+    if (version >= 4)
+    {
+        this->e131_enabled = reader.readU8() == 1;
+        this->e131_universe = reader.readU16();
+    }
+    else
+    {
+        this->e131_enabled = false;
+        this->e131_universe = 1;
+    }
+
+    for (SceneConfig &scene : this->sceneConfigs)
+    {
+        if (version >= 5)
+        {
+            reader.readString(scene.name);
+            scene.enabled = reader.readU8() == 1;
+            scene.channels = reader.readU8();
+            for (uint8_t &level : scene.levels)
+            {
+                level = reader.readU8();
+            }
+            scene.fadeTime = reader.readU16();
+        }
+        else
+        {
+            scene = SceneConfig();
+        }
+    }
+    for (ButtonConfig &button : this->buttonConfigs)
+    {
+        button.scene = version >= 5 ? reader.readU8() : 0;
+    }
+
+    if (version >= 6)
+    {
+        this->log_serial = reader.readU8() == 1;
+        reader.readString(this->syslog_server);
+        this->syslog_port = reader.readU16();
+    }
+    else
+    {
+        this->log_serial = true;
+        this->syslog_server = "";
+        this->syslog_port = 514;
+    }
+
+    this->dmx_min_frame_rate = version >= 7 ? reader.readU8() : 2;
+
+    for (ChannelConfig &channel : this->channelConfigs)
+    {
+        channel.universe = version >= 8 ? reader.readU8() : 1;
+    }
+
+    for (ChannelConfig &channel : this->channelConfigs)
+    {
+        channel.fine = version >= 9 ? reader.readU8() != 0 : false;
+    }
+
+    for (ChannelConfig &channel : this->channelConfigs)
+    {
+        channel.type = version >= 10 ? reader.readU8() : FIXTURE_DIMMER;
+    }
+
+    for (int i = 0; i < sizeof(this->groupConfigs) / sizeof(GroupConfig); i++)
+    {
+        GroupConfig &group = this->groupConfigs[i];
+        if (version >= 11)
+        {
+            reader.readString(group.name);
+            group.enabled = reader.readU8() == 1;
+            group.channels = reader.readU8();
+            group.fadeTime = reader.readU16();
+        }
+        else
+        {
+            group = GroupConfig();
+            group.name = "group" + std::to_string(i + 1);
+        }
+    }
+
+    if (version >= 12)
+    {
+        this->mqtt_raw_enabled = reader.readU8() == 1;
+        this->mqtt_raw_hold = reader.readU16();
+    }
+    else
+    {
+        this->mqtt_raw_enabled = false;
+        this->mqtt_raw_hold = 2000;
+    }
+
+    if (version >= 13)
+    {
+        reader.readString(this->time_zone);
+        reader.readString(this->ntp_server);
+        this->latitude = reader.readU16();
+        this->longitude = reader.readU16();
+    }
+    else
+    {
+        this->time_zone = "UTC0";
+        this->ntp_server = "pool.ntp.org";
+        this->latitude = 0;
+        this->longitude = 0;
+    }
+    for (int i = 0; i < sizeof(this->scheduleConfigs) / sizeof(ScheduleConfig); i++)
+    {
+        ScheduleConfig &schedule = this->scheduleConfigs[i];
+        if (version >= 13)
+        {
+            reader.readString(schedule.name);
+            schedule.enabled = reader.readU8() == 1;
+            schedule.trigger = reader.readU8();
+            schedule.time = reader.readU16();
+            schedule.offset = reader.readU16();
+            schedule.days = reader.readU8();
+            schedule.channels = reader.readU8();
+            schedule.level = reader.readU8();
+            schedule.fadeTime = reader.readU16();
+        }
+        else
+        {
+            schedule = ScheduleConfig();
+            schedule.name = "schedule" + std::to_string(i + 1);
+        }
+    }
+
+    return !reader.overflowed();
+}
+
+uint8_t LMANConfig::diff(const LMANConfig &previous)
+{
+    uint8_t changes = CONFIG_CHANGE_NONE;
+    if (this->wifi_hostname != previous.wifi_hostname ||
+        this->wifi_ssid != previous.wifi_ssid ||
+        this->wifi_psk != previous.wifi_psk ||
+        this->home_assistant_base_topic != previous.home_assistant_base_topic ||
+        this->mqtt_server != previous.mqtt_server ||
+        this->mqtt_port != previous.mqtt_port ||
+        this->mqtt_username != previous.mqtt_username ||
+        this->mqtt_password != previous.mqtt_password ||
+        this->artnet_enabled != previous.artnet_enabled ||
+        this->e131_enabled != previous.e131_enabled ||
+        this->e131_universe != previous.e131_universe)
+    {
+        // The hostname and base topic are also part of the MQTT last will.
+        // A new sACN universe means another multicast group.
+        changes |= CONFIG_CHANGE_REBOOT;
+    }
+
+    if (this->logging_level != previous.logging_level ||
+        this->home_assistant_state_change_wait != previous.home_assistant_state_change_wait ||
+        this->buttonPressMinTime != previous.buttonPressMinTime ||
+        this->buttonPressMaxTime != previous.buttonPressMaxTime ||
+        this->update_url != previous.update_url ||
+        this->update_poll_interval != previous.update_poll_interval ||
+        this->update_stagger != previous.update_stagger ||
+        this->artnet_universe != previous.artnet_universe ||
+        this->dmx_merge_mode != previous.dmx_merge_mode ||
+        this->dmx_min_frame_rate != previous.dmx_min_frame_rate ||
+        this->mqtt_raw_hold != previous.mqtt_raw_hold ||
+        this->time_zone != previous.time_zone ||
+        this->ntp_server != previous.ntp_server ||
+        this->latitude != previous.latitude ||
+        this->longitude != previous.longitude ||
+        this->log_serial != previous.log_serial ||
+        this->syslog_server != previous.syslog_server ||
+        this->syslog_port != previous.syslog_port)
+    {
+        changes |= CONFIG_CHANGE_HOT;
+    }
+
+    for (int i = 0; i < sizeof(this->channelConfigs) / sizeof(ChannelConfig); i++)
+    {
+        const ChannelConfig &current = this->channelConfigs[i];
+        const ChannelConfig &old = previous.channelConfigs[i];
+        // The brightness scale and color modes are part of the Home Assistant entity
+        if (current.name != old.name || current.channel != old.channel || current.universe != old.universe || current.enabled != old.enabled ||
+            current.fine != old.fine || current.type != old.type)
+        {
+            changes |= CONFIG_CHANGE_RESUBSCRIBE | CONFIG_CHANGE_HOT;
+        }
+        if (current.min != old.min || current.max != old.max ||
+            current.dimmingSpeed != old.dimmingSpeed || current.autoDimmingSpeed != old.autoDimmingSpeed ||
+            current.holdPeriod != old.holdPeriod)
+        {
+            changes |= CONFIG_CHANGE_HOT;
+        }
+    }
+
+    for (int i = 0; i < sizeof(this->buttonConfigs) / sizeof(ButtonConfig); i++)
+    {
+        if (this->buttonConfigs[i].enabled != previous.buttonConfigs[i].enabled || this->buttonConfigs[i].channel != previous.buttonConfigs[i].channel ||
+            this->buttonConfigs[i].scene != previous.buttonConfigs[i].scene)
+        {
+            changes |= CONFIG_CHANGE_HOT;
+        }
+    }
+
+    for (int i = 0; i < sizeof(this->sceneConfigs) / sizeof(SceneConfig); i++)
+    {
+        const SceneConfig &current = this->sceneConfigs[i];
+        const SceneConfig &old = previous.sceneConfigs[i];
+        if (current.name != old.name || current.enabled != old.enabled)
+        {
+            changes |= CONFIG_CHANGE_RESUBSCRIBE;
+        }
+        // Levels and fade time are read when a scene is recalled, nothing to apply.
+    }
+
+    for (int i = 0; i < sizeof(this->groupConfigs) / sizeof(GroupConfig); i++)
+    {
+        const GroupConfig &current = this->groupConfigs[i];
+        const GroupConfig &old = previous.groupConfigs[i];
+        // Members decide which color modes the group entity supports
+        if (current.name != old.name || current.enabled != old.enabled || current.channels != old.channels)
+        {
+            changes |= CONFIG_CHANGE_RESUBSCRIBE;
+        }
+    }
+
+    for (int i = 0; i < sizeof(this->scheduleConfigs) / sizeof(ScheduleConfig); i++)
+    {
+        const ScheduleConfig &current = this->scheduleConfigs[i];
+        const ScheduleConfig &old = previous.scheduleConfigs[i];
+        // The next fire times are calculated again, the name is only shown in the web interface
+        if (current.enabled != old.enabled || current.trigger != old.trigger || current.time != old.time || current.offset != old.offset ||
+            current.days != old.days || current.channels != old.channels || current.level != old.level || current.fadeTime != old.fadeTime)
+        {
+            changes |= CONFIG_CHANGE_HOT;
+        }
+    }
+
+    if (this->mqtt_raw_enabled != previous.mqtt_raw_enabled)
+    {
+        changes |= CONFIG_CHANGE_RESUBSCRIBE;
+    }
+    return changes;
+}
+
+std::string LMANConfig::buildMqttRawTopic() const
+{
+    std::string rawTopic = this->home_assistant_base_topic;
+    rawTopic.append("light/");
+    rawTopic.append(this->wifi_hostname);
+    rawTopic.append("/raw");
+    return rawTopic;
+}
+
+const std::string &LMANConfig::getMqttRawTopic()
+{
+    if (this->_mqttRawTopic.value.empty())
+    {
+        this->_mqttRawTopic.value = this->buildMqttRawTopic();
+    }
+    return this->_mqttRawTopic.value;
+}
+
 bool LMANConfig::factoryReset()
 {
     this->wifi_hostname = "lman";
@@ -245,8 +1181,34 @@ bool LMANConfig::factoryReset()
     this->buttonPressMinTime = 80;
     this->buttonPressMaxTime = 800;
 
+    this->update_url = "";
+    this->update_poll_interval = 0;
+    this->update_stagger = 0;
+    this->update_littlefs_sha256 = "";
+
+    this->artnet_enabled = false;
+    this->artnet_universe = 0;
+    this->dmx_merge_mode = 0;
+    this->dmx_min_frame_rate = 2;
+    this->e131_enabled = false;
+    this->e131_universe = 1;
+    this->mqtt_raw_enabled = false;
+    this->mqtt_raw_hold = 2000;
+
+    this->time_zone = "UTC0";
+    this->ntp_server = "pool.ntp.org";
+    this->latitude = 0;
+    this->longitude = 0;
+
+    this->log_serial = true;
+    this->syslog_server = "";
+    this->syslog_port = 514;
+
     this->channelConfigs[0].name = "channel1";
     this->channelConfigs[0].channel = 1;
+    this->channelConfigs[0].universe = 1;
+    this->channelConfigs[0].fine = false;
+    this->channelConfigs[0].type = FIXTURE_DIMMER;
     this->channelConfigs[0].min = 1;
     this->channelConfigs[0].max = 255;
     this->channelConfigs[0].dimmingSpeed = 5;
@@ -255,6 +1217,9 @@ bool LMANConfig::factoryReset()
     this->channelConfigs[0].enabled = false;
     this->channelConfigs[1].name = "channel2";
     this->channelConfigs[1].channel = 1;
+    this->channelConfigs[1].universe = 1;
+    this->channelConfigs[1].fine = false;
+    this->channelConfigs[1].type = FIXTURE_DIMMER;
     this->channelConfigs[1].min = 1;
     this->channelConfigs[1].max = 255;
     this->channelConfigs[1].dimmingSpeed = 5;
@@ -263,6 +1228,9 @@ bool LMANConfig::factoryReset()
     this->channelConfigs[1].enabled = false;
     this->channelConfigs[2].name = "channel3";
     this->channelConfigs[2].channel = 1;
+    this->channelConfigs[2].universe = 1;
+    this->channelConfigs[2].fine = false;
+    this->channelConfigs[2].type = FIXTURE_DIMMER;
     this->channelConfigs[2].min = 1;
     this->channelConfigs[2].max = 255;
     this->channelConfigs[2].dimmingSpeed = 5;
@@ -271,6 +1239,9 @@ bool LMANConfig::factoryReset()
     this->channelConfigs[2].enabled = false;
     this->channelConfigs[3].name = "channel4";
     this->channelConfigs[3].channel = 1;
+    this->channelConfigs[3].universe = 1;
+    this->channelConfigs[3].fine = false;
+    this->channelConfigs[3].type = FIXTURE_DIMMER;
     this->channelConfigs[3].min = 1;
     this->channelConfigs[3].max = 255;
     this->channelConfigs[3].dimmingSpeed = 5;
@@ -286,5 +1257,27 @@ bool LMANConfig::factoryReset()
     this->buttonConfigs[2].enabled = 0;
     this->buttonConfigs[3].channel = 1;
     this->buttonConfigs[3].enabled = 0;
+    for (ButtonConfig &button : this->buttonConfigs)
+    {
+        button.scene = 0;
+    }
+
+    for (int i = 0; i < sizeof(this->sceneConfigs) / sizeof(SceneConfig); i++)
+    {
+        this->sceneConfigs[i] = SceneConfig();
+        this->sceneConfigs[i].name = "scene" + std::to_string(i + 1);
+    }
+
+    for (int i = 0; i < sizeof(this->groupConfigs) / sizeof(GroupConfig); i++)
+    {
+        this->groupConfigs[i] = GroupConfig();
+        this->groupConfigs[i].name = "group" + std::to_string(i + 1);
+    }
+
+    for (int i = 0; i < sizeof(this->scheduleConfigs) / sizeof(ScheduleConfig); i++)
+    {
+        this->scheduleConfigs[i] = ScheduleConfig();
+        this->scheduleConfigs[i].name = "schedule" + std::to_string(i + 1);
+    }
     return this->saveToLittleFS();
 }
\ No newline at end of file
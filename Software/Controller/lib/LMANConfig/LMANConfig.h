@@ -1,8 +1,27 @@
 #ifndef LMAN_CONFIG_H
 #define LMAN_CONFIG_H
 
+#include <ArduinoJson.h>
+#include <Color.h>
 #include <string>
 #include <list>
+#include <vector>
+
+/// @brief Capacity of a JSON document holding the whole config in the config.json format
+#define CONFIG_JSON_SIZE 6144
+
+/// @brief A topic built on first use. Only the MQTT task builds, reads and clears it. A copy starts empty so that
+/// copying a config on another task (to diff it) never reads a topic while the MQTT task builds it.
+struct CachedTopic
+{
+    std::string value;
+    CachedTopic() = default;
+    CachedTopic(const CachedTopic &) {}
+    CachedTopic &operator=(const CachedTopic &)
+    {
+        return *this;
+    }
+};
 
 class ChannelConfig
 {
@@ -15,6 +34,12 @@ public:
     uint8_t max = 255;
     /// @brief The DMX channel to send data on. A channel of 0 = no initialized/valid
     uint8_t channel = 0;
+    /// @brief The DMX output (universe) the channel is sent on, 1-DMX_OUTPUT_COUNT
+    uint8_t universe = 1;
+    /// @brief Wether the channel is 16 bit, sent as coarse level on channel and fine level on channel + 1. Only for FIXTURE_DIMMER.
+    bool fine = false;
+    /// @brief What is connected, a FixtureType. Fixtures use FIXTURE_SLOTS consecutive slots starting at channel.
+    uint8_t type = FIXTURE_DIMMER;
     /// @brief The speed in ms to wait between dimming events.
     uint8_t dimmingSpeed = 5;
     /// @brief The period to hold the light at min/max when reached before reversing dimming.
@@ -23,33 +48,165 @@ public:
     uint8_t autoDimmingSpeed = 1;
     /// @brief Wether or not this channel is enabled.
     bool enabled = false;
-    /// @brief Return the base topic where all other sub-topics for this channel exists
+    /// @brief Return the base topic where all other sub-topics for this channel exists. Only use from the MQTT task.
     /// @return MQTT Topic
-    std::string getBaseTopic();
+    const std::string &getBaseTopic();
+    /// @brief Build the base topic from the current config without the cache, safe from any task
+    /// @return MQTT Topic
+    std::string buildBaseTopic() const;
     /// @brief Return the unique MQTT name of this channel
     /// @return Unique Name
     std::string getUniqueName();
-    /// @brief Return the topic where state updates of this channel should be sent
+    /// @brief Return the topic where state updates of this channel should be sent. Only use from the MQTT task.
     /// @return MQTT Topic
-    std::string getStateTopic();
-    /// @brief Return the topic where commands for this channel are sent
+    const std::string &getStateTopic();
+    /// @brief Return the topic where commands for this channel are sent. Only use from the MQTT task.
     /// @return MQTT Topic
-    std::string getCmdTopic();
+    const std::string &getCmdTopic();
     /// @brief Return the topic where configuration for this channel are sent
     /// @return MQTT Topic
     std::string getCfgTopic();
     /// @brief Return the topic where availability for this channel are sent
     /// @return MQTT Topic
     std::string getAvailabilityTopic();
+    /// @brief Forget the cached topics so that they are rebuilt from the current config. Only use from the MQTT task.
+    void clearTopicCache();
+    /// @brief The number of consecutive slots the channel uses, starting at channel
+    uint8_t getSlotCount() const;
 
 private:
-    std::string _baseTopic;
+    // Built once so that the topics used for every MQTT message do not allocate
+    CachedTopic _baseTopic;
+    CachedTopic _stateTopic;
+    CachedTopic _cmdTopic;
 };
 
 struct ButtonConfig
 {
     bool enabled;
     uint8_t channel;
+    /// @brief The scene to recall on a press, 1-4. 0 = control the channel instead.
+    uint8_t scene = 0;
+};
+
+class SceneConfig
+{
+public:
+    /// @brief The name of this scene (mostly used for home assistant)
+    std::string name;
+    /// @brief Wether or not this scene is enabled.
+    bool enabled = false;
+    /// @brief Bit per channel in LMANConfig::channelConfigs that is part of this scene. Other channels are left as they are.
+    uint8_t channels = 0;
+    /// @brief The level for each channel in LMANConfig::channelConfigs. 0 = turn off.
+    uint8_t levels[4] = {0, 0, 0, 0};
+    /// @brief The time in ms for all channels to reach their level.
+    uint16_t fadeTime = 1000;
+    /// @brief Return the base topic where all other sub-topics for this scene exists
+    /// @param index The index of this scene in LMANConfig::sceneConfigs
+    /// @return MQTT Topic
+    std::string getBaseTopic(uint8_t index);
+    /// @brief Return the topic where this scene is activated. Only use from the MQTT task.
+    /// @param index The index of this scene in LMANConfig::sceneConfigs
+    /// @return MQTT Topic
+    const std::string &getCmdTopic(uint8_t index);
+    /// @brief Return the topic where configuration for this scene are sent
+    /// @param index The index of this scene in LMANConfig::sceneConfigs
+    /// @return MQTT Topic
+    std::string getCfgTopic(uint8_t index);
+    /// @brief Return the unique MQTT name of this scene
+    /// @param index The index of this scene in LMANConfig::sceneConfigs
+    /// @return Unique Name
+    std::string getUniqueName(uint8_t index);
+
+private:
+    // Only depends on settings that need a reboot, built once
+    CachedTopic _cmdTopic;
+};
+
+class GroupConfig
+{
+public:
+    /// @brief The name of this group (mostly used for home assistant)
+    std::string name;
+    /// @brief Wether or not this group is enabled.
+    bool enabled = false;
+    /// @brief Bit per channel in LMANConfig::channelConfigs that is a member of this group.
+    uint8_t channels = 0;
+    /// @brief The time in ms for all members to reach a new level, if the command has no transition.
+    uint16_t fadeTime = 500;
+    /// @brief Return the base topic where all other sub-topics for this group exists
+    /// @param index The index of this group in LMANConfig::groupConfigs
+    /// @return MQTT Topic
+    std::string getBaseTopic(uint8_t index);
+    /// @brief Return the topic where commands for this group are received. Only use from the MQTT task.
+    /// @param index The index of this group in LMANConfig::groupConfigs
+    /// @return MQTT Topic
+    const std::string &getCmdTopic(uint8_t index);
+    /// @brief Return the topic where the state of this group is sent. Only use from the MQTT task.
+    /// @param index The index of this group in LMANConfig::groupConfigs
+    /// @return MQTT Topic
+    const std::string &getStateTopic(uint8_t index);
+    /// @brief Return the topic where configuration for this group are sent
+    /// @param index The index of this group in LMANConfig::groupConfigs
+    /// @return MQTT Topic
+    std::string getCfgTopic(uint8_t index);
+    /// @brief Return the unique MQTT name of this group
+    /// @param index The index of this group in LMANConfig::groupConfigs
+    /// @return Unique Name
+    std::string getUniqueName(uint8_t index);
+
+private:
+    // Only depends on settings that need a reboot, built once
+    CachedTopic _cmdTopic;
+    CachedTopic _stateTopic;
+};
+
+/// @brief When a schedule fires. Stored in ScheduleConfig::trigger.
+enum ScheduleTrigger : uint8_t
+{
+    /// @brief At a local time of day
+    SCHEDULE_TRIGGER_TIME = 0,
+    /// @brief At sunrise plus an offset
+    SCHEDULE_TRIGGER_SUNRISE = 1,
+    /// @brief At sunset plus an offset
+    SCHEDULE_TRIGGER_SUNSET = 2,
+    SCHEDULE_TRIGGER_COUNT,
+};
+
+class ScheduleConfig
+{
+public:
+    /// @brief The name of this schedule, only shown in the web interface
+    std::string name;
+    /// @brief Wether or not this schedule is enabled.
+    bool enabled = false;
+    /// @brief When the schedule fires, a ScheduleTrigger
+    uint8_t trigger = SCHEDULE_TRIGGER_TIME;
+    /// @brief The local time of day in minutes after midnight, for SCHEDULE_TRIGGER_TIME
+    uint16_t time = 0;
+    /// @brief Minutes to fire after (or before, if negative) sunrise or sunset
+    int16_t offset = 0;
+    /// @brief Bit per weekday the schedule fires on, bit 0 = Sunday
+    uint8_t days = 0x7F;
+    /// @brief Bit per channel in LMANConfig::channelConfigs that is faded.
+    uint8_t channels = 0;
+    /// @brief The 8 bit level to fade the channels to, 0 turns them off
+    uint8_t level = 0;
+    /// @brief The time in s for the channels to reach the level
+    uint16_t fadeTime = 60;
+};
+
+/// @brief What is needed for a config change to take effect. Values are combined as bit flags.
+enum ConfigChange : uint8_t
+{
+    CONFIG_CHANGE_NONE = 0,
+    /// @brief Can be applied to the running LightManager straight away
+    CONFIG_CHANGE_HOT = 1,
+    /// @brief MQTT topics or Home Assistant entities changed, needs re-subscribe and re-registration
+    CONFIG_CHANGE_RESUBSCRIBE = 2,
+    /// @brief WiFi or MQTT connection settings changed, needs a reboot
+    CONFIG_CHANGE_REBOOT = 4,
 };
 
 class LMANConfig
@@ -58,15 +215,30 @@ public:
     /// @brief Will try to initialize and load LittleFS
     /// @return True if successful
     bool init();
-    /// @brief Load config file from LittleFS
+    /// @brief Load config file from LittleFS. Imports a legacy config.json if no binary config exists.
     /// @return True if successful
     bool loadFromLittleFS();
-    /// @brief Save current config file to LittleFS
+    /// @brief Save current config file to LittleFS. Nothing is written if the config is unchanged.
     /// @return True if successful
     bool saveToLittleFS();
+    /// @brief Load config values from a JSON document in the config.json format
+    /// @param doc The JSON document to read
+    void loadFromJson(JsonDocument &doc);
+    /// @brief Write all config values to a JSON document in the config.json format
+    /// @param doc The JSON document to write to
+    void toJson(JsonDocument &doc);
+    /// @brief Compare this config to a previous version of it
+    /// @param previous The config before the change
+    /// @return ConfigChange flags of what is needed to apply the change
+    uint8_t diff(const LMANConfig &previous);
     /// @brief Reset all values to default
     /// @return True if successfuly saved to LittleFS
     bool factoryReset();
+    /// @brief The topic raw DMX slots are streamed to, see mqtt_raw_enabled. Built once as it only changes with a reboot.
+    /// Only use from the MQTT task.
+    const std::string &getMqttRawTopic();
+    /// @brief Build the raw DMX topic without the cache, safe from any task
+    std::string buildMqttRawTopic() const;
     /// @brief The instance of the config manager
     static LMANConfig *instance;
 
@@ -98,10 +270,76 @@ public:
     /// @brief The maximum time for a button press before it is considered a "hold" action
     uint16_t buttonPressMaxTime;
 
+    /// @brief URL of the update manifest on the local update server. Empty disables pulled updates.
+    std::string update_url;
+    /// @brief Minutes between polls of the update manifest, 0 to only update when requested via MQTT
+    uint16_t update_poll_interval;
+    /// @brief Maximum random delay (in s) before downloading an update, spreads a rollout over the fleet
+    uint16_t update_stagger;
+    /// @brief SHA-256 of the installed LittleFS image, used to only download a changed image
+    std::string update_littlefs_sha256;
+
+    /// @brief Wether to receive DMX levels over Art-Net
+    bool artnet_enabled;
+    /// @brief The Art-Net universe (15 bit port address) to receive
+    uint16_t artnet_universe;
+    /// @brief Wether to receive DMX levels over sACN (E1.31)
+    bool e131_enabled;
+    /// @brief The sACN universe to receive, 1-63999
+    uint16_t e131_universe;
+    /// @brief How levels received over the network are merged with local levels, a DMXMergeMode
+    uint8_t dmx_merge_mode;
+    /// @brief The DMX frame is sent at least this often (frames per second, 1-44), even if no level changed
+    uint8_t dmx_min_frame_rate;
+    /// @brief Wether to accept raw DMX slots on the MQTT raw topic, for streaming from a sequencer
+    bool mqtt_raw_enabled;
+    /// @brief Time (in ms) without raw MQTT slots before local levels are output again
+    uint16_t mqtt_raw_hold;
+
+    /// @brief POSIX TZ string of the local time zone, for schedules
+    std::string time_zone;
+    /// @brief The NTP server to take the time from. Empty disables NTP.
+    std::string ntp_server;
+    /// @brief Latitude of the location in 1/100 degree, north positive. Used for the sunrise and sunset of schedules.
+    int16_t latitude;
+    /// @brief Longitude of the location in 1/100 degree, east positive
+    int16_t longitude;
+
+    /// @brief Wether to write the log to the serial port
+    bool log_serial;
+    /// @brief Host name or IP of the syslog server to send the log to. Empty disables syslog.
+    std::string syslog_server;
+    /// @brief UDP port of the syslog server
+    uint16_t syslog_port;
+
     /// @brief Configuration for all DMX channels
     ChannelConfig channelConfigs[4];
     /// @brief Configuration for all buttons
     ButtonConfig buttonConfigs[4];
+    /// @brief Configuration for all scenes
+    SceneConfig sceneConfigs[4];
+    /// @brief Configuration for all groups
+    GroupConfig groupConfigs[4];
+    /// @brief Configuration for all schedules
+    ScheduleConfig scheduleConfigs[8];
+
+private:
+    /// @brief CRC of the config last read from or written to LittleFS
+    uint32_t _savedCrc = 0;
+    CachedTopic _mqttRawTopic;
+    /// @brief Load a binary config file and verify its CRC
+    /// @param path The file to load
+    /// @return True if successful
+    bool _loadBinary(const char *path);
+    /// @brief Serialize all values to the binary config format
+    /// @param data The buffer to append to
+    void _serialize(std::vector<uint8_t> &data);
+    /// @brief Read all values from the binary config format
+    /// @param data The payload of the config file
+    /// @param length The length of the payload
+    /// @param version The version of the config file
+    /// @return True if all values could be read
+    bool _deserialize(const uint8_t *data, size_t length, uint16_t version);
 };
 
 #endif
\ No newline at end of file
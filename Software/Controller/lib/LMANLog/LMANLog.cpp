@@ -0,0 +1,95 @@
+#include <LMANLog.h>
+
+// The format of each LogFormat, arguments are always printed as unsigned integers.
+static const char *const LOG_FORMATS[LOGF_COUNT] = {
+    "Setting channel %u to level %u",
+    "Updating DMX channel %u to value %u",
+    "Stop auto-dimming requested for channel %u",
+    "Adding new button event on pin %u, new state: %u",
+    "New state DEPRESSED from confirmed PRESSED. Skipping debounce checking for channel %u",
+    "New state %u (1 = PRESSED) for channel %u",
+    "New state %u (1 = PRESSED) confirmed for channel %u",
+    "_taskReadButtonStates got notification.",
+    "Button on PIN %u has undetermined state, will check again in %u ms",
+    "Unhandled button event on pin %u",
+    "Hold period over at min light for channel %u, reversing!",
+    "Hold period over at max light for channel %u, reversing!",
+    "Restoring previous level %u for DMX Channel %u",
+};
+
+static const char *const LOG_LEVEL_NAMES[] = {"NONE", "ERROR", "WARNING", "INFO", "DEBUG", "TRACE"};
+
+static LogRecord _records[LMAN_LOG_BUFFER_SIZE];
+/// @brief The total number of records written, the next record goes to _written % LMAN_LOG_BUFFER_SIZE
+static uint32_t _written = 0;
+static portMUX_TYPE _recordsMux = portMUX_INITIALIZER_UNLOCKED;
+
+void LMANLog::_write(uint8_t level, uint16_t format, const uint32_t *args, uint8_t argCount)
+{
+    uint32_t time = micros();
+    portENTER_CRITICAL(&_recordsMux);
+    LogRecord *record = &_records[_written % LMAN_LOG_BUFFER_SIZE];
+    record->time = time;
+    record->format = format;
+    record->level = level;
+    record->argCount = argCount;
+    for (uint8_t i = 0; i < argCount; i++)
+    {
+        record->args[i] = args[i];
+    }
+    _written++;
+    portEXIT_CRITICAL(&_recordsMux);
+}
+
+uint16_t LMANLog::_snapshot(LogRecord *records)
+{
+    portENTER_CRITICAL(&_recordsMux);
+    uint16_t count = _written < LMAN_LOG_BUFFER_SIZE ? _written : LMAN_LOG_BUFFER_SIZE;
+    uint32_t first = _written - count;
+    for (uint16_t i = 0; i < count; i++)
+    {
+        records[i] = _records[(first + i) % LMAN_LOG_BUFFER_SIZE];
+    }
+    portEXIT_CRITICAL(&_recordsMux);
+    return count;
+}
+
+void LMANLog::decode(Print &output)
+{
+    LogRecord *records = (LogRecord *)malloc(sizeof(LogRecord) * LMAN_LOG_BUFFER_SIZE);
+    if (!records)
+    {
+        output.print("Not enough memory to read the log.\n");
+        return;
+    }
+    uint16_t count = LMANLog::_snapshot(records);
+    char line[160];
+    for (uint16_t i = 0; i < count; i++)
+    {
+        LogRecord *record = &records[i];
+        int length = snprintf(line, sizeof(line), "[%10u us] %s: ", (unsigned)record->time, record->level <= LMAN_LOG_LEVEL_TRACE ? LOG_LEVEL_NAMES[record->level] : "?");
+        if (record->format < LOGF_COUNT)
+        {
+            snprintf(line + length, sizeof(line) - length, LOG_FORMATS[record->format], (unsigned)record->args[0], (unsigned)record->args[1], (unsigned)record->args[2]);
+        }
+        else
+        {
+            snprintf(line + length, sizeof(line) - length, "Unknown format %u", (unsigned)record->format);
+        }
+        output.print(line);
+        output.print("\n");
+    }
+    free(records);
+}
+
+void LMANLog::dump(Print &output)
+{
+    LogRecord *records = (LogRecord *)malloc(sizeof(LogRecord) * LMAN_LOG_BUFFER_SIZE);
+    if (!records)
+    {
+        return;
+    }
+    uint16_t count = LMANLog::_snapshot(records);
+    output.write((const uint8_t *)records, sizeof(LogRecord) * count);
+    free(records);
+}
@@ -0,0 +1,144 @@
+#ifndef LMAN_LOG
+#define LMAN_LOG
+
+#include <Arduino.h>
+#include <ArduLog.h>
+
+// Log levels, same values as ArduLogLevel
+#define LMAN_LOG_LEVEL_NONE 0
+#define LMAN_LOG_LEVEL_ERROR 1
+#define LMAN_LOG_LEVEL_WARNING 2
+#define LMAN_LOG_LEVEL_INFO 3
+#define LMAN_LOG_LEVEL_DEBUG 4
+#define LMAN_LOG_LEVEL_TRACE 5
+
+/// @brief Highest level of text logs that is compiled in. Calls above it are removed together with their arguments.
+#ifndef LMAN_LOG_LEVEL
+#define LMAN_LOG_LEVEL LMAN_LOG_LEVEL_TRACE
+#endif
+
+/// @brief Highest level of deferred logs that is compiled in.
+#ifndef LMAN_LOG_DEFERRED_LEVEL
+#define LMAN_LOG_DEFERRED_LEVEL LMAN_LOG_LEVEL_TRACE
+#endif
+
+/// @brief The number of deferred log records kept, the oldest are overwritten.
+#define LMAN_LOG_BUFFER_SIZE 256
+/// @brief The maximum number of arguments of a deferred log record
+#define LMAN_LOG_MAX_ARGS 3
+
+#if LMAN_LOG_LEVEL < LMAN_LOG_LEVEL_TRACE
+#undef LOG_TRACE
+#define LOG_TRACE(...) \
+    do                 \
+    {                  \
+    } while (0)
+#endif
+#if LMAN_LOG_LEVEL < LMAN_LOG_LEVEL_DEBUG
+#undef LOG_DEBUG
+#define LOG_DEBUG(...) \
+    do                 \
+    {                  \
+    } while (0)
+#endif
+#if LMAN_LOG_LEVEL < LMAN_LOG_LEVEL_INFO
+#undef LOG_INFO
+#define LOG_INFO(...) \
+    do                \
+    {                 \
+    } while (0)
+#endif
+#if LMAN_LOG_LEVEL < LMAN_LOG_LEVEL_WARNING
+#undef LOG_WARNING
+#define LOG_WARNING(...) \
+    do                   \
+    {                    \
+    } while (0)
+#endif
+#if LMAN_LOG_LEVEL < LMAN_LOG_LEVEL_ERROR
+#undef LOG_ERROR
+#define LOG_ERROR(...) \
+    do                 \
+    {                  \
+    } while (0)
+#endif
+
+/// @brief Log a record to the deferred log. Only the format ID and the raw arguments are stored,
+/// formatting is done when the log is read. Never blocks on Serial.
+#if LMAN_LOG_DEFERRED_LEVEL >= LMAN_LOG_LEVEL_TRACE
+#define LOGD_TRACE(format, ...) LMANLog::log(LMAN_LOG_LEVEL_TRACE, format, ##__VA_ARGS__)
+#else
+#define LOGD_TRACE(format, ...) \
+    do                          \
+    {                           \
+    } while (0)
+#endif
+#if LMAN_LOG_DEFERRED_LEVEL >= LMAN_LOG_LEVEL_DEBUG
+#define LOGD_DEBUG(format, ...) LMANLog::log(LMAN_LOG_LEVEL_DEBUG, format, ##__VA_ARGS__)
+#else
+#define LOGD_DEBUG(format, ...) \
+    do                          \
+    {                           \
+    } while (0)
+#endif
+
+/// @brief The formats of the deferred log. Only append, the IDs are stored in the log.
+enum LogFormat : uint16_t
+{
+    LOGF_SET_LEVEL,
+    LOGF_UPDATE_DMX,
+    LOGF_STOP_AUTO_DIMMING,
+    LOGF_BUTTON_EVENT,
+    LOGF_BUTTON_RELEASED,
+    LOGF_BUTTON_CHANGED,
+    LOGF_BUTTON_CONFIRMED,
+    LOGF_READ_BUTTONS_NOTIFIED,
+    LOGF_BUTTON_UNDETERMINED,
+    LOGF_BUTTON_UNHANDLED,
+    LOGF_HOLD_MIN,
+    LOGF_HOLD_MAX,
+    LOGF_RESTORE_LEVEL,
+    LOGF_COUNT,
+};
+
+/// @brief A deferred log record as stored in the ring buffer and sent by /logs?raw
+struct LogRecord
+{
+    /// @brief micros() when the record was logged
+    uint32_t time;
+    uint16_t format;
+    uint8_t level;
+    uint8_t argCount;
+    uint32_t args[LMAN_LOG_MAX_ARGS];
+};
+
+class LMANLog
+{
+public:
+    /// @brief Add a record to the deferred log
+    /// @param level The log level
+    /// @param format The format ID
+    /// @param args Up to LMAN_LOG_MAX_ARGS integer arguments
+    template <typename... Args>
+    static void log(uint8_t level, uint16_t format, Args... args)
+    {
+        static_assert(sizeof...(args) <= LMAN_LOG_MAX_ARGS, "Too many arguments for a deferred log record");
+        uint32_t values[LMAN_LOG_MAX_ARGS + 1] = {0, (uint32_t)args...};
+        LMANLog::_write(level, format, values + 1, sizeof...(args));
+    }
+    /// @brief Format all records in the deferred log, oldest first
+    /// @param output Where to print the log to
+    static void decode(Print &output);
+    /// @brief Copy all records in the deferred log, oldest first
+    /// @param output Where to write the raw LogRecord structs to
+    static void dump(Print &output);
+
+private:
+    static void _write(uint8_t level, uint16_t format, const uint32_t *args, uint8_t argCount);
+    /// @brief Copy the records in order as the ring buffer is written to while reading
+    /// @param records Buffer of LMAN_LOG_BUFFER_SIZE records
+    /// @return The number of records copied
+    static uint16_t _snapshot(LogRecord *records);
+};
+
+#endif
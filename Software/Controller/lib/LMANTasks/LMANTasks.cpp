@@ -0,0 +1,168 @@
+#include <LMANTasks.h>
+#include <LMANLog.h>
+
+// DMX output preempts everything on its core so that frames go out as soon as they are ready.
+// The fade engines come next, buttons after that. The Arduino loop runs at priority 1 on the DMX core.
+// The network core shares time with the WiFi stack (priority 23) and the async_tcp task.
+const TaskPlacement TASK_PLAN[TASK_COUNT] = {
+    {"taskSendDMXData1", 5000, 6, LMAN_DMX_CORE},
+    {"taskSendDMXData2", 5000, 6, LMAN_DMX_CORE},
+    {"taskEffects", 3000, 5, LMAN_DMX_CORE},
+    {"taskColor", 3000, 5, LMAN_DMX_CORE},
+    {"taskSceneFade", 5000, 5, LMAN_DMX_CORE},
+    {"taskAutoDimLights", 5000, 5, LMAN_DMX_CORE},
+    {"taskDimLights", 5000, 5, LMAN_DMX_CORE},
+    {"taskReadButtonStates", 5000, 4, LMAN_DMX_CORE},
+    {"taskProcessButtonEvents", 5000, 4, LMAN_DMX_CORE},
+    {"taskScheduler", 4000, 3, LMAN_DMX_CORE},
+    {"taskWiFiMqttHandler", 8192, 1, LMAN_NETWORK_CORE},
+    {"taskErrorLed", 5000, 1, LMAN_NETWORK_CORE},
+    {"taskWebStatusUpdates", 5000, 1, LMAN_NETWORK_CORE},
+    {"taskWriteUpdate", 5000, 2, LMAN_NETWORK_CORE},
+    {"taskPullUpdate", 6000, 1, LMAN_NETWORK_CORE},
+    {"taskDrainLog", 4000, 0, LMAN_NETWORK_CORE},
+};
+
+TaskTiming taskTimings[TIMING_COUNT];
+static const char *const TIMING_NAMES[TIMING_COUNT] = {"dmx_frame_1", "dmx_frame_2", "dmx_latency_1", "dmx_latency_2", "effect_period", "effect_frame", "color_frame"};
+static const char *const BOOT_STAGE_NAMES[BOOT_STAGE_COUNT] = {"config", "dmx", "channels", "buttons", "wifi", "web", "mqtt", "discovery"};
+/// @brief When each boot stage was reached in us, 0 if not yet
+static uint32_t _bootStageTimes[BOOT_STAGE_COUNT] = {0};
+
+/// @brief micros() when the pending frame of each output was marked ready, 0 if none
+static volatile uint32_t _dmxFrameReadyAt[TIMING_DMX_LATENCY_1 - TIMING_DMX_FRAME_1] = {0};
+
+/// @brief Handles of the created tasks, for the stack usage
+static TaskHandle_t _taskHandles[TASK_COUNT];
+
+bool createTask(LMANTask task, TaskFunction_t function, TaskHandle_t *handle, void *param)
+{
+    const TaskPlacement &placement = TASK_PLAN[task];
+    if (xTaskCreatePinnedToCore(function, placement.name, placement.stackSize, param, placement.priority, &_taskHandles[task], placement.core) != pdPASS)
+    {
+        LOG_ERROR("Failed to create task ", LOG_BOLD, placement.name);
+        return false;
+    }
+    if (handle)
+    {
+        *handle = _taskHandles[task];
+    }
+    return true;
+}
+
+void TaskTiming::add(uint32_t time)
+{
+    this->_count++;
+    this->_sum += time;
+    if (time < this->_min)
+    {
+        this->_min = time;
+    }
+    if (time > this->_max)
+    {
+        this->_max = time;
+    }
+}
+
+void TaskTiming::reset()
+{
+    this->_count = 0;
+    this->_min = UINT32_MAX;
+    this->_max = 0;
+    this->_sum = 0;
+}
+
+size_t TaskTiming::toJson(char *buffer, size_t size)
+{
+    int length = snprintf(buffer, size, "{\"count\":%u,\"min\":%u,\"max\":%u,\"avg\":%u}", (unsigned)this->_count,
+                          (unsigned)(this->_count ? this->_min : 0), (unsigned)this->_max, (unsigned)(this->_count ? this->_sum / this->_count : 0));
+    return length > 0 && (size_t)length < size ? length : 0;
+}
+
+void markDmxFrameReady()
+{
+    uint32_t now = micros() | 1;
+    for (volatile uint32_t &readyAt : _dmxFrameReadyAt)
+    {
+        if (readyAt == 0)
+        {
+            readyAt = now;
+        }
+    }
+}
+
+void takeDmxFrameLatency(uint8_t output)
+{
+    uint32_t readyAt = _dmxFrameReadyAt[output];
+    if (readyAt != 0)
+    {
+        _dmxFrameReadyAt[output] = 0;
+        taskTimings[TIMING_DMX_LATENCY_1 + output].add(micros() - readyAt);
+    }
+}
+
+void resetTaskTimings()
+{
+    for (TaskTiming &timing : taskTimings)
+    {
+        timing.reset();
+    }
+}
+
+void markBootStage(BootStage stage)
+{
+    if (_bootStageTimes[stage] == 0)
+    {
+        _bootStageTimes[stage] = micros() | 1;
+        LOG_INFO("Boot stage ", LOG_BOLD, BOOT_STAGE_NAMES[stage], LOG_RESET_DECORATIONS, " reached after ", _bootStageTimes[stage] / 1000, " ms");
+    }
+}
+
+size_t getBootJson(char *buffer, size_t size)
+{
+    size_t length = snprintf(buffer, size, "{");
+    for (uint8_t i = 0; i < BOOT_STAGE_COUNT && length < size; i++)
+    {
+        if (_bootStageTimes[i] == 0)
+        {
+            length += snprintf(buffer + length, size - length, "%s\"%s\":null", i ? "," : "", BOOT_STAGE_NAMES[i]);
+        }
+        else
+        {
+            length += snprintf(buffer + length, size - length, "%s\"%s\":%u", i ? "," : "", BOOT_STAGE_NAMES[i], (unsigned)_bootStageTimes[i]);
+        }
+    }
+    if (length < size)
+    {
+        length += snprintf(buffer + length, size - length, "}");
+    }
+    return length < size ? length : 0;
+}
+
+size_t getTasksJson(char *buffer, size_t size)
+{
+    size_t length = snprintf(buffer, size, "{\"tasks\":[");
+    for (uint8_t i = 0; i < TASK_COUNT && length < size; i++)
+    {
+        const TaskPlacement &placement = TASK_PLAN[i];
+        length += snprintf(buffer + length, size - length, "%s{\"name\":\"%s\",\"core\":%d,\"priority\":%u,\"stack\":%u,\"stack_free\":%u}", i ? "," : "", placement.name,
+                           (int)placement.core, (unsigned)placement.priority, (unsigned)placement.stackSize, _taskHandles[i] ? (unsigned)uxTaskGetStackHighWaterMark(_taskHandles[i]) : 0);
+    }
+    if (length < size)
+    {
+        length += snprintf(buffer + length, size - length, "],\"timing\":{");
+    }
+    for (uint8_t i = 0; i < TIMING_COUNT && length < size; i++)
+    {
+        length += snprintf(buffer + length, size - length, "%s\"%s\":", i ? "," : "", TIMING_NAMES[i]);
+        if (length < size)
+        {
+            length += taskTimings[i].toJson(buffer + length, size - length);
+        }
+    }
+    if (length < size)
+    {
+        length += snprintf(buffer + length, size - length, "}}");
+    }
+    return length < size ? length : 0;
+}
@@ -0,0 +1,139 @@
+#ifndef LMAN_TASKS
+#define LMAN_TASKS
+
+#include <Arduino.h>
+#include <freertos/task.h>
+
+/// @brief Core for DMX output, the fade engines and buttons. The Arduino loop also runs here, below all of them.
+#define LMAN_DMX_CORE 1
+/// @brief Core for the WiFi stack, the web server (see CONFIG_ASYNC_TCP_RUNNING_CORE) and all other network tasks, MQTT included
+#define LMAN_NETWORK_CORE 0
+
+/// @brief All tasks of the controller, index into TASK_PLAN
+enum LMANTask : uint8_t
+{
+    /// @brief One frame scheduler per DMX output, see DMX_OUTPUT_COUNT
+    TASK_SEND_DMX_1,
+    TASK_SEND_DMX_2,
+    TASK_EFFECTS,
+    TASK_COLOR,
+    TASK_SCENE_FADE,
+    TASK_AUTO_DIM_LIGHTS,
+    TASK_DIM_LIGHTS,
+    TASK_READ_BUTTON_STATES,
+    TASK_PROCESS_BUTTON_EVENTS,
+    TASK_SCHEDULER,
+    TASK_WIFI_MQTT_HANDLER,
+    TASK_ERROR_LED,
+    TASK_WEB_STATUS_UPDATES,
+    TASK_WRITE_UPDATE,
+    TASK_PULL_UPDATE,
+    TASK_DRAIN_LOG,
+    TASK_COUNT,
+};
+
+struct TaskPlacement
+{
+    const char *name;
+    uint32_t stackSize;
+    UBaseType_t priority;
+    BaseType_t core;
+};
+
+/// @brief Where and at which priority each task runs
+extern const TaskPlacement TASK_PLAN[TASK_COUNT];
+
+/// @brief Create a task as placed in TASK_PLAN
+/// @param task The task to create
+/// @param function The task function
+/// @param handle Where to store the task handle, can be NULL
+/// @param param Passed to the task function
+/// @return True if the task was created
+bool createTask(LMANTask task, TaskFunction_t function, TaskHandle_t *handle, void *param = NULL);
+
+/// @brief Min/max/average of a time in us, used for frame times and jitter
+class TaskTiming
+{
+public:
+    void add(uint32_t time);
+    void reset();
+    /// @brief Describe the timing as a JSON object
+    /// @param buffer The buffer to write to
+    /// @param size The size of the buffer
+    /// @return The length of the written JSON
+    size_t toJson(char *buffer, size_t size);
+
+private:
+    uint32_t _count = 0;
+    uint32_t _min = UINT32_MAX;
+    uint32_t _max = 0;
+    uint64_t _sum = 0;
+};
+
+/// @brief The measured timings, index into taskTimings
+enum LMANTiming : uint8_t
+{
+    /// @brief Time to send a DMX frame, one per DMX output, see DMX_OUTPUT_COUNT
+    TIMING_DMX_FRAME_1,
+    TIMING_DMX_FRAME_2,
+    /// @brief Time from a DMX send notification until the frame is sent, one per DMX output
+    TIMING_DMX_LATENCY_1,
+    TIMING_DMX_LATENCY_2,
+    /// @brief Time between effect frames, EFFECT_FRAME_TIME without jitter
+    TIMING_EFFECT_PERIOD,
+    /// @brief Time to calculate an effect frame
+    TIMING_EFFECT_FRAME,
+    /// @brief Time to convert the colors of all fixtures to their slots
+    TIMING_COLOR_FRAME,
+    TIMING_COUNT,
+};
+
+extern TaskTiming taskTimings[TIMING_COUNT];
+
+/// @brief Note that a DMX frame is ready to be sent on all outputs, for TIMING_DMX_LATENCY_1
+void markDmxFrameReady();
+/// @brief Add the time since markDmxFrameReady() to the latency of an output, if a frame was marked for it
+/// @param output The index of the DMX output
+void takeDmxFrameLatency(uint8_t output);
+
+/// @brief Reset all timings, for example at the start of a load test
+void resetTaskTimings();
+
+/// @brief The steps of the boot, in the order they are reached. The lights work after BOOT_BUTTONS.
+enum BootStage : uint8_t
+{
+    /// @brief The binary config is loaded
+    BOOT_CONFIG,
+    /// @brief The DMX outputs send
+    BOOT_DMX,
+    /// @brief The channels are restored from the state journal
+    BOOT_CHANNELS,
+    /// @brief The buttons are read, the end of setup()
+    BOOT_BUTTONS,
+    /// @brief Connected to WiFi
+    BOOT_WIFI,
+    /// @brief The web server is started
+    BOOT_WEB,
+    /// @brief Connected to the MQTT server
+    BOOT_MQTT,
+    /// @brief All entities are registered to Home Assistant
+    BOOT_DISCOVERY,
+    BOOT_STAGE_COUNT,
+};
+
+/// @brief Note the time a boot stage is reached. Only the first time counts.
+void markBootStage(BootStage stage);
+
+/// @brief Describe the time in us since the start of the app at which each boot stage was reached as JSON, null for stages not reached
+/// @param buffer The buffer to write to
+/// @param size The size of the buffer
+/// @return The length of the written JSON
+size_t getBootJson(char *buffer, size_t size);
+
+/// @brief Describe the placement, stack usage and timing of all tasks as JSON
+/// @param buffer The buffer to write to
+/// @param size The size of the buffer
+/// @return The length of the written JSON
+size_t getTasksJson(char *buffer, size_t size);
+
+#endif
@@ -1,20 +1,23 @@
 #include <LightManager.h>
-#include <ESPDMX.h>
 
 // Reserve memory for variables
 // std::mutex DMXChannel::_autoDimmingHandleMutex;
 
 // DMX Channel functions
-void DMXChannel::init(TaskHandle_t *dmxSendTask, DMXESPSerial *dmx, ChannelConfig *config)
+void DMXChannel::init(DMXMerger *dmx, ChannelConfig *config)
 {
   this->config = config;
-  this->level = this->config->max;
-  this->_dmxSendTask = dmxSendTask;
+  this->level = this->config->max * LEVEL_SCALE;
   this->_dmx = dmx;
   this->_autoDimmingHandleMutex = xSemaphoreCreateMutex();
+  if (this->config->type == FIXTURE_CCT)
+  {
+    this->color.mode = COLOR_MODE_COLOR_TEMP;
+  }
+  this->outputColor = this->color;
 }
 
-void DMXChannel::setState(bool state)
+void DMXChannel::setState(bool state, bool sendUpdate)
 {
   // Do nothing if this channel is disabled.
   if (!this->config->enabled)
@@ -24,23 +27,23 @@ void DMXChannel::setState(bool state)
   this->state = state;
   this->mqttSendUpdate = true;
   this->webSendUpdate = true;
-  this->updateDMXData(true);
+  this->updateDMXData(sendUpdate);
 }
 
-void DMXChannel::setLevel(uint8_t level)
+void DMXChannel::setLevel(uint16_t level, bool sendUpdate)
 {
   // Do nothing if this channel is disabled.
   if (!this->config->enabled)
   {
     return;
   }
-  LOG_TRACE("Setting channel ", LOG_BOLD, this->config->channel, LOG_RESET_DECORATIONS, " to level ", LOG_BOLD, level);
+  LOGD_TRACE(LOGF_SET_LEVEL, this->config->channel, level);
   this->level = level;
   this->lastLevelChange = millis();
   this->mqttSendUpdate = true;
   this->webSendUpdate = true;
   // If the light is on, send the update straight away
-  this->updateDMXData(this->state);
+  this->updateDMXData(this->state && sendUpdate);
 }
 
 void DMXChannel::updateDMXData(bool sendUpdate)
@@ -50,20 +53,145 @@ void DMXChannel::updateDMXData(bool sendUpdate)
   {
     return;
   }
-  uint8_t newLevel = this->state ? this->level : 0;
-  LOG_TRACE("Updating DMX channel ", LOG_BOLD, this->config->channel, LOG_RESET_DECORATIONS, " to value ", LOG_BOLD, newLevel);
-  this->_dmx->write(this->config->channel, newLevel);
-  if (sendUpdate)
+  if (this->state && this->effect.type != EFFECT_NONE)
+  {
+    // The output follows the effect, it is written with the next effect frame.
+    return;
+  }
+  uint16_t newLevel = this->state ? this->level : 0;
+  LOGD_TRACE(LOGF_UPDATE_DMX, this->config->channel, newLevel);
+  this->writeOutput(newLevel);
+  if (sendUpdate && this->_dmx)
   {
-    try
+    this->_dmx->notifySendTask();
+  }
+}
+
+void DMXChannel::writeOutput(uint16_t value)
+{
+  if (!this->_dmx)
+  {
+    return;
+  }
+  if (this->config->type != FIXTURE_DIMMER)
+  {
+    // The color task converts all fixtures together
+    this->outputLevel = value;
+    LightManager::instance->requestColorFrame();
+    return;
+  }
+  if (this->config->fine)
+  {
+    this->_dmx->writeLocal16(this->config->channel, value);
+  }
+  else
+  {
+    this->_dmx->writeLocal(this->config->channel, value >> 8);
+  }
+  this->_outputChannel = this->config->channel;
+  this->_outputSlots = this->config->getSlotCount();
+  this->_outputDmx = this->_dmx;
+}
+
+void DMXChannel::writeSlots(const uint8_t *values)
+{
+  if (!this->_dmx)
+  {
+    return;
+  }
+  this->_dmx->writeLocalSlots(this->config->channel, values, this->config->getSlotCount());
+  this->_outputChannel = this->config->channel;
+  this->_outputSlots = this->config->getSlotCount();
+  this->_outputDmx = this->_dmx;
+}
+
+void DMXChannel::setColor(const Color &color, uint32_t fadeTime)
+{
+  // Do nothing if this channel is disabled or not a fixture.
+  if (!this->config->enabled || this->config->type == FIXTURE_DIMMER)
+  {
+    return;
+  }
+  if (this->config->type == FIXTURE_CCT && color.mode != COLOR_MODE_COLOR_TEMP)
+  {
+    LOG_WARNING("Tunable white channel ", LOG_BOLD, this->config->channel, LOG_RESET_DECORATIONS, " can only be set to a color temperature.");
+    return;
+  }
+  unsigned long now = millis();
+  portENTER_CRITICAL(&this->_colorMux);
+  this->color = color;
+  if (fadeTime == 0 || !this->state)
+  {
+    // Nothing to see, change straight away
+    this->outputColor = color;
+    this->isColorFading = false;
+  }
+  else
+  {
+    this->colorFadeFrom = this->outputColor;
+    this->colorFadeStart = now;
+    this->colorFadeTime = fadeTime;
+    this->isColorFading = true;
+  }
+  portEXIT_CRITICAL(&this->_colorMux);
+  this->mqttSendUpdate = true;
+  this->webSendUpdate = true;
+  LightManager::instance->requestColorFrame();
+}
+
+Color DMXChannel::getColor()
+{
+  portENTER_CRITICAL(&this->_colorMux);
+  Color color = this->color;
+  portEXIT_CRITICAL(&this->_colorMux);
+  return color;
+}
+
+bool DMXChannel::stepColorFade(unsigned long now, Color &output)
+{
+  portENTER_CRITICAL(&this->_colorMux);
+  if (this->isColorFading)
+  {
+    // A fade started after the frame began has not started yet
+    unsigned long elapsed = (long)(now - this->colorFadeStart) > 0 ? now - this->colorFadeStart : 0;
+    if (elapsed >= this->colorFadeTime)
     {
-      xTaskNotifyGive((*this->_dmxSendTask));
+      this->outputColor = this->color;
+      this->isColorFading = false;
     }
-    catch (const std::exception &e)
+    else
     {
-      LOG_ERROR("Failed to notify _dmxSendTask. Error: ", LOG_BOLD, e.what());
+      this->outputColor = colorInterpolate(this->colorFadeFrom, this->color, (uint64_t)elapsed * 65535 / this->colorFadeTime);
     }
   }
+  bool fading = this->isColorFading;
+  output = this->outputColor;
+  portEXIT_CRITICAL(&this->_colorMux);
+  return fading;
+}
+
+uint16_t DMXChannel::getMinLevel()
+{
+  return this->config->min * LEVEL_SCALE;
+}
+
+uint16_t DMXChannel::getMaxLevel()
+{
+  return this->config->max * LEVEL_SCALE;
+}
+
+uint16_t DMXChannel::getBrightness()
+{
+  return this->config->fine ? this->level : this->level >> 8;
+}
+
+uint16_t DMXChannel::brightnessToLevel(uint16_t brightness)
+{
+  if (this->config->fine)
+  {
+    return brightness;
+  }
+  return (brightness > 255 ? 255 : brightness) * LEVEL_SCALE;
 }
 
 bool DMXChannel::stopAutoDimming()
@@ -75,8 +203,9 @@ bool DMXChannel::stopAutoDimming()
   }
   try
   {
-    LOG_TRACE("Stop auto-dimming requested!");
+    LOGD_TRACE(LOGF_STOP_AUTO_DIMMING, this->config->channel);
     this->isAutoDimming = false;
+    this->isSceneFading = false;
     return true;
   }
   catch (const std::exception &e)
@@ -86,6 +215,61 @@ bool DMXChannel::stopAutoDimming()
   }
 }
 
+void DMXChannel::applyConfig(DMXMerger *dmx)
+{
+  if (this->_outputChannel != 0 && (this->_outputChannel != this->config->channel || this->_outputDmx != dmx || !this->config->enabled))
+  {
+    LOG_INFO("Turning off DMX channel ", LOG_BOLD, this->_outputChannel, LOG_RESET_DECORATIONS, " as it is no longer used.");
+    for (uint8_t i = 0; i < this->_outputSlots; i++)
+    {
+      this->_outputDmx->writeLocal(this->_outputChannel + i, 0);
+    }
+    this->_outputDmx->notifySendTask();
+    this->_outputChannel = 0;
+    this->_outputSlots = 0;
+    this->_outputDmx = nullptr;
+  }
+  else if (this->_outputSlots > this->config->getSlotCount())
+  {
+    // Fewer slots than before, the ones at the end are no longer part of this channel
+    for (uint8_t i = this->config->getSlotCount(); i < this->_outputSlots; i++)
+    {
+      this->_outputDmx->writeLocal(this->_outputChannel + i, 0);
+    }
+    this->_outputSlots = this->config->getSlotCount();
+  }
+  portENTER_CRITICAL(&this->_colorMux);
+  if (this->config->type == FIXTURE_CCT && this->color.mode != COLOR_MODE_COLOR_TEMP)
+  {
+    this->color.mode = COLOR_MODE_COLOR_TEMP;
+    this->outputColor = this->color;
+    this->isColorFading = false;
+  }
+  portEXIT_CRITICAL(&this->_colorMux);
+  this->_dmx = dmx;
+
+  if (!this->config->enabled)
+  {
+    this->isAutoDimming = false;
+    this->isSceneFading = false;
+    this->effect.type = EFFECT_NONE;
+    this->state = false;
+    return;
+  }
+
+  if (this->level > this->getMaxLevel())
+  {
+    this->level = this->getMaxLevel();
+  }
+  else if (this->level < this->getMinLevel())
+  {
+    this->level = this->getMinLevel();
+  }
+  this->mqttSendUpdate = true;
+  this->webSendUpdate = true;
+  this->updateDMXData(true);
+}
+
 // Button functions
 void Button::addButtonEvent(bool state)
 {
@@ -94,7 +278,7 @@ void Button::addButtonEvent(bool state)
   {
     return;
   }
-  LOG_TRACE("Adding new button event, new state: ", LOG_BOLD, state ? "ON" : "OFF");
+  LOGD_TRACE(LOGF_BUTTON_EVENT, this->pin, state);
   // Shift current events down the list
   this->buttonEvents[2] = this->buttonEvents[1];
   this->buttonEvents[1] = this->buttonEvents[0];
@@ -108,8 +292,8 @@ void Button::addButtonEvent(bool state)
 
 void Button::updateState()
 {
-  // Do nothing if this button is disabled.
-  if (!this->config->enabled)
+  // Do nothing if this button is disabled or has no channel or scene to control.
+  if (!this->config->enabled || (!this->dmxChannel && this->config->scene == 0))
   {
     return;
   }
@@ -121,7 +305,7 @@ void Button::updateState()
     if (!currentButtonState && currentButtonState != this->buttonEvents[0].state)
     {
       // The state went to LOW when it was previously HIGH, the button was released.
-      LOG_DEBUG("(", millis(), ") ", "New state DEPRESSED from confirmed PRESSED. Skipping debounce checking for channel ", LOG_BOLD, this->config->channel);
+      LOGD_DEBUG(LOGF_BUTTON_RELEASED, this->config->channel);
       this->_currentButtonState.millis = millis();
       this->_currentButtonState.state = currentButtonState;
       this->_currentButtonState.handled = true;
@@ -131,7 +315,7 @@ void Button::updateState()
     {
       // Check that the current state is not the same as already confirmed
       // AND that the state is not the same as the last read state.
-      LOG_DEBUG("(", millis(), ") ", "New state ", LOG_BOLD, currentButtonState ? "PRESSED" : "DEPRESSED", LOG_RESET_DECORATIONS, " for channel ", LOG_BOLD, this->config->channel);
+      LOGD_DEBUG(LOGF_BUTTON_CHANGED, currentButtonState, this->config->channel);
       this->_currentButtonState.millis = millis();
       this->_currentButtonState.state = currentButtonState;
       this->_currentButtonState.handled = false;
@@ -139,7 +323,7 @@ void Button::updateState()
     else if (!this->_currentButtonState.handled && currentButtonState == this->_currentButtonState.state && millis() - this->_currentButtonState.millis >= LMANConfig::instance->buttonPressMinTime)
     {
       // Current state is not handled and it is confirmed as a read state and has been the same for button min press time
-      LOG_DEBUG("(", millis(), ") ", "New state ", LOG_BOLD, currentButtonState ? "PRESSED" : "DEPRESSED", LOG_RESET_DECORATIONS, " confirmed for channel ", LOG_BOLD, this->config->channel);
+      LOGD_DEBUG(LOGF_BUTTON_CONFIRMED, currentButtonState, this->config->channel);
       this->addButtonEvent(this->_currentButtonState.state);
       this->_currentButtonState.handled = true;
     }
@@ -152,7 +336,7 @@ void Button::updateState()
 
 bool Button::hasDeterminedState()
 {
-  if (this->config->enabled)
+  if (this->config->enabled && (this->dmxChannel || this->config->scene != 0))
   {
     return this->_currentButtonState.handled;
   }
@@ -178,66 +362,162 @@ LightManager *LightManager::instance;
 
 Button *LightManager::initButton(uint8_t buttonPin, ButtonConfig *buttonConfig)
 {
+  LOG_DEBUG("Initializing button on PIN ", LOG_BOLD, buttonPin);
+  Button newBtn;
+  newBtn.pin = buttonPin;
+  newBtn.dmxChannel = nullptr;
+  newBtn.config = buttonConfig;
+  // Mark all events handled from the start.
+  newBtn.buttonEvents[0].handled = true;
+  newBtn.buttonEvents[1].handled = true;
+  newBtn.buttonEvents[2].handled = true;
+  pinMode(buttonPin, INPUT_PULLUP);
+  // The button is kept even without a matching DMX channel so that a later config change can enable it.
+  this->buttons.push_back(newBtn);
+  this->_attachButton(&this->buttons.back());
+  return &this->buttons.back();
+}
+
+DMXChannel *LightManager::_findDMXChannel(uint8_t channel)
+{
+  for (DMXChannel &dmxChannel : this->dmxChannels)
+  {
+    if (dmxChannel.config->channel == channel)
+    {
+      return &dmxChannel;
+    }
+  }
+  return nullptr;
+}
+
+void LightManager::_attachButton(Button *button)
+{
+  detachInterrupt(button->pin);
   // Find if the dmx channel to be used has already been created.
-  DMXChannel *dmxChannel = nullptr;
-  for (DMXChannel &channel : LightManager::instance->dmxChannels)
+  button->dmxChannel = this->_findDMXChannel(button->config->channel);
+  if (button->config->scene != 0)
+  {
+    if (button->config->enabled)
+    {
+      LOG_INFO("Button on pin ", LOG_BOLD, button->pin, LOG_RESET_DECORATIONS, " recalls scene ", LOG_BOLD, button->config->scene);
+      attachInterrupt(button->pin, LightManager::ISRForwarder, CHANGE);
+    }
+  }
+  else if (button->dmxChannel == nullptr)
+  {
+    // If the dmx channel to be used was not found in the list, log error.
+    LOG_ERROR("Failed to find matching DMX channel for button on pin ", LOG_BOLD, button->pin, LOG_RESET_DECORATIONS, ". Will not enable interrupt!");
+  }
+  else if (button->config->enabled)
+  {
+    LOG_INFO("DMX Channel ", LOG_BOLD, button->config->channel, LOG_RESET_DECORATIONS, " already in use and found.");
+    attachInterrupt(button->pin, LightManager::ISRForwarder, CHANGE);
+  }
+  else
   {
-    if (channel.config->channel == buttonConfig->channel)
+    LOG_WARNING("Button on pin ", LOG_BOLD, button->pin, LOG_RESET_DECORATIONS, " not enabled. Will not enabled interrupt!");
+  }
+}
+
+void LightManager::_updateDimmingSpeeds()
+{
+  uint8_t fastestDimmingSpeed = 255;
+  uint8_t fastestAutoDimmingSpeed = 255;
+  for (DMXChannel &channel : this->dmxChannels)
+  {
+    if (channel.config->enabled)
     {
-      LOG_INFO("DMX Channel ", LOG_BOLD, buttonConfig->channel, LOG_RESET_DECORATIONS, " already in use and found.");
-      dmxChannel = &channel;
-      break;
+      if (channel.config->dimmingSpeed < fastestDimmingSpeed && channel.config->dimmingSpeed > 0)
+      {
+        fastestDimmingSpeed = channel.config->dimmingSpeed;
+      }
+      if (channel.config->autoDimmingSpeed < fastestAutoDimmingSpeed && channel.config->autoDimmingSpeed > 0)
+      {
+        fastestAutoDimmingSpeed = channel.config->autoDimmingSpeed;
+      }
     }
   }
-  // If the dmx channel to be used was not found in the list, log error.
-  if (dmxChannel == nullptr)
+  this->_fastestDimmingSpeed = fastestDimmingSpeed;
+  this->_fastestAutoDimmingSpeed = fastestAutoDimmingSpeed;
+}
+
+DMXMerger *LightManager::_getMerger(uint8_t universe)
+{
+  if (universe < 1 || universe > DMX_OUTPUT_COUNT)
   {
-    LOG_ERROR("Failed to find matching DMX channel. Will not initiate button!");
+    LOG_ERROR("DMX universe ", LOG_BOLD, universe, LOG_RESET_DECORATIONS, " does not exist, channels on it are not output.");
     return nullptr;
   }
+  return &this->_dmx[universe - 1];
+}
 
-  if (buttonConfig->enabled)
+void LightManager::_notifySendTasks()
+{
+  for (uint8_t i = 0; i < DMX_OUTPUT_COUNT; i++)
   {
-    attachInterrupt(buttonPin, LightManager::ISRForwarder, CHANGE);
+    this->_dmx[i].notifySendTask();
   }
-  else
+}
+
+void LightManager::_updateSlotCount()
+{
+  uint16_t highestSlot[DMX_OUTPUT_COUNT] = {0};
+  for (DMXChannel &channel : this->dmxChannels)
+  {
+    uint8_t universe = channel.config->universe;
+    // 16 bit channels and fixtures also use the following slots
+    uint16_t slot = channel.config->channel + channel.config->getSlotCount() - 1;
+    if (channel.config->enabled && universe >= 1 && universe <= DMX_OUTPUT_COUNT && slot > highestSlot[universe - 1])
+    {
+      highestSlot[universe - 1] = slot;
+    }
+  }
+  for (uint8_t i = 0; i < DMX_OUTPUT_COUNT; i++)
   {
-    LOG_WARNING("Button on pin ", LOG_BOLD, buttonPin, LOG_RESET_DECORATIONS, " not enabled. Will not enabled interrupt!");
+    this->_dmx[i].setLocalSlotCount(highestSlot[i]);
   }
+}
 
-  LOG_DEBUG("Initializing button on PIN ", LOG_BOLD, buttonPin);
-  Button newBtn;
-  newBtn.pin = buttonPin;
-  newBtn.dmxChannel = dmxChannel;
-  newBtn.config = buttonConfig;
-  // Mark all events handled from the start.
-  newBtn.buttonEvents[0].handled = true;
-  newBtn.buttonEvents[1].handled = true;
-  newBtn.buttonEvents[2].handled = true;
-  pinMode(buttonPin, INPUT_PULLUP);
-  this->buttons.push_back(newBtn);
-  return &this->buttons.back();
+void LightManager::applyConfig()
+{
+  ArduLog::getInstance()->SetLogLevel(static_cast<ArduLogLevel>(LMANConfig::instance->logging_level));
+  for (DMXChannel &channel : this->dmxChannels)
+  {
+    channel.applyConfig(this->_getMerger(channel.config->universe));
+  }
+  for (Button &btn : this->buttons)
+  {
+    this->_attachButton(&btn);
+  }
+  this->_updateDimmingSpeeds();
+  this->_updateSlotCount();
+  LOG_INFO("Applied new config to LightManager.");
 }
 
 DMXChannel *LightManager::initDMXChannel(ChannelConfig *config)
 {
   LOG_INFO("Initiating DMX Channel ", LOG_BOLD, config->channel);
-  DMXChannel newChannel;
+  // Built in place, the channel holds a lock that is not copied
+  this->dmxChannels.emplace_back();
+  DMXChannel &newChannel = this->dmxChannels.back();
   newChannel.state = false;
-  newChannel.init(this->_dmxSendTask, this->_dmx, config);
-  this->dmxChannels.push_back(newChannel);
-  return &(*this->dmxChannels.end());
+  newChannel.init(this->_getMerger(config->universe), config);
+  this->_updateDimmingSpeeds();
+  this->_updateSlotCount();
+  return &this->dmxChannels.back();
 }
 
-void LightManager::init(TaskHandle_t *dmxSendTask, DMXESPSerial *dmx)
+void LightManager::init(DMXMerger *dmx)
 {
   LightManager::instance = this;
-  this->_dmxSendTask = dmxSendTask;
   this->_dmx = dmx;
-  xTaskCreatePinnedToCore(_taskReadButtonStates, "taskReadButtonStates", 5000, NULL, 1, &this->_taskHandleReadButtonStates, CONFIG_ARDUINO_RUNNING_CORE);
-  xTaskCreatePinnedToCore(taskProcessButtonEvents, "taskProcessButtonEvents", 5000, NULL, 1, NULL, CONFIG_ARDUINO_RUNNING_CORE);
-  xTaskCreatePinnedToCore(_taskDimLights, "taskDimLights", 5000, NULL, 1, &this->_taskHandleDimLights, CONFIG_ARDUINO_RUNNING_CORE);
-  xTaskCreatePinnedToCore(_taskAutoDimLights, "taskAutoDimLights", 5000, NULL, 1, &this->_taskHandleAutoDimLights, CONFIG_ARDUINO_RUNNING_CORE);
+  createTask(TASK_READ_BUTTON_STATES, _taskReadButtonStates, &this->_taskHandleReadButtonStates);
+  createTask(TASK_PROCESS_BUTTON_EVENTS, taskProcessButtonEvents, NULL);
+  createTask(TASK_DIM_LIGHTS, _taskDimLights, &this->_taskHandleDimLights);
+  createTask(TASK_AUTO_DIM_LIGHTS, _taskAutoDimLights, &this->_taskHandleAutoDimLights);
+  createTask(TASK_SCENE_FADE, _taskSceneFade, &this->_taskHandleSceneFade);
+  createTask(TASK_EFFECTS, _taskEffects, &this->_taskHandleEffects);
+  createTask(TASK_COLOR, _taskColor, &this->_taskHandleColor);
 }
 
 void IRAM_ATTR LightManager::ISRForwarder()
@@ -252,26 +532,26 @@ void LightManager::_taskReadButtonStates(void *param)
 {
   LOG_INFO("Started _taskReadButtonStates");
 
-  uint8_t loopDelay = LMANConfig::instance->buttonPressMinTime;
-  // Set the loop delay so that at least 3 readings will be done to determine
-  // a state, if the value is to low set reading interval to 5 ms
-  if (loopDelay / 3 >= 5)
-  {
-    loopDelay = loopDelay / 3;
-  }
-  else
-  {
-    loopDelay = 5;
-  }
-  LOG_DEBUG("Will poll button states every ", LOG_BOLD, loopDelay, LOG_RESET_DECORATIONS, " ms until determined state is set");
-
   for (;;)
   {
     if (ulTaskNotifyTake(pdTRUE, portMAX_DELAY))
     {
-      LOG_TRACE("_taskReadButtonStates got notification.");
+      LOGD_TRACE(LOGF_READ_BUTTONS_NOTIFIED);
       if (LightManager::instance)
       {
+        // Calculated on every notification as buttonPressMinTime can change at runtime.
+        uint8_t loopDelay = LMANConfig::instance->buttonPressMinTime;
+        // Set the loop delay so that at least 3 readings will be done to determine
+        // a state, if the value is to low set reading interval to 5 ms
+        if (loopDelay / 3 >= 5)
+        {
+          loopDelay = loopDelay / 3;
+        }
+        else
+        {
+          loopDelay = 5;
+        }
+
         bool allButtonsHasDetminedState = false; // Keep looping over buttons and checking states until a determined state has been reached.
         while (!allButtonsHasDetminedState)
         {
@@ -284,7 +564,7 @@ void LightManager::_taskReadButtonStates(void *param)
             btn.updateState();
             if (!btn.hasDeterminedState())
             {
-              LOG_DEBUG("Button on PIN ", btn.pin, " has undetermined state, will check again in ", loopDelay, " ms");
+              LOGD_DEBUG(LOGF_BUTTON_UNDETERMINED, btn.pin, loopDelay);
               allButtonsHasDetminedState = false;
             }
           }
@@ -312,7 +592,7 @@ void LightManager::taskProcessButtonEvents(void *param)
         // Do initial filtering
         if (!btn.buttonEvents[0].handled && btn.getTimeDelta(0, 1) >= LMANConfig::instance->buttonPressMinTime)
         {
-          if (btn.buttonEvents[0].state && btn.getTimeDeltaNowLastState() >= LMANConfig::instance->buttonPressMaxTime && btn.dmxChannel->state)
+          if (btn.buttonEvents[0].state && btn.getTimeDeltaNowLastState() >= LMANConfig::instance->buttonPressMaxTime && btn.config->scene == 0 && btn.dmxChannel->state)
           {
             // State is high and has been for the max threshold time. Consider it a dimming event.
             // If a dimming task has been created, notify it and mark event as handled.
@@ -332,7 +612,12 @@ void LightManager::taskProcessButtonEvents(void *param)
           {
             // State is low, previous state was high and the time between states
             // was lower than max and higher than min. This was a toggle press.
-            if (btn.dmxChannel->state)
+            if (btn.config->scene != 0)
+            {
+              LOG_DEBUG("Scene ", LOG_BOLD, btn.config->scene, LOG_RESET_DECORATIONS, " triggered by button");
+              LightManager::instance->recallScene(btn.config->scene - 1);
+            }
+            else if (btn.dmxChannel->state)
             {
               LOG_DEBUG("Slow turn off triggered for channel ", LOG_BOLD, btn.dmxChannel->config->channel);
               LightManager::instance->autoDimOff(&(*btn.dmxChannel));
@@ -348,7 +633,7 @@ void LightManager::taskProcessButtonEvents(void *param)
           if (!unhandledButtonEvents && !btn.buttonEvents[0].handled)
           {
             unhandledButtonEvents = true;
-            LOG_DEBUG(unhandledButtonEvents);
+            LOGD_DEBUG(LOGF_BUTTON_UNHANDLED, btn.pin);
           }
         }
       }
@@ -375,25 +660,13 @@ void LightManager::_taskDimLights(void *param)
 {
   LOG_INFO("Started _taskDimLights");
 
-  uint8_t fastestDimmingSpeed = 255;
-  for (DMXChannel &channel : LightManager::instance->dmxChannels)
-  {
-    if (channel.config->enabled)
-    {
-      if (channel.config->dimmingSpeed < fastestDimmingSpeed && channel.config->dimmingSpeed > 0)
-      {
-        fastestDimmingSpeed = channel.config->dimmingSpeed;
-      }
-    }
-  }
-
   for (;;)
   {
     bool hasDimmingJob = false;
     for (Button &btn : LightManager::instance->buttons)
     {
       // Latest state is high, dim the light
-      if (btn.buttonEvents[0].state)
+      if (btn.buttonEvents[0].state && btn.dmxChannel && btn.config->scene == 0)
       {
         // Indicate that there is still a dimming job to do.
         if (!hasDimmingJob)
@@ -403,35 +676,37 @@ void LightManager::_taskDimLights(void *param)
         // Update dim level.
         DMXChannel *channel = btn.dmxChannel;
         channel->stopAutoDimming(); // Stop auto-dimming if it is currently happening
-        if (channel->level != channel->config->min && channel->level != channel->config->max && millis() - channel->lastLevelChange >= channel->config->dimmingSpeed)
+        uint16_t minLevel = channel->getMinLevel();
+        uint16_t maxLevel = channel->getMaxLevel();
+        if (channel->level > minLevel && channel->level < maxLevel && millis() - channel->lastLevelChange >= channel->config->dimmingSpeed)
         {
           // We are not at min/max and have reached time for a new dim event.
           if (channel->dimmingDirection)
           {
-            channel->setLevel(channel->level + 1);
+            channel->setLevel(maxLevel - channel->level > LEVEL_SCALE ? channel->level + LEVEL_SCALE : maxLevel);
           }
           else
           {
-            channel->setLevel(channel->level - 1);
+            channel->setLevel(channel->level - minLevel > LEVEL_SCALE ? channel->level - LEVEL_SCALE : minLevel);
           }
         }
-        else if (channel->level == channel->config->min && millis() - channel->lastLevelChange >= channel->config->holdPeriod)
+        else if (channel->level <= minLevel && millis() - channel->lastLevelChange >= channel->config->holdPeriod)
         {
-          LOG_DEBUG("Hold period over at min light, reversing!");
-          channel->setLevel(channel->config->min + 1);
+          LOGD_DEBUG(LOGF_HOLD_MIN, channel->config->channel);
+          channel->setLevel(minLevel + LEVEL_SCALE);
           channel->dimmingDirection = true;
         }
-        else if (channel->level == channel->config->max && millis() - channel->lastLevelChange >= channel->config->holdPeriod)
+        else if (channel->level >= maxLevel && millis() - channel->lastLevelChange >= channel->config->holdPeriod)
         {
-          LOG_DEBUG("Hold period over at max light, reversing!");
-          channel->setLevel(channel->config->max - 1);
+          LOGD_DEBUG(LOGF_HOLD_MAX, channel->config->channel);
+          channel->setLevel(maxLevel - LEVEL_SCALE);
           channel->dimmingDirection = false;
         }
       }
     }
     if (hasDimmingJob)
     {
-      vTaskDelay(fastestDimmingSpeed / portTICK_PERIOD_MS);
+      vTaskDelay(LightManager::instance->_fastestDimmingSpeed / portTICK_PERIOD_MS);
     }
     else
     {
@@ -444,17 +719,17 @@ void LightManager::_taskDimLights(void *param)
   }
 }
 
-void LightManager::autoDimTo(DMXChannel *dmxChannel, uint8_t level)
+void LightManager::autoDimTo(DMXChannel *dmxChannel, uint16_t level)
 {
   if (dmxChannel->stopAutoDimming())
   {
-    if (level > dmxChannel->config->max)
+    if (level > dmxChannel->getMaxLevel())
     {
-      level = dmxChannel->config->max;
+      level = dmxChannel->getMaxLevel();
     }
-    else if (level < dmxChannel->config->min)
+    else if (level < dmxChannel->getMinLevel())
     {
-      level = dmxChannel->config->min;
+      level = dmxChannel->getMinLevel();
     }
 
     LOG_DEBUG("Starting auto-dim to level: ", level);
@@ -474,11 +749,11 @@ void LightManager::autoDimOn(DMXChannel *dmxChannel)
   this->autoDimOnToLevel(dmxChannel, dmxChannel->level);
 }
 
-void LightManager::autoDimOnToLevel(DMXChannel *dmxChannel, uint8_t level)
+void LightManager::autoDimOnToLevel(DMXChannel *dmxChannel, uint16_t level)
 {
-  dmxChannel->turnOffWhenAutoDimComplete = false; // Do not turn off when auto-dim done.
-  dmxChannel->setLevel(dmxChannel->config->min);  // Set the current level to min
-  dmxChannel->setState(true);                     // Turn on the light
+  dmxChannel->turnOffWhenAutoDimComplete = false;  // Do not turn off when auto-dim done.
+  dmxChannel->setLevel(dmxChannel->getMinLevel()); // Set the current level to min
+  dmxChannel->setState(true);                      // Turn on the light
   LightManager::autoDimTo(dmxChannel, level);
 }
 
@@ -486,23 +761,12 @@ void LightManager::autoDimOff(DMXChannel *dmxChannel)
 {
   dmxChannel->turnOffWhenAutoDimComplete = true;                          // Turn off the light when dimming is complete
   dmxChannel->levelBeforeAutoDimming = dmxChannel->level;                 // Save the current level
-  LightManager::instance->autoDimTo(dmxChannel, dmxChannel->config->min); // Dim to target
+  LightManager::instance->autoDimTo(dmxChannel, dmxChannel->getMinLevel()); // Dim to target
 }
 
 void LightManager::_taskAutoDimLights(void *param)
 {
   LOG_INFO("Started _taskAutoDimLights");
-  uint8_t fastestDimmingSpeed = 255;
-  for (DMXChannel &channel : LightManager::instance->dmxChannels)
-  {
-    if (channel.config->enabled)
-    {
-      if (channel.config->autoDimmingSpeed < fastestDimmingSpeed && channel.config->autoDimmingSpeed > 0)
-      {
-        fastestDimmingSpeed = channel.config->autoDimmingSpeed;
-      }
-    }
-  }
 
   for (;;)
   {
@@ -511,13 +775,14 @@ void LightManager::_taskAutoDimLights(void *param)
     {
       if (channel.isAutoDimming)
       {
+        // One 8 bit level per step, the last step lands on the target
         if (channel.level > channel.autoDimmingTarget)
         {
-          channel.setLevel(channel.level - 1);
+          channel.setLevel(channel.level - channel.autoDimmingTarget > LEVEL_SCALE ? channel.level - LEVEL_SCALE : channel.autoDimmingTarget);
         }
         else if (channel.level < channel.autoDimmingTarget)
         {
-          channel.setLevel(channel.level + 1);
+          channel.setLevel(channel.autoDimmingTarget - channel.level > LEVEL_SCALE ? channel.level + LEVEL_SCALE : channel.autoDimmingTarget);
         }
 
         if (channel.turnOffWhenAutoDimComplete && channel.autoDimmingTarget == channel.level)
@@ -525,7 +790,7 @@ void LightManager::_taskAutoDimLights(void *param)
           channel.setState(false);
           channel.turnOffWhenAutoDimComplete = false;
           // Reset level to what it was before auto-dimming started.
-          LOG_DEBUG("Restoring previous level for DMX Channel: ", channel.levelBeforeAutoDimming);
+          LOGD_DEBUG(LOGF_RESTORE_LEVEL, channel.levelBeforeAutoDimming, channel.config->channel);
           channel.setLevel(channel.levelBeforeAutoDimming);
         }
         else if (!hasAutoDimmingJob && channel.autoDimmingTarget != channel.level)
@@ -537,7 +802,7 @@ void LightManager::_taskAutoDimLights(void *param)
     }
     if (hasAutoDimmingJob)
     {
-      vTaskDelay(fastestDimmingSpeed / portTICK_PERIOD_MS);
+      vTaskDelay(LightManager::instance->_fastestAutoDimmingSpeed / portTICK_PERIOD_MS);
     }
     else
     {
@@ -548,4 +813,343 @@ void LightManager::_taskAutoDimLights(void *param)
       }
     }
   }
-}
\ No newline at end of file
+}
+
+bool LightManager::recallScene(uint8_t scene)
+{
+  if (scene >= sizeof(LMANConfig::instance->sceneConfigs) / sizeof(SceneConfig) || !LMANConfig::instance->sceneConfigs[scene].enabled)
+  {
+    LOG_ERROR("Scene ", LOG_BOLD, scene + 1, LOG_RESET_DECORATIONS, " does not exist or is disabled.");
+    return false;
+  }
+  SceneConfig *sceneConfig = &LMANConfig::instance->sceneConfigs[scene];
+  LOG_INFO("Recalling scene ", LOG_BOLD, sceneConfig->name.c_str());
+  unsigned long fadeStart = millis();
+
+  for (int i = 0; i < sizeof(LMANConfig::instance->channelConfigs) / sizeof(ChannelConfig); i++)
+  {
+    DMXChannel *channel = this->getChannel(i);
+    if (!channel || !channel->config->enabled || !(sceneConfig->channels & (1 << i)))
+    {
+      continue;
+    }
+    uint8_t target = sceneConfig->levels[i];
+    this->_startFade(channel, target != 0, target * LEVEL_SCALE, fadeStart, sceneConfig->fadeTime);
+  }
+
+  xTaskNotifyGive(this->_taskHandleSceneFade);
+  return true;
+}
+
+bool LightManager::setGroup(uint8_t group, bool state, uint16_t level, uint32_t fadeTime)
+{
+  if (group >= sizeof(LMANConfig::instance->groupConfigs) / sizeof(GroupConfig) || !LMANConfig::instance->groupConfigs[group].enabled)
+  {
+    LOG_ERROR("Group ", LOG_BOLD, group + 1, LOG_RESET_DECORATIONS, " does not exist or is disabled.");
+    return false;
+  }
+  GroupConfig *groupConfig = &LMANConfig::instance->groupConfigs[group];
+  LOG_DEBUG("Setting group ", LOG_BOLD, groupConfig->name.c_str());
+  unsigned long fadeStart = millis();
+
+  for (int i = 0; i < sizeof(LMANConfig::instance->channelConfigs) / sizeof(ChannelConfig); i++)
+  {
+    DMXChannel *channel = this->getChannel(i);
+    if (!channel || !channel->config->enabled || !(groupConfig->channels & (1 << i)))
+    {
+      continue;
+    }
+    this->_startFade(channel, state, level != 0 ? level : channel->level, fadeStart, fadeTime);
+  }
+
+  xTaskNotifyGive(this->_taskHandleSceneFade);
+  return true;
+}
+
+void LightManager::fadeChannels(const ChannelFade *fades, uint8_t count)
+{
+  unsigned long fadeStart = millis();
+  for (uint8_t i = 0; i < count; i++)
+  {
+    if (fades[i].channel && fades[i].channel->config->enabled)
+    {
+      this->_startFade(fades[i].channel, fades[i].state, fades[i].level, fadeStart, fades[i].fadeTime);
+    }
+  }
+  xTaskNotifyGive(this->_taskHandleSceneFade);
+}
+
+DMXChannel *LightManager::getChannel(uint8_t index)
+{
+  for (DMXChannel &dmxChannel : this->dmxChannels)
+  {
+    if (dmxChannel.config == &LMANConfig::instance->channelConfigs[index])
+    {
+      return &dmxChannel;
+    }
+  }
+  return nullptr;
+}
+
+void LightManager::_startFade(DMXChannel *channel, bool state, uint16_t level, unsigned long fadeStart, uint32_t fadeTime)
+{
+  channel->stopAutoDimming();
+  channel->turnOffWhenAutoDimComplete = false;
+  if (!state && !channel->state)
+  {
+    return; // Already off
+  }
+  if (!state)
+  {
+    channel->levelBeforeAutoDimming = channel->level;
+    channel->sceneFadeTo = channel->getMinLevel();
+    channel->turnOffWhenSceneFadeComplete = true;
+  }
+  else
+  {
+    channel->sceneFadeTo = level < channel->getMinLevel() ? channel->getMinLevel() : (level > channel->getMaxLevel() ? channel->getMaxLevel() : level);
+    channel->turnOffWhenSceneFadeComplete = false;
+    if (!channel->state)
+    {
+      // Turn on at min and fade up from there, output is updated with the first fade step.
+      channel->setLevel(channel->getMinLevel(), false);
+      channel->setState(true, false);
+    }
+  }
+  channel->sceneFadeFrom = channel->level;
+  channel->sceneFadeStart = fadeStart;
+  channel->sceneFadeTime = fadeTime;
+  channel->isSceneFading = true;
+}
+
+void LightManager::_taskSceneFade(void *param)
+{
+  LOG_INFO("Started _taskSceneFade");
+
+  for (;;)
+  {
+    bool hasSceneFadeJob = false;
+    unsigned long now = millis();
+    // All channels are stepped from the same point in time and sent in one DMX frame so that they land together.
+    for (DMXChannel &channel : LightManager::instance->dmxChannels)
+    {
+      if (!channel.isSceneFading)
+      {
+        continue;
+      }
+
+      // A fade started on the other core after now was taken has not started yet
+      unsigned long elapsed = (long)(now - channel.sceneFadeStart) > 0 ? now - channel.sceneFadeStart : 0;
+      if (elapsed >= channel.sceneFadeTime)
+      {
+        channel.isSceneFading = false;
+        if (channel.turnOffWhenSceneFadeComplete)
+        {
+          channel.turnOffWhenSceneFadeComplete = false;
+          // Restore the level from before the fade for the next time the light is turned on.
+          channel.setLevel(channel.levelBeforeAutoDimming, false);
+          channel.setState(false, false);
+        }
+        else
+        {
+          channel.setLevel(channel.sceneFadeTo, false);
+        }
+      }
+      else
+      {
+        channel.setLevel(levelInterpolate(channel.sceneFadeFrom, channel.sceneFadeTo, elapsed, channel.sceneFadeTime), false);
+        hasSceneFadeJob = true;
+      }
+    }
+    markDmxFrameReady();
+    LightManager::instance->_notifySendTasks();
+
+    if (hasSceneFadeJob)
+    {
+      vTaskDelay(SCENE_FADE_STEP / portTICK_PERIOD_MS);
+    }
+    else
+    {
+      LOG_INFO("Scene fade done. Waiting for notification.");
+      ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    }
+  }
+}
+
+void LightManager::setEffect(DMXChannel *dmxChannel, uint8_t effect, uint16_t period)
+{
+  if (effect >= EFFECT_COUNT)
+  {
+    effect = EFFECT_NONE;
+  }
+  LOG_INFO("Setting effect ", LOG_BOLD, EFFECT_NAMES[effect], LOG_RESET_DECORATIONS, " on channel ", LOG_BOLD, dmxChannel->config->channel);
+  portENTER_CRITICAL(&this->_effectMux);
+  // Seed with the channel number so that candles next to each other do not flicker in sync.
+  effectStart(dmxChannel->effect, effect, period, 0x9E3779B9UL * dmxChannel->config->channel);
+
+  // Number all chasing channels in list order and restart them so that they step together.
+  uint8_t chaseCount = 0;
+  for (DMXChannel &channel : this->dmxChannels)
+  {
+    if (channel.effect.type == EFFECT_CHASE)
+    {
+      channel.effect.chaseIndex = chaseCount++;
+    }
+  }
+  for (DMXChannel &channel : this->dmxChannels)
+  {
+    if (channel.effect.type == EFFECT_CHASE)
+    {
+      channel.effect.chaseCount = chaseCount;
+      channel.effect.phase = 0;
+      channel.effect.phaseStep = dmxChannel->effect.type == EFFECT_CHASE ? dmxChannel->effect.phaseStep : channel.effect.phaseStep;
+    }
+  }
+  portEXIT_CRITICAL(&this->_effectMux);
+
+  dmxChannel->mqttSendUpdate = true;
+  dmxChannel->webSendUpdate = true;
+  if (effect == EFFECT_NONE)
+  {
+    // Go back to the static level
+    dmxChannel->updateDMXData(true);
+  }
+  else
+  {
+    xTaskNotifyGive(this->_taskHandleEffects);
+  }
+}
+
+void LightManager::_taskEffects(void *param)
+{
+  LOG_INFO("Started _taskEffects");
+
+  const uint8_t maxChannels = sizeof(LMANConfig::instance->channelConfigs) / sizeof(ChannelConfig);
+  DMXChannel *outputChannels[maxChannels];
+  uint16_t outputs[maxChannels];
+  unsigned long lastFrame = millis();
+  // Frames are timed from the tick of the previous frame so that the period does not drift with the frame time.
+  TickType_t lastWake = xTaskGetTickCount();
+  uint32_t lastFrameStart = 0;
+  for (;;)
+  {
+    bool hasEffect = false;
+    unsigned long now = millis();
+    uint16_t elapsed = now - lastFrame > EFFECT_FRAME_TIME * 4 ? EFFECT_FRAME_TIME : now - lastFrame;
+    lastFrame = now;
+
+    // All channels are calculated in one pass and sent in one DMX frame.
+    uint32_t frameStart = micros();
+    if (lastFrameStart != 0)
+    {
+      taskTimings[TIMING_EFFECT_PERIOD].add(frameStart - lastFrameStart);
+    }
+    lastFrameStart = frameStart;
+    // Stepped under the lock so that a chase is never seen half renumbered, written to the mergers after it.
+    uint8_t count = 0;
+    portENTER_CRITICAL(&LightManager::instance->_effectMux);
+    for (DMXChannel &channel : LightManager::instance->dmxChannels)
+    {
+      if (channel.effect.type == EFFECT_NONE || !channel.config->enabled || count >= maxChannels)
+      {
+        continue;
+      }
+      // Effects keep running while the light is off so that a chase stays in step.
+      hasEffect = true;
+      uint16_t output = effectStep(channel.effect, channel.level, elapsed);
+      if (channel.state)
+      {
+        outputChannels[count] = &channel;
+        outputs[count] = output;
+        count++;
+      }
+    }
+    portEXIT_CRITICAL(&LightManager::instance->_effectMux);
+    for (uint8_t i = 0; i < count; i++)
+    {
+      outputChannels[i]->writeOutput(outputs[i]);
+    }
+    taskTimings[TIMING_EFFECT_FRAME].add(micros() - frameStart);
+
+    if (hasEffect)
+    {
+      markDmxFrameReady();
+      LightManager::instance->_notifySendTasks();
+      vTaskDelayUntil(&lastWake, EFFECT_FRAME_TIME / portTICK_PERIOD_MS);
+    }
+    else
+    {
+      LOG_INFO("No effects running. Waiting for notification.");
+      ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+      lastFrame = millis();
+      lastWake = xTaskGetTickCount();
+      lastFrameStart = 0;
+    }
+  }
+}
+
+void LightManager::requestColorFrame()
+{
+  if (this->_taskHandleColor)
+  {
+    xTaskNotifyGive(this->_taskHandleColor);
+  }
+}
+
+void LightManager::_taskColor(void *param)
+{
+  LOG_INFO("Started _taskColor");
+
+  const uint8_t maxFixtures = sizeof(LMANConfig::instance->channelConfigs) / sizeof(ChannelConfig);
+  DMXChannel *fixtures[maxFixtures];
+  Color colors[maxFixtures];
+  uint8_t types[maxFixtures];
+  uint16_t levels[maxFixtures];
+  uint8_t slots[maxFixtures * FIXTURE_MAX_SLOTS];
+  TickType_t lastWake = xTaskGetTickCount();
+  for (;;)
+  {
+    bool hasColorFade = false;
+    unsigned long now = millis();
+    uint32_t frameStart = micros();
+    uint8_t count = 0;
+    for (DMXChannel &channel : LightManager::instance->dmxChannels)
+    {
+      if (channel.config->type == FIXTURE_DIMMER || !channel.config->enabled || count >= maxFixtures)
+      {
+        continue;
+      }
+      if (channel.stepColorFade(now, colors[count]))
+      {
+        hasColorFade = true;
+      }
+      fixtures[count] = &channel;
+      types[count] = channel.config->type;
+      levels[count] = channel.outputLevel;
+      count++;
+    }
+
+    // All fixtures are converted in one pass and sent in one DMX frame.
+    colorRender(colors, types, levels, slots, count);
+    for (uint8_t i = 0; i < count; i++)
+    {
+      fixtures[i]->writeSlots(&slots[i * FIXTURE_MAX_SLOTS]);
+    }
+    taskTimings[TIMING_COLOR_FRAME].add(micros() - frameStart);
+
+    if (count > 0)
+    {
+      markDmxFrameReady();
+      LightManager::instance->_notifySendTasks();
+    }
+    if (hasColorFade)
+    {
+      vTaskDelayUntil(&lastWake, EFFECT_FRAME_TIME / portTICK_PERIOD_MS);
+    }
+    else
+    {
+      ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+      lastWake = xTaskGetTickCount();
+    }
+  }
+}
@@ -1,34 +1,74 @@
 #ifndef LIGHTMANAGER_H
 #define LIGHTMANAGER_H
 
-#include <ArduLog.h>
+#include <LMANLog.h>
 #include <Arduino.h>
-#include <ESPDMX.h>
+#include <DMXMerger.h>
+#include <Effects.h>
+#include <Color.h>
 #include <LMANConfig.h>
+#include <LMANTasks.h>
 #include <freertos/semphr.h>
 
 #include <list>
 #include <string>
 
+/// @brief Time in ms between level updates while fading to a scene
+#define SCENE_FADE_STEP 20
+/// @brief Levels are 16 bit, an 8 bit level (config, scenes, web) is multiplied by this. One dimming step is one 8 bit level.
+#define LEVEL_SCALE 257
+/// @brief Time in ms a fixture takes to change color if no transition is given
+#define COLOR_FADE_TIME 500
+
 class DMXChannel
 {
 public:
-  void init(TaskHandle_t *dmxSendTask, DMXESPSerial *dmx, ChannelConfig *config);
+  /// @param dmx The merger of the channel's universe, nullptr if the universe does not exist
+  void init(DMXMerger *dmx, ChannelConfig *config);
   ChannelConfig *config;
-  /// @brief The current dim level
-  uint8_t level;
+  /// @brief The current dim level, 16 bit. 8 bit channels send the upper byte.
+  uint16_t level;
   /// @brief The current dimming direction. True = getting brighter, false = fading
   bool dimmingDirection = true;
   /// @brief The last light level change in ms
   unsigned long lastLevelChange = 0;
   /// @brief The target for the auto-dimming function.
-  uint8_t levelBeforeAutoDimming = 255;
+  uint16_t levelBeforeAutoDimming = 65535;
   /// @brief The target for auto-dimming.
-  uint8_t autoDimmingTarget = 0;
+  uint16_t autoDimmingTarget = 0;
   /// @brief Wether or not this channel is auto-dimming.
   bool isAutoDimming = false;
   /// @brief Wether or not to turn off light when the auto-dimming target has been reached.
   bool turnOffWhenAutoDimComplete = false;
+  /// @brief Wether or not this channel is fading to a scene.
+  bool isSceneFading = false;
+  /// @brief The level when the scene fade started.
+  uint16_t sceneFadeFrom = 0;
+  /// @brief The level at the end of the scene fade.
+  uint16_t sceneFadeTo = 0;
+  /// @brief When the scene fade started in ms. Shared by all channels of the scene.
+  unsigned long sceneFadeStart = 0;
+  /// @brief The length of the scene fade in ms.
+  uint32_t sceneFadeTime = 0;
+  /// @brief Wether or not to turn off light when the scene fade is complete.
+  bool turnOffWhenSceneFadeComplete = false;
+  /// @brief The effect running on this channel. While running, the output is written by _taskEffects.
+  EffectState effect;
+  /// @brief The color of a fixture at full brightness, the one last set. The color fields are written under a lock,
+  /// other tasks read the color with getColor().
+  Color color;
+  /// @brief The color that is output, follows color while it is fading
+  Color outputColor;
+  /// @brief Wether the output color is fading to color
+  bool isColorFading = false;
+  /// @brief The output color when the fade started
+  Color colorFadeFrom;
+  /// @brief When the color fade started in ms
+  unsigned long colorFadeStart = 0;
+  /// @brief The length of the color fade in ms
+  uint32_t colorFadeTime = 0;
+  /// @brief The brightness last written to a fixture, rendered to its slots by _taskColor
+  uint16_t outputLevel = 0;
   /// @brief Current state. True = output on, false = output off.
   bool state;
   /// @brief Wether the state has changed since last MQTT update was sent.
@@ -37,21 +77,58 @@ public:
   bool webSendUpdate = false;
   /// @brief Set the output state and update DMX
   /// @param state The output state. true = on, false = off
-  void setState(bool state);
+  /// @param sendUpdate Weather or not to send the update straight away or wait until next cycle.
+  void setState(bool state, bool sendUpdate = true);
   /// @brief Set the new dim level
-  /// @param level The level to set
-  void setLevel(uint8_t level);
+  /// @param level The 16 bit level to set
+  /// @param sendUpdate Weather or not to send the update straight away (if on) or wait until next cycle.
+  void setLevel(uint16_t level, bool sendUpdate = true);
+  /// @brief The configured minimum as 16 bit level
+  uint16_t getMinLevel();
+  /// @brief The configured maximum as 16 bit level
+  uint16_t getMaxLevel();
+  /// @brief The level in the resolution of the channel: 0-255, or 0-65535 for 16 bit channels. Used as Home Assistant brightness.
+  uint16_t getBrightness();
+  /// @brief Convert a brightness in the resolution of the channel to a 16 bit level
+  uint16_t brightnessToLevel(uint16_t brightness);
   /// @brief Update DMX data and cause a send out straight away.
   /// @param sendUpdate Weather or not to send the update straight away or wait until next cycle.
   void updateDMXData(bool sendUpdate);
-  /// @brief If auto-dimming is currently happening, stop it.
+  /// @brief Write a 16 bit level to the channel's slots without changing the channel state. Used for effect frames.
+  /// Fixtures are converted to their slots by _taskColor.
+  void writeOutput(uint16_t value);
+  /// @brief Write the slots of a fixture, ChannelConfig::getSlotCount() levels
+  void writeSlots(const uint8_t *values);
+  /// @brief Set the color of a fixture
+  /// @param color The new color
+  /// @param fadeTime The time in ms to fade from the current color, faded in a perceptual space (see colorInterpolate)
+  void setColor(const Color &color, uint32_t fadeTime = COLOR_FADE_TIME);
+  /// @brief The color last set, read under the color lock so that it is never half written
+  Color getColor();
+  /// @brief Advance the color fade, called by _taskColor each frame
+  /// @param now millis() at the start of the frame
+  /// @param output Set to the color to output
+  /// @return True while the color is fading
+  bool stepColorFade(unsigned long now, Color &output);
+  /// @brief If auto-dimming or a scene fade is currently happening, stop it.
   /// @return True if stop was successful
   bool stopAutoDimming();
+  /// @brief Apply a changed config to this channel. Clears the previously used DMX channel if it moved or was disabled.
+  /// @param dmx The merger of the (new) universe of the channel, nullptr if the universe does not exist
+  void applyConfig(DMXMerger *dmx);
 
 private:
-  TaskHandle_t *_dmxSendTask;
-  DMXESPSerial *_dmx;
+  /// @brief The DMX channel last written to. 0 = nothing written yet.
+  uint8_t _outputChannel = 0;
+  /// @brief The number of slots written from _outputChannel on
+  uint8_t _outputSlots = 0;
+  /// @brief The merger _outputChannel was written to
+  DMXMerger *_outputDmx = nullptr;
+  /// @brief The merger of the configured universe
+  DMXMerger *_dmx = nullptr;
   SemaphoreHandle_t _autoDimmingHandleMutex = NULL;
+  /// @brief Guards the color and color fade fields, set from the network core while _taskColor fades them
+  portMUX_TYPE _colorMux = portMUX_INITIALIZER_UNLOCKED;
 };
 
 struct ButtonEvent
@@ -93,13 +170,27 @@ private:
   ButtonEvent _currentButtonState;
 };
 
+/// @brief A level change for LightManager::fadeChannels
+struct ChannelFade
+{
+  DMXChannel *channel;
+  /// @brief Wether the channel is on at the end of the fade
+  bool state;
+  /// @brief The 16 bit level at the end of the fade, if on
+  uint16_t level;
+  /// @brief The time in ms to reach the level, long enough for slow scheduled ramps
+  uint32_t fadeTime;
+};
+
 class LightManager
 {
 public:
   /// @brief Start LightManager processing.
-  /// @param dmxSendTask Task handle to the last that needs to be notified of changes in DMX data.
-  /// @param dmx The DMX handler
-  void init(TaskHandle_t *dmxSendTask, DMXESPSerial *dmx);
+  /// @param dmx The DMX mergers that local levels are written to, one per universe (DMX_OUTPUT_COUNT)
+  void init(DMXMerger *dmx);
+  /// @brief Apply changes in LMANConfig to running channels and buttons without a reboot.
+  /// Updates dimming speeds, re-attaches button interrupts, moves channels and resizes the DMX output.
+  void applyConfig();
   /// @brief Initialize a button used for input and control over a DMX channel
   /// @param buttonPin The GPIO pin used to read button state
   /// @param buttonConfig The Button configuration from config manager
@@ -117,12 +208,12 @@ public:
   static void taskProcessButtonEvents(void *param);
   /// @brief Start auto-dimming to specified target. Starting from already set value.
   /// @param dmxChannel The channel to auto-dim
-  /// @param level The level to dim to.
-  void autoDimTo(DMXChannel *dmxChannel, uint8_t level);
+  /// @param level The 16 bit level to dim to.
+  void autoDimTo(DMXChannel *dmxChannel, uint16_t level);
   /// @brief Turn on light by auto-dimming to the previous level.
   /// @param dmxChannel The DMX Channel to turn on.
-  /// @param level The requested level.
-  void autoDimOnToLevel(DMXChannel *dmxChannel, uint8_t level);
+  /// @param level The requested 16 bit level.
+  void autoDimOnToLevel(DMXChannel *dmxChannel, uint16_t level);
   /// @brief Turn on light by auto-dimming to the previous level.
   /// @param dmxChannel The DMX Channel to turn on.
   void autoDimOn(DMXChannel *dmxChannel);
@@ -130,21 +221,79 @@ public:
   /// @param dmxChannel The DMX Channel to turn on.
   void autoDimOff(DMXChannel *dmxChannel);
   static void taskAutoDimDMXChannel(void *param);
+  /// @brief Fade all channels of a scene to their levels. All channels start and end at the same time.
+  /// @param scene The index of the scene in LMANConfig::sceneConfigs
+  /// @return True if the scene was recalled
+  bool recallScene(uint8_t scene);
+  /// @brief Turn all channels of a group on or off in one fade. All members start and end at the same time.
+  /// @param group The index of the group in LMANConfig::groupConfigs
+  /// @param state Wether to turn the members on or off
+  /// @param level The 16 bit level to fade the members to, 0 to keep the level of each member
+  /// @param fadeTime The time in ms for all members to reach their level
+  /// @return True if the group was set
+  bool setGroup(uint8_t group, bool state, uint16_t level, uint32_t fadeTime);
+  /// @brief Fade many channels in one step, each to its own level in its own time. All fades start at the same time.
+  /// @param fades The channels and their targets
+  /// @param count The number of fades
+  void fadeChannels(const ChannelFade *fades, uint8_t count);
+  /// @brief Find the channel of a config
+  /// @param index The index of the channel in LMANConfig::channelConfigs
+  /// @return The channel, nullptr if it has not been initiated
+  DMXChannel *getChannel(uint8_t index);
+  /// @brief Start or stop an effect on a channel. The level of the channel sets the brightness of the effect.
+  /// @param dmxChannel The channel to run the effect on
+  /// @param effect The effect, EFFECT_NONE to go back to a static level
+  /// @param period The length of one effect cycle in ms, 0 for the default of the effect
+  void setEffect(DMXChannel *dmxChannel, uint8_t effect, uint16_t period = 0);
+  /// @brief Wake the color task to convert the fixtures to their slots, after the level or color of a fixture changed
+  void requestColorFrame();
   /// @brief The list of DMX Channels in use
   std::list<DMXChannel> dmxChannels;
   /// @brief The list of active buttons
   std::list<Button> buttons;
 
 private:
+  /// @brief Find the DMX channel object using a DMX channel number
+  /// @param channel The DMX channel number
+  /// @return The channel or nullptr if not found
+  DMXChannel *_findDMXChannel(uint8_t channel);
+  /// @brief Link a button to its DMX channel and (re-)attach its interrupt.
+  void _attachButton(Button *button);
+  /// @brief Find the fastest dimming speeds of all enabled channels
+  void _updateDimmingSpeeds();
+  /// @brief The fastest dimming speed of all enabled channels, used by _taskDimLights
+  uint8_t _fastestDimmingSpeed = 255;
+  /// @brief The fastest auto-dimming speed of all enabled channels, used by _taskAutoDimLights
+  uint8_t _fastestAutoDimmingSpeed = 255;
+  /// @brief Tell each DMX merger the highest slot of the enabled channels on its universe
+  void _updateSlotCount();
+  /// @brief Start fading a channel with _taskSceneFade. The task has to be notified by the caller.
+  /// @param state Wether the channel is on at the end of the fade
+  /// @param level The 16 bit level at the end of the fade, if on
+  void _startFade(DMXChannel *channel, bool state, uint16_t level, unsigned long fadeStart, uint32_t fadeTime);
+  /// @brief The merger of a universe
+  /// @param universe The universe, 1-DMX_OUTPUT_COUNT
+  /// @return The merger or nullptr if the universe does not exist
+  DMXMerger *_getMerger(uint8_t universe);
+  /// @brief Wake the send tasks of all universes, for changes that can span universes
+  void _notifySendTasks();
   TaskHandle_t _taskHandleReadButtonStates;
   static void _taskReadButtonStates(void *param);
   TaskHandle_t _taskHandleDimLights;
   static void _taskDimLights(void *param);
   TaskHandle_t _taskHandleAutoDimLights;
   static void _taskAutoDimLights(void *param);
-  TaskHandle_t *_dmxSendTask;
-  /// @brief The DMX handler
-  DMXESPSerial *_dmx;
+  TaskHandle_t _taskHandleSceneFade;
+  static void _taskSceneFade(void *param);
+  TaskHandle_t _taskHandleEffects;
+  static void _taskEffects(void *param);
+  /// @brief Guards DMXChannel::effect of all channels. setEffect() runs on the MQTT and web tasks while _taskEffects steps the effects.
+  portMUX_TYPE _effectMux = portMUX_INITIALIZER_UNLOCKED;
+  TaskHandle_t _taskHandleColor = NULL;
+  /// @brief Converts the colors of all fixtures to their slots in one pass, each frame while a color is fading
+  static void _taskColor(void *param);
+  /// @brief The DMX mergers, one per universe
+  DMXMerger *_dmx;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,262 @@
+#include <LogSink.h>
+#include <LMANConfig.h>
+#include <LMANLog.h>
+#include <LMANTasks.h>
+#include <WiFi.h>
+
+// Syslog facility local0, severity informational
+#define SYSLOG_PRIORITY 134
+
+// Make space for variables in memory
+LogSink *LogSink::instance;
+
+LogSink::LogSink() : HardwareSerial(0), _head(0), _tail(0), _dropped(0)
+{
+    for (LogSlot &slot : this->_slots)
+    {
+        slot.ready.store(0);
+    }
+    for (PendingLine &line : this->_pending)
+    {
+        line.task.store(nullptr);
+        line.length = 0;
+    }
+}
+
+void LogSink::init()
+{
+    LogSink::instance = this;
+    this->_configMutex = xSemaphoreCreateMutex();
+    createTask(TASK_DRAIN_LOG, _taskDrain, NULL);
+}
+
+void LogSink::applyConfig()
+{
+    this->_serialEnabled = LMANConfig::instance->log_serial;
+    if (xSemaphoreTake(this->_configMutex, portMAX_DELAY))
+    {
+        this->_syslogServer = LMANConfig::instance->syslog_server;
+        this->_syslogPort = LMANConfig::instance->syslog_port;
+        this->_syslogResolve = true;
+        xSemaphoreGive(this->_configMutex);
+    }
+}
+
+void LogSink::attachWebSocket(AsyncWebSocket *socket)
+{
+    this->_webSocket = socket;
+}
+
+size_t LogSink::write(const uint8_t *data, size_t length)
+{
+    PendingLine *line = this->_pendingLine();
+    if (!line)
+    {
+        // More tasks are logging than there are lines, the data may end up in between another line.
+        return this->_push((const char *)data, length) ? length : 0;
+    }
+    for (size_t i = 0; i < length; i++)
+    {
+        line->data[line->length++] = data[i];
+        if (data[i] == '\n' || line->length == LOG_SINK_LINE_SIZE)
+        {
+            // A dropped line is counted, the task goes on with the next one.
+            this->_push(line->data, line->length);
+            line->length = 0;
+        }
+    }
+    if (line->length == 0)
+    {
+        line->task.store(nullptr, std::memory_order_release);
+    }
+    return length;
+}
+
+size_t LogSink::write(uint8_t data)
+{
+    return this->write(&data, 1);
+}
+
+void LogSink::flush()
+{
+}
+
+PendingLine *LogSink::_pendingLine()
+{
+    TaskHandle_t task = xTaskGetCurrentTaskHandle();
+    // Only the owning task touches a claimed line, so finding it needs no lock.
+    for (PendingLine &line : this->_pending)
+    {
+        if (line.task.load(std::memory_order_acquire) == task)
+        {
+            return &line;
+        }
+    }
+    for (PendingLine &line : this->_pending)
+    {
+        TaskHandle_t free = nullptr;
+        if (line.task.compare_exchange_strong(free, task, std::memory_order_acquire))
+        {
+            return &line;
+        }
+    }
+    return nullptr;
+}
+
+bool LogSink::_push(const char *data, uint16_t length)
+{
+    // Reserve all slots of the data at once, so that they are drained in one piece. Give up instead of
+    // waiting if the drain task is behind.
+    uint32_t count = (length + LOG_SINK_SLOT_SIZE - 1) / LOG_SINK_SLOT_SIZE;
+    uint32_t head = this->_head.load();
+    do
+    {
+        if (head + count - this->_tail.load() > LOG_SINK_SLOT_COUNT)
+        {
+            this->_dropped++;
+            return false;
+        }
+    } while (!this->_head.compare_exchange_weak(head, head + count));
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        LogSlot &slot = this->_slots[(head + i) % LOG_SINK_SLOT_COUNT];
+        slot.length = length > LOG_SINK_SLOT_SIZE ? LOG_SINK_SLOT_SIZE : length;
+        memcpy(slot.data, data, slot.length);
+        slot.ready.store(1, std::memory_order_release);
+        data += slot.length;
+        length -= slot.length;
+    }
+    return true;
+}
+
+uint32_t LogSink::getDropped()
+{
+    return this->_dropped.load();
+}
+
+void LogSink::_taskDrain(void *param)
+{
+    for (;;)
+    {
+        LogSink::instance->_resolveSyslogServer();
+        LogSink::instance->_drain();
+        vTaskDelay(LOG_SINK_DRAIN_INTERVAL / portTICK_PERIOD_MS);
+    }
+}
+
+void LogSink::_resolveSyslogServer()
+{
+    if (!this->_syslogResolve || !WiFi.isConnected())
+    {
+        return;
+    }
+    std::string server;
+    if (xSemaphoreTake(this->_configMutex, portMAX_DELAY))
+    {
+        server = this->_syslogServer;
+        this->_syslogResolve = false;
+        xSemaphoreGive(this->_configMutex);
+    }
+    this->_syslogEnabled = false;
+    if (server.empty())
+    {
+        return;
+    }
+    if (this->_syslogAddress.fromString(server.c_str()) || WiFi.hostByName(server.c_str(), this->_syslogAddress))
+    {
+        this->_syslogEnabled = true;
+    }
+    else
+    {
+        // Logged like any other line, it ends up on the remaining targets.
+        LOG_ERROR("Failed to resolve syslog server ", LOG_BOLD, server.c_str());
+    }
+}
+
+void LogSink::_drain()
+{
+    for (;;)
+    {
+        uint32_t tail = this->_tail.load();
+        if (tail == this->_head.load())
+        {
+            break;
+        }
+        LogSlot &slot = this->_slots[tail % LOG_SINK_SLOT_COUNT];
+        if (!slot.ready.load(std::memory_order_acquire))
+        {
+            // Reserved but still being written, continue with the next drain.
+            break;
+        }
+        if (this->_serialEnabled)
+        {
+            Serial.write((const uint8_t *)slot.data, slot.length);
+        }
+        this->_addToLine(slot.data, slot.length);
+        slot.ready.store(0);
+        this->_tail.store(tail + 1);
+    }
+
+    uint32_t dropped = this->_dropped.load();
+    if (dropped != this->_reportedDropped)
+    {
+        char message[64];
+        int length = snprintf(message, sizeof(message), "Log ring full, dropped %u lines\n", (unsigned)(dropped - this->_reportedDropped));
+        this->_reportedDropped = dropped;
+        if (this->_serialEnabled)
+        {
+            Serial.write((const uint8_t *)message, length);
+        }
+        this->_addToLine(message, length);
+    }
+}
+
+void LogSink::_addToLine(const char *data, uint8_t length)
+{
+    for (uint8_t i = 0; i < length; i++)
+    {
+        char c = data[i];
+        if (this->_inEscape)
+        {
+            // ANSI sequences end with a letter
+            this->_inEscape = !isalpha(c);
+        }
+        else if (c == '\e')
+        {
+            this->_inEscape = true;
+        }
+        else if (c == '\n')
+        {
+            this->_sendLine();
+        }
+        else if (c != '\r')
+        {
+            this->_line[this->_lineLength++] = c;
+            if (this->_lineLength == LOG_SINK_LINE_SIZE)
+            {
+                this->_sendLine();
+            }
+        }
+    }
+}
+
+void LogSink::_sendLine()
+{
+    if (this->_lineLength == 0)
+    {
+        return;
+    }
+    if (this->_webSocket && this->_webSocket->count() > 0)
+    {
+        this->_webSocket->textAll(this->_line, this->_lineLength);
+    }
+    if (this->_syslogEnabled && WiFi.isConnected())
+    {
+        // RFC 3164 without timestamp, the server adds the time of reception.
+        char packet[LOG_SINK_LINE_SIZE + 64];
+        int length = snprintf(packet, sizeof(packet), "<%u>%s lman: %.*s", SYSLOG_PRIORITY, LMANConfig::instance->wifi_hostname.c_str(), this->_lineLength, this->_line);
+        this->_udp.writeTo((const uint8_t *)packet, length < (int)sizeof(packet) ? length : sizeof(packet) - 1, this->_syslogAddress, this->_syslogPort);
+    }
+    this->_lineLength = 0;
+}
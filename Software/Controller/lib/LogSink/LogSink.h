@@ -0,0 +1,107 @@
+#ifndef LMAN_LOG_SINK
+#define LMAN_LOG_SINK
+
+#include <Arduino.h>
+#include <AsyncUDP.h>
+#include <ESPAsyncWebServer.h>
+#include <freertos/semphr.h>
+#include <atomic>
+
+/// @brief The number of slots in the log ring
+#define LOG_SINK_SLOT_COUNT 48
+/// @brief The number of bytes in each slot, enough for most log lines. Longer lines take several consecutive slots.
+#define LOG_SINK_SLOT_SIZE 128
+/// @brief The longest line sent to syslog or the WebSocket, longer lines are split
+#define LOG_SINK_LINE_SIZE 256
+/// @brief The number of tasks that can format a line at the same time. Writes of further tasks go to the ring as they are.
+#define LOG_SINK_PENDING_COUNT 8
+/// @brief Time in ms between drains of the log ring
+#define LOG_SINK_DRAIN_INTERVAL 20
+
+struct LogSlot
+{
+    /// @brief Set by the writer when data and length are complete, cleared by the drain task
+    std::atomic<uint8_t> ready;
+    uint8_t length;
+    char data[LOG_SINK_SLOT_SIZE];
+};
+
+/// @brief A line that a task is still writing. ArduLog writes each token of a line separately.
+struct PendingLine
+{
+    /// @brief The task writing the line, nullptr if free
+    std::atomic<TaskHandle_t> task;
+    uint16_t length;
+    char data[LOG_SINK_LINE_SIZE];
+};
+
+/// @brief Log output for ArduLog that never blocks the logging task. Each task collects its writes into a line,
+/// complete lines go into an in-RAM ring of slots as one entry, so lines of different tasks never mix. The ring is
+/// drained by a low priority task to Serial, syslog over UDP and the /logs WebSocket.
+/// Derives from HardwareSerial only so that it can be handed to ArduLog::SetSerial, it never touches the UART itself.
+class LogSink : public HardwareSerial
+{
+public:
+    LogSink();
+    /// @brief Start the drain task
+    void init();
+    /// @brief The instance of the log sink started with .init();
+    static LogSink *instance;
+    /// @brief Read the log targets from LMANConfig. The syslog server is resolved by the drain task.
+    void applyConfig();
+    /// @brief Also send all log lines to the clients of a WebSocket
+    void attachWebSocket(AsyncWebSocket *socket);
+    /// @brief Add data to the line of the calling task, the line is queued for the log targets at its end.
+    /// Lock-free, if the ring is full the line is dropped and counted.
+    size_t write(const uint8_t *data, size_t length) override;
+    size_t write(uint8_t data) override;
+    /// @brief Nothing to flush, the drain task empties the ring
+    void flush() override;
+    /// @brief The number of lines dropped because the ring was full
+    uint32_t getDropped();
+
+private:
+    /// @brief The line of the calling task, a free one is claimed for it
+    /// @return The line, nullptr if all are in use by other tasks
+    PendingLine *_pendingLine();
+    /// @brief Queue data in consecutive slots of the ring
+    /// @return False if the ring is full
+    bool _push(const char *data, uint16_t length);
+    static void _taskDrain(void *param);
+    /// @brief Send all complete slots to the targets
+    void _drain();
+    /// @brief Add drained data to the current line and send the line when it is complete
+    void _addToLine(const char *data, uint8_t length);
+    void _sendLine();
+    /// @brief Look up the syslog server if it changed
+    void _resolveSyslogServer();
+
+    LogSlot _slots[LOG_SINK_SLOT_COUNT];
+    PendingLine _pending[LOG_SINK_PENDING_COUNT];
+    /// @brief The next slot to reserve for writing
+    std::atomic<uint32_t> _head;
+    /// @brief The next slot to drain
+    std::atomic<uint32_t> _tail;
+    std::atomic<uint32_t> _dropped;
+    /// @brief The number of dropped lines already reported in the log
+    uint32_t _reportedDropped = 0;
+
+    /// @brief The current line without ANSI decorations, for syslog and the WebSocket
+    char _line[LOG_SINK_LINE_SIZE];
+    uint16_t _lineLength = 0;
+    /// @brief Wether the drain is inside an ANSI escape sequence
+    bool _inEscape = false;
+
+    bool _serialEnabled = true;
+    AsyncWebSocket *_webSocket = nullptr;
+    AsyncUDP _udp;
+    /// @brief Guards _syslogServer which is set from the web server
+    SemaphoreHandle_t _configMutex;
+    std::string _syslogServer;
+    uint16_t _syslogPort = 514;
+    bool _syslogResolve = false;
+    IPAddress _syslogAddress;
+    bool _syslogEnabled = false;
+};
+
+#endif
@@ -0,0 +1,78 @@
+#include <MqttRaw.h>
+#include <LMANLog.h>
+#include <DMXMerger.h>
+#include <DMXOutput.h>
+#include <LMANConfig.h>
+
+// Make space for variables in memory
+MqttRawReceiver *MqttRawReceiver::instance = nullptr;
+
+void MqttRawReceiver::init()
+{
+    MqttRawReceiver::instance = this;
+    if (LMANConfig::instance->mqtt_raw_enabled)
+    {
+        LOG_INFO("Accepting raw DMX levels on ", LOG_BOLD, LMANConfig::instance->getMqttRawTopic().c_str());
+    }
+}
+
+bool MqttRawReceiver::handleMessage(const char *topic, const uint8_t *payload, unsigned int length)
+{
+    if (!LMANConfig::instance->mqtt_raw_enabled || LMANConfig::instance->getMqttRawTopic().compare(topic) != 0)
+    {
+        return false;
+    }
+
+    unsigned long start = micros();
+    uint16_t slot = length >= MQTT_RAW_HEADER_SIZE ? (payload[0] << 8) | payload[1] : 0;
+    if (length <= MQTT_RAW_HEADER_SIZE || slot < 1 || slot > DMX_UNIVERSE_SIZE)
+    {
+        this->_rejected++;
+        LOG_DEBUG("Dropped raw DMX message of ", length, " bytes starting at slot ", slot);
+        return true;
+    }
+
+    // The levels are merged straight from PubSubClient's receive buffer
+    uint16_t count = length - MQTT_RAW_HEADER_SIZE > DMX_UNIVERSE_SIZE ? DMX_UNIVERSE_SIZE : length - MQTT_RAW_HEADER_SIZE;
+    DMXMerger::instance->writeNetworkSlots(slot, payload + MQTT_RAW_HEADER_SIZE, count, LMANConfig::instance->mqtt_raw_hold);
+
+    this->_messages++;
+    this->_slots += count;
+    this->_lastProcessingTime = micros() - start;
+    if (this->_lastProcessingTime > this->_maxProcessingTime)
+    {
+        this->_maxProcessingTime = this->_lastProcessingTime;
+    }
+    this->_updateRate();
+    return true;
+}
+
+void MqttRawReceiver::_updateRate()
+{
+    unsigned long now = millis();
+    if (now - this->_lastRateUpdate >= 1000)
+    {
+        this->_messagesPerSecond = ((this->_messages - this->_messagesAtLastRate) * 1000) / (now - this->_lastRateUpdate);
+        this->_messagesAtLastRate = this->_messages;
+        this->_lastRateUpdate = now;
+        LOG_TRACE("Raw MQTT: ", this->_messagesPerSecond, " messages/s, processing ", this->_lastProcessingTime, " us");
+    }
+}
+
+size_t MqttRawReceiver::getStatusJson(char *buffer, size_t size)
+{
+    if (millis() - this->_lastRateUpdate > 2000)
+    {
+        this->_messagesPerSecond = 0; // No messages received recently
+    }
+    return snprintf(buffer, size, "{\"enabled\":%s,\"hold\":%u,\"active\":%s,\"messages\":%u,\"messages_per_second\":%u,\"slots\":%u,\"rejected\":%u,\"processing_us\":%u,\"max_processing_us\":%u}",
+                    LMANConfig::instance->mqtt_raw_enabled ? "true" : "false",
+                    (unsigned int)LMANConfig::instance->mqtt_raw_hold,
+                    DMXMerger::instance->isNetworkActive() ? "true" : "false",
+                    (unsigned int)this->_messages,
+                    (unsigned int)this->_messagesPerSecond,
+                    (unsigned int)this->_slots,
+                    (unsigned int)this->_rejected,
+                    (unsigned int)this->_lastProcessingTime,
+                    (unsigned int)this->_maxProcessingTime);
+}
@@ -0,0 +1,50 @@
+#ifndef LMAN_MQTT_RAW
+#define LMAN_MQTT_RAW
+
+#include <Arduino.h>
+
+/// @brief Bytes before the levels in a raw message: the first slot, 16 bit big-endian
+#define MQTT_RAW_HEADER_SIZE 2
+
+/// @brief Receives DMX levels on the raw MQTT topic and merges them into the DMX output through DMXMerger.
+/// A message is the first slot followed by the levels of consecutive slots. They are copied into the output as they are,
+/// without JSON and without fades, for sequencers that stream at a high rate. After LMANConfig::mqtt_raw_hold ms
+/// without a message the local levels are output again.
+class MqttRawReceiver
+{
+public:
+    /// @brief Set the instance. Messages are only accepted while LMANConfig::mqtt_raw_enabled is set, it can change without a reboot.
+    void init();
+    /// @brief The instance of the receiver started with .init();
+    static MqttRawReceiver *instance;
+    /// @brief Merge a message into the output if it was sent to the raw topic. Called first in the MQTT callback.
+    /// @param topic The topic of the message
+    /// @param payload The message
+    /// @param length The length of the message
+    /// @return True if the message was for the raw topic, also if it was rejected
+    bool handleMessage(const char *topic, const uint8_t *payload, unsigned int length);
+    /// @brief Describe the receive statistics as JSON
+    /// @param buffer The buffer to write to
+    /// @param size The size of the buffer
+    /// @return The length of the written JSON
+    size_t getStatusJson(char *buffer, size_t size);
+
+private:
+    /// @brief Calculate messages/s once every second
+    void _updateRate();
+
+    /// @brief Messages merged into the output
+    uint32_t _messages = 0;
+    /// @brief Messages dropped as too short or with a first slot outside the universe
+    uint32_t _rejected = 0;
+    /// @brief Levels merged into the output
+    uint32_t _slots = 0;
+    uint32_t _messagesAtLastRate = 0;
+    unsigned long _lastRateUpdate = 0;
+    uint16_t _messagesPerSecond = 0;
+    /// @brief Time (in us) from the MQTT callback until the levels are in the output buffer
+    uint32_t _lastProcessingTime = 0;
+    uint32_t _maxProcessingTime = 0;
+};
+
+#endif
@@ -0,0 +1,383 @@
+#include <RDM.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static void _writeUid(uint8_t *buffer, RDMUid uid)
+{
+    for (int i = 0; i < 6; i++)
+    {
+        buffer[i] = uid >> (40 - 8 * i);
+    }
+}
+
+static RDMUid _readUid(const uint8_t *buffer)
+{
+    RDMUid uid = 0;
+    for (int i = 0; i < 6; i++)
+    {
+        uid = (uid << 8) | buffer[i];
+    }
+    return uid;
+}
+
+size_t rdmBuildPacket(uint8_t *buffer, RDMUid destination, RDMUid source, uint8_t transaction, uint8_t portOrResponseType,
+                      uint8_t commandClass, uint16_t parameter, const uint8_t *data, uint8_t dataLength)
+{
+    if (dataLength > RDM_MAX_PARAMETER_SIZE)
+    {
+        return 0;
+    }
+    buffer[0] = RDM_START_CODE;
+    buffer[1] = RDM_SUB_START_CODE;
+    buffer[2] = RDM_HEADER_SIZE + dataLength;
+    _writeUid(buffer + 3, destination);
+    _writeUid(buffer + 9, source);
+    buffer[15] = transaction;
+    buffer[16] = portOrResponseType;
+    buffer[17] = 0; // Message count
+    buffer[18] = 0; // Sub-device, always the root device
+    buffer[19] = 0;
+    buffer[20] = commandClass;
+    buffer[21] = parameter >> 8;
+    buffer[22] = parameter;
+    buffer[23] = dataLength;
+    if (dataLength > 0)
+    {
+        memcpy(buffer + RDM_HEADER_SIZE, data, dataLength);
+    }
+
+    size_t length = RDM_HEADER_SIZE + dataLength;
+    uint16_t checksum = 0;
+    for (size_t i = 0; i < length; i++)
+    {
+        checksum += buffer[i];
+    }
+    buffer[length++] = checksum >> 8;
+    buffer[length++] = checksum;
+    return length;
+}
+
+bool rdmParsePacket(const uint8_t *buffer, size_t length, RDMPacket &packet)
+{
+    if (length < RDM_HEADER_SIZE + 2 || buffer[0] != RDM_START_CODE || buffer[1] != RDM_SUB_START_CODE)
+    {
+        return false;
+    }
+    uint8_t messageLength = buffer[2];
+    if (messageLength < RDM_HEADER_SIZE || (size_t)messageLength + 2 > length || buffer[23] != messageLength - RDM_HEADER_SIZE)
+    {
+        return false;
+    }
+    uint16_t checksum = 0;
+    for (size_t i = 0; i < messageLength; i++)
+    {
+        checksum += buffer[i];
+    }
+    if (checksum != ((buffer[messageLength] << 8) | buffer[messageLength + 1]))
+    {
+        return false;
+    }
+
+    packet.destination = _readUid(buffer + 3);
+    packet.source = _readUid(buffer + 9);
+    packet.transaction = buffer[15];
+    packet.portOrResponseType = buffer[16];
+    packet.commandClass = buffer[20];
+    packet.parameter = (buffer[21] << 8) | buffer[22];
+    packet.dataLength = buffer[23];
+    packet.data = buffer + RDM_HEADER_SIZE;
+    return true;
+}
+
+size_t rdmEncodeDiscoveryResponse(uint8_t *buffer, RDMUid uid)
+{
+    memset(buffer, 0xFE, 7);
+    buffer[7] = 0xAA;
+    uint8_t raw[6];
+    _writeUid(raw, uid);
+    uint16_t checksum = 0;
+    for (int i = 0; i < 6; i++)
+    {
+        // Every byte is sent twice with half of the bits forced high, so that colliding responses corrupt each other
+        buffer[8 + 2 * i] = raw[i] | 0xAA;
+        buffer[9 + 2 * i] = raw[i] | 0x55;
+        checksum += buffer[8 + 2 * i] + buffer[9 + 2 * i];
+    }
+    buffer[20] = (checksum >> 8) | 0xAA;
+    buffer[21] = (checksum >> 8) | 0x55;
+    buffer[22] = checksum | 0xAA;
+    buffer[23] = checksum | 0x55;
+    return RDM_DISCOVERY_RESPONSE_SIZE;
+}
+
+bool rdmDecodeDiscoveryResponse(const uint8_t *buffer, size_t length, RDMUid &uid)
+{
+    // Skip up to 7 preamble bytes
+    size_t start = 0;
+    while (start < length && start < 7 && buffer[start] == 0xFE)
+    {
+        start++;
+    }
+    if (start >= length || buffer[start] != 0xAA || length - start - 1 < 16)
+    {
+        return false;
+    }
+    const uint8_t *euid = buffer + start + 1;
+
+    uint16_t checksum = 0;
+    uint8_t raw[6];
+    for (int i = 0; i < 6; i++)
+    {
+        raw[i] = euid[2 * i] & euid[2 * i + 1];
+        checksum += euid[2 * i] + euid[2 * i + 1];
+    }
+    uint16_t received = ((euid[12] & euid[13]) << 8) | (euid[14] & euid[15]);
+    if (checksum != received)
+    {
+        return false;
+    }
+    uid = _readUid(raw);
+    return true;
+}
+
+void rdmFormatUid(RDMUid uid, char *buffer, size_t size)
+{
+    snprintf(buffer, size, "%04x:%08lx", (unsigned)(uid >> 32), (unsigned long)(uid & 0xFFFFFFFFUL));
+}
+
+bool rdmParseUid(const char *text, RDMUid &uid)
+{
+    char *end;
+    unsigned long manufacturer = strtoul(text, &end, 16);
+    if (end == text || *end != ':' || manufacturer > 0xFFFF)
+    {
+        return false;
+    }
+    const char *device = end + 1;
+    unsigned long long deviceId = strtoull(device, &end, 16);
+    if (end == device || *end != '\0' || deviceId > 0xFFFFFFFFULL)
+    {
+        return false;
+    }
+    uid = ((RDMUid)manufacturer << 32) | deviceId;
+    return true;
+}
+
+void RDMController::init(RDMUid uid)
+{
+    this->_uid = uid;
+}
+
+void RDMController::startDiscovery()
+{
+    this->_unMutePending = true;
+    this->_branches[0] = {0, RDM_UID_MAX};
+    this->_branchCount = 1;
+    this->_muteUid = 0;
+    this->_muteFailures = 0;
+}
+
+void RDMController::poll()
+{
+    this->_pollRemaining = this->deviceCount;
+}
+
+bool RDMController::setStartAddress(RDMUid uid, uint16_t address)
+{
+    return this->_queue(uid, RDM_SET_COMMAND, RDM_PID_DMX_START_ADDRESS, address);
+}
+
+bool RDMController::isBusy()
+{
+    return this->isDiscovering() || this->_queueCount > 0 || this->_pollRemaining > 0;
+}
+
+bool RDMController::isDiscovering()
+{
+    return this->_unMutePending || this->_branchCount > 0 || this->_muteUid != 0;
+}
+
+uint32_t RDMController::getGeneration()
+{
+    return this->_generation;
+}
+
+bool RDMController::step(RDMTransport &transport)
+{
+    // Requests and polls go first so that devices do not go offline while a large line is being discovered
+    if (this->_queueCount > 0)
+    {
+        Request request = this->_queueItems[this->_queueHead];
+        this->_queueHead = (this->_queueHead + 1) % RDM_QUEUE_SIZE;
+        this->_queueCount--;
+        this->_stepRequest(transport, request);
+        return true;
+    }
+    if (this->_pollRemaining > 0 && this->deviceCount > 0)
+    {
+        this->_pollRemaining--;
+        this->_pollIndex = (this->_pollIndex + 1) % this->deviceCount;
+        this->_stepRequest(transport, {this->devices[this->_pollIndex].uid, RDM_GET_COMMAND, RDM_PID_DMX_START_ADDRESS, 0});
+        return true;
+    }
+    if (this->isDiscovering())
+    {
+        this->_stepDiscovery(transport);
+        return true;
+    }
+    return false;
+}
+
+bool RDMController::_transact(RDMTransport &transport, RDMUid uid, uint8_t commandClass, uint16_t parameter, const uint8_t *data, uint8_t dataLength)
+{
+    uint8_t transaction = this->_transaction++;
+    size_t length = rdmBuildPacket(this->_packet, uid, this->_uid, transaction, 1, commandClass, parameter, data, dataLength);
+    size_t received = transport.transact(this->_packet, length, this->_responseBuffer, sizeof(this->_responseBuffer));
+    return received > 0 && rdmParsePacket(this->_responseBuffer, received, this->_response) &&
+           this->_response.source == uid && this->_response.destination == this->_uid && this->_response.transaction == transaction &&
+           this->_response.commandClass == commandClass + 1 && this->_response.parameter == parameter;
+}
+
+void RDMController::_stepDiscovery(RDMTransport &transport)
+{
+    if (this->_unMutePending)
+    {
+        // Broadcasts have no response
+        this->_transact(transport, RDM_UID_BROADCAST, RDM_DISCOVERY_COMMAND, RDM_PID_DISC_UN_MUTE, NULL, 0);
+        this->_unMutePending = false;
+        return;
+    }
+
+    if (this->_muteUid != 0)
+    {
+        RDMUid uid = this->_muteUid;
+        this->_muteUid = 0;
+        if (!this->_transact(transport, uid, RDM_DISCOVERY_COMMAND, RDM_PID_DISC_MUTE, NULL, 0))
+        {
+            // A device that does not mute answers every branch it is in, give up on the branch after a few tries
+            if (++this->_muteFailures >= RDM_MAX_MISSED_POLLS && this->_branchCount > 0)
+            {
+                this->_branchCount--;
+                this->_muteFailures = 0;
+            }
+            return;
+        }
+        this->_muteFailures = 0;
+        if (!this->_findDevice(uid) && this->deviceCount < RDM_MAX_DEVICES)
+        {
+            RDMDevice &device = this->devices[this->deviceCount++];
+            device = RDMDevice();
+            device.uid = uid;
+            this->_generation++;
+        }
+        this->_queue(uid, RDM_GET_COMMAND, RDM_PID_DEVICE_INFO);
+        // The same branch is searched again, it can hold more devices
+        return;
+    }
+
+    Branch branch = this->_branches[this->_branchCount - 1];
+    uint8_t bounds[12];
+    _writeUid(bounds, branch.lower);
+    _writeUid(bounds + 6, branch.upper);
+    size_t length = rdmBuildPacket(this->_packet, RDM_UID_BROADCAST, this->_uid, this->_transaction++, 1, RDM_DISCOVERY_COMMAND,
+                                   RDM_PID_DISC_UNIQUE_BRANCH, bounds, sizeof(bounds));
+    size_t received = transport.transact(this->_packet, length, this->_responseBuffer, sizeof(this->_responseBuffer));
+    if (received == 0)
+    {
+        // No unmuted device in this branch
+        this->_branchCount--;
+        return;
+    }
+
+    RDMUid uid;
+    if (rdmDecodeDiscoveryResponse(this->_responseBuffer, received, uid) && uid >= branch.lower && uid <= branch.upper)
+    {
+        this->_muteUid = uid;
+        return;
+    }
+
+    // More than one device answered, search both halves
+    this->_branchCount--;
+    if (branch.lower == branch.upper || this->_branchCount + 2 > RDM_DISCOVERY_DEPTH)
+    {
+        return;
+    }
+    RDMUid middle = branch.lower + (branch.upper - branch.lower) / 2;
+    this->_branches[this->_branchCount++] = {middle + 1, branch.upper};
+    this->_branches[this->_branchCount++] = {branch.lower, middle};
+}
+
+void RDMController::_stepRequest(RDMTransport &transport, const Request &request)
+{
+    RDMDevice *device = this->_findDevice(request.uid);
+    uint8_t data[2] = {(uint8_t)(request.value >> 8), (uint8_t)request.value};
+    bool ok = this->_transact(transport, request.uid, request.commandClass, request.parameter, data, request.commandClass == RDM_SET_COMMAND ? 2 : 0) &&
+              this->_response.portOrResponseType == RDM_RESPONSE_ACK;
+    if (!device)
+    {
+        return;
+    }
+    if (!ok)
+    {
+        if (device->missedPolls < 255 && ++device->missedPolls == RDM_MAX_MISSED_POLLS)
+        {
+            this->_generation++;
+        }
+        return;
+    }
+    if (device->missedPolls >= RDM_MAX_MISSED_POLLS)
+    {
+        this->_generation++;
+    }
+    device->missedPolls = 0;
+
+    uint16_t startAddress = device->startAddress;
+    if (request.parameter == RDM_PID_DEVICE_INFO && this->_response.dataLength >= 19)
+    {
+        const uint8_t *info = this->_response.data;
+        device->model = (info[2] << 8) | info[3];
+        device->footprint = (info[10] << 8) | info[11];
+        startAddress = (info[14] << 8) | info[15];
+    }
+    else if (request.parameter == RDM_PID_DMX_START_ADDRESS && request.commandClass == RDM_GET_COMMAND && this->_response.dataLength >= 2)
+    {
+        startAddress = (this->_response.data[0] << 8) | this->_response.data[1];
+    }
+    else if (request.parameter == RDM_PID_DMX_START_ADDRESS && request.commandClass == RDM_SET_COMMAND)
+    {
+        startAddress = request.value;
+    }
+    if (startAddress != device->startAddress)
+    {
+        device->startAddress = startAddress;
+        this->_generation++;
+    }
+}
+
+bool RDMController::_queue(RDMUid uid, uint8_t commandClass, uint16_t parameter, uint16_t value)
+{
+    if (this->_queueCount >= RDM_QUEUE_SIZE)
+    {
+        return false;
+    }
+    Request &request = this->_queueItems[(this->_queueHead + this->_queueCount) % RDM_QUEUE_SIZE];
+    request.uid = uid;
+    request.commandClass = commandClass;
+    request.parameter = parameter;
+    request.value = value;
+    this->_queueCount++;
+    return true;
+}
+
+RDMDevice *RDMController::_findDevice(RDMUid uid)
+{
+    for (uint8_t i = 0; i < this->deviceCount; i++)
+    {
+        if (this->devices[i].uid == uid)
+        {
+            return &this->devices[i];
+        }
+    }
+    return nullptr;
+}
@@ -0,0 +1,186 @@
+#ifndef LMAN_RDM
+#define LMAN_RDM
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define RDM_START_CODE 0xCC
+#define RDM_SUB_START_CODE 0x01
+/// @brief Bytes from the start code up to the parameter data
+#define RDM_HEADER_SIZE 24
+#define RDM_MAX_PARAMETER_SIZE 231
+/// @brief Largest packet: header, parameter data and checksum
+#define RDM_MAX_PACKET_SIZE (RDM_HEADER_SIZE + RDM_MAX_PARAMETER_SIZE + 2)
+/// @brief Discovery response: 7 preamble bytes, separator, encoded UID and encoded checksum
+#define RDM_DISCOVERY_RESPONSE_SIZE 24
+#define RDM_UID_BROADCAST 0xFFFFFFFFFFFFULL
+/// @brief Highest UID searched by discovery, all above are broadcast addresses
+#define RDM_UID_MAX 0xFFFFFFFFFFFEULL
+/// @brief Manufacturer ID from the range ESTA reserves for prototypes
+#define RDM_MANUFACTURER_ID 0x7FF0
+/// @brief Devices the controller keeps track of
+#define RDM_MAX_DEVICES 32
+/// @brief Branches waiting to be searched, one per UID bit plus the branch being searched
+#define RDM_DISCOVERY_DEPTH 50
+/// @brief Requests waiting to be sent
+#define RDM_QUEUE_SIZE 16
+/// @brief Polls a device can miss before it is reported offline
+#define RDM_MAX_MISSED_POLLS 3
+
+enum RDMCommandClass : uint8_t
+{
+    RDM_DISCOVERY_COMMAND = 0x10,
+    RDM_DISCOVERY_COMMAND_RESPONSE = 0x11,
+    RDM_GET_COMMAND = 0x20,
+    RDM_GET_COMMAND_RESPONSE = 0x21,
+    RDM_SET_COMMAND = 0x30,
+    RDM_SET_COMMAND_RESPONSE = 0x31,
+};
+
+enum RDMParameter : uint16_t
+{
+    RDM_PID_DISC_UNIQUE_BRANCH = 0x0001,
+    RDM_PID_DISC_MUTE = 0x0002,
+    RDM_PID_DISC_UN_MUTE = 0x0003,
+    RDM_PID_DEVICE_INFO = 0x0060,
+    RDM_PID_DMX_START_ADDRESS = 0x00F0,
+};
+
+enum RDMResponseType : uint8_t
+{
+    RDM_RESPONSE_ACK = 0x00,
+    RDM_RESPONSE_ACK_TIMER = 0x01,
+    RDM_RESPONSE_NACK_REASON = 0x02,
+    RDM_RESPONSE_ACK_OVERFLOW = 0x03,
+};
+
+/// @brief 48 bit RDM UID, manufacturer ID in the upper 16 bits
+typedef uint64_t RDMUid;
+
+/// @brief A parsed RDM packet. Data points into the buffer that was parsed.
+struct RDMPacket
+{
+    RDMUid destination;
+    RDMUid source;
+    uint8_t transaction;
+    /// @brief Port ID in requests, RDMResponseType in responses
+    uint8_t portOrResponseType;
+    uint8_t commandClass;
+    uint16_t parameter;
+    uint8_t dataLength;
+    const uint8_t *data;
+};
+
+/// @brief Build an RDM packet with its checksum
+/// @param buffer At least RDM_HEADER_SIZE + dataLength + 2 bytes
+/// @param portOrResponseType The port ID (1) for requests, a RDMResponseType for responses
+/// @return The length of the packet, 0 if the data is too long
+size_t rdmBuildPacket(uint8_t *buffer, RDMUid destination, RDMUid source, uint8_t transaction, uint8_t portOrResponseType,
+                      uint8_t commandClass, uint16_t parameter, const uint8_t *data, uint8_t dataLength);
+/// @brief Parse and check an RDM packet
+/// @return False if the packet is incomplete or its checksum does not match
+bool rdmParsePacket(const uint8_t *buffer, size_t length, RDMPacket &packet);
+/// @brief Build the response to DISC_UNIQUE_BRANCH, which has no break and no header so that collisions can be detected
+/// @param buffer At least RDM_DISCOVERY_RESPONSE_SIZE bytes
+/// @return RDM_DISCOVERY_RESPONSE_SIZE
+size_t rdmEncodeDiscoveryResponse(uint8_t *buffer, RDMUid uid);
+/// @brief Decode the response to DISC_UNIQUE_BRANCH
+/// @return False if there was no valid response, which means more than one device answered
+bool rdmDecodeDiscoveryResponse(const uint8_t *buffer, size_t length, RDMUid &uid);
+/// @brief Format a UID as "mmmm:dddddddd"
+void rdmFormatUid(RDMUid uid, char *buffer, size_t size);
+/// @brief Parse a UID in the "mmmm:dddddddd" format
+bool rdmParseUid(const char *text, RDMUid &uid);
+
+/// @brief Sends an RDM request on the line and receives the response. Implemented by the output the devices are connected to.
+class RDMTransport
+{
+public:
+    /// @brief Send a request and wait for the response
+    /// @param request The packet to send, without break
+    /// @param response Where to store the response
+    /// @param size The size of response
+    /// @return The number of bytes received, 0 if nothing was received
+    virtual size_t transact(const uint8_t *request, size_t length, uint8_t *response, size_t size) = 0;
+};
+
+struct RDMDevice
+{
+    RDMUid uid;
+    uint16_t model = 0;
+    uint16_t footprint = 0;
+    /// @brief DMX start address, 0 until it is known
+    uint16_t startAddress = 0;
+    /// @brief Polls in a row without response
+    uint8_t missedPolls = 0;
+};
+
+/// @brief Finds devices with the binary search of E1.20 and polls their DMX start address.
+/// Does one transaction per step() so that RDM can be interleaved with DMX frames.
+/// Has no hardware dependencies so that it can be tested on the host.
+class RDMController
+{
+public:
+    /// @param uid The UID of the controller
+    void init(RDMUid uid);
+    /// @brief Un-mute all devices and search the whole UID range. Devices found before are kept.
+    void startDiscovery();
+    /// @brief Request the DMX start address of all known devices, one per step
+    void poll();
+    /// @brief Queue setting the DMX start address of a device
+    /// @return False if the queue is full
+    bool setStartAddress(RDMUid uid, uint16_t address);
+    /// @brief Wether discovery is running or requests are queued
+    bool isBusy();
+    bool isDiscovering();
+    /// @brief Do the next transaction, if any
+    /// @return True if a request was sent
+    bool step(RDMTransport &transport);
+    /// @brief Incremented whenever a device is added or its info changes
+    uint32_t getGeneration();
+
+    RDMDevice devices[RDM_MAX_DEVICES];
+    uint8_t deviceCount = 0;
+
+private:
+    struct Branch
+    {
+        RDMUid lower;
+        RDMUid upper;
+    };
+    struct Request
+    {
+        RDMUid uid;
+        uint8_t commandClass;
+        uint16_t parameter;
+        uint16_t value;
+    };
+    /// @brief Send a request and parse the response into _response
+    /// @return True if a valid response from uid to this request was received
+    bool _transact(RDMTransport &transport, RDMUid uid, uint8_t commandClass, uint16_t parameter, const uint8_t *data, uint8_t dataLength);
+    void _stepDiscovery(RDMTransport &transport);
+    void _stepRequest(RDMTransport &transport, const Request &request);
+    bool _queue(RDMUid uid, uint8_t commandClass, uint16_t parameter, uint16_t value = 0);
+    RDMDevice *_findDevice(RDMUid uid);
+    RDMUid _uid = 0;
+    uint8_t _transaction = 0;
+    bool _unMutePending = false;
+    Branch _branches[RDM_DISCOVERY_DEPTH];
+    uint8_t _branchCount = 0;
+    /// @brief A device that answered discovery alone and is muted next, 0 if none
+    RDMUid _muteUid = 0;
+    /// @brief Times a branch returned a device that could not be muted
+    uint8_t _muteFailures = 0;
+    Request _queueItems[RDM_QUEUE_SIZE];
+    uint8_t _queueHead = 0;
+    uint8_t _queueCount = 0;
+    /// @brief Devices still to be polled and the next one
+    uint8_t _pollRemaining = 0;
+    uint8_t _pollIndex = 0;
+    uint32_t _generation = 0;
+    uint8_t _packet[RDM_MAX_PACKET_SIZE];
+    uint8_t _responseBuffer[RDM_MAX_PACKET_SIZE];
+    RDMPacket _response;
+};
+
+#endif
@@ -0,0 +1,213 @@
+#include <RDMManager.h>
+#include <LMANConfig.h>
+#include <LMANLog.h>
+
+RDMManager *RDMManager::instance;
+
+void RDMManager::init(DMXOutput *output, uint8_t universe)
+{
+    RDMManager::instance = this;
+    this->_output = output;
+    this->_universe = universe;
+    // The device part of the UID is the last four bytes of the MAC address: the three NIC specific bytes and the
+    // last byte of the OUI, in the order the MAC is written. getEfuseMac() holds the first byte in its low byte.
+    uint64_t mac = ESP.getEfuseMac();
+    uint32_t deviceId = 0;
+    for (uint8_t i = 2; i < 6; i++)
+    {
+        deviceId = (deviceId << 8) | (uint8_t)(mac >> (8 * i));
+    }
+    RDMUid uid = ((RDMUid)RDM_MANUFACTURER_ID << 32) | deviceId;
+    this->_controller.init(uid);
+    char uidText[16];
+    rdmFormatUid(uid, uidText, sizeof(uidText));
+    LOG_INFO("RDM controller ", LOG_BOLD, uidText, LOG_RESET_DECORATIONS, " on DMX output ", LOG_BOLD, universe);
+    this->startDiscovery();
+}
+
+uint8_t RDMManager::getUniverse()
+{
+    return this->_universe;
+}
+
+bool RDMManager::isBusy()
+{
+    return this->_discoveryRequested || this->_setRequested || this->_controller.isBusy();
+}
+
+void RDMManager::afterFrame()
+{
+    if (this->_output == NULL)
+    {
+        return;
+    }
+    // The transaction delays the next frame, skip it if that would break the minimum frame rate
+    uint8_t minFrameRate = LMANConfig::instance->dmx_min_frame_rate > 0 ? LMANConfig::instance->dmx_min_frame_rate : 1;
+    if (this->_output->getFrameTime() + RDM_TRANSACTION_TIME > 1000000UL / minFrameRate)
+    {
+        return;
+    }
+
+    if (this->_discoveryRequested)
+    {
+        this->_discoveryRequested = false;
+        this->_controller.startDiscovery();
+        LOG_INFO("RDM discovery started.");
+    }
+    if (this->_setRequested)
+    {
+        portENTER_CRITICAL(&this->_mux);
+        RDMUid uid = this->_setUid;
+        uint16_t address = this->_setAddress;
+        this->_setRequested = false;
+        portEXIT_CRITICAL(&this->_mux);
+        this->_controller.setStartAddress(uid, address);
+    }
+    if (!this->_controller.isBusy() && millis() - this->_lastPoll >= RDM_POLL_INTERVAL)
+    {
+        this->_lastPoll = millis();
+        this->_controller.poll();
+    }
+
+    bool wasDiscovering = this->_controller.isDiscovering();
+    if (!this->_controller.step(*this->_output))
+    {
+        return;
+    }
+    this->_transactions++;
+    if (wasDiscovering && !this->_controller.isDiscovering())
+    {
+        LOG_INFO("RDM discovery done, ", LOG_BOLD, this->_controller.deviceCount, LOG_RESET_DECORATIONS, " devices.");
+    }
+
+    uint32_t generation = this->_controller.getGeneration();
+    portENTER_CRITICAL(&this->_mux);
+    this->_discovering = this->_controller.isDiscovering();
+    if (generation != this->_generation)
+    {
+        this->_generation = generation;
+        this->_deviceCount = this->_controller.deviceCount;
+        memcpy(this->_devices, this->_controller.devices, sizeof(RDMDevice) * this->_deviceCount);
+    }
+    portEXIT_CRITICAL(&this->_mux);
+}
+
+void RDMManager::startDiscovery()
+{
+    this->_discoveryRequested = true;
+}
+
+bool RDMManager::setStartAddress(RDMUid uid, uint16_t address)
+{
+    bool accepted = false;
+    portENTER_CRITICAL(&this->_mux);
+    if (!this->_setRequested)
+    {
+        this->_setUid = uid;
+        this->_setAddress = address;
+        this->_setRequested = true;
+        accepted = true;
+    }
+    portEXIT_CRITICAL(&this->_mux);
+    return accepted;
+}
+
+bool RDMManager::hasChannelChanges()
+{
+    return this->_generation != this->_appliedGeneration;
+}
+
+bool RDMManager::updateChannelTable()
+{
+    RDMDevice devices[RDM_MAX_DEVICES];
+    portENTER_CRITICAL(&this->_mux);
+    uint8_t deviceCount = this->_deviceCount;
+    memcpy(devices, this->_devices, sizeof(RDMDevice) * deviceCount);
+    this->_appliedGeneration = this->_generation;
+    portEXIT_CRITICAL(&this->_mux);
+
+    bool changed = false;
+    for (uint8_t i = 0; i < deviceCount; i++)
+    {
+        RDMDevice &device = devices[i];
+        // ChannelConfig::channel is 8 bit
+        if (device.startAddress == 0 || device.startAddress > 255 || device.missedPolls >= RDM_MAX_MISSED_POLLS)
+        {
+            continue;
+        }
+        char uidText[16];
+        rdmFormatUid(device.uid, uidText, sizeof(uidText));
+        std::string name = RDM_CHANNEL_NAME_PREFIX;
+        name.append(uidText);
+        // The colon is not allowed in Home Assistant object IDs
+        name[name.find(':')] = '_';
+
+        ChannelConfig *own = NULL;
+        ChannelConfig *taken = NULL;
+        ChannelConfig *unused = NULL;
+        for (ChannelConfig &channel : LMANConfig::instance->channelConfigs)
+        {
+            if (channel.name == name)
+            {
+                own = &channel;
+            }
+            else if (channel.enabled && channel.channel == device.startAddress && channel.universe == this->_universe)
+            {
+                taken = &channel;
+            }
+            else if (!channel.enabled && unused == NULL)
+            {
+                unused = &channel;
+            }
+        }
+        if (taken != NULL)
+        {
+            continue;
+        }
+        if (own != NULL)
+        {
+            if (own->channel != device.startAddress || own->universe != this->_universe)
+            {
+                LOG_INFO("RDM device ", LOG_BOLD, uidText, LOG_RESET_DECORATIONS, " moved to slot ", LOG_BOLD, device.startAddress);
+                own->channel = device.startAddress;
+                own->universe = this->_universe;
+                changed = true;
+            }
+            continue;
+        }
+        if (unused == NULL)
+        {
+            LOG_WARNING("No free channel for RDM device ", LOG_BOLD, uidText);
+            continue;
+        }
+        LOG_INFO("Adding channel for RDM device ", LOG_BOLD, uidText, LOG_RESET_DECORATIONS, " on slot ", LOG_BOLD, device.startAddress);
+        unused->name = name;
+        unused->channel = device.startAddress;
+        unused->universe = this->_universe;
+        unused->enabled = true;
+        changed = true;
+    }
+    return changed;
+}
+
+void RDMManager::printStatusJson(Print &out)
+{
+    RDMDevice devices[RDM_MAX_DEVICES];
+    portENTER_CRITICAL(&this->_mux);
+    uint8_t deviceCount = this->_deviceCount;
+    bool discovering = this->_discovering || this->_discoveryRequested;
+    memcpy(devices, this->_devices, sizeof(RDMDevice) * deviceCount);
+    portEXIT_CRITICAL(&this->_mux);
+
+    out.printf("{\"supported\":true,\"universe\":%u,\"discovering\":%s,\"transactions\":%u,\"devices\":[",
+               this->_universe, discovering ? "true" : "false", (unsigned)this->_transactions);
+    for (uint8_t i = 0; i < deviceCount; i++)
+    {
+        char uidText[16];
+        rdmFormatUid(devices[i].uid, uidText, sizeof(uidText));
+        out.printf("%s{\"uid\":\"%s\",\"model\":%u,\"footprint\":%u,\"start_address\":%u,\"online\":%s}",
+                   i > 0 ? "," : "", uidText, devices[i].model, devices[i].footprint, devices[i].startAddress,
+                   devices[i].missedPolls < RDM_MAX_MISSED_POLLS ? "true" : "false");
+    }
+    out.print("]}");
+}
@@ -0,0 +1,66 @@
+#ifndef LMAN_RDM_MANAGER
+#define LMAN_RDM_MANAGER
+
+#include <Arduino.h>
+#include <DMXOutput.h>
+#include <RDM.h>
+
+/// @brief Time in ms between polls of the start addresses of the known devices
+#define RDM_POLL_INTERVAL 10000
+/// @brief Longest time in us one RDM transaction keeps the line from DMX: the request, the response time and the break after it
+#define RDM_TRANSACTION_TIME 4000
+/// @brief Prefix of the names of channels created for RDM devices, followed by the UID
+#define RDM_CHANNEL_NAME_PREFIX "rdm_"
+
+/// @brief Runs RDM on one DMX output between its frames and keeps a channel for each device in the channel table.
+/// Discovery and polling are done by the output's send task, the channel table is updated from the main loop.
+class RDMManager
+{
+public:
+    static RDMManager *instance;
+    /// @brief Start discovery on an output
+    /// @param output The output, RDM must be set up on it with DMXOutput::initRdm()
+    /// @param universe The universe of the output
+    void init(DMXOutput *output, uint8_t universe);
+    /// @brief The universe RDM runs on, 0 if RDM is not set up
+    uint8_t getUniverse();
+    /// @brief Wether there is RDM work waiting, so that the send task should not wait for the keepalive time
+    bool isBusy();
+    /// @brief Called by the send task after each frame. Does at most one transaction, and only if the
+    /// frame rate stays above LMANConfig::dmx_min_frame_rate.
+    void afterFrame();
+    /// @brief Search for new devices. Can be called from any task.
+    void startDiscovery();
+    /// @brief Set the DMX start address of a device. Can be called from any task.
+    /// @return False if a previous request is still waiting
+    bool setStartAddress(RDMUid uid, uint16_t address);
+    /// @brief Wether devices were found or changed since the last updateChannelTable()
+    bool hasChannelChanges();
+    /// @brief Create or move the channel of each online device. Devices above slot 255 or on a slot already
+    /// used by a configured channel are left out. Does not save the config.
+    /// @return True if the channel table changed
+    bool updateChannelTable();
+    /// @brief Write the discovered devices as JSON
+    void printStatusJson(Print &out);
+
+private:
+    DMXOutput *_output = NULL;
+    uint8_t _universe = 0;
+    RDMController _controller;
+    /// @brief Copy of the controller's devices for the other tasks, guarded by _mux
+    RDMDevice _devices[RDM_MAX_DEVICES];
+    uint8_t _deviceCount = 0;
+    uint32_t _generation = 0;
+    uint32_t _appliedGeneration = 0;
+    bool _discovering = false;
+    uint32_t _transactions = 0;
+    /// @brief Requests from other tasks, taken by afterFrame()
+    volatile bool _discoveryRequested = false;
+    volatile bool _setRequested = false;
+    RDMUid _setUid = 0;
+    uint16_t _setAddress = 0;
+    unsigned long _lastPoll = 0;
+    portMUX_TYPE _mux = portMUX_INITIALIZER_UNLOCKED;
+};
+
+#endif
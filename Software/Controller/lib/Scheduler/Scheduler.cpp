@@ -0,0 +1,367 @@
+#include <Scheduler.h>
+#include <LightManager.h>
+#include <LMANTasks.h>
+#include <LMANLog.h>
+#include <esp_sntp.h>
+#include <sys/time.h>
+
+// Make space for variables in memory
+Scheduler *Scheduler::instance = nullptr;
+
+/// @brief The NTP server in use. lwIP keeps the pointer, so it must stay valid while the config is edited.
+static char _ntpServer[64] = "";
+
+/// @brief Days since 1970-01-01 of a date, to find midnight UTC of a local day without timegm()
+static int32_t daysFromCivil(int32_t year, uint32_t month, uint32_t day)
+{
+    year -= month <= 2;
+    int32_t era = (year >= 0 ? year : year - 399) / 400;
+    uint32_t yearOfEra = year - era * 400;
+    uint32_t dayOfYear = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+    uint32_t dayOfEra = yearOfEra * 365 + yearOfEra / 4 - yearOfEra / 100 + dayOfYear;
+    return era * 146097 + (int32_t)dayOfEra - 719468;
+}
+
+void Scheduler::init()
+{
+    Scheduler::instance = this;
+    setenv("TZ", LMANConfig::instance->time_zone.c_str(), 1);
+    tzset();
+    createTask(TASK_SCHEDULER, Scheduler::_taskScheduler, &this->_taskHandle);
+}
+
+void Scheduler::startTimeSync()
+{
+    if (this->_timeSyncStarted)
+    {
+        return; // SNTP keeps running while the WiFi reconnects
+    }
+    if (LMANConfig::instance->ntp_server.empty())
+    {
+        LOG_WARNING("No NTP server set, schedules only run if the clock was kept over the restart.");
+        return;
+    }
+    strncpy(_ntpServer, LMANConfig::instance->ntp_server.c_str(), sizeof(_ntpServer) - 1);
+    sntp_set_time_sync_notification_cb(Scheduler::_onTimeSync);
+    configTzTime(LMANConfig::instance->time_zone.c_str(), _ntpServer);
+    this->_timeSyncStarted = true;
+    LOG_INFO("Taking the time from ", LOG_BOLD, _ntpServer);
+}
+
+void Scheduler::applyConfig()
+{
+    setenv("TZ", LMANConfig::instance->time_zone.c_str(), 1);
+    tzset();
+    if (this->_timeSyncStarted && LMANConfig::instance->ntp_server != _ntpServer)
+    {
+        this->_timeSyncStarted = false;
+        this->startTimeSync();
+    }
+    this->_rebuildRequested = true;
+    if (this->_taskHandle)
+    {
+        xTaskNotifyGive(this->_taskHandle);
+    }
+}
+
+bool Scheduler::isTimeValid()
+{
+    return time(nullptr) >= SCHEDULER_MIN_VALID_TIME;
+}
+
+void Scheduler::_onTimeSync(struct timeval *tv)
+{
+    Scheduler *scheduler = Scheduler::instance;
+    scheduler->_lastSync = tv->tv_sec;
+    scheduler->_syncs++;
+    // The clock may have been stepped, the fire times are calculated again
+    scheduler->_rebuildRequested = true;
+    xTaskNotifyGive(scheduler->_taskHandle);
+}
+
+void Scheduler::_taskScheduler(void *param)
+{
+    LOG_INFO("Started _taskScheduler");
+    Scheduler *scheduler = Scheduler::instance;
+
+    for (;;)
+    {
+        uint32_t sleep = SCHEDULER_MAX_SLEEP;
+        struct timeval now;
+        gettimeofday(&now, nullptr);
+        if (now.tv_sec >= SCHEDULER_MIN_VALID_TIME)
+        {
+            // Between syncs the clock runs on the crystal like millis(). If the two part, it was stepped.
+            long clockDelta = (long)(now.tv_sec - scheduler->_clockReference) - (long)((millis() - scheduler->_millisReference) / 1000);
+            if (scheduler->_rebuildRequested || clockDelta > SCHEDULER_CLOCK_TOLERANCE || clockDelta < -SCHEDULER_CLOCK_TOLERANCE)
+            {
+                scheduler->_rebuildRequested = false;
+                scheduler->_rebuild(now.tv_sec, !scheduler->_caughtUp);
+                scheduler->_caughtUp = true;
+            }
+
+            while (scheduler->_heapSize > 0 && scheduler->_heap[0].time <= now.tv_sec)
+            {
+                ScheduleEvent event = scheduler->_pop();
+                scheduler->_fire(event.schedule, event.time, now.tv_sec);
+                if (scheduler->_nextFireTime(event.schedule, event.time, event.time))
+                {
+                    scheduler->_push(event);
+                }
+            }
+
+            if (scheduler->_heapSize > 0)
+            {
+                int64_t untilNext = (int64_t)(scheduler->_heap[0].time - now.tv_sec) * 1000 - now.tv_usec / 1000;
+                if (untilNext < sleep)
+                {
+                    sleep = untilNext > 0 ? untilNext : 0;
+                }
+            }
+        }
+        // Nothing runs between events. Config changes and time syncs wake the task early.
+        ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(sleep) + 1);
+    }
+}
+
+void Scheduler::_buildSunTable()
+{
+    float latitude = LMANConfig::instance->latitude / 100.0f * DEG_TO_RAD;
+    float longitude = LMANConfig::instance->longitude / 100.0f;
+    // The sun is up while its center is less than 0.833 degrees below the horizon: refraction plus its radius
+    float cosZenith = cosf(90.833f * DEG_TO_RAD);
+    for (uint16_t day = 0; day < 366; day++)
+    {
+        // NOAA's approximation of the equation of time (in minutes) and the declination, at noon
+        float gamma = 2 * PI / 365 * day;
+        float equationOfTime = 229.18f * (0.000075f + 0.001868f * cosf(gamma) - 0.032077f * sinf(gamma) - 0.014615f * cosf(2 * gamma) - 0.040849f * sinf(2 * gamma));
+        float declination = 0.006918f - 0.399912f * cosf(gamma) + 0.070257f * sinf(gamma) - 0.006758f * cosf(2 * gamma) + 0.000907f * sinf(2 * gamma) -
+                            0.002697f * cosf(3 * gamma) + 0.00148f * sinf(3 * gamma);
+        float cosHourAngle = cosZenith / (cosf(latitude) * cosf(declination)) - tanf(latitude) * tanf(declination);
+        if (cosHourAngle > 1 || cosHourAngle < -1)
+        {
+            // Polar night or midnight sun
+            this->_sunrise[day] = SUN_NONE;
+            this->_sunset[day] = SUN_NONE;
+            continue;
+        }
+        float hourAngle = acosf(cosHourAngle) * RAD_TO_DEG;
+        // Not wrapped to 0-1439, far from the prime meridian sunrise can be on the UTC day before
+        this->_sunrise[day] = lroundf(720 - 4 * (longitude + hourAngle) - equationOfTime);
+        this->_sunset[day] = lroundf(720 - 4 * (longitude - hourAngle) - equationOfTime);
+    }
+    this->_sunLatitude = LMANConfig::instance->latitude;
+    this->_sunLongitude = LMANConfig::instance->longitude;
+    this->_sunTableBuilt = true;
+    LOG_INFO("Calculated sunrise and sunset for ", LMANConfig::instance->latitude / 100.0f, ", ", LMANConfig::instance->longitude / 100.0f);
+}
+
+void Scheduler::_rebuild(time_t now, bool catchUp)
+{
+    if (!this->_sunTableBuilt || this->_sunLatitude != LMANConfig::instance->latitude || this->_sunLongitude != LMANConfig::instance->longitude)
+    {
+        this->_buildSunTable();
+    }
+    this->_clockReference = now;
+    this->_millisReference = millis();
+    this->_heapSize = 0;
+
+    struct tm today;
+    localtime_r(&now, &today);
+    today.tm_hour = 12;
+    today.tm_min = 0;
+    today.tm_sec = 0;
+    today.tm_isdst = -1;
+    mktime(&today);
+    for (uint8_t i = 0; i < SCHEDULER_COUNT; i++)
+    {
+        const ScheduleConfig &config = LMANConfig::instance->scheduleConfigs[i];
+        if (!config.enabled || config.channels == 0)
+        {
+            continue;
+        }
+        ScheduleEvent event;
+        event.schedule = i;
+        // After a restart a wake-up ramp that should be running picks up where it would be
+        if (catchUp && this->_fireTimeOnDay(config, today, event.time) && event.time <= now && now < event.time + config.fadeTime)
+        {
+            this->_push(event);
+        }
+        else if (this->_nextFireTime(i, now, event.time))
+        {
+            this->_push(event);
+        }
+    }
+
+    if (this->_heapSize > 0)
+    {
+        struct tm next;
+        localtime_r(&this->_heap[0].time, &next);
+        char time[20];
+        strftime(time, sizeof(time), "%Y-%m-%d %H:%M", &next);
+        LOG_INFO(this->_heapSize, " schedules waiting, next is ", LOG_BOLD, LMANConfig::instance->scheduleConfigs[this->_heap[0].schedule].name.c_str(), LOG_RESET_DECORATIONS, " at ", time);
+    }
+}
+
+bool Scheduler::_nextFireTime(uint8_t schedule, time_t after, time_t &fireAt)
+{
+    const ScheduleConfig &config = LMANConfig::instance->scheduleConfigs[schedule];
+    struct tm start;
+    localtime_r(&after, &start);
+    for (uint16_t offset = 0; offset <= SCHEDULER_SEARCH_DAYS; offset++)
+    {
+        // Noon is never skipped or repeated by a DST change, mktime() normalizes the day
+        struct tm day = start;
+        day.tm_mday += offset;
+        day.tm_hour = 12;
+        day.tm_min = 0;
+        day.tm_sec = 0;
+        day.tm_isdst = -1;
+        mktime(&day);
+        if (this->_fireTimeOnDay(config, day, fireAt) && fireAt > after)
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool Scheduler::_fireTimeOnDay(const ScheduleConfig &config, const struct tm &day, time_t &fireAt)
+{
+    if (!(config.days & (1 << day.tm_wday)))
+    {
+        return false;
+    }
+    if (config.trigger == SCHEDULE_TRIGGER_TIME)
+    {
+        struct tm fire = day;
+        fire.tm_hour = 0;
+        fire.tm_min = config.time;
+        fire.tm_sec = 0;
+        fire.tm_isdst = -1;
+        fireAt = mktime(&fire);
+        return true;
+    }
+    int16_t minutes = config.trigger == SCHEDULE_TRIGGER_SUNRISE ? this->_sunrise[day.tm_yday] : this->_sunset[day.tm_yday];
+    if (minutes == SUN_NONE)
+    {
+        return false;
+    }
+    fireAt = (time_t)daysFromCivil(day.tm_year + 1900, day.tm_mon + 1, day.tm_mday) * 86400 + (minutes + config.offset) * 60;
+    return true;
+}
+
+void Scheduler::_fire(uint8_t schedule, time_t fireAt, time_t now)
+{
+    const ScheduleConfig &config = LMANConfig::instance->scheduleConfigs[schedule];
+    uint32_t fadeTime = config.fadeTime * 1000UL;
+    uint32_t late = (now - fireAt) * 1000UL;
+    fadeTime = late < fadeTime ? fadeTime - late : 0;
+
+    ChannelFade fades[sizeof(LMANConfig::channelConfigs) / sizeof(ChannelConfig)];
+    uint8_t count = 0;
+    for (uint8_t c = 0; c < sizeof(fades) / sizeof(ChannelFade); c++)
+    {
+        DMXChannel *channel = LightManager::instance->getChannel(c);
+        if (channel && (config.channels & (1 << c)))
+        {
+            fades[count].channel = channel;
+            fades[count].state = config.level != 0;
+            fades[count].level = config.level * LEVEL_SCALE;
+            fades[count].fadeTime = fadeTime;
+            count++;
+        }
+    }
+    LOG_INFO("Running schedule ", LOG_BOLD, config.name.c_str(), LOG_RESET_DECORATIONS, ", fading ", count, " channels to ", config.level, " in ", fadeTime / 1000, " s");
+    LightManager::instance->fadeChannels(fades, count);
+    this->_fired++;
+}
+
+void Scheduler::_push(const ScheduleEvent &event)
+{
+    if (this->_heapSize >= SCHEDULER_COUNT)
+    {
+        return;
+    }
+    // Move parents that fire later down until the event's place is found
+    uint8_t i = this->_heapSize++;
+    while (i > 0 && this->_heap[(i - 1) / 2].time > event.time)
+    {
+        this->_heap[i] = this->_heap[(i - 1) / 2];
+        i = (i - 1) / 2;
+    }
+    this->_heap[i] = event;
+}
+
+ScheduleEvent Scheduler::_pop()
+{
+    ScheduleEvent first = this->_heap[0];
+    ScheduleEvent last = this->_heap[--this->_heapSize];
+    // Move the earlier child up until the place of the last event is found
+    uint8_t i = 0;
+    for (;;)
+    {
+        uint8_t child = 2 * i + 1;
+        if (child >= this->_heapSize)
+        {
+            break;
+        }
+        if (child + 1 < this->_heapSize && this->_heap[child + 1].time < this->_heap[child].time)
+        {
+            child++;
+        }
+        if (this->_heap[child].time >= last.time)
+        {
+            break;
+        }
+        this->_heap[i] = this->_heap[child];
+        i = child;
+    }
+    this->_heap[i] = last;
+    return first;
+}
+
+size_t Scheduler::getStatusJson(char *buffer, size_t size)
+{
+    time_t now = time(nullptr);
+    struct tm local;
+    localtime_r(&now, &local);
+    char localTime[20];
+    strftime(localTime, sizeof(localTime), "%Y-%m-%d %H:%M:%S", &local);
+
+    // Today's sun times in local time
+    char sunrise[6] = "";
+    char sunset[6] = "";
+    if (this->_sunTableBuilt)
+    {
+        time_t midnight = (time_t)daysFromCivil(local.tm_year + 1900, local.tm_mon + 1, local.tm_mday) * 86400;
+        struct tm sun;
+        if (this->_sunrise[local.tm_yday] != SUN_NONE)
+        {
+            time_t time = midnight + this->_sunrise[local.tm_yday] * 60;
+            localtime_r(&time, &sun);
+            strftime(sunrise, sizeof(sunrise), "%H:%M", &sun);
+        }
+        if (this->_sunset[local.tm_yday] != SUN_NONE)
+        {
+            time_t time = midnight + this->_sunset[local.tm_yday] * 60;
+            localtime_r(&time, &sun);
+            strftime(sunset, sizeof(sunset), "%H:%M", &sun);
+        }
+    }
+
+    uint8_t heapSize = this->_heapSize;
+    ScheduleEvent next = this->_heap[0];
+    return snprintf(buffer, size, "{\"time_valid\":%s,\"time\":%lld,\"local_time\":\"%s\",\"syncs\":%u,\"last_sync\":%lld,\"sunrise\":\"%s\",\"sunset\":\"%s\",\"waiting\":%u,\"next_schedule\":%d,\"next_time\":%lld,\"fired\":%u}",
+                    now >= SCHEDULER_MIN_VALID_TIME ? "true" : "false",
+                    (long long)now,
+                    localTime,
+                    (unsigned int)this->_syncs,
+                    (long long)this->_lastSync,
+                    sunrise,
+                    sunset,
+                    (unsigned int)heapSize,
+                    heapSize > 0 ? next.schedule + 1 : 0,
+                    heapSize > 0 ? (long long)next.time : 0LL,
+                    (unsigned int)this->_fired);
+}
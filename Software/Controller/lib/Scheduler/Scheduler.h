@@ -0,0 +1,99 @@
+#ifndef LMAN_SCHEDULER
+#define LMAN_SCHEDULER
+
+#include <Arduino.h>
+#include <LMANConfig.h>
+#include <time.h>
+
+/// @brief The number of schedules
+#define SCHEDULER_COUNT (sizeof(LMANConfig::scheduleConfigs) / sizeof(ScheduleConfig))
+/// @brief Times before this (2024-01-01) mean the clock was not set yet
+#define SCHEDULER_MIN_VALID_TIME 1704067200
+/// @brief Longest time in ms the scheduler sleeps, also without events, to notice a clock that was stepped without a sync
+#define SCHEDULER_MAX_SLEEP 3600000
+/// @brief Seconds the clock may move against millis() before the fire times are calculated again
+#define SCHEDULER_CLOCK_TOLERANCE 2
+/// @brief Days to search ahead for the next fire time, covers a year without sunrise near the poles
+#define SCHEDULER_SEARCH_DAYS 366
+/// @brief Marks a day of the sun table on which the sun does not rise or set
+#define SUN_NONE INT16_MIN
+
+/// @brief The next time a schedule fires, an entry of the scheduler's min-heap
+struct ScheduleEvent
+{
+    time_t time;
+    uint8_t schedule;
+};
+
+/// @brief Runs the schedules of LMANConfig::scheduleConfigs on the device, without MQTT or Home Assistant.
+/// The time is taken from NTP while the network is up and kept by the system clock in between.
+/// The next fire time of each schedule is kept in a min-heap, the task sleeps until the earliest one.
+/// Sunrise and sunset are read from a table calculated once per location.
+class Scheduler
+{
+public:
+    /// @brief Set the time zone and start the scheduler task. The sun table is calculated by the task.
+    void init();
+    /// @brief Start taking the time from the NTP server. Called when the WiFi is connected.
+    void startTimeSync();
+    /// @brief Apply a changed time zone, NTP server, location or schedule
+    void applyConfig();
+    /// @brief The instance of the scheduler started with .init();
+    static Scheduler *instance;
+    /// @brief Wether the clock is set
+    bool isTimeValid();
+    /// @brief Describe the clock, the sun times of today and the next events as JSON
+    /// @param buffer The buffer to write to
+    /// @param size The size of the buffer
+    /// @return The length of the written JSON
+    size_t getStatusJson(char *buffer, size_t size);
+
+private:
+    static void _taskScheduler(void *param);
+    /// @brief Called by SNTP after the clock was set
+    static void _onTimeSync(struct timeval *tv);
+    /// @brief Calculate sunrise and sunset of every day of the year for the configured location
+    void _buildSunTable();
+    /// @brief Calculate the next fire time of all enabled schedules
+    /// @param catchUp Wether schedules whose fade would still be running now fire straight away, after the clock was set at boot
+    void _rebuild(time_t now, bool catchUp);
+    /// @brief Find the first time a schedule fires after a point in time
+    /// @param schedule The index in LMANConfig::scheduleConfigs
+    /// @param after The time to search from
+    /// @param fireAt Set to the fire time
+    /// @return False if the schedule does not fire within SCHEDULER_SEARCH_DAYS
+    bool _nextFireTime(uint8_t schedule, time_t after, time_t &fireAt);
+    /// @brief The time a schedule fires on a day
+    /// @param day Noon of the local day, normalized by mktime()
+    /// @return False if the schedule does not fire on that weekday or the sun does not rise or set on that day
+    bool _fireTimeOnDay(const ScheduleConfig &config, const struct tm &day, time_t &fireAt);
+    /// @brief Fade the channels of a schedule, for the rest of the fade time if it fired late
+    void _fire(uint8_t schedule, time_t fireAt, time_t now);
+    void _push(const ScheduleEvent &event);
+    ScheduleEvent _pop();
+    /// @brief Min-heap of the next fire times, the earliest at index 0
+    ScheduleEvent _heap[SCHEDULER_COUNT];
+    uint8_t _heapSize = 0;
+    /// @brief Sunrise and sunset by day of the year (0-365) in minutes after midnight UTC, SUN_NONE if there is none
+    int16_t _sunrise[366];
+    int16_t _sunset[366];
+    /// @brief The location _sunrise and _sunset were calculated for
+    int16_t _sunLatitude = 0;
+    int16_t _sunLongitude = 0;
+    bool _sunTableBuilt = false;
+    TaskHandle_t _taskHandle = NULL;
+    /// @brief Set by applyConfig() and time syncs, the task calculates all fire times again
+    volatile bool _rebuildRequested = true;
+    bool _timeSyncStarted = false;
+    bool _caughtUp = false;
+    /// @brief time() and millis() when the fire times were calculated, to notice when the clock is stepped
+    time_t _clockReference = 0;
+    unsigned long _millisReference = 0;
+    volatile time_t _lastSync = 0;
+    volatile uint32_t _syncs = 0;
+    uint32_t _fired = 0;
+    /// @brief The host tests reach the heap, the sun table and the fire time search
+    friend struct SchedulerTest;
+};
+
+#endif
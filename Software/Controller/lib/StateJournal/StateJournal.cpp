@@ -0,0 +1,215 @@
+#include <StateJournal.h>
+#include <LightManager.h>
+#include <LittleFS.h>
+#include <LMANLog.h>
+#include <FS.h>
+#include <rom/crc.h>
+
+StateJournal *StateJournal::instance = nullptr;
+
+bool StateJournal::restore()
+{
+    StateJournal::instance = this;
+    this->_snapshot(this->_snapshotData);
+    memcpy(this->_writtenData, this->_snapshotData, sizeof(this->_writtenData));
+    this->_lastChange = millis();
+
+    File file = LittleFS.open(STATE_JOURNAL_FILE);
+    if (!file)
+    {
+        LOG_INFO("No channel state saved, all channels start off.");
+        return false;
+    }
+    this->_fileSize = file.size();
+    // Records are appended, the last valid one is the latest state. A record cut short by a power loss is skipped.
+    uint8_t record[STATE_JOURNAL_RECORD_SIZE];
+    bool found = false;
+    while (file.read(record, sizeof(record)) == sizeof(record))
+    {
+        uint32_t crc = record[STATE_JOURNAL_RECORD_SIZE - 4] | (record[STATE_JOURNAL_RECORD_SIZE - 3] << 8) | (record[STATE_JOURNAL_RECORD_SIZE - 2] << 16) | ((uint32_t)record[STATE_JOURNAL_RECORD_SIZE - 1] << 24);
+        if ((record[0] | (record[1] << 8)) != STATE_JOURNAL_MAGIC || crc32_le(0, record, STATE_JOURNAL_RECORD_SIZE - 4) != crc)
+        {
+            this->_compact = true;
+            continue;
+        }
+        this->_sequence = record[2] | (record[3] << 8) | (record[4] << 16) | ((uint32_t)record[5] << 24);
+        memcpy(this->_writtenData, record + 6, sizeof(this->_writtenData));
+        found = true;
+    }
+    file.close();
+    if (this->_fileSize % STATE_JOURNAL_RECORD_SIZE != 0)
+    {
+        // Appending after a partial record would misalign all following records
+        this->_compact = true;
+    }
+    if (!found)
+    {
+        LOG_WARNING("No valid record in ", STATE_JOURNAL_FILE, ", all channels start off.");
+        return false;
+    }
+
+    for (uint8_t i = 0; i < STATE_JOURNAL_CHANNELS; i++)
+    {
+        DMXChannel *channel = LightManager::instance->getChannel(i);
+        if (!channel || !channel->config->enabled)
+        {
+            continue;
+        }
+        const uint8_t *data = this->_writtenData + i * STATE_JOURNAL_CHANNEL_SIZE;
+        uint16_t level = data[1] | (data[2] << 8);
+        channel->level = level < channel->getMinLevel() ? channel->getMinLevel() : (level > channel->getMaxLevel() ? channel->getMaxLevel() : level);
+        if (channel->config->type != FIXTURE_DIMMER && data[4] < COLOR_MODE_COUNT)
+        {
+            Color color;
+            color.mode = data[4];
+            color.hue = data[5] | (data[6] << 8);
+            color.saturation = data[7];
+            color.mireds = data[8] | (data[9] << 8);
+            memcpy(color.rgbw, data + 10, sizeof(color.rgbw));
+            channel->setColor(color, 0);
+        }
+        // Writes the output and wakes the send task
+        channel->setState(data[0] == 1);
+        if (data[3] != EFFECT_NONE && data[3] < EFFECT_COUNT)
+        {
+            LightManager::instance->setEffect(channel, data[3]);
+        }
+    }
+    this->_restored = true;
+    this->_snapshot(this->_snapshotData);
+    LOG_INFO("Restored channel state from record ", LOG_BOLD, this->_sequence);
+    return true;
+}
+
+void StateJournal::loop()
+{
+    uint8_t current[sizeof(this->_snapshotData)];
+    this->_snapshot(current);
+    unsigned long now = millis();
+    if (memcmp(current, this->_snapshotData, sizeof(current)) != 0)
+    {
+        memcpy(this->_snapshotData, current, sizeof(current));
+        this->_lastChange = now;
+    }
+    if (memcmp(this->_snapshotData, this->_writtenData, sizeof(this->_snapshotData)) == 0)
+    {
+        return;
+    }
+    // Dimming and fades change the level many times a second, only the level they end on is written.
+    if (now - this->_lastChange < STATE_JOURNAL_SETTLE_TIME || (this->_lastWrite != 0 && now - this->_lastWrite < STATE_JOURNAL_MIN_INTERVAL))
+    {
+        return;
+    }
+    this->_write();
+}
+
+void StateJournal::flush()
+{
+    this->_snapshot(this->_snapshotData);
+    if (memcmp(this->_snapshotData, this->_writtenData, sizeof(this->_snapshotData)) != 0)
+    {
+        this->_write();
+    }
+}
+
+void StateJournal::clear()
+{
+    LittleFS.remove(STATE_JOURNAL_FILE);
+    this->_fileSize = 0;
+    this->_compact = false;
+}
+
+size_t StateJournal::getStatusJson(char *buffer, size_t size)
+{
+    bool pending = memcmp(this->_snapshotData, this->_writtenData, sizeof(this->_snapshotData)) != 0;
+    return snprintf(buffer, size, "{\"restored\":%s,\"pending\":%s,\"sequence\":%u,\"file_size\":%u,\"writes\":%u,\"bytes_written\":%u,\"compactions\":%u,\"failures\":%u}",
+                    this->_restored ? "true" : "false",
+                    pending ? "true" : "false",
+                    (unsigned int)this->_sequence,
+                    (unsigned int)this->_fileSize,
+                    (unsigned int)this->_writes,
+                    (unsigned int)this->_bytesWritten,
+                    (unsigned int)this->_compactions,
+                    (unsigned int)this->_failures);
+}
+
+void StateJournal::_snapshot(uint8_t *channels)
+{
+    memset(channels, 0, sizeof(this->_snapshotData));
+    for (uint8_t i = 0; i < STATE_JOURNAL_CHANNELS; i++)
+    {
+        DMXChannel *channel = LightManager::instance->getChannel(i);
+        if (!channel)
+        {
+            continue;
+        }
+        uint8_t *data = channels + i * STATE_JOURNAL_CHANNEL_SIZE;
+        data[0] = channel->state ? 1 : 0;
+        data[1] = channel->level & 0xFF;
+        data[2] = channel->level >> 8;
+        data[3] = channel->effect.type;
+        Color color = channel->getColor();
+        data[4] = color.mode;
+        data[5] = color.hue & 0xFF;
+        data[6] = color.hue >> 8;
+        data[7] = color.saturation;
+        data[8] = color.mireds & 0xFF;
+        data[9] = color.mireds >> 8;
+        memcpy(data + 10, color.rgbw, sizeof(color.rgbw));
+    }
+}
+
+bool StateJournal::_write()
+{
+    this->_lastWrite = millis();
+    uint32_t sequence = this->_sequence + 1;
+    uint8_t record[STATE_JOURNAL_RECORD_SIZE];
+    record[0] = STATE_JOURNAL_MAGIC & 0xFF;
+    record[1] = STATE_JOURNAL_MAGIC >> 8;
+    for (uint8_t i = 0; i < 4; i++)
+    {
+        record[2 + i] = sequence >> (i * 8);
+    }
+    memcpy(record + 6, this->_snapshotData, sizeof(this->_snapshotData));
+    uint32_t crc = crc32_le(0, record, STATE_JOURNAL_RECORD_SIZE - 4);
+    for (uint8_t i = 0; i < 4; i++)
+    {
+        record[STATE_JOURNAL_RECORD_SIZE - 4 + i] = crc >> (i * 8);
+    }
+
+    // Appending only programs the tail of the file. When it is full it is replaced by a file with just this record,
+    // renames are atomic so a power loss leaves either the old or the new file.
+    bool replace = this->_compact || this->_fileSize + STATE_JOURNAL_RECORD_SIZE > STATE_JOURNAL_MAX_SIZE;
+    File file = LittleFS.open(replace ? STATE_JOURNAL_FILE_TMP : STATE_JOURNAL_FILE, replace ? "w" : "a");
+    if (!file)
+    {
+        LOG_ERROR("Failed to open ", replace ? STATE_JOURNAL_FILE_TMP : STATE_JOURNAL_FILE, " for writing.");
+        this->_failures++;
+        return false;
+    }
+    bool written = file.write(record, sizeof(record)) == sizeof(record);
+    file.close();
+    if (!written || (replace && !LittleFS.rename(STATE_JOURNAL_FILE_TMP, STATE_JOURNAL_FILE)))
+    {
+        LOG_ERROR("Failed to write channel state.");
+        this->_failures++;
+        return false;
+    }
+
+    if (replace)
+    {
+        this->_fileSize = sizeof(record);
+        this->_compact = false;
+        this->_compactions++;
+    }
+    else
+    {
+        this->_fileSize += sizeof(record);
+    }
+    this->_sequence = sequence;
+    memcpy(this->_writtenData, this->_snapshotData, sizeof(this->_writtenData));
+    this->_writes++;
+    this->_bytesWritten += sizeof(record);
+    LOG_DEBUG("Saved channel state, record ", this->_sequence);
+    return true;
+}
@@ -0,0 +1,64 @@
+#ifndef LMAN_STATE_JOURNAL
+#define LMAN_STATE_JOURNAL
+
+#include <Arduino.h>
+#include <LMANConfig.h>
+
+#define STATE_JOURNAL_FILE "/state.bin"
+#define STATE_JOURNAL_FILE_TMP "/state.bin.tmp"
+#define STATE_JOURNAL_MAGIC 0x4A53 // "SJ"
+/// @brief Time in ms the channels must be unchanged before their state is written, so a fade is written once it is done
+#define STATE_JOURNAL_SETTLE_TIME 5000
+/// @brief Least time in ms between two writes, changes in between are coalesced into one record
+#define STATE_JOURNAL_MIN_INTERVAL 30000
+/// @brief Size the journal may grow to before it is compacted to the last record
+#define STATE_JOURNAL_MAX_SIZE 4096
+/// @brief The number of channels in a record
+#define STATE_JOURNAL_CHANNELS (sizeof(LMANConfig::channelConfigs) / sizeof(ChannelConfig))
+/// @brief Bytes per channel: state, level, effect, color mode, hue, saturation, mireds and 4 color components
+#define STATE_JOURNAL_CHANNEL_SIZE 14
+/// @brief Bytes per record: magic, sequence number, channels and CRC32
+#define STATE_JOURNAL_RECORD_SIZE (2 + 4 + STATE_JOURNAL_CHANNELS * STATE_JOURNAL_CHANNEL_SIZE + 4)
+
+/// @brief Keeps the state of all channels in flash so that the lights come back as they were after a reboot.
+/// Records are appended to a file, only after the channels settled and at most every STATE_JOURNAL_MIN_INTERVAL.
+/// The file is replaced by its last record when it grows past STATE_JOURNAL_MAX_SIZE.
+class StateJournal
+{
+public:
+    /// @brief Read the last valid record and restore the channels from it. Call after the channels are initiated.
+    /// @return True if the channels were restored
+    bool restore();
+    /// @brief Write the state if it changed and settled. Called from the main loop.
+    void loop();
+    /// @brief Write a changed state straight away, before a reboot
+    void flush();
+    /// @brief Remove the journal, for a factory reset
+    void clear();
+    /// @brief Write the write statistics as JSON
+    /// @return The length of the JSON
+    size_t getStatusJson(char *buffer, size_t size);
+    /// @brief The instance of the journal, set by restore()
+    static StateJournal *instance;
+
+private:
+    /// @brief Read the state of all channels into a record payload
+    void _snapshot(uint8_t *channels);
+    /// @brief Append the last snapshot as a record, or replace the file with it if the file is full
+    bool _write();
+    uint8_t _snapshotData[STATE_JOURNAL_CHANNELS * STATE_JOURNAL_CHANNEL_SIZE];
+    uint8_t _writtenData[STATE_JOURNAL_CHANNELS * STATE_JOURNAL_CHANNEL_SIZE];
+    uint32_t _sequence = 0;
+    size_t _fileSize = 0;
+    /// @brief Set when the file ends in an incomplete record, the next write replaces the file
+    bool _compact = false;
+    bool _restored = false;
+    unsigned long _lastChange = 0;
+    unsigned long _lastWrite = 0;
+    uint32_t _writes = 0;
+    uint32_t _bytesWritten = 0;
+    uint32_t _compactions = 0;
+    uint32_t _failures = 0;
+};
+
+#endif
@@ -0,0 +1,560 @@
+#include <UpdateManager.h>
+#include <LMANLog.h>
+#include <JsonPool.h>
+#include <LMANTasks.h>
+#include <LittleFS.h>
+#include <LMANConfig.h>
+#include <HTTPClient.h>
+#include <WiFi.h>
+#include <ArduinoJson.h>
+#include <version.h>
+
+// Notify progress every time this many bytes has been written to flash
+#define UPDATE_PROGRESS_INTERVAL 32768
+// Give up a pulled download if no data has arrived for this long
+#define UPDATE_PULL_TIMEOUT 10000
+// Give up a pulled download if the flash does not free a buffer for this long
+#define UPDATE_PULL_WRITE_TIMEOUT 5000
+
+// Make space for variables in memory
+UpdateManager *UpdateManager::instance;
+
+void UpdateManager::init()
+{
+    UpdateManager::instance = this;
+    this->_freeBuffers = xQueueCreate(UPDATE_BUFFER_COUNT, sizeof(uint8_t));
+    this->_filledBuffers = xQueueCreate(UPDATE_BUFFER_COUNT + 1, sizeof(UpdateChunk));
+    this->_updateMutex = xSemaphoreCreateMutex();
+    for (uint8_t i = 0; i < UPDATE_BUFFER_COUNT; i++)
+    {
+        this->_buffers[i] = (uint8_t *)malloc(UPDATE_BUFFER_SIZE);
+        xQueueSend(this->_freeBuffers, &i, 0);
+    }
+    mbedtls_sha256_init(&this->_sha256);
+    this->_pullMutex = xSemaphoreCreateMutex();
+    createTask(TASK_WRITE_UPDATE, UpdateManager::_taskWriteUpdate, NULL);
+    createTask(TASK_PULL_UPDATE, UpdateManager::_taskPullUpdate, &this->_pullTask);
+}
+
+bool UpdateManager::begin(int command, size_t size, const std::string &sha256)
+{
+    xSemaphoreTake(this->_updateMutex, portMAX_DELAY);
+    if (Update.isRunning())
+    {
+        LOG_WARNING("Aborting unfinished update.");
+        Update.abort();
+    }
+    this->_session++; // Any chunks still queued for the old update will be dropped
+    if (this->_currentBuffer >= 0)
+    {
+        uint8_t buffer = this->_currentBuffer;
+        xQueueSend(this->_freeBuffers, &buffer, 0);
+        this->_currentBuffer = -1;
+    }
+
+    this->_command = command;
+    this->_size = size;
+    this->_received = 0;
+    this->_written = 0;
+    this->_lastNotifiedWritten = 0;
+    this->_expectedSha256 = sha256;
+    this->_error.clear();
+
+    size_t maxSize;
+    if (command == U_SPIFFS)
+    {
+        maxSize = LittleFS.totalBytes();
+    }
+    else
+    {
+        maxSize = (ESP.getFreeSketchSpace() - 0x1000) & 0xFFFFF000;
+    }
+    if (size > maxSize)
+    {
+        xSemaphoreGive(this->_updateMutex);
+        this->_fail("Image is larger than the partition");
+        return false;
+    }
+
+    LOG_INFO("Starting ", command == U_SPIFFS ? "LittleFS" : "firmware", " update. Size: ", size);
+    bool started = Update.begin(size > 0 ? size : maxSize, command);
+    xSemaphoreGive(this->_updateMutex);
+    if (!started)
+    {
+        this->_fail(Update.errorString());
+        return false;
+    }
+
+    mbedtls_sha256_starts_ret(&this->_sha256, 0);
+    this->_state = UPDATE_RECEIVING;
+    this->_notifyProgress();
+    return true;
+}
+
+bool UpdateManager::write(const uint8_t *data, size_t len, TickType_t wait)
+{
+    this->_behind = false;
+    if (this->_state != UPDATE_RECEIVING)
+    {
+        return false;
+    }
+
+    while (len > 0)
+    {
+        if (this->_currentBuffer < 0)
+        {
+            // All buffers wait for the writer task if the network is faster than the flash.
+            // The caller sends the rest again later instead of blocking the network.
+            uint8_t buffer;
+            if (!xQueueReceive(this->_freeBuffers, &buffer, wait))
+            {
+                this->_behind = true;
+                return false;
+            }
+            this->_currentBuffer = buffer;
+            this->_currentBufferLength = 0;
+        }
+
+        size_t toCopy = UPDATE_BUFFER_SIZE - this->_currentBufferLength;
+        if (toCopy > len)
+        {
+            toCopy = len;
+        }
+        memcpy(this->_buffers[this->_currentBuffer] + this->_currentBufferLength, data, toCopy);
+        this->_currentBufferLength += toCopy;
+        this->_received += toCopy;
+        data += toCopy;
+        len -= toCopy;
+
+        if (this->_currentBufferLength == UPDATE_BUFFER_SIZE && !this->_queueCurrentBuffer())
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool UpdateManager::_queueCurrentBuffer()
+{
+    UpdateChunk chunk;
+    chunk.session = this->_session;
+    chunk.buffer = this->_currentBuffer;
+    chunk.length = this->_currentBufferLength;
+    this->_currentBuffer = -1;
+    // There is room for every buffer and the end marker, this never waits
+    if (!xQueueSend(this->_filledBuffers, &chunk, 0))
+    {
+        this->_fail("Timeout queueing data for flash writes");
+        return false;
+    }
+    return true;
+}
+
+void UpdateManager::end()
+{
+    if (this->_state != UPDATE_RECEIVING)
+    {
+        return;
+    }
+    if (this->_currentBuffer >= 0 && this->_currentBufferLength > 0 && !this->_queueCurrentBuffer())
+    {
+        return;
+    }
+    this->_state = UPDATE_VERIFYING;
+    UpdateChunk endChunk;
+    endChunk.session = this->_session;
+    endChunk.buffer = 0;
+    endChunk.length = 0;
+    xQueueSend(this->_filledBuffers, &endChunk, portMAX_DELAY);
+}
+
+void UpdateManager::abort()
+{
+    xSemaphoreTake(this->_updateMutex, portMAX_DELAY);
+    this->_session++;
+    if (Update.isRunning())
+    {
+        Update.abort();
+    }
+    xSemaphoreGive(this->_updateMutex);
+    if (this->_state == UPDATE_RECEIVING || this->_state == UPDATE_VERIFYING)
+    {
+        this->_fail("Aborted");
+    }
+}
+
+void UpdateManager::_taskWriteUpdate(void *param)
+{
+    LOG_INFO("Started taskWriteUpdate");
+    UpdateManager *manager = UpdateManager::instance;
+    UpdateChunk chunk;
+    for (;;)
+    {
+        if (!xQueueReceive(manager->_filledBuffers, &chunk, portMAX_DELAY))
+        {
+            continue;
+        }
+
+        // The session is changed by begin() and abort() on other tasks, it is compared under the same lock as the write
+        xSemaphoreTake(manager->_updateMutex, portMAX_DELAY);
+        if (chunk.length == 0)
+        {
+            // End marker, it does not hold a buffer.
+            if (chunk.session == manager->_session)
+            {
+                manager->_finish();
+            }
+            xSemaphoreGive(manager->_updateMutex);
+            continue;
+        }
+
+        if (chunk.session != manager->_session || manager->_state == UPDATE_FAILED)
+        {
+            xSemaphoreGive(manager->_updateMutex);
+        }
+        else
+        {
+            mbedtls_sha256_update_ret(&manager->_sha256, manager->_buffers[chunk.buffer], chunk.length);
+            size_t written = Update.write(manager->_buffers[chunk.buffer], chunk.length);
+            xSemaphoreGive(manager->_updateMutex);
+            if (written != chunk.length)
+            {
+                manager->_fail(Update.errorString());
+            }
+            else
+            {
+                manager->_written += written;
+                if (manager->_written - manager->_lastNotifiedWritten >= UPDATE_PROGRESS_INTERVAL)
+                {
+                    manager->_lastNotifiedWritten = manager->_written;
+                    manager->_notifyProgress();
+                }
+            }
+        }
+        xQueueSend(manager->_freeBuffers, &chunk.buffer, portMAX_DELAY);
+    }
+}
+
+void UpdateManager::_finish()
+{
+    if (this->_state == UPDATE_FAILED)
+    {
+        return;
+    }
+
+    uint8_t hash[32];
+    mbedtls_sha256_finish_ret(&this->_sha256, hash);
+    char hashHex[65];
+    for (int i = 0; i < 32; i++)
+    {
+        sprintf(&hashHex[i * 2], "%02x", hash[i]);
+    }
+    LOG_INFO("Update SHA-256: ", hashHex);
+
+    if (!this->_expectedSha256.empty() && strcasecmp(this->_expectedSha256.c_str(), hashHex) != 0)
+    {
+        LOG_ERROR("SHA-256 mismatch, expected ", this->_expectedSha256.c_str());
+        Update.abort();
+        this->_fail("SHA-256 mismatch");
+        return;
+    }
+
+    if (!Update.end(true))
+    {
+        this->_fail(Update.errorString());
+        return;
+    }
+
+    if (this->_command == U_SPIFFS)
+    {
+        LMANConfig::instance->update_littlefs_sha256 = hashHex;
+        LMANConfig::instance->saveToLittleFS(); // Save currently loaded values to the new LittleFS
+    }
+    LOG_INFO("Update done. Written: ", this->_written);
+    this->_state = UPDATE_DONE;
+    this->_notifyProgress();
+}
+
+void UpdateManager::_fail(const char *error)
+{
+    LOG_ERROR("Update failed: ", error);
+    this->_error = error;
+    this->_state = UPDATE_FAILED;
+    this->_notifyProgress();
+}
+
+void UpdateManager::_notifyProgress()
+{
+    if (this->_progressCallback)
+    {
+        this->_progressCallback();
+    }
+}
+
+void UpdateManager::setProgressCallback(void (*callback)())
+{
+    this->_progressCallback = callback;
+}
+
+void UpdateManager::requestPull(const std::string &url)
+{
+    xSemaphoreTake(this->_pullMutex, portMAX_DELAY);
+    this->_pullUrl = url;
+    xSemaphoreGive(this->_pullMutex);
+    xTaskNotifyGive(this->_pullTask);
+}
+
+bool UpdateManager::doReboot()
+{
+    if (this->_doReboot)
+    {
+        this->_doReboot = false;
+        return true;
+    }
+    return false;
+}
+
+void UpdateManager::_taskPullUpdate(void *param)
+{
+    LOG_INFO("Started taskPullUpdate");
+    UpdateManager *manager = UpdateManager::instance;
+    for (;;)
+    {
+        // Wait for a request via MQTT or until it is time to poll
+        uint16_t pollInterval = LMANConfig::instance->update_poll_interval;
+        // Up to 65535 minutes, only fits in 32 bits as ms. pdMS_TO_TICKS() would overflow multiplying by the tick rate.
+        TickType_t wait = pollInterval > 0 ? (pollInterval * 60000UL) / portTICK_PERIOD_MS : portMAX_DELAY;
+        ulTaskNotifyTake(pdTRUE, wait);
+
+        xSemaphoreTake(manager->_pullMutex, portMAX_DELAY);
+        std::string url = manager->_pullUrl.empty() ? LMANConfig::instance->update_url : manager->_pullUrl;
+        manager->_pullUrl.clear();
+        xSemaphoreGive(manager->_pullMutex);
+        if (url.empty() || !WiFi.isConnected())
+        {
+            continue;
+        }
+
+        // Spread the load on the update server when the whole fleet is told to update at once.
+        if (LMANConfig::instance->update_stagger > 0)
+        {
+            uint32_t delayMs = esp_random() % (LMANConfig::instance->update_stagger * 1000UL);
+            LOG_INFO("Checking for updates in ", LOG_BOLD, delayMs, LOG_RESET_DECORATIONS, " ms.");
+            vTaskDelay(delayMs / portTICK_PERIOD_MS);
+        }
+
+        if (manager->_state == UPDATE_RECEIVING || manager->_state == UPDATE_VERIFYING)
+        {
+            LOG_WARNING("Update already in progress, not checking for updates.");
+            continue;
+        }
+        if (manager->_pullUpdate(url))
+        {
+            manager->_doReboot = true;
+        }
+    }
+}
+
+/// @brief Resolve a URL from the manifest that may be relative to the manifest URL
+static std::string resolveUrl(const std::string &base, const std::string &url)
+{
+    if (url.find("://") != std::string::npos)
+    {
+        return url;
+    }
+    if (!url.empty() && url[0] == '/')
+    {
+        size_t hostStart = base.find("://");
+        size_t pathStart = base.find('/', hostStart == std::string::npos ? 0 : hostStart + 3);
+        return base.substr(0, pathStart) + url;
+    }
+    return base.substr(0, base.rfind('/') + 1) + url;
+}
+
+bool UpdateManager::_pullUpdate(const std::string &url)
+{
+    LOG_INFO("Fetching update manifest from ", LOG_BOLD, url.c_str());
+    HTTPClient http;
+    http.begin(url.c_str());
+    int code = http.GET();
+    if (code != HTTP_CODE_OK)
+    {
+        LOG_ERROR("Failed to fetch update manifest: ", code);
+        http.end();
+        return false;
+    }
+
+    PooledJsonDocument manifest(1024);
+    DeserializationError err = deserializeJson(manifest, http.getStream());
+    http.end();
+    if (err)
+    {
+        LOG_ERROR("Failed to deserialize update manifest.");
+        return false;
+    }
+
+    bool installed = false;
+    JsonObject firmware = manifest["firmware"];
+    if (!firmware.isNull())
+    {
+        std::string version = firmware["version"] | "";
+        if (version.empty() || version.compare(DMX512_SW_VERSION) == 0)
+        {
+            LOG_INFO("Firmware ", LOG_BOLD, DMX512_SW_VERSION, LOG_RESET_DECORATIONS, " is up to date.");
+        }
+        else
+        {
+            LOG_INFO("New firmware ", LOG_BOLD, version.c_str(), LOG_RESET_DECORATIONS, " available, running ", DMX512_SW_VERSION);
+            if (!this->_pullImage(U_FLASH, resolveUrl(url, firmware["url"] | ""), firmware["size"] | 0, firmware["sha256"] | ""))
+            {
+                return false;
+            }
+            installed = true;
+        }
+    }
+
+    JsonObject littlefs = manifest["littlefs"];
+    if (!littlefs.isNull())
+    {
+        std::string sha256 = littlefs["sha256"] | "";
+        if (sha256.empty() || strcasecmp(sha256.c_str(), LMANConfig::instance->update_littlefs_sha256.c_str()) == 0)
+        {
+            LOG_INFO("LittleFS image is up to date.");
+        }
+        else
+        {
+            LOG_INFO("New LittleFS image available.");
+            if (!this->_pullImage(U_SPIFFS, resolveUrl(url, littlefs["url"] | ""), littlefs["size"] | 0, sha256))
+            {
+                return installed;
+            }
+            installed = true;
+        }
+    }
+    return installed;
+}
+
+bool UpdateManager::_pullImage(int command, const std::string &url, size_t size, const std::string &sha256)
+{
+    if (sha256.empty())
+    {
+        // Pulled images are unattended, never install one that can not be verified.
+        LOG_ERROR("No SHA-256 for ", url.c_str(), " in manifest.");
+        return false;
+    }
+
+    LOG_INFO("Downloading ", LOG_BOLD, url.c_str());
+    HTTPClient http;
+    http.begin(url.c_str());
+    int code = http.GET();
+    if (code != HTTP_CODE_OK)
+    {
+        LOG_ERROR("Failed to download image: ", code);
+        http.end();
+        return false;
+    }
+    int length = http.getSize();
+    if (length > 0)
+    {
+        size = length;
+    }
+    if (!this->begin(command, size, sha256))
+    {
+        http.end();
+        return false;
+    }
+
+    WiFiClient *stream = http.getStreamPtr();
+    uint8_t buffer[1024];
+    unsigned long lastData = millis();
+    while (this->_state == UPDATE_RECEIVING && (length < 0 || this->_received < (size_t)length))
+    {
+        size_t available = stream->available();
+        if (available > 0)
+        {
+            int read = stream->readBytes(buffer, available < sizeof(buffer) ? available : sizeof(buffer));
+            if (read > 0 && !this->write(buffer, read, UPDATE_PULL_WRITE_TIMEOUT / portTICK_PERIOD_MS))
+            {
+                if (this->_behind)
+                {
+                    // The download cannot be paused, the rest of the read data would be lost
+                    this->_fail("Timeout waiting for flash writes");
+                }
+                break;
+            }
+            lastData = millis();
+        }
+        else if ((length < 0 && !http.connected()) || millis() - lastData > UPDATE_PULL_TIMEOUT)
+        {
+            break;
+        }
+        else
+        {
+            vTaskDelay(1);
+        }
+    }
+    http.end();
+
+    if (this->_state != UPDATE_RECEIVING)
+    {
+        return false;
+    }
+    if (length > 0 && this->_received < (size_t)length)
+    {
+        this->abort();
+        return false;
+    }
+    this->end();
+    while (this->_state == UPDATE_VERIFYING)
+    {
+        vTaskDelay(100 / portTICK_PERIOD_MS);
+    }
+    return this->_state == UPDATE_DONE;
+}
+
+UpdateState UpdateManager::getState()
+{
+    return this->_state;
+}
+
+int UpdateManager::getCommand()
+{
+    return this->_command;
+}
+
+size_t UpdateManager::getSize()
+{
+    return this->_size;
+}
+
+size_t UpdateManager::getReceived()
+{
+    return this->_received;
+}
+
+size_t UpdateManager::getWritten()
+{
+    return this->_written;
+}
+
+bool UpdateManager::isBehind()
+{
+    return this->_behind;
+}
+
+const char *UpdateManager::getError()
+{
+    return this->_error.c_str();
+}
+
+size_t UpdateManager::getStatusJson(char *buffer, size_t size)
+{
+    static const char *stateNames[] = {"idle", "receiving", "verifying", "done", "failed"};
+    return snprintf(buffer, size, "{\"image\":\"%s\",\"state\":\"%s\",\"size\":%u,\"received\":%u,\"written\":%u,\"error\":\"%s\"}",
+                    this->_command == U_SPIFFS ? "littlefs" : "firmware",
+                    stateNames[this->_state],
+                    (unsigned int)this->_size,
+                    (unsigned int)this->_received,
+                    (unsigned int)this->_written,
+                    this->_error.c_str());
+}
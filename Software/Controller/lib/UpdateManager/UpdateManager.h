@@ -0,0 +1,136 @@
+#ifndef LMAN_UPDATE_MANAGER
+#define LMAN_UPDATE_MANAGER
+
+#include <Arduino.h>
+#include <Update.h>
+#include <mbedtls/sha256.h>
+#include <freertos/queue.h>
+#include <freertos/semphr.h>
+#include <string>
+
+/// @brief The number of buffers between network receive and flash writes
+#define UPDATE_BUFFER_COUNT 4
+/// @brief The size of each buffer, one flash sector
+#define UPDATE_BUFFER_SIZE 4096
+
+enum UpdateState
+{
+    UPDATE_IDLE,
+    UPDATE_RECEIVING,
+    UPDATE_VERIFYING,
+    UPDATE_DONE,
+    UPDATE_FAILED,
+};
+
+/// @brief A chunk of received data handed from the receiving task to the writer task.
+/// A length of 0 marks the end of the image.
+struct UpdateChunk
+{
+    /// @brief The update the chunk belongs to. Chunks of aborted updates are dropped.
+    uint16_t session;
+    uint8_t buffer;
+    uint16_t length;
+};
+
+class UpdateManager
+{
+public:
+    /// @brief Allocate buffers and start the flash writer task
+    void init();
+    /// @brief The instance of the update manager started with .init();
+    static UpdateManager *instance;
+    /// @brief Start receiving a new image. Aborts any update in progress.
+    /// @param command U_FLASH for firmware, U_SPIFFS for LittleFS
+    /// @param size The size of the image, 0 if unknown
+    /// @param sha256 Expected SHA-256 of the image as hex string, empty to skip verification
+    /// @return True if the update was started
+    bool begin(int command, size_t size, const std::string &sha256);
+    /// @brief Queue received data for writing to flash
+    /// @param data The data to write
+    /// @param len The length of the data
+    /// @param wait Ticks to wait for the writer task to free a buffer. 0 on the web server task, which must not block.
+    /// @return True if all data was queued. Otherwise the data up to getReceived() was taken, see isBehind().
+    bool write(const uint8_t *data, size_t len, TickType_t wait = 0);
+    /// @brief All data has been received. Verify and finish the update once all data is written.
+    void end();
+    /// @brief Stop the current update and discard what has been written
+    void abort();
+    /// @brief Set a function that is called from the writer task when progress or state changes
+    void setProgressCallback(void (*callback)());
+    /// @brief Check the update manifest and download changed images, after the configured stagger delay
+    /// @param url Manifest URL to use instead of the configured one, empty to use the configured one
+    void requestPull(const std::string &url);
+    /// @brief Returns true once if a pulled update was installed and the device should reboot
+    bool doReboot();
+
+    UpdateState getState();
+    /// @brief U_FLASH or U_SPIFFS
+    int getCommand();
+    /// @brief The size of the image, 0 if unknown
+    size_t getSize();
+    /// @brief The number of bytes received so far. An interrupted upload is resumed from this offset.
+    size_t getReceived();
+    /// @brief The number of bytes written to flash so far
+    size_t getWritten();
+    /// @brief Wether the last write() stopped because all buffers were waiting to be written.
+    /// The rest of the data can be sent again from getReceived() once the flash has caught up.
+    bool isBehind();
+    /// @brief Description of the last error
+    const char *getError();
+    /// @brief Describe the current state as JSON
+    /// @param buffer The buffer to write to
+    /// @param size The size of the buffer
+    /// @return The length of the written JSON
+    size_t getStatusJson(char *buffer, size_t size);
+
+private:
+    static void _taskWriteUpdate(void *param);
+    static void _taskPullUpdate(void *param);
+    /// @brief Fetch the manifest and install all images that differ from the running ones
+    /// @param url The manifest URL
+    /// @return True if anything was installed
+    bool _pullUpdate(const std::string &url);
+    /// @brief Download an image and stream it to flash
+    /// @param command U_FLASH or U_SPIFFS
+    /// @param url URL of the image
+    /// @param size Size of the image as stated in the manifest
+    /// @param sha256 Expected SHA-256 of the image
+    /// @return True if the image was verified and installed
+    bool _pullImage(int command, const std::string &url, size_t size, const std::string &sha256);
+    /// @brief Hand the currently filled buffer to the writer task
+    bool _queueCurrentBuffer();
+    /// @brief Verify the SHA-256 and finish the update. Called from the writer task with _updateMutex held.
+    void _finish();
+    void _fail(const char *error);
+    void _notifyProgress();
+
+    uint8_t *_buffers[UPDATE_BUFFER_COUNT];
+    QueueHandle_t _freeBuffers;
+    QueueHandle_t _filledBuffers;
+    /// @brief The buffer currently being filled by write(), -1 if none
+    int _currentBuffer = -1;
+    size_t _currentBufferLength = 0;
+
+    /// @brief Guards all calls to Update and _session
+    SemaphoreHandle_t _updateMutex;
+    uint16_t _session = 0;
+    volatile bool _behind = false;
+    mbedtls_sha256_context _sha256;
+    std::string _expectedSha256;
+    volatile UpdateState _state = UPDATE_IDLE;
+    int _command = U_FLASH;
+    size_t _size = 0;
+    size_t _received = 0;
+    size_t _written = 0;
+    size_t _lastNotifiedWritten = 0;
+    std::string _error;
+    void (*_progressCallback)() = nullptr;
+
+    TaskHandle_t _pullTask = NULL;
+    /// @brief Guards _pullUrl which is set from the MQTT callback
+    SemaphoreHandle_t _pullMutex;
+    std::string _pullUrl;
+    bool _doReboot = false;
+};
+
+#endif
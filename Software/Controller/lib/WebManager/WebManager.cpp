@@ -1,13 +1,35 @@
 #include <WebManager.h>
-#include <ArduLog.h>
+#include <LMANLog.h>
 #include <LittleFS.h>
 #include <LMANConfig.h>
 #include <LightManager.h>
+#include <ArtNet.h>
+#include <E131.h>
+#include <MqttRaw.h>
+#include <LogSink.h>
+#include <JsonPool.h>
+#include <LMANTasks.h>
+#include <DMXOutput.h>
+#include <RDMManager.h>
+#include <StateJournal.h>
+#include <Scheduler.h>
 #include <list>
+#include <algorithm>
 #include <WiFi.h>
 #include <Arduino.h>
 #include <Update.h>
 
+// HTML pages are always revalidated, they reference the static assets by content hash
+// so the static assets themselves can be cached "forever".
+#define CACHE_CONTROL_PAGE "no-cache"
+#define CACHE_CONTROL_STATIC "public, max-age=31536000, immutable"
+// The largest request body accepted on /raw_config and /api/channels
+#define REQUEST_BODY_MAX_SIZE 4096
+// Bytes per command in a binary /api/channels body: channel (u16), universe, 16 bit level (u16), transition in ms (u16), little-endian
+#define CHANNEL_COMMAND_SIZE 7
+// The longest transition in ms of an /api/channels command, the same hour MQTT transitions are limited to
+#define CHANNEL_MAX_TRANSITION 3600000
+
 // Make space for variables in memory
 WebManager *WebManager::instance;
 
@@ -16,20 +38,24 @@ void WebManager::init(PubSubClient *mqttClient)
     this->instance = this;
     this->_mqttClient = mqttClient;
     this->_doRebootAt = 0;
+    this->_loadAssetTags();
 
     LOG_DEBUG("Setting up web server routes");
     // this->_server = server;
     this->_server.on("/", HTTP_GET, [](AsyncWebServerRequest *request)
-                     { request->send(LittleFS, "/index.html"); });
+                     { WebManager::sendAsset(request, "/index.html", CACHE_CONTROL_PAGE); });
 
     this->_server.on("/reboot", HTTP_GET, [](AsyncWebServerRequest *request)
-                     { request->send(LittleFS, "/reboot.html"); });
+                     { WebManager::sendAsset(request, "/reboot.html", CACHE_CONTROL_PAGE); });
 
     this->_server.on("/update", HTTP_GET, [](AsyncWebServerRequest *request)
-                     { request->send(LittleFS, "/update.html"); });
+                     { WebManager::sendAsset(request, "/update.html", CACHE_CONTROL_PAGE); });
+
+    this->_server.on("/static", HTTP_GET, [](AsyncWebServerRequest *request)
+                     { WebManager::sendAsset(request, request->url().c_str(), CACHE_CONTROL_STATIC); });
 
-    this->_server.on("/raw_config", HTTP_GET, [](AsyncWebServerRequest *request)
-                     { request->send(LittleFS, "/config.json"); });
+    this->_server.on("/raw_config", HTTP_GET, WebManager::sendRawConfig);
+    this->_server.on("/raw_config", HTTP_POST, WebManager::importRawConfig, NULL, WebManager::receiveBody);
 
     this->_server.on("/connection_test", HTTP_GET, [](AsyncWebServerRequest *request)
                      { request->send(200, "text/plain", "OK"); });
@@ -38,9 +64,30 @@ void WebManager::init(PubSubClient *mqttClient)
     this->_server.on("/save_config", HTTP_POST, WebManager::saveConfigFromWeb);
     this->_server.on("/available_wifi_networks", HTTP_GET, respondAvailableWiFiNetworks);
     this->_server.onFileUpload(performFirmwareUpdate);
+    this->_server.on("/ota", HTTP_POST, WebManager::respondUpdateChunk, NULL, WebManager::receiveUpdateChunk);
+    this->_server.on("/ota", HTTP_GET, WebManager::respondUpdateStatus);
+    this->_server.on("/artnet", HTTP_GET, WebManager::respondArtNetStatus);
+    this->_server.on("/e131", HTTP_GET, WebManager::respondE131Status);
+    this->_server.on("/mqtt_raw", HTTP_GET, WebManager::respondMqttRawStatus);
+    this->_server.on("/schedule", HTTP_GET, WebManager::respondScheduleStatus);
+    this->_server.on("/heap", HTTP_GET, WebManager::respondHeapStatus);
+    this->_server.on("/tasks", HTTP_GET, WebManager::respondTaskStatus);
+    this->_server.on("/dmx", HTTP_GET, WebManager::respondDMXStatus);
+    this->_server.on("/rdm", HTTP_GET, WebManager::respondRDMStatus);
+    this->_server.on("/state", HTTP_GET, WebManager::respondStateJournalStatus);
+    this->_server.on("/api/channels", HTTP_GET, WebManager::respondChannels);
+    this->_server.on("/api/channels", HTTP_POST, WebManager::setChannels, NULL, WebManager::receiveBody);
+    // The log WebSocket only handles upgrade requests, it has to come before the plain GET /logs route.
+    this->_server.addHandler(&this->_logSocket);
+    LogSink::instance->attachWebSocket(&this->_logSocket);
+    this->_server.on("/logs", HTTP_GET, WebManager::respondLogs);
     this->_server.on("/do_factory_reset", HTTP_GET, [](AsyncWebServerRequest *request)
                      {
         LMANConfig::instance->factoryReset();
+        if (StateJournal::instance)
+        {
+            StateJournal::instance->clear();
+        }
         request->redirect("/reboot"); });
 
     this->_server.onNotFound([](AsyncWebServerRequest *request)
@@ -50,18 +97,76 @@ void WebManager::init(PubSubClient *mqttClient)
 
     LOG_INFO("Starting web server.");
 
-    this->_server.serveStatic("/static", LittleFS, "/static");
     this->_server.addHandler(&this->_indexDataSocket);
+    this->_server.addHandler(&this->_updateDataSocket);
+    UpdateManager::instance->setProgressCallback(WebManager::sendUpdateProgress);
     this->_server.begin();
 
-    xTaskCreatePinnedToCore(WebManager::taskSendStatusUpdates, "taskWebStatusUpdates", 5000, NULL, 0, NULL, CONFIG_ARDUINO_RUNNING_CORE);
+    createTask(TASK_WEB_STATUS_UPDATES, WebManager::taskSendStatusUpdates, NULL);
+}
+
+void WebManager::_loadAssetTags()
+{
+    File tagsFile = LittleFS.open("/etags");
+    if (!tagsFile)
+    {
+        LOG_WARNING("No '/etags' found. Web assets will be served without caching.");
+        return;
+    }
+
+    while (tagsFile.available())
+    {
+        String line = tagsFile.readStringUntil('\n');
+        int separator = line.indexOf(' ');
+        if (separator > 0)
+        {
+            this->_assetTags[line.substring(0, separator).c_str()] = line.substring(separator + 1).c_str();
+        }
+    }
+    tagsFile.close();
+    LOG_INFO("Loaded ", LOG_BOLD, this->_assetTags.size(), LOG_RESET_DECORATIONS, " asset tags.");
+}
+
+void WebManager::sendAsset(AsyncWebServerRequest *request, const char *path, const char *cacheControl)
+{
+    std::map<std::string, std::string>::iterator tag = WebManager::instance->_assetTags.find(path);
+    if (tag == WebManager::instance->_assetTags.end())
+    {
+        // Asset not built by compressassets.py, serve it as is without caching.
+        request->send(LittleFS, path);
+        return;
+    }
+
+    std::string etag = "\"";
+    etag.append(tag->second);
+    etag.append("\"");
+
+    AsyncWebServerResponse *response;
+    if (request->hasHeader("If-None-Match") && etag.compare(request->header("If-None-Match").c_str()) == 0)
+    {
+        LOG_TRACE("Asset ", path, " not modified.");
+        response = request->beginResponse(304);
+    }
+    else
+    {
+        // Will send "<path>.gz" with Content-Encoding: gzip if only the compressed file exists.
+        response = request->beginResponse(LittleFS, path);
+        if (!response)
+        {
+            request->send(404, "text/plain", "Path/File not found!");
+            return;
+        }
+    }
+    response->addHeader("ETag", etag.c_str());
+    response->addHeader("Cache-Control", cacheControl);
+    request->send(response);
 }
 
 void WebManager::sendBaseData(AsyncWebSocketClient *client)
 {
     LOG_TRACE("Constructing indexData BaseData");
     // A client just connected. Curate all data into a single JSON response
-    StaticJsonDocument<2048> json;
+    PooledJsonDocument json(CONFIG_JSON_SIZE);
 
     // WiFi values
     json["wifi_hostname"] = LMANConfig::instance->wifi_hostname.c_str();
@@ -74,8 +179,26 @@ void WebManager::sendBaseData(AsyncWebSocketClient *client)
     json["mqtt_psk"] = LMANConfig::instance->mqtt_password.c_str();
     json["mqtt_base_topic"] = LMANConfig::instance->home_assistant_base_topic.c_str();
     json["home_assistant_state_change_wait"] = LMANConfig::instance->home_assistant_state_change_wait;
-    json["mqtt_status"] = WebManager::instance->_mqttClient->connected() ? "Connected" : "DISCONNECTED";
+    json["mqtt_status"] = WebManager::instance->_mqttClient->state() == MQTT_CONNECTED ? "Connected" : "DISCONNECTED";
     json["log_level"] = LMANConfig::instance->logging_level;
+    json["update_url"] = LMANConfig::instance->update_url.c_str();
+    json["update_poll_interval"] = LMANConfig::instance->update_poll_interval;
+    json["update_stagger"] = LMANConfig::instance->update_stagger;
+    json["artnet_enabled"] = LMANConfig::instance->artnet_enabled;
+    json["artnet_universe"] = LMANConfig::instance->artnet_universe;
+    json["dmx_merge_mode"] = LMANConfig::instance->dmx_merge_mode;
+    json["dmx_min_frame_rate"] = LMANConfig::instance->dmx_min_frame_rate;
+    json["e131_enabled"] = LMANConfig::instance->e131_enabled;
+    json["e131_universe"] = LMANConfig::instance->e131_universe;
+    json["mqtt_raw_enabled"] = LMANConfig::instance->mqtt_raw_enabled;
+    json["mqtt_raw_hold"] = LMANConfig::instance->mqtt_raw_hold;
+    json["time_zone"] = LMANConfig::instance->time_zone.c_str();
+    json["ntp_server"] = LMANConfig::instance->ntp_server.c_str();
+    json["latitude"] = LMANConfig::instance->latitude / 100.0f;
+    json["longitude"] = LMANConfig::instance->longitude / 100.0f;
+    json["log_serial"] = LMANConfig::instance->log_serial;
+    json["syslog_server"] = LMANConfig::instance->syslog_server;
+    json["syslog_port"] = LMANConfig::instance->syslog_port;
 
     // General button data
     json["button_min_time"] = LMANConfig::instance->buttonPressMinTime;
@@ -88,12 +211,15 @@ void WebManager::sendBaseData(AsyncWebSocketClient *client)
         doc["name"] = it->config->name;
         doc["enabled"] = it->config->enabled ? 1 : 0;
         doc["channel"] = it->config->channel;
+        doc["universe"] = it->config->universe;
+        doc["fine"] = it->config->fine ? 1 : 0;
+        doc["type"] = it->config->type;
         doc["min"] = it->config->min;
         doc["max"] = it->config->max;
         doc["dimmingSpeed"] = it->config->dimmingSpeed;
         doc["autoDimmingSpeed"] = it->config->autoDimmingSpeed;
         doc["holdPeriod"] = it->config->holdPeriod;
-        doc["level"] = it->level;
+        doc["level"] = it->level >> 8;
         doc["state"] = it->state ? 1 : 0;
     }
 
@@ -103,13 +229,88 @@ void WebManager::sendBaseData(AsyncWebSocketClient *client)
         JsonObject doc = buttonData.createNestedObject();
         doc["channel"] = it->config->channel;
         doc["enabled"] = it->config->enabled ? 1 : 0;
+        doc["scene"] = it->config->scene;
+    }
+
+    JsonArray sceneData = json.createNestedArray("scenes");
+    for (SceneConfig &scene : LMANConfig::instance->sceneConfigs)
+    {
+        JsonObject doc = sceneData.createNestedObject();
+        doc["name"] = scene.name.c_str();
+        doc["enabled"] = scene.enabled ? 1 : 0;
+        doc["fadeTime"] = scene.fadeTime;
+        JsonArray levels = doc.createNestedArray("levels");
+        for (int c = 0; c < sizeof(scene.levels); c++)
+        {
+            if (scene.channels & (1 << c))
+            {
+                levels.add(scene.levels[c]);
+            }
+            else
+            {
+                levels.add(nullptr);
+            }
+        }
+    }
+
+    JsonArray groupData = json.createNestedArray("groups");
+    for (GroupConfig &group : LMANConfig::instance->groupConfigs)
+    {
+        JsonObject doc = groupData.createNestedObject();
+        doc["name"] = group.name.c_str();
+        doc["enabled"] = group.enabled ? 1 : 0;
+        doc["fadeTime"] = group.fadeTime;
+        JsonArray members = doc.createNestedArray("channels");
+        for (int c = 0; c < sizeof(LMANConfig::instance->channelConfigs) / sizeof(ChannelConfig); c++)
+        {
+            if (group.channels & (1 << c))
+            {
+                members.add(c + 1);
+            }
+        }
+    }
+
+    JsonArray scheduleData = json.createNestedArray("schedules");
+    for (ScheduleConfig &schedule : LMANConfig::instance->scheduleConfigs)
+    {
+        JsonObject doc = scheduleData.createNestedObject();
+        doc["name"] = schedule.name.c_str();
+        doc["enabled"] = schedule.enabled ? 1 : 0;
+        doc["trigger"] = schedule.trigger;
+        doc["time"] = schedule.time;
+        doc["offset"] = schedule.offset;
+        doc["level"] = schedule.level;
+        doc["fadeTime"] = schedule.fadeTime;
+        JsonArray days = doc.createNestedArray("days");
+        for (int d = 0; d < 7; d++)
+        {
+            if (schedule.days & (1 << d))
+            {
+                days.add(d);
+            }
+        }
+        JsonArray members = doc.createNestedArray("channels");
+        for (int c = 0; c < sizeof(LMANConfig::instance->channelConfigs) / sizeof(ChannelConfig); c++)
+        {
+            if (schedule.channels & (1 << c))
+            {
+                members.add(c + 1);
+            }
+        }
     }
 
     LOG_TRACE("Serializing indexData BaseData");
-    char json_data[2048];
-    serializeJson(json, json_data);
+    size_t length = measureJson(json);
+    // Serialized straight into the message of the socket, which is queued without another copy.
+    AsyncWebSocketMessageBuffer *buffer = WebManager::instance->_indexDataSocket.makeBuffer(length);
+    if (!buffer)
+    {
+        LOG_ERROR("Not enough memory to send base data.");
+        return;
+    }
+    serializeJson(json, (char *)buffer->get(), length + 1);
     LOG_TRACE("Sending indexData BaseData");
-    client->printf(json_data);
+    client->text(buffer);
 }
 
 void WebManager::handleIndexDataEvent(AsyncWebSocket *server, AsyncWebSocketClient *client, AwsEventType type, void *arg, uint8_t *data, size_t len)
@@ -136,7 +337,7 @@ void WebManager::handleIndexDataEvent(AsyncWebSocket *server, AsyncWebSocketClie
             if (info->opcode == WS_TEXT)
             {
                 data[len] = 0;
-                StaticJsonDocument<256> doc;
+                PooledJsonDocument doc(256);
                 DeserializationError error = deserializeJson(doc, (char *)data);
                 if (error)
                 {
@@ -146,8 +347,13 @@ void WebManager::handleIndexDataEvent(AsyncWebSocket *server, AsyncWebSocketClie
                 }
                 uint16_t channel = doc["channel"] | 0;
                 uint8_t dimmingTarget = doc["value"] | 0;
+                uint8_t scene = doc["scene"] | 0;
 
-                if (channel != 0)
+                if (scene != 0)
+                {
+                    LightManager::instance->recallScene(scene - 1);
+                }
+                else if (channel != 0)
                 {
                     for (std::list<DMXChannel>::iterator it = LightManager::instance->dmxChannels.begin(); it != LightManager::instance->dmxChannels.end(); ++it)
                     {
@@ -166,11 +372,11 @@ void WebManager::handleIndexDataEvent(AsyncWebSocket *server, AsyncWebSocketClie
                             }
                             else if (!it->state && dimmingTarget != 0)
                             {
-                                LightManager::instance->autoDimOnToLevel(&(*it), dimmingTarget);
+                                LightManager::instance->autoDimOnToLevel(&(*it), dimmingTarget * LEVEL_SCALE);
                             }
                             else if (it->state)
                             {
-                                LightManager::instance->autoDimTo(&(*it), dimmingTarget);
+                                LightManager::instance->autoDimTo(&(*it), dimmingTarget * LEVEL_SCALE);
                             }
                             else
                             {
@@ -196,7 +402,7 @@ void WebManager::taskSendStatusUpdates(void *param)
     LOG_INFO("Started taskSendStatusUpdates.");
     for (;;)
     {
-        if (WebManager::instance->_mqttClient->connected())
+        if (WebManager::instance->_mqttClient->state() == MQTT_CONNECTED)
         {
             bool sendStatusUpdate = false;
             for (std::list<DMXChannel>::iterator it = LightManager::instance->dmxChannels.begin(); it != LightManager::instance->dmxChannels.end(); ++it)
@@ -217,10 +423,9 @@ void WebManager::taskSendStatusUpdates(void *param)
                 JsonArray channelData = doc.createNestedArray("channels");
                 for (std::list<DMXChannel>::iterator it = LightManager::instance->dmxChannels.begin(); it != LightManager::instance->dmxChannels.end(); ++it)
                 {
-                    StaticJsonDocument<128> data;
+                    JsonObject data = channelData.createNestedObject();
                     data["state"] = it->state ? 1 : 0;
-                    data["level"] = it->level;
-                    channelData.add(data);
+                    data["level"] = it->level >> 8;
                 }
                 char buffer[256];
                 size_t length = serializeJson(doc, buffer);
@@ -245,9 +450,115 @@ bool WebManager::doReboot()
     return this->_doRebootAt > 0 && this->_doRebootAt <= millis();
 }
 
+bool WebManager::doMqttResubscribe()
+{
+    return this->_doMqttResubscribe.exchange(false);
+}
+
+void WebManager::takeStaleTopics(std::list<std::string> &cmdTopics, std::list<std::string> &cfgTopics)
+{
+    // Splicing moves the nodes, nothing is allocated in the critical section
+    portENTER_CRITICAL(&this->_staleTopicsMux);
+    cmdTopics.splice(cmdTopics.end(), this->_staleCmdTopics);
+    cfgTopics.splice(cfgTopics.end(), this->_staleCfgTopics);
+    portEXIT_CRITICAL(&this->_staleTopicsMux);
+}
+
+void WebManager::collectTopics(std::list<std::string> &cmdTopics, std::list<std::string> &cfgTopics)
+{
+    // Built without the topic caches, they belong to the MQTT task
+    for (ChannelConfig &channel : LMANConfig::instance->channelConfigs)
+    {
+        if (channel.enabled && channel.channel != 0)
+        {
+            cmdTopics.push_back(channel.buildBaseTopic() + "/cmd");
+            cfgTopics.push_back(channel.getCfgTopic());
+        }
+    }
+    for (int i = 0; i < sizeof(LMANConfig::instance->sceneConfigs) / sizeof(SceneConfig); i++)
+    {
+        if (LMANConfig::instance->sceneConfigs[i].enabled)
+        {
+            cmdTopics.push_back(LMANConfig::instance->sceneConfigs[i].getBaseTopic(i) + "/cmd");
+            cfgTopics.push_back(LMANConfig::instance->sceneConfigs[i].getCfgTopic(i));
+        }
+    }
+    for (int i = 0; i < sizeof(LMANConfig::instance->groupConfigs) / sizeof(GroupConfig); i++)
+    {
+        if (LMANConfig::instance->groupConfigs[i].enabled)
+        {
+            cmdTopics.push_back(LMANConfig::instance->groupConfigs[i].getBaseTopic(i) + "/cmd");
+            cfgTopics.push_back(LMANConfig::instance->groupConfigs[i].getCfgTopic(i));
+        }
+    }
+    if (LMANConfig::instance->mqtt_raw_enabled)
+    {
+        // Not a Home Assistant entity, there is no config topic to remove
+        cmdTopics.push_back(LMANConfig::instance->buildMqttRawTopic());
+    }
+}
+
+bool WebManager::saveAndApplyConfig(const LMANConfig &previous, const std::list<std::string> &previousCmdTopics, const std::list<std::string> &previousCfgTopics)
+{
+    if (!LMANConfig::instance->saveToLittleFS())
+    {
+        LOG_ERROR("Failed to save new configuration!");
+    }
+
+    uint8_t changes = LMANConfig::instance->diff(previous);
+    LOG_INFO("Config saved. Changes: hot=", (changes & CONFIG_CHANGE_HOT) ? 1 : 0, " resubscribe=", (changes & CONFIG_CHANGE_RESUBSCRIBE) ? 1 : 0, " reboot=", (changes & CONFIG_CHANGE_REBOOT) ? 1 : 0);
+    if (changes & CONFIG_CHANGE_REBOOT)
+    {
+        return true;
+    }
+
+    if (changes & CONFIG_CHANGE_HOT)
+    {
+        LightManager::instance->applyConfig();
+        LogSink::instance->applyConfig();
+        Scheduler::instance->applyConfig();
+    }
+
+    if (changes & CONFIG_CHANGE_RESUBSCRIBE)
+    {
+        // Find the topics no longer in use, the MQTT task rebuilds its topic caches when it resubscribes
+        std::list<std::string> currentCmdTopics;
+        std::list<std::string> currentCfgTopics;
+        WebManager::collectTopics(currentCmdTopics, currentCfgTopics);
+        std::list<std::string> staleCmdTopics;
+        std::list<std::string> staleCfgTopics;
+        for (const std::string &topic : previousCmdTopics)
+        {
+            if (std::find(currentCmdTopics.begin(), currentCmdTopics.end(), topic) == currentCmdTopics.end())
+            {
+                staleCmdTopics.push_back(topic);
+            }
+        }
+        for (const std::string &topic : previousCfgTopics)
+        {
+            if (std::find(currentCfgTopics.begin(), currentCfgTopics.end(), topic) == currentCfgTopics.end())
+            {
+                staleCfgTopics.push_back(topic);
+            }
+        }
+        // Added to the topics of changes the MQTT task has not taken yet. A topic that is in use again is
+        // unsubscribed and then subscribed again by the registration that follows.
+        portENTER_CRITICAL(&this->_staleTopicsMux);
+        this->_staleCmdTopics.splice(this->_staleCmdTopics.end(), staleCmdTopics);
+        this->_staleCfgTopics.splice(this->_staleCfgTopics.end(), staleCfgTopics);
+        portEXIT_CRITICAL(&this->_staleTopicsMux);
+        this->_doMqttResubscribe = true;
+    }
+    return false;
+}
+
 void WebManager::saveConfigFromWeb(AsyncWebServerRequest *request)
 {
-    StaticJsonDocument<2048> config_json;
+    // Keep a copy to find out what changed
+    LMANConfig previous = *LMANConfig::instance;
+    std::list<std::string> previousCmdTopics;
+    std::list<std::string> previousCfgTopics;
+    WebManager::collectTopics(previousCmdTopics, previousCfgTopics);
 
     LMANConfig::instance->wifi_hostname = request->arg("wifi_hostname").c_str();
     LMANConfig::instance->wifi_ssid = request->arg("wifi_ssid").c_str();
@@ -262,12 +573,35 @@ void WebManager::saveConfigFromWeb(AsyncWebServerRequest *request)
     LMANConfig::instance->home_assistant_base_topic = request->arg("mqtt_base_topic").c_str();
     LMANConfig::instance->home_assistant_state_change_wait = request->arg("home_assistant_state_change_wait").toInt();
 
+    LMANConfig::instance->update_url = request->arg("update_url").c_str();
+    LMANConfig::instance->update_poll_interval = request->arg("update_poll_interval").toInt();
+    LMANConfig::instance->update_stagger = request->arg("update_stagger").toInt();
+
+    LMANConfig::instance->artnet_enabled = request->hasArg("artnet_enabled");
+    LMANConfig::instance->artnet_universe = request->arg("artnet_universe").toInt();
+    LMANConfig::instance->dmx_merge_mode = request->arg("dmx_merge_mode").toInt();
+    LMANConfig::instance->dmx_min_frame_rate = request->arg("dmx_min_frame_rate").toInt();
+    LMANConfig::instance->e131_enabled = request->hasArg("e131_enabled");
+    LMANConfig::instance->e131_universe = request->arg("e131_universe").toInt();
+    LMANConfig::instance->mqtt_raw_enabled = request->hasArg("mqtt_raw_enabled");
+    LMANConfig::instance->mqtt_raw_hold = request->arg("mqtt_raw_hold").toInt();
+    LMANConfig::instance->time_zone = request->arg("time_zone").c_str();
+    LMANConfig::instance->ntp_server = request->arg("ntp_server").c_str();
+    LMANConfig::instance->latitude = lroundf(request->arg("latitude").toFloat() * 100);
+    LMANConfig::instance->longitude = lroundf(request->arg("longitude").toFloat() * 100);
+    LMANConfig::instance->log_serial = request->hasArg("log_serial");
+    LMANConfig::instance->syslog_server = request->arg("syslog_server").c_str();
+    LMANConfig::instance->syslog_port = request->arg("syslog_port").toInt();
+
     LMANConfig::instance->buttonPressMaxTime = request->arg("button_max_press").toInt();
     LMANConfig::instance->buttonPressMinTime = request->arg("button_min_press").toInt();
 
     LMANConfig::instance->channelConfigs[0].enabled = request->hasArg("channel1_enabled");
     LMANConfig::instance->channelConfigs[0].name = request->arg("channel1_name").c_str();
     LMANConfig::instance->channelConfigs[0].channel = request->arg("channel1_channel").toInt();
+    LMANConfig::instance->channelConfigs[0].universe = request->arg("channel1_universe").toInt();
+    LMANConfig::instance->channelConfigs[0].fine = request->hasArg("channel1_fine");
+    LMANConfig::instance->channelConfigs[0].type = request->arg("channel1_type").toInt();
     LMANConfig::instance->channelConfigs[0].min = request->arg("channel1_min").toInt();
     LMANConfig::instance->channelConfigs[0].max = request->arg("channel1_max").toInt();
     LMANConfig::instance->channelConfigs[0].dimmingSpeed = request->arg("channel1_dimmingSpeed").toInt();
@@ -277,6 +611,9 @@ void WebManager::saveConfigFromWeb(AsyncWebServerRequest *request)
     LMANConfig::instance->channelConfigs[1].enabled = request->hasArg("channel2_enabled");
     LMANConfig::instance->channelConfigs[1].name = request->arg("channel2_name").c_str();
     LMANConfig::instance->channelConfigs[1].channel = request->arg("channel2_channel").toInt();
+    LMANConfig::instance->channelConfigs[1].universe = request->arg("channel2_universe").toInt();
+    LMANConfig::instance->channelConfigs[1].fine = request->hasArg("channel2_fine");
+    LMANConfig::instance->channelConfigs[1].type = request->arg("channel2_type").toInt();
     LMANConfig::instance->channelConfigs[1].min = request->arg("channel2_min").toInt();
     LMANConfig::instance->channelConfigs[1].max = request->arg("channel2_max").toInt();
     LMANConfig::instance->channelConfigs[1].dimmingSpeed = request->arg("channel2_dimmingSpeed").toInt();
@@ -286,6 +623,9 @@ void WebManager::saveConfigFromWeb(AsyncWebServerRequest *request)
     LMANConfig::instance->channelConfigs[2].enabled = request->hasArg("channel3_enabled");
     LMANConfig::instance->channelConfigs[2].name = request->arg("channel3_name").c_str();
     LMANConfig::instance->channelConfigs[2].channel = request->arg("channel3_channel").toInt();
+    LMANConfig::instance->channelConfigs[2].universe = request->arg("channel3_universe").toInt();
+    LMANConfig::instance->channelConfigs[2].fine = request->hasArg("channel3_fine");
+    LMANConfig::instance->channelConfigs[2].type = request->arg("channel3_type").toInt();
     LMANConfig::instance->channelConfigs[2].min = request->arg("channel3_min").toInt();
     LMANConfig::instance->channelConfigs[2].max = request->arg("channel3_max").toInt();
     LMANConfig::instance->channelConfigs[2].dimmingSpeed = request->arg("channel3_dimmingSpeed").toInt();
@@ -295,6 +635,9 @@ void WebManager::saveConfigFromWeb(AsyncWebServerRequest *request)
     LMANConfig::instance->channelConfigs[3].enabled = request->hasArg("channel4_enabled");
     LMANConfig::instance->channelConfigs[3].name = request->arg("channel4_name").c_str();
     LMANConfig::instance->channelConfigs[3].channel = request->arg("channel4_channel").toInt();
+    LMANConfig::instance->channelConfigs[3].universe = request->arg("channel4_universe").toInt();
+    LMANConfig::instance->channelConfigs[3].fine = request->hasArg("channel4_fine");
+    LMANConfig::instance->channelConfigs[3].type = request->arg("channel4_type").toInt();
     LMANConfig::instance->channelConfigs[3].min = request->arg("channel4_min").toInt();
     LMANConfig::instance->channelConfigs[3].max = request->arg("channel4_max").toInt();
     LMANConfig::instance->channelConfigs[3].dimmingSpeed = request->arg("channel4_dimmingSpeed").toInt();
@@ -313,12 +656,214 @@ void WebManager::saveConfigFromWeb(AsyncWebServerRequest *request)
     LMANConfig::instance->buttonConfigs[3].enabled = request->hasArg("button4_enabled");
     LMANConfig::instance->buttonConfigs[3].channel = request->arg("button4_channel").toInt();
 
-    if (!LMANConfig::instance->saveToLittleFS())
+    for (int i = 0; i < sizeof(LMANConfig::instance->buttonConfigs) / sizeof(ButtonConfig); i++)
     {
-        LOG_ERROR("Failed to save new configuration!");
+        std::string prefix = "button" + std::to_string(i + 1);
+        LMANConfig::instance->buttonConfigs[i].scene = request->arg((prefix + "_scene").c_str()).toInt();
+    }
+
+    for (int i = 0; i < sizeof(LMANConfig::instance->sceneConfigs) / sizeof(SceneConfig); i++)
+    {
+        SceneConfig &scene = LMANConfig::instance->sceneConfigs[i];
+        std::string prefix = "scene" + std::to_string(i + 1);
+        scene.enabled = request->hasArg((prefix + "_enabled").c_str());
+        scene.name = request->arg((prefix + "_name").c_str()).c_str();
+        scene.fadeTime = request->arg((prefix + "_fadeTime").c_str()).toInt();
+        scene.channels = 0;
+        for (int c = 0; c < sizeof(scene.levels); c++)
+        {
+            // An empty level leaves the channel out of the scene
+            String level = request->arg((prefix + "_level" + std::to_string(c + 1)).c_str());
+            scene.levels[c] = level.toInt();
+            if (level.length() > 0)
+            {
+                scene.channels |= 1 << c;
+            }
+        }
+    }
+
+    for (int i = 0; i < sizeof(LMANConfig::instance->groupConfigs) / sizeof(GroupConfig); i++)
+    {
+        GroupConfig &group = LMANConfig::instance->groupConfigs[i];
+        std::string prefix = "group" + std::to_string(i + 1);
+        group.enabled = request->hasArg((prefix + "_enabled").c_str());
+        group.name = request->arg((prefix + "_name").c_str()).c_str();
+        group.fadeTime = request->arg((prefix + "_fadeTime").c_str()).toInt();
+        group.channels = 0;
+        for (int c = 0; c < sizeof(LMANConfig::instance->channelConfigs) / sizeof(ChannelConfig); c++)
+        {
+            if (request->hasArg((prefix + "_channel" + std::to_string(c + 1)).c_str()))
+            {
+                group.channels |= 1 << c;
+            }
+        }
+    }
+
+    for (int i = 0; i < sizeof(LMANConfig::instance->scheduleConfigs) / sizeof(ScheduleConfig); i++)
+    {
+        ScheduleConfig &schedule = LMANConfig::instance->scheduleConfigs[i];
+        std::string prefix = "schedule" + std::to_string(i + 1);
+        schedule.enabled = request->hasArg((prefix + "_enabled").c_str());
+        schedule.name = request->arg((prefix + "_name").c_str()).c_str();
+        schedule.trigger = request->arg((prefix + "_trigger").c_str()).toInt();
+        // The time of day is sent as HH:MM
+        String time = request->arg((prefix + "_time").c_str());
+        schedule.time = time.substring(0, 2).toInt() * 60 + time.substring(3, 5).toInt();
+        schedule.offset = request->arg((prefix + "_offset").c_str()).toInt();
+        schedule.level = request->arg((prefix + "_level").c_str()).toInt();
+        schedule.fadeTime = request->arg((prefix + "_fadeTime").c_str()).toInt();
+        schedule.days = 0;
+        for (int d = 0; d < 7; d++)
+        {
+            if (request->hasArg((prefix + "_day" + std::to_string(d)).c_str()))
+            {
+                schedule.days |= 1 << d;
+            }
+        }
+        schedule.channels = 0;
+        for (int c = 0; c < sizeof(LMANConfig::instance->channelConfigs) / sizeof(ChannelConfig); c++)
+        {
+            if (request->hasArg((prefix + "_channel" + std::to_string(c + 1)).c_str()))
+            {
+                schedule.channels |= 1 << c;
+            }
+        }
+    }
+
+    if (WebManager::instance->saveAndApplyConfig(previous, previousCmdTopics, previousCfgTopics))
+    {
+        request->redirect("/reboot");
+        return;
+    }
+    request->redirect("/");
+}
+
+void WebManager::sendRawConfig(AsyncWebServerRequest *request)
+{
+    PooledJsonDocument config_json(CONFIG_JSON_SIZE);
+    LMANConfig::instance->toJson(config_json);
+    AsyncResponseStream *response = request->beginResponseStream("application/json");
+    serializeJson(config_json, *response);
+    request->send(response);
+}
+
+void WebManager::receiveBody(AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total)
+{
+    if (total > REQUEST_BODY_MAX_SIZE)
+    {
+        return;
+    }
+    if (index == 0)
+    {
+        // Freed by AsyncWebServerRequest when the request is done.
+        request->_tempObject = malloc(total + 1);
+        if (request->_tempObject)
+        {
+            ((char *)request->_tempObject)[total] = 0;
+        }
+    }
+    if (request->_tempObject)
+    {
+        memcpy((uint8_t *)request->_tempObject + index, data, len);
+    }
+}
+
+/// @brief Find values of a config that the controller cannot run with
+/// @return A description of the first bad value, NULL if the config is valid
+static const char *findConfigError(const LMANConfig &config)
+{
+    for (const ChannelConfig &channel : config.channelConfigs)
+    {
+        if (!channel.enabled)
+        {
+            continue;
+        }
+        if (channel.type >= FIXTURE_TYPE_COUNT)
+        {
+            return "Unknown channel type";
+        }
+        if (channel.channel < 1 || channel.channel + channel.getSlotCount() - 1 > 512)
+        {
+            return "Channel outside of 1-512";
+        }
+        if (channel.universe < 1 || channel.universe > DMX_OUTPUT_COUNT)
+        {
+            return "Channel universe does not exist";
+        }
+        if (channel.min > channel.max)
+        {
+            return "Channel min above max";
+        }
+    }
+    for (const ScheduleConfig &schedule : config.scheduleConfigs)
+    {
+        if (schedule.enabled && (schedule.trigger >= SCHEDULE_TRIGGER_COUNT || schedule.time >= 24 * 60))
+        {
+            return "Bad schedule trigger or time";
+        }
+    }
+    if (config.dmx_merge_mode > DMX_MERGE_LTP)
+    {
+        return "Unknown DMX merge mode";
+    }
+    if (config.dmx_min_frame_rate < 1 || config.dmx_min_frame_rate > 44)
+    {
+        return "DMX min frame rate outside of 1-44";
+    }
+    if (config.e131_universe < 1 || config.e131_universe > 63999)
+    {
+        return "sACN universe outside of 1-63999";
+    }
+    return NULL;
+}
+
+void WebManager::importRawConfig(AsyncWebServerRequest *request)
+{
+    if (request->contentLength() > REQUEST_BODY_MAX_SIZE)
+    {
+        request->send(413, "text/plain", "Config too large!");
+        return;
+    }
+    if (!request->_tempObject)
+    {
+        request->send(400, "text/plain", "No config received!");
+        return;
     }
 
-    request->redirect("/reboot");
+    PooledJsonDocument config_json(CONFIG_JSON_SIZE);
+    DeserializationError error = deserializeJson(config_json, (const char *)request->_tempObject);
+    if (error)
+    {
+        LOG_ERROR("Failed to deserialize imported config: ", error.c_str());
+        request->send(400, "text/plain", error.c_str());
+        return;
+    }
+    // Missing values fall back to their defaults, a document without channels is not a config
+    if (!config_json["channels"].is<JsonArray>())
+    {
+        request->send(400, "text/plain", "Not a config, no channels!");
+        return;
+    }
+
+    // The running config is read by the MQTT and log tasks, the import is loaded on its own and takes effect after a reboot
+    LMANConfig imported;
+    imported.loadFromJson(config_json);
+    const char *configError = findConfigError(imported);
+    if (configError)
+    {
+        LOG_ERROR("Imported config is invalid: ", configError);
+        request->send(400, "text/plain", configError);
+        return;
+    }
+    if (!imported.saveToLittleFS())
+    {
+        LOG_ERROR("Failed to save imported configuration!");
+        request->send(500, "text/plain", "Failed to save config!");
+        return;
+    }
+    LOG_INFO("Imported config saved, rebooting.");
+    WebManager::instance->_doRebootAt = millis() + 2000;
+    request->send(200, "text/plain", "OK, rebooting");
 }
 
 void WebManager::respondAvailableWiFiNetworks(AsyncWebServerRequest *request)
@@ -381,71 +926,443 @@ void WebManager::respondAvailableWiFiNetworks(AsyncWebServerRequest *request)
 
 void WebManager::performFirmwareUpdate(AsyncWebServerRequest *request, String filename, size_t index, uint8_t *data, size_t len, bool final)
 {
+    // Multipart uploads of a single file. The web interface uses /ota which can resume interrupted uploads.
     if (!index)
     {
         LOG_INFO("Starting flash of file: '", filename.c_str(), "'. Length:", request->contentLength());
-
-        // Update.runAsync(true);
-        // Detect update type depending on filename
-        int uploadType;
+        int command;
         if (filename.startsWith("firmware") && filename.endsWith(".bin"))
         {
-            uploadType = U_FLASH;
-            uint32_t maxSketchSpace = (ESP.getFreeSketchSpace() - 0x1000) & 0xFFFFF000;
-            if (!Update.begin(maxSketchSpace, uploadType))
-            {
-                LOG_ERROR("Update error! Could not start update, error:");
-                Update.printError(Serial);
-            }
+            command = U_FLASH;
         }
         else if (filename.startsWith("littlefs") && filename.endsWith(".bin"))
         {
-            uploadType = U_SPIFFS;
-            size_t fsSize = LittleFS.totalBytes();
-            if (!Update.begin(fsSize, uploadType))
-            {
-                LOG_ERROR("Update error! Could not start update, error:");
-                Update.printError(Serial);
-            }
+            command = U_SPIFFS;
         }
         else
         {
-            request->send(500, "Unknown file type!");
+            request->send(500, "text/plain", "Unknown file type!");
+            return;
+        }
+        // The size of the file is not known, only the size of the whole form.
+        if (!UpdateManager::instance->begin(command, 0, ""))
+        {
+            request->send(500, "text/plain", UpdateManager::instance->getError());
             return;
         }
     }
 
-    // If no error has occrued, continue updating
-    if (!Update.hasError())
+    if (!UpdateManager::instance->write(data, len))
     {
-        if (Update.write(data, len) != len)
+        if (UpdateManager::instance->isBehind())
         {
-            LOG_ERROR("Update error occured: ");
-            Update.printError(Serial);
+            // A multipart upload cannot be resumed, give up instead of blocking the web server until the flash catches up
+            UpdateManager::instance->abort();
+            request->send(503, "text/plain", "Flash writes fell behind, upload again or use /ota");
         }
-        else
+        return;
+    }
+
+    if (final)
+    {
+        UpdateManager::instance->end();
+        LOG_INFO("Upload of file: ", filename.c_str(), " ended");
+        // The last buffers are still being written. Progress and result is sent on /update_data and /ota.
+        request->send(202, "text/plain", "Accepted");
+    }
+}
+
+void WebManager::receiveUpdateChunk(AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total)
+{
+    size_t offset = request->hasParam("offset") ? request->getParam("offset")->value().toInt() : 0;
+    if (index == 0 && offset == 0)
+    {
+        int command = U_FLASH;
+        if (request->hasParam("image") && request->getParam("image")->value() == "littlefs")
         {
-            int size = index + len;
-            LOG_INFO("Update written ", size);
+            command = U_SPIFFS;
         }
+        size_t size = request->hasParam("size") ? request->getParam("size")->value().toInt() : 0;
+        std::string sha256 = request->hasParam("sha256") ? request->getParam("sha256")->value().c_str() : "";
+        UpdateManager::instance->begin(command, size, sha256);
     }
 
-    if (final)
+    // Only accept data that continues where the previous chunk ended. Anything else is answered
+    // with the current offset in respondUpdateChunk so that the client can resume from there.
+    if (offset + index == UpdateManager::instance->getReceived())
     {
-        Update.end(true);
-        if (filename.startsWith("firmware") && filename.endsWith(".bin"))
+        UpdateManager::instance->write(data, len);
+    }
+}
+
+void WebManager::respondUpdateChunk(AsyncWebServerRequest *request)
+{
+    size_t offset = request->hasParam("offset") ? request->getParam("offset")->value().toInt() : 0;
+    size_t size = request->hasParam("size") ? request->getParam("size")->value().toInt() : 0;
+    UpdateManager *manager = UpdateManager::instance;
+
+    int code = 200;
+    if (manager->getState() == UPDATE_FAILED)
+    {
+        code = 500;
+    }
+    else if (manager->getReceived() != offset + request->contentLength())
+    {
+        // Part of the chunk was not taken while the flash writes catch up, or the chunk does not continue the image.
+        // Either way the client continues from "received".
+        code = manager->isBehind() ? 503 : 409;
+    }
+    else if (manager->getState() == UPDATE_RECEIVING && size > 0 && manager->getReceived() >= size)
+    {
+        manager->end();
+    }
+
+    char buffer[256];
+    manager->getStatusJson(buffer, sizeof(buffer));
+    AsyncWebServerResponse *response = request->beginResponse(code, "application/json", buffer);
+    if (code == 503)
+    {
+        response->addHeader("Retry-After", "1");
+    }
+    request->send(response);
+}
+
+void WebManager::respondUpdateStatus(AsyncWebServerRequest *request)
+{
+    char buffer[256];
+    UpdateManager::instance->getStatusJson(buffer, sizeof(buffer));
+    request->send(200, "application/json", buffer);
+}
+
+void WebManager::respondArtNetStatus(AsyncWebServerRequest *request)
+{
+    if (!ArtNetReceiver::instance)
+    {
+        request->send(200, "application/json", "{\"enabled\":false}");
+        return;
+    }
+    char buffer[256];
+    ArtNetReceiver::instance->getStatusJson(buffer, sizeof(buffer));
+    request->send(200, "application/json", buffer);
+}
+
+void WebManager::respondE131Status(AsyncWebServerRequest *request)
+{
+    if (!E131Receiver::instance)
+    {
+        request->send(200, "application/json", "{\"enabled\":false}");
+        return;
+    }
+    char buffer[256];
+    E131Receiver::instance->getStatusJson(buffer, sizeof(buffer));
+    request->send(200, "application/json", buffer);
+}
+
+void WebManager::respondMqttRawStatus(AsyncWebServerRequest *request)
+{
+    if (!MqttRawReceiver::instance)
+    {
+        request->send(200, "application/json", "{\"enabled\":false}");
+        return;
+    }
+    char buffer[256];
+    MqttRawReceiver::instance->getStatusJson(buffer, sizeof(buffer));
+    request->send(200, "application/json", buffer);
+}
+
+void WebManager::respondScheduleStatus(AsyncWebServerRequest *request)
+{
+    char buffer[384];
+    Scheduler::instance->getStatusJson(buffer, sizeof(buffer));
+    request->send(200, "application/json", buffer);
+}
+
+void WebManager::sendUpdateProgress()
+{
+    if (WebManager::instance)
+    {
+        char buffer[256];
+        size_t length = UpdateManager::instance->getStatusJson(buffer, sizeof(buffer));
+        WebManager::instance->_updateDataSocket.textAll(buffer, length);
+    }
+}
+
+void WebManager::respondLogs(AsyncWebServerRequest *request)
+{
+    if (request->hasArg("raw"))
+    {
+        AsyncResponseStream *response = request->beginResponseStream("application/octet-stream");
+        LMANLog::dump(*response);
+        request->send(response);
+        return;
+    }
+    AsyncResponseStream *response = request->beginResponseStream("text/plain");
+    LMANLog::decode(*response);
+    request->send(response);
+}
+
+void WebManager::respondHeapStatus(AsyncWebServerRequest *request)
+{
+    char buffer[512];
+    size_t length = JsonPool::getStatusJson(buffer, sizeof(buffer));
+    request->send(200, "application/json", length ? buffer : "{}");
+}
+
+void WebManager::respondChannels(AsyncWebServerRequest *request)
+{
+    uint8_t universe = request->hasArg("universe") ? request->arg("universe").toInt() : 1;
+    uint16_t from = request->hasArg("from") ? request->arg("from").toInt() : 1;
+    uint16_t to = request->hasArg("to") ? request->arg("to").toInt() : DMX_UNIVERSE_SIZE;
+    PooledJsonDocument doc(1024);
+    JsonArray channels = doc.to<JsonArray>();
+    for (DMXChannel &channel : LightManager::instance->dmxChannels)
+    {
+        if (!channel.config->enabled || channel.config->universe != universe || channel.config->channel < from || channel.config->channel > to)
         {
-            WebManager::instance->_hasFirmwareUpdated = true;
+            continue;
         }
-        else if (filename.startsWith("littlefs") && filename.endsWith(".bin"))
+        JsonObject channelJson = channels.createNestedObject();
+        channelJson["channel"] = channel.config->channel;
+        channelJson["universe"] = channel.config->universe;
+        channelJson["name"] = channel.config->name.c_str();
+        channelJson["state"] = channel.state;
+        channelJson["level"] = channel.level >> 8;
+        channelJson["level_16"] = channel.level;
+        channelJson["fading"] = channel.isSceneFading || channel.isAutoDimming;
+    }
+    AsyncResponseStream *response = request->beginResponseStream("application/json");
+    serializeJson(doc, *response);
+    request->send(response);
+}
+
+/// @brief Add a command to a batch of fades. A later command for the same channel replaces the earlier one.
+/// @param level The 16 bit level, 0 = turn off
+/// @param transition The fade time in ms
+/// @return False if there is no enabled channel at the slot
+static bool addChannelFade(ChannelFade *fades, uint8_t &count, uint16_t slot, uint8_t universe, uint16_t level, uint32_t transition)
+{
+    for (DMXChannel &channel : LightManager::instance->dmxChannels)
+    {
+        if (!channel.config->enabled || channel.config->channel != slot || channel.config->universe != universe)
+        {
+            continue;
+        }
+        uint8_t i = 0;
+        while (i < count && fades[i].channel != &channel)
         {
-            WebManager::instance->_hasLITTLEFSUpdated = true;
-            LMANConfig::instance->saveToLittleFS(); // Save currently loaded values to LittleFS
+            i++;
         }
-        LOG_INFO("Update of file: ", filename.c_str(), " ended");
-        if (WebManager::instance->_hasFirmwareUpdated && WebManager::instance->_hasLITTLEFSUpdated)
+        fades[i].channel = &channel;
+        fades[i].state = level != 0;
+        fades[i].level = level;
+        fades[i].fadeTime = transition;
+        if (i == count)
         {
-            request->send(200, "text/plain", "OK");
+            count++;
         }
+        return true;
+    }
+    return false;
+}
+
+/// @brief Read a JSON channel command. The level is either "level" (8 bit) or "level_16" (16 bit).
+/// @return A description of the first bad value, NULL if the command is valid
+static const char *parseChannelCommand(JsonObject command, uint16_t &slot, uint8_t &universe, uint16_t &level, uint32_t &transition)
+{
+    JsonVariant value = command["channel"];
+    if (!value.is<long>() || value.as<long>() < 1 || value.as<long>() > DMX_UNIVERSE_SIZE)
+    {
+        return "channel outside of 1-512";
+    }
+    slot = value.as<long>();
+    value = command["universe"];
+    if (!value.isNull() && (!value.is<long>() || value.as<long>() < 1 || value.as<long>() > 255))
+    {
+        return "universe outside of 1-255";
+    }
+    universe = value.isNull() ? 1 : value.as<long>();
+    value = command["level_16"];
+    if (!value.isNull())
+    {
+        if (!value.is<long>() || value.as<long>() < 0 || value.as<long>() > 65535)
+        {
+            return "level_16 outside of 0-65535";
+        }
+        level = value.as<long>();
+    }
+    else
+    {
+        value = command["level"];
+        if (!value.isNull() && (!value.is<long>() || value.as<long>() < 0 || value.as<long>() > 255))
+        {
+            return "level outside of 0-255";
+        }
+        level = value.isNull() ? 0 : value.as<long>() * LEVEL_SCALE;
+    }
+    value = command["transition"];
+    if (!value.isNull() && (!value.is<long>() || value.as<long>() < 0 || value.as<long>() > CHANNEL_MAX_TRANSITION))
+    {
+        return "transition outside of 0-3600000 ms";
     }
-}
\ No newline at end of file
+    transition = value.isNull() ? 0 : value.as<long>();
+    return NULL;
+}
+
+void WebManager::setChannels(AsyncWebServerRequest *request)
+{
+    if (request->contentLength() > REQUEST_BODY_MAX_SIZE)
+    {
+        request->send(413, "text/plain", "Too many commands!");
+        return;
+    }
+    if (!request->_tempObject)
+    {
+        request->send(400, "text/plain", "No commands received!");
+        return;
+    }
+
+    // One fade per channel at most, so the batch always fits
+    ChannelFade fades[sizeof(LMANConfig::instance->channelConfigs) / sizeof(ChannelConfig)];
+    uint8_t count = 0;
+    uint16_t unknown = 0;
+    if (request->contentType() == "application/octet-stream")
+    {
+        const uint8_t *data = (const uint8_t *)request->_tempObject;
+        size_t length = request->contentLength();
+        if (length % CHANNEL_COMMAND_SIZE != 0)
+        {
+            request->send(400, "text/plain", "Body is not a whole number of commands!");
+            return;
+        }
+        for (size_t i = 0; i < length; i += CHANNEL_COMMAND_SIZE)
+        {
+            const uint8_t *command = data + i;
+            if (!addChannelFade(fades, count, command[0] | (command[1] << 8), command[2], command[3] | (command[4] << 8), command[5] | (command[6] << 8)))
+            {
+                unknown++;
+            }
+        }
+    }
+    else
+    {
+        PooledJsonDocument doc(CONFIG_JSON_SIZE);
+        DeserializationError error = deserializeJson(doc, (const char *)request->_tempObject);
+        if (error || !doc.is<JsonArray>())
+        {
+            request->send(400, "text/plain", error ? error.c_str() : "Expected an array of commands!");
+            return;
+        }
+        // Nothing is applied if any command is bad
+        size_t index = 0;
+        for (JsonObject command : doc.as<JsonArray>())
+        {
+            uint16_t slot;
+            uint8_t universe;
+            uint16_t level;
+            uint32_t transition;
+            const char *commandError = parseChannelCommand(command, slot, universe, level, transition);
+            if (commandError)
+            {
+                char message[96];
+                snprintf(message, sizeof(message), "Command %u: %s!", (unsigned)index, commandError);
+                request->send(400, "text/plain", message);
+                return;
+            }
+            if (!addChannelFade(fades, count, slot, universe, level, transition))
+            {
+                unknown++;
+            }
+            index++;
+        }
+    }
+
+    // All channels start fading at the same time in one transaction of the scene fade task
+    LightManager::instance->fadeChannels(fades, count);
+    char buffer[64];
+    snprintf(buffer, sizeof(buffer), "{\"applied\":%u,\"unknown\":%u}", (unsigned)count, (unsigned)unknown);
+    request->send(200, "application/json", buffer);
+}
+
+void WebManager::respondStateJournalStatus(AsyncWebServerRequest *request)
+{
+    if (!StateJournal::instance)
+    {
+        request->send(200, "application/json", "{\"restored\":false}");
+        return;
+    }
+    char buffer[256];
+    StateJournal::instance->getStatusJson(buffer, sizeof(buffer));
+    request->send(200, "application/json", buffer);
+}
+
+void WebManager::respondTaskStatus(AsyncWebServerRequest *request)
+{
+    if (request->hasArg("reset"))
+    {
+        resetTaskTimings();
+    }
+    AsyncResponseStream *response = request->beginResponseStream("application/json");
+    char buffer[2048];
+    size_t length = getTasksJson(buffer, sizeof(buffer));
+    response->write((const uint8_t *)buffer, length);
+    request->send(response);
+}
+
+void WebManager::respondDMXStatus(AsyncWebServerRequest *request)
+{
+    char buffer[256 * DMX_OUTPUT_COUNT];
+    size_t length = 0;
+    buffer[length++] = '[';
+    for (uint8_t i = 0; i < DMX_OUTPUT_COUNT; i++)
+    {
+        DMXOutput *output = DMXOutput::instances[i];
+        if (!output)
+        {
+            continue;
+        }
+        if (request->hasArg("reset"))
+        {
+            output->resetTiming();
+        }
+        if (length > 1)
+        {
+            buffer[length++] = ',';
+        }
+        length += output->getStatusJson(buffer + length, sizeof(buffer) - length - 1);
+    }
+    buffer[length++] = ']';
+    buffer[length] = '\0';
+    request->send(200, "application/json", buffer);
+}
+
+void WebManager::respondRDMStatus(AsyncWebServerRequest *request)
+{
+    RDMManager *rdm = RDMManager::instance;
+    if (!rdm)
+    {
+        request->send(200, "application/json", "{\"supported\":false}");
+        return;
+    }
+    if (request->hasArg("discover"))
+    {
+        rdm->startDiscovery();
+    }
+    if (request->hasArg("uid") && request->hasArg("address"))
+    {
+        RDMUid uid;
+        long address = request->arg("address").toInt();
+        if (!rdmParseUid(request->arg("uid").c_str(), uid) || address < 1 || address > DMX_UNIVERSE_SIZE)
+        {
+            request->send(400, "text/plain", "Invalid UID or address!");
+            return;
+        }
+        if (!rdm->setStartAddress(uid, address))
+        {
+            request->send(503, "text/plain", "Previous request still pending!");
+            return;
+        }
+    }
+    AsyncResponseStream *response = request->beginResponseStream("application/json");
+    rdm->printStatusJson(*response);
+    request->send(response);
+}
@@ -6,6 +6,11 @@
 #include <ESPAsyncWebServer.h>
 #include <ArduinoJson.h>
 #include <PubSubClient.h>
+#include <UpdateManager.h>
+#include <atomic>
+#include <list>
+#include <map>
+#include <string>
 
 class WebManager
 {
@@ -16,21 +21,97 @@ public:
     /// @brief Indicate wether a reboot should be done or not
     /// @return True = time to reboot
     bool doReboot();
+    /// @brief Indicate wether MQTT topics has changed and a re-subscribe and re-registration is needed.
+    /// Clears the request.
+    /// @return True = time to re-subscribe
+    bool doMqttResubscribe();
+    /// @brief Move the topics that are no longer in use since the last config changes to the given lists. Called by the MQTT task.
+    /// @param cmdTopics Appended with the command topics to unsubscribe from
+    /// @param cfgTopics Appended with the Home Assistant config topics to remove
+    void takeStaleTopics(std::list<std::string> &cmdTopics, std::list<std::string> &cfgTopics);
     static WebManager *instance;
     static void handleIndexDataEvent(AsyncWebSocket *server, AsyncWebSocketClient *client, AwsEventType type, void *arg, uint8_t *data, size_t len);
     static void sendBaseData(AsyncWebSocketClient *client);
     static void taskSendStatusUpdates(void *param);
+    /// @brief Collect the topics of the enabled channels and scenes. Taken before a config change to find the stale ones afterwards.
+    static void collectTopics(std::list<std::string> &cmdTopics, std::list<std::string> &cfgTopics);
+    /// @brief Save the config and apply what changed since previous, without a reboot where possible
+    /// @param previous The config before the change
+    /// @param previousCmdTopics The command topics before the change, from collectTopics()
+    /// @param previousCfgTopics The Home Assistant config topics before the change, from collectTopics()
+    /// @return True if a reboot is needed for the change to take effect
+    bool saveAndApplyConfig(const LMANConfig &previous, const std::list<std::string> &previousCmdTopics, const std::list<std::string> &previousCfgTopics);
     static void saveConfigFromWeb(AsyncWebServerRequest *request);
+    /// @brief Respond with the current config in the config.json format
+    static void sendRawConfig(AsyncWebServerRequest *request);
+    /// @brief Import a config in the config.json format from the request body. The config is validated and saved, it takes effect after a reboot.
+    static void importRawConfig(AsyncWebServerRequest *request);
+    /// @brief Collect a request body into request->_tempObject, null terminated
+    static void receiveBody(AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total);
     static void respondAvailableWiFiNetworks(AsyncWebServerRequest *request);
     static void performFirmwareUpdate(AsyncWebServerRequest *request, String filename, size_t index, uint8_t *data, size_t len, bool final);
+    /// @brief Receive a chunk of an update image on /ota. The image type, offset of the chunk, total size and
+    /// SHA-256 are given as query parameters. An offset of 0 starts a new update.
+    static void receiveUpdateChunk(AsyncWebServerRequest *request, uint8_t *data, size_t len, size_t index, size_t total);
+    /// @brief Respond to a chunk received by receiveUpdateChunk. Finishes the update when all data is received.
+    static void respondUpdateChunk(AsyncWebServerRequest *request);
+    /// @brief Respond with the update status. Used to find the offset to resume an interrupted upload from.
+    static void respondUpdateStatus(AsyncWebServerRequest *request);
+    /// @brief Respond with the Art-Net receive statistics
+    static void respondArtNetStatus(AsyncWebServerRequest *request);
+    /// @brief Respond with the sACN receive statistics
+    static void respondE131Status(AsyncWebServerRequest *request);
+    /// @brief Respond with the raw MQTT receive statistics
+    static void respondMqttRawStatus(AsyncWebServerRequest *request);
+    /// @brief Respond with the clock, today's sunrise and sunset and the next schedule
+    static void respondScheduleStatus(AsyncWebServerRequest *request);
+    /// @brief Respond with the JSON pool usage and heap fragmentation
+    static void respondHeapStatus(AsyncWebServerRequest *request);
+    /// @brief Respond with the task placement and DMX timing. Resets the timing if "reset" is set.
+    static void respondTaskStatus(AsyncWebServerRequest *request);
+    /// @brief Respond with the slot count, frame rate and frame interval of each DMX output. Resets the interval if "reset" is set.
+    static void respondDMXStatus(AsyncWebServerRequest *request);
+    /// @brief Respond with the RDM devices. Starts discovery if "discover" is set, sets the start address of a device if "uid" and "address" are set.
+    static void respondRDMStatus(AsyncWebServerRequest *request);
+    /// @brief Respond with the state, 8 bit "level" and 16 bit "level_16" of the channels in a range.
+    /// "universe", "from" and "to" select the range, default all of universe 1.
+    static void respondChannels(AsyncWebServerRequest *request);
+    /// @brief Set many channels in one fade. The body is a JSON array of {channel, universe, level or level_16, transition}
+    /// or, as application/octet-stream, CHANNEL_COMMAND_SIZE bytes per command with a 16 bit level.
+    /// Answers 400 naming the first bad command and 413 if the body is larger than REQUEST_BODY_MAX_SIZE.
+    static void setChannels(AsyncWebServerRequest *request);
+    /// @brief Respond with the write statistics of the channel state journal
+    static void respondStateJournalStatus(AsyncWebServerRequest *request);
+    /// @brief Respond with the deferred log as text, or as raw records for logdecode.py if "raw" is set
+    static void respondLogs(AsyncWebServerRequest *request);
+    /// @brief Send update progress to all clients on /update_data
+    static void sendUpdateProgress();
+    /// @brief Send a web asset from LittleFS, using the gzipped variant and content hash ETag if available.
+    /// Answers with 304 if the client already has the current version.
+    /// @param request The request to answer
+    /// @param path The path of the asset in LittleFS (without .gz)
+    /// @param cacheControl The Cache-Control header to send with the asset
+    static void sendAsset(AsyncWebServerRequest *request, const char *path, const char *cacheControl);
 
 private:
     AsyncWebServer _server = AsyncWebServer(80);
     AsyncWebSocket _indexDataSocket = AsyncWebSocket("/index_data");
+    /// @brief Only its state() is read here, the client belongs to taskWiFiMqttHandler
     PubSubClient *_mqttClient;
     unsigned long _doRebootAt;
-    bool _hasFirmwareUpdated = false;
-    bool _hasLITTLEFSUpdated = false;
+    AsyncWebSocket _updateDataSocket = AsyncWebSocket("/update_data");
+    /// @brief Streams the log, shares its path with the GET /logs route for the deferred log
+    AsyncWebSocket _logSocket = AsyncWebSocket("/logs");
+    std::atomic<bool> _doMqttResubscribe{false};
+    /// @brief Topics no longer in use, collected until the MQTT task takes them. Guarded by _staleTopicsMux.
+    std::list<std::string> _staleCmdTopics;
+    std::list<std::string> _staleCfgTopics;
+    /// @brief Config changes are saved on async_tcp or the Arduino loop, the MQTT task takes the stale topics. Only held to splice the lists.
+    portMUX_TYPE _staleTopicsMux = portMUX_INITIALIZER_UNLOCKED;
+    /// @brief Content hash for each asset, read from "/etags" created by compressassets.py
+    std::map<std::string, std::string> _assetTags;
+    /// @brief Load the content hashes of all assets from LittleFS
+    void _loadAssetTags();
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,80 @@
+#!/usr/bin/env python
+# DMX timing under network load.
+#
+# Resets the timing counters of a controller, loads its web server (and
+# optionally MQTT) for a while and prints the DMX frame and effect period
+# timing from http://<controller>/tasks. Start an effect on a channel first
+# so that frames are sent at a fixed rate, for example by publishing
+# {"effect": "breathe"} to its command topic. Run once per firmware to compare:
+#   python loadtest.py 192.168.1.50 --seconds 60 --threads 8
+import argparse
+import json
+import threading
+import time
+import urllib.request
+
+PATHS = ["/", "/update", "/connection_test", "/heap", "/artnet"]
+
+
+def fetch(host, path, timeout=5):
+    with urllib.request.urlopen("http://%s%s" % (host, path), timeout=timeout) as response:
+        return response.read()
+
+
+def web_load(host, stop, counter):
+    i = 0
+    while not stop.is_set():
+        try:
+            fetch(host, PATHS[i % len(PATHS)])
+            counter[0] += 1
+        except Exception:
+            counter[1] += 1
+        i += 1
+
+
+def mqtt_load(broker, topic, stop, counter):
+    import paho.mqtt.client as mqtt  # Only needed with --mqtt
+    client = mqtt.Client()
+    client.connect(broker)
+    client.loop_start()
+    level = 0
+    while not stop.is_set():
+        client.publish(topic, json.dumps({"brightness": level}))
+        counter[0] += 1
+        level = (level + 7) % 256
+        time.sleep(0.01)
+    client.loop_stop()
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Measure DMX timing of a controller under web and MQTT load.")
+    parser.add_argument("host")
+    parser.add_argument("--seconds", type=int, default=60)
+    parser.add_argument("--threads", type=int, default=4, help="Parallel web clients")
+    parser.add_argument("--mqtt", help="MQTT broker to send brightness commands through")
+    parser.add_argument("--topic", help="Command topic of a channel other than the one running the effect")
+    args = parser.parse_args()
+
+    fetch(args.host, "/tasks?reset")
+    stop = threading.Event()
+    web_counter = [0, 0]
+    mqtt_counter = [0]
+    workers = [threading.Thread(target=web_load, args=(args.host, stop, web_counter)) for _ in range(args.threads)]
+    if args.mqtt and args.topic:
+        workers.append(threading.Thread(target=mqtt_load, args=(args.mqtt, args.topic, stop, mqtt_counter)))
+    for worker in workers:
+        worker.start()
+    time.sleep(args.seconds)
+    stop.set()
+    for worker in workers:
+        worker.join()
+
+    status = json.loads(fetch(args.host, "/tasks"))
+    print("Web requests: %d ok, %d failed. MQTT commands: %d" % (web_counter[0], web_counter[1], mqtt_counter[0]))
+    for name, timing in status["timing"].items():
+        print("%-14s count %7d  min %7d us  avg %7d us  max %7d us  jitter %7d us" % (
+            name, timing["count"], timing["min"], timing["avg"], timing["max"], timing["max"] - timing["min"]))
+
+
+if __name__ == "__main__":
+    main()
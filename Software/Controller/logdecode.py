@@ -0,0 +1,55 @@
+#!/usr/bin/env python
+# Decode the deferred log of a controller on the host.
+#
+# Fetches the raw log records from http://<controller>/logs?raw and formats
+# them with the format strings from lib/LMANLog/LMANLog.cpp, so that the
+# formats of a build can be used with a log saved earlier:
+#
+#   python logdecode.py --host 192.168.1.50
+#   curl -o log.bin http://192.168.1.50/logs?raw && python logdecode.py --file log.bin
+import argparse
+import os
+import re
+import struct
+import urllib.request
+
+# struct LogRecord in LMANLog.h
+RECORD = struct.Struct("<IHBB3I")
+LEVELS = ["NONE", "ERROR", "WARNING", "INFO", "DEBUG", "TRACE"]
+
+
+def load_formats(source):
+    with open(source) as f:
+        text = f.read()
+    table = re.search(r"LOG_FORMATS\[LOGF_COUNT\] = \{(.*?)\};", text, re.S).group(1)
+    return [bytes(s, "ascii").decode("unicode_escape") for s in re.findall(r'"((?:[^"\\]|\\.)*)"', table)]
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Decode the deferred log of a controller.")
+    group = parser.add_mutually_exclusive_group(required=True)
+    group.add_argument("--host", help="Address of the controller")
+    group.add_argument("--file", help="Raw log saved from /logs?raw")
+    parser.add_argument("--source", default=os.path.join(os.path.dirname(__file__), "lib", "LMANLog", "LMANLog.cpp"))
+    args = parser.parse_args()
+
+    formats = load_formats(args.source)
+    if args.host:
+        data = urllib.request.urlopen("http://%s/logs?raw" % args.host).read()
+    else:
+        with open(args.file, "rb") as f:
+            data = f.read()
+
+    for offset in range(0, len(data) - RECORD.size + 1, RECORD.size):
+        time, fmt, level, arg_count, *values = RECORD.unpack_from(data, offset)
+        level_name = LEVELS[level] if level < len(LEVELS) else "?"
+        if fmt < len(formats):
+            # %u is the only conversion used by the formats
+            message = formats[fmt] % tuple(values[:formats[fmt].count("%u")])
+        else:
+            message = "Unknown format %d" % fmt
+        print("[%10d us] %s: %s" % (time, level_name, message))
+
+
+if __name__ == "__main__":
+    main()
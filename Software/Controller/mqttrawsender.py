@@ -0,0 +1,96 @@
+#!/usr/bin/env python
+# Raw MQTT DMX source. Streams levels to the controller's raw topic
+# (<base topic>light/<hostname>/raw) at a fixed rate and reports how many
+# messages the controller merged, read from http://<controller>/mqtt_raw.
+# A message is the first slot as 16 bit big-endian followed by the levels.
+#
+# Enable "Receive raw DMX levels over MQTT" on the config page and run for example:
+#   python mqttrawsender.py 192.168.1.50 192.168.1.10 --slots 512 --rate 44 --seconds 30
+#   python mqttrawsender.py 192.168.1.50 192.168.1.10 --slots 4 --rate 0
+# --rate 0 sends as fast as the broker accepts. The broker latency is measured
+# by subscribing to the raw topic as well, the time the controller needs per
+# message is its processing_us.
+import argparse
+import json
+import math
+import struct
+import threading
+import time
+import urllib.request
+
+import paho.mqtt.client as mqtt
+
+
+def status(host):
+    with urllib.request.urlopen("http://%s/mqtt_raw" % host, timeout=5) as response:
+        return json.loads(response.read())
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Stream raw DMX levels to a controller over MQTT.")
+    parser.add_argument("host", help="The controller, for the receive statistics")
+    parser.add_argument("broker")
+    parser.add_argument("--base-topic", default="homeassistant/")
+    parser.add_argument("--hostname", default="lman", help="Host name of the controller, part of the topic")
+    parser.add_argument("--start", type=int, default=1, help="First slot, 1-512")
+    parser.add_argument("--slots", type=int, default=512, help="Levels per message")
+    parser.add_argument("--rate", type=float, default=44, help="Messages per second, 0 = as fast as possible")
+    parser.add_argument("--seconds", type=float, default=30)
+    parser.add_argument("--period", type=float, default=4, help="Seconds per fade cycle")
+    args = parser.parse_args()
+
+    topic = "%slight/%s/raw" % (args.base_topic, args.hostname)
+    latencies = []
+    sent_at = {}
+    lock = threading.Lock()
+
+    def on_message(client, userdata, message):
+        now = time.time()
+        with lock:
+            start = sent_at.pop(message.payload[2:6], None)
+        if start is not None:
+            latencies.append(now - start)
+
+    client = mqtt.Client()
+    client.on_message = on_message
+    client.connect(args.broker)
+    client.subscribe(topic)
+    client.loop_start()
+
+    before = status(args.host)
+    if not before.get("enabled"):
+        print("Raw MQTT is disabled on the controller")
+    start = time.time()
+    sent = 0
+    while time.time() - start < args.seconds:
+        phase = (time.time() - start) / args.period * 2 * math.pi
+        level = int((math.sin(phase) + 1) * 127.5)
+        data = bytearray([level] * args.slots)
+        # The first 4 levels carry the message number so the loopback can match it
+        data[:4] = struct.pack(">I", sent)[:min(4, args.slots)]
+        with lock:
+            sent_at[bytes(data[:4])] = time.time()
+        client.publish(topic, struct.pack(">H", args.start) + bytes(data))
+        sent += 1
+        if args.rate > 0:
+            delay = start + sent / args.rate - time.time()
+            if delay > 0:
+                time.sleep(delay)
+    elapsed = time.time() - start
+    time.sleep(1)
+    client.loop_stop()
+    after = status(args.host)
+
+    merged = after["messages"] - before["messages"]
+    print("Sent %d messages of %d levels in %.1f s = %.0f messages/s" % (sent, args.slots, elapsed, sent / elapsed))
+    print("Controller merged %d (%.1f %%), %.0f messages/s, rejected %d" % (
+        merged, 100.0 * merged / sent if sent else 0, merged / elapsed, after["rejected"] - before["rejected"]))
+    print("Controller processing: last %d us, max %d us" % (after["processing_us"], after["max_processing_us"]))
+    if latencies:
+        latencies.sort()
+        print("Broker loopback latency: median %.1f ms, 99th percentile %.1f ms" % (
+            latencies[len(latencies) // 2] * 1000, latencies[int(len(latencies) * 0.99)] * 1000))
+
+
+if __name__ == "__main__":
+    main()
@@ -1,29 +1,75 @@
-#include <ArduLog.h>
+#include <LMANLog.h>
 #include <Arduino.h>
 #include <string>
 #include <LightManager.h>
 #include <pins.h>
 #include <LMANConfig.h>
-#include <ESPDMX.h>
+#include <DMXOutput.h>
 #include <WiFi.h>
 #include <PubSubClient.h>
 #include <WebManager.h>
+#include <UpdateManager.h>
+#include <DMXMerger.h>
+#include <RDMManager.h>
+#include <StateJournal.h>
+#include <Scheduler.h>
+#include <ArtNet.h>
+#include <E131.h>
+#include <MqttRaw.h>
+#include <LogSink.h>
+#include <JsonPool.h>
+#include <LMANTasks.h>
 #include <version.h>
 
 ArduLog logger;
+LogSink logSink;
 LMANConfig config;
 LightManager lMan;
-DMXESPSerial dmx;
+DMXOutput dmx[DMX_OUTPUT_COUNT];
+DMXMerger dmxMerger[DMX_OUTPUT_COUNT];
+/// @brief UART and TX pin of each universe. UART0 carries the serial log.
+const uart_port_t DMX_OUTPUT_PORTS[DMX_OUTPUT_COUNT] = {UART_NUM_2, UART_NUM_1};
+const int DMX_OUTPUT_PINS[DMX_OUTPUT_COUNT] = {PIN_DMX_DATA, PIN_DMX_DATA_2};
+ArtNetReceiver artNet;
+E131Receiver e131;
+MqttRawReceiver mqttRaw;
+RDMManager rdm;
+StateJournal stateJournal;
+Scheduler scheduler;
 TaskHandle_t taskHandleErrorLedHandle = NULL;
-TaskHandle_t taskHandleSendDMXData = NULL;
+TaskHandle_t taskHandleSendDMXData[DMX_OUTPUT_COUNT] = {NULL};
 WiFiClient espClient;
 PubSubClient mqttClient(espClient);
 WebManager webMan;
+UpdateManager updateMan;
 bool lastResetButtonState = false;
 bool homeassistantStatus = true;
 unsigned long lastHomeAssistantStateChange = 0;
 bool homeAssistantStateChangeHandled = true;
 unsigned long lastResetButtonStateChange = 0;
+unsigned long lastHeapStatusLog = 0;
+/// @brief Wether the boot stage times were sent to MQTT
+bool bootReported = false;
+/// @brief Time in ms to wait for the WiFi connection before starting over
+#define WIFI_CONNECT_TIMEOUT 10000
+/// @brief Time in ms between checks of the WiFi connection while connecting
+#define WIFI_CONNECT_POLL 50
+/// @brief Time in ms between checks of the WiFi and MQTT connections
+#define CONNECTION_CHECK_INTERVAL 10000
+/// @brief Time in ms between MQTT polls, incoming commands and state updates wait at most this long
+#define MQTT_LOOP_INTERVAL 100
+/// @brief Longest transition in s taken from a Home Assistant command, an hour
+#define MAX_TRANSITION 3600
+
+/// @brief The state of a group last sent to MQTT, a group is only sent when it changes
+struct GroupState
+{
+  bool sent = false;
+  bool state = false;
+  uint8_t brightness = 0;
+  Color color;
+};
+GroupState groupStates[sizeof(LMANConfig::groupConfigs) / sizeof(GroupConfig)];
 
 void taskHandleErrorLed(void *param)
 {
@@ -42,8 +88,9 @@ void taskHandleErrorLed(void *param)
     {
       digitalWrite(PIN_ERROR_LED, 1);
     }
-    else if (!mqttClient.connected())
+    else if (mqttClient.state() != MQTT_CONNECTED)
     {
+      // Only reads the state, connected() may close the connection and belongs to taskWiFiMqttHandler
       digitalWrite(PIN_ERROR_LED, (millis() / 500) % 2 == 0);
     }
     else
@@ -55,24 +102,207 @@ void taskHandleErrorLed(void *param)
   }
 }
 
+/// @brief The topic where this device is told to check for updates. Built once as it only changes with a reboot.
+const std::string &getUpdateTopic()
+{
+  static std::string topic;
+  if (topic.empty())
+  {
+    topic = LMANConfig::instance->home_assistant_base_topic;
+    topic.append("light/");
+    topic.append(LMANConfig::instance->wifi_hostname);
+    topic.append("/update");
+  }
+  return topic;
+}
+
+/// @brief The topic where all devices are told to check for updates. Built once as it only changes with a reboot.
+const std::string &getFleetUpdateTopic()
+{
+  static std::string topic;
+  if (topic.empty())
+  {
+    topic = LMANConfig::instance->home_assistant_base_topic;
+    topic.append("light/update");
+  }
+  return topic;
+}
+
+/// @brief The topic the boot stage times are sent to once after boot
+const std::string &getBootTopic()
+{
+  static std::string topic;
+  if (topic.empty())
+  {
+    topic = LMANConfig::instance->home_assistant_base_topic;
+    topic.append("light/");
+    topic.append(LMANConfig::instance->wifi_hostname);
+    topic.append("/boot");
+  }
+  return topic;
+}
+
+/// @brief Compare a payload that is not null terminated to a string
+bool payloadEquals(const byte *payload, unsigned int length, const char *value)
+{
+  return strlen(value) == length && memcmp(payload, value, length) == 0;
+}
+
+/// @brief Wether a fixture can be set to a color mode, the Home Assistant supported_color_modes
+bool fixtureSupportsColorMode(uint8_t type, uint8_t mode)
+{
+  switch (type)
+  {
+  case FIXTURE_RGB:
+    return mode == COLOR_MODE_HS || mode == COLOR_MODE_RGB;
+  case FIXTURE_RGBW:
+    return mode == COLOR_MODE_HS || mode == COLOR_MODE_RGBW;
+  case FIXTURE_CCT:
+    return mode == COLOR_MODE_COLOR_TEMP;
+  default:
+    return false;
+  }
+}
+
+/// @brief Read the transition of a Home Assistant JSON command, given in seconds
+/// @param fallback The fade time in ms if the command has no transition
+/// @return The fade time in ms, at most MAX_TRANSITION s
+uint32_t transitionFromMqtt(JsonDocument &doc, uint32_t fallback)
+{
+  if (!doc.containsKey("transition"))
+  {
+    return fallback;
+  }
+  float transition = doc["transition"].as<float>();
+  // Negative, NaN and non-numeric transitions change straight away
+  if (!(transition > 0))
+  {
+    return 0;
+  }
+  return min(transition, (float)MAX_TRANSITION) * 1000;
+}
+
+/// @brief Read the color of a Home Assistant JSON command
+/// @return False if the command has no color
+bool colorFromMqtt(JsonDocument &doc, Color &color)
+{
+  if (doc.containsKey("color_temp"))
+  {
+    color.mode = COLOR_MODE_COLOR_TEMP;
+    color.mireds = constrain(doc["color_temp"].as<int>(), FIXTURE_COLD_MIREDS, FIXTURE_WARM_MIREDS);
+    return true;
+  }
+  if (!doc.containsKey("color"))
+  {
+    return false;
+  }
+  JsonObject value = doc["color"];
+  if (value.containsKey("h"))
+  {
+    // Hue in degrees, saturation in percent
+    color.mode = COLOR_MODE_HS;
+    color.hue = (uint32_t)(value["h"].as<float>() * 65536.0f / 360.0f) & 0xFFFF;
+    color.saturation = constrain(value["s"].as<float>(), 0.0f, 100.0f) * 255.0f / 100.0f + 0.5f;
+    return true;
+  }
+  color.mode = value.containsKey("w") ? COLOR_MODE_RGBW : COLOR_MODE_RGB;
+  color.rgbw[0] = value["r"] | 0;
+  color.rgbw[1] = value["g"] | 0;
+  color.rgbw[2] = value["b"] | 0;
+  color.rgbw[3] = value["w"] | 0;
+  return true;
+}
+
+/// @brief Add the color of a fixture to a Home Assistant JSON state
+void colorToMqtt(const Color &color, uint8_t type, JsonDocument &doc)
+{
+  uint8_t mode = color.mode;
+  uint16_t hue = color.hue;
+  uint8_t saturation = color.saturation;
+  if (!fixtureSupportsColorMode(type, mode))
+  {
+    // Set while the fixture had an other type, report what it looks like
+    uint8_t rgb[3];
+    colorToRgb(color, rgb);
+    colorRgbToHs(rgb, hue, saturation);
+    mode = type == FIXTURE_CCT ? COLOR_MODE_COLOR_TEMP : COLOR_MODE_HS;
+  }
+  doc["color_mode"] = COLOR_MODE_NAMES[mode];
+  if (mode == COLOR_MODE_COLOR_TEMP)
+  {
+    doc["color_temp"] = color.mireds;
+    return;
+  }
+  JsonObject value = doc.createNestedObject("color");
+  if (mode == COLOR_MODE_HS)
+  {
+    value["h"] = hue * 360.0f / 65536.0f;
+    value["s"] = saturation * 100.0f / 255.0f;
+    return;
+  }
+  value["r"] = color.rgbw[0];
+  value["g"] = color.rgbw[1];
+  value["b"] = color.rgbw[2];
+  if (mode == COLOR_MODE_RGBW)
+  {
+    value["w"] = color.rgbw[3];
+  }
+}
+
+/// @brief Apply a Home Assistant JSON command to all members of a group, parsed once and faded together
+/// @param index The index of the group in LMANConfig::groupConfigs
+void handleGroupCommand(uint8_t index, JsonDocument &doc)
+{
+  GroupConfig &group = LMANConfig::instance->groupConfigs[index];
+  LOG_INFO("Got MQTT command for group ", LOG_BOLD, group.name.c_str());
+  uint32_t fadeTime = transitionFromMqtt(doc, group.fadeTime);
+  Color color;
+  bool hasColor = colorFromMqtt(doc, color);
+  for (int i = 0; i < sizeof(LMANConfig::instance->channelConfigs) / sizeof(ChannelConfig); i++)
+  {
+    DMXChannel *channel = lMan.getChannel(i);
+    if (!channel || !(group.channels & (1 << i)))
+    {
+      continue;
+    }
+    if (doc.containsKey("effect"))
+    {
+      lMan.setEffect(channel, effectFromName(doc["effect"] | "none"));
+    }
+    // Tunable white members only take a color temperature, the other members of a mixed group still change
+    if (hasColor && channel->config->type != FIXTURE_DIMMER && (channel->config->type != FIXTURE_CCT || color.mode == COLOR_MODE_COLOR_TEMP))
+    {
+      channel->setColor(color, fadeTime);
+    }
+  }
+  if (doc.containsKey("state") || doc.containsKey("brightness") || hasColor)
+  {
+    // Group brightness is 0-255 whatever the resolution of the members
+    bool state = strcmp(doc["state"] | "ON", "OFF") != 0;
+    uint16_t level = constrain(doc["brightness"] | 0, 0, 255) * LEVEL_SCALE;
+    lMan.setGroup(index, state, level, fadeTime);
+  }
+}
+
 void mqttCallback(char *topic, byte *payload, unsigned int length)
 {
-  std::string tpc = topic;
-  std::string pld;
-  pld.assign((char *)payload, length);
-  LOG_TRACE("Got message on ", LOG_BOLD, tpc.c_str());
-  LOG_TRACE(pld.c_str());
+  // Raw levels are streamed at a high rate, they skip the topic scan and the JSON parsing below
+  if (mqttRaw.handleMessage(topic, payload, length))
+  {
+    return;
+  }
 
-  std::string homeassistantStatusTopic = LMANConfig::instance->home_assistant_base_topic;
-  homeassistantStatusTopic.append("status");
+  LOG_TRACE("Got message on ", LOG_BOLD, topic);
 
-  if (homeassistantStatusTopic.compare(tpc) == 0)
+  // Compared in place, building the topic would allocate for every message.
+  const std::string &homeAssistantBaseTopic = LMANConfig::instance->home_assistant_base_topic;
+  if (strncmp(topic, homeAssistantBaseTopic.c_str(), homeAssistantBaseTopic.size()) == 0 && strcmp(topic + homeAssistantBaseTopic.size(), "status") == 0)
   {
-    if (pld.compare("offline") == 0)
+    if (payloadEquals(payload, length, "offline"))
     {
       LOG_ERROR("New HA status ", LOG_BOLD, "OFFLINE", LOG_RESET_DECORATIONS, ". Manual control via web interface and physical buttons will still work.");
     }
-    else if (pld.compare("online") == 0)
+    else if (payloadEquals(payload, length, "online"))
     {
       lastHomeAssistantStateChange = millis();
       homeAssistantStateChangeHandled = false;
@@ -80,13 +310,31 @@ void mqttCallback(char *topic, byte *payload, unsigned int length)
     }
     else
     {
-      LOG_INFO("Got state update for home asssistant, unknown new state: ", LOG_BOLD, pld.c_str());
+      LOG_INFO("Got state update for home asssistant, unknown new state: ", LOG_BOLD, std::string((char *)payload, length).c_str());
     }
     return;
   }
 
+  if (getUpdateTopic().compare(topic) == 0 || getFleetUpdateTopic().compare(topic) == 0)
+  {
+    // The payload may hold a manifest URL to use instead of the configured one
+    LOG_INFO("Update check requested via MQTT.");
+    UpdateManager::instance->requestPull(std::string((char *)payload, length));
+    return;
+  }
+
+  for (int i = 0; i < sizeof(LMANConfig::instance->sceneConfigs) / sizeof(SceneConfig); i++)
+  {
+    if (LMANConfig::instance->sceneConfigs[i].enabled && LMANConfig::instance->sceneConfigs[i].getCmdTopic(i).compare(topic) == 0)
+    {
+      LOG_INFO("Got MQTT command for scene ", LOG_BOLD, LMANConfig::instance->sceneConfigs[i].name.c_str());
+      lMan.recallScene(i);
+      return;
+    }
+  }
+
   // Message was not a home assistant state update, try to parse as a JSON and state update for light
-  StaticJsonDocument<256> doc;
+  PooledJsonDocument doc(256);
   DeserializationError err = deserializeJson(doc, payload, length);
   if (err)
   {
@@ -94,38 +342,61 @@ void mqttCallback(char *topic, byte *payload, unsigned int length)
     return;
   }
   // Deserialization was successfull
+  for (int i = 0; i < sizeof(LMANConfig::instance->groupConfigs) / sizeof(GroupConfig); i++)
+  {
+    if (LMANConfig::instance->groupConfigs[i].enabled && LMANConfig::instance->groupConfigs[i].getCmdTopic(i).compare(topic) == 0)
+    {
+      handleGroupCommand(i, doc);
+      return;
+    }
+  }
   for (DMXChannel &channel : LightManager::instance->dmxChannels)
   {
     if (channel.config->channel != 0)
     {
-      if (channel.config->getCmdTopic().compare(tpc) == 0)
+      if (channel.config->getCmdTopic().compare(topic) == 0)
       {
         try
         {
           LOG_INFO("Got MQTT command for ", LOG_BOLD, channel.config->name.c_str());
+          if (doc.containsKey("effect"))
+          {
+            lMan.setEffect(&channel, effectFromName(doc["effect"] | "none"));
+          }
+          Color color = channel.getColor();
+          if (channel.config->type != FIXTURE_DIMMER && colorFromMqtt(doc, color))
+          {
+            channel.setColor(color, transitionFromMqtt(doc, COLOR_FADE_TIME));
+            if (!channel.state && !doc.containsKey("brightness"))
+            {
+              // Picking a color turns the light on, like in Home Assistant
+              lMan.autoDimOn(&channel);
+            }
+          }
           if (doc.containsKey("brightness"))
           {
-            uint8_t brightess = 128;
+            uint16_t brightess = 128;
             try
             {
-              brightess = doc["brightness"].as<uint8_t>();
+              // 0-255, or 0-65535 for 16 bit channels as set by brightness_scale
+              brightess = doc["brightness"].as<uint16_t>();
             }
             catch (const std::exception &e)
             {
-              LOG_ERROR("Failed to cast brightness to uint8_t");
+              LOG_ERROR("Failed to cast brightness to uint16_t");
               break; // Error converting. Do not do anything.
             }
 
             if (channel.state)
             {
               // Light is already on, just dim to requested level.
-              LightManager::instance->autoDimTo(&channel, brightess);
+              LightManager::instance->autoDimTo(&channel, channel.brightnessToLevel(brightess));
             }
             else if (!channel.state)
             {
               // Light is off but a level was requested, turn on and dim to target.
               LOG_INFO("Slow turn on requested by MQTT for ", LOG_BOLD, channel.config->name.c_str(), LOG_RESET_DECORATIONS, " to level ", LOG_BOLD, brightess);
-              lMan.autoDimOnToLevel(&channel, brightess);
+              lMan.autoDimOnToLevel(&channel, channel.brightnessToLevel(brightess));
             }
             else
             {
@@ -146,7 +417,7 @@ void mqttCallback(char *topic, byte *payload, unsigned int length)
               // Light is on and a turn off was requested
               lMan.autoDimOff(&channel);
             }
-            else
+            else if (!doc.containsKey("effect"))
             {
               LOG_ERROR("Unknown state!");
             }
@@ -172,11 +443,17 @@ void sendMqttStatusUpdate()
 
   for (DMXChannel &channel : LightManager::instance->dmxChannels)
   {
-    if (channel.config->enabled && channel.config->channel != 0 && millis() - channel.lastLevelChange > 100 && channel.mqttSendUpdate)
+    // A fading channel is sent once it lands, a group command does not send every member twice
+    if (channel.config->enabled && channel.config->channel != 0 && !channel.isSceneFading && millis() - channel.lastLevelChange > 100 && channel.mqttSendUpdate)
     {
-      StaticJsonDocument<200> doc;
+      StaticJsonDocument<300> doc;
       doc["state"] = channel.state ? "ON" : "OFF";
-      doc["brightness"] = channel.level;
+      doc["brightness"] = channel.getBrightness();
+      doc["effect"] = EFFECT_NAMES[channel.effect.type];
+      if (channel.config->type != FIXTURE_DIMMER)
+      {
+        colorToMqtt(channel.getColor(), channel.config->type, doc);
+      }
 
       char buffer[256];
       size_t length = serializeJson(doc, buffer);
@@ -192,6 +469,139 @@ void sendMqttStatusUpdate()
   }
 }
 
+/// @brief Send the state of the groups that changed, summed up from their members
+void sendMqttGroupUpdate()
+{
+  if (!mqttClient.connected())
+  {
+    return;
+  }
+
+  for (int i = 0; i < sizeof(LMANConfig::instance->groupConfigs) / sizeof(GroupConfig); i++)
+  {
+    GroupConfig &group = LMANConfig::instance->groupConfigs[i];
+    if (!group.enabled)
+    {
+      continue;
+    }
+    // On if any member is on, at the average brightness of the members that are on
+    bool state = false;
+    bool settled = true;
+    uint32_t brightnessSum = 0;
+    uint8_t onCount = 0;
+    DMXChannel *colorChannel = nullptr;
+    for (int c = 0; c < sizeof(LMANConfig::instance->channelConfigs) / sizeof(ChannelConfig); c++)
+    {
+      DMXChannel *channel = lMan.getChannel(c);
+      if (!channel || !channel->config->enabled || !(group.channels & (1 << c)))
+      {
+        continue;
+      }
+      if (channel->isSceneFading || millis() - channel->lastLevelChange <= 100)
+      {
+        settled = false;
+      }
+      if (channel->state)
+      {
+        state = true;
+        brightnessSum += channel->level >> 8;
+        onCount++;
+      }
+      if (!colorChannel && channel->config->type != FIXTURE_DIMMER)
+      {
+        colorChannel = channel;
+      }
+    }
+    GroupState &sent = groupStates[i];
+    uint8_t brightness = onCount > 0 ? brightnessSum / onCount : 0;
+    Color color = colorChannel ? colorChannel->getColor() : Color();
+    if (!settled || (sent.sent && sent.state == state && sent.brightness == brightness && sent.color == color))
+    {
+      continue;
+    }
+
+    StaticJsonDocument<300> doc;
+    doc["state"] = state ? "ON" : "OFF";
+    doc["brightness"] = brightness;
+    if (colorChannel)
+    {
+      colorToMqtt(color, colorChannel->config->type, doc);
+    }
+    char buffer[256];
+    size_t length = serializeJson(doc, buffer);
+    if (mqttClient.publish(group.getStateTopic(i).c_str(), buffer, length))
+    {
+      sent.sent = true;
+      sent.state = state;
+      sent.brightness = brightness;
+      sent.color = color;
+    }
+    else
+    {
+      LOG_ERROR("Failed to send state update for group ", LOG_BOLD, group.name.c_str());
+    }
+  }
+}
+
+/// @brief Add the color modes of fixtures to a Home Assistant light discovery document
+/// @param fixtureTypes Bit per FixtureType of the light
+void addColorDiscovery(JsonDocument &doc, uint8_t fixtureTypes)
+{
+  if ((fixtureTypes & ~(1 << FIXTURE_DIMMER)) == 0)
+  {
+    return;
+  }
+  JsonArray colorModes = doc.createNestedArray("sup_clrm");
+  for (uint8_t mode = 0; mode < COLOR_MODE_COUNT; mode++)
+  {
+    for (uint8_t type = FIXTURE_RGB; type < FIXTURE_TYPE_COUNT; type++)
+    {
+      if ((fixtureTypes & (1 << type)) && fixtureSupportsColorMode(type, mode))
+      {
+        colorModes.add(COLOR_MODE_NAMES[mode]);
+        break;
+      }
+    }
+  }
+  if (fixtureTypes & (1 << FIXTURE_CCT))
+  {
+    doc["min_mirs"] = FIXTURE_COLD_MIREDS;
+    doc["max_mirs"] = FIXTURE_WARM_MIREDS;
+  }
+}
+
+/// @brief Add the effects to a Home Assistant light discovery document
+void addEffectDiscovery(JsonDocument &doc)
+{
+  doc["effect"] = true;
+  JsonArray effectList = doc.createNestedArray("effect_list");
+  for (uint8_t effect = 0; effect < EFFECT_COUNT; effect++)
+  {
+    effectList.add(EFFECT_NAMES[effect]);
+  }
+}
+
+/// @brief Add the device information to a Home Assistant discovery document
+void addDeviceDiscovery(JsonDocument &doc)
+{
+  std::string device_configuration_url = "http://";
+  device_configuration_url.append(WiFi.localIP().toString().c_str());
+
+  JsonObject device = doc.createNestedObject("device");
+  device["cu"] = device_configuration_url.c_str();
+  device["name"] = LMANConfig::instance->wifi_hostname;
+  device["mf"] = "Tim P";
+  device["mdl"] = "DMX512 Controller";
+  device["sw_version"] = DMX512_SW_VERSION;
+  JsonArray connections = device.createNestedArray("cns");
+  JsonArray mac_address = connections.createNestedArray();
+  mac_address.add("mac");
+  mac_address.add(WiFi.macAddress());
+  JsonArray ip_address = connections.createNestedArray();
+  ip_address.add("ip");
+  ip_address.add(WiFi.localIP().toString());
+}
+
 /// @brief Register device and channels to MQTT
 void registerToMqtt()
 {
@@ -205,6 +615,13 @@ void registerToMqtt()
     delay(50);
   }
   LOG_INFO("Subscribed to home assistant status update topic");
+  mqttClient.subscribe(getUpdateTopic().c_str());
+  mqttClient.subscribe(getFleetUpdateTopic().c_str());
+  if (LMANConfig::instance->mqtt_raw_enabled)
+  {
+    LOG_DEBUG("Subscribing to ", LOG_BOLD, LMANConfig::instance->getMqttRawTopic().c_str());
+    mqttClient.subscribe(LMANConfig::instance->getMqttRawTopic().c_str());
+  }
 
   for (int i = 0; i < sizeof(LMANConfig::instance->channelConfigs) / sizeof(ChannelConfig); i++)
   {
@@ -216,7 +633,7 @@ void registerToMqtt()
       mqttClient.subscribe(cmdTopic.c_str());
 
       // Register light to home assistant
-      DynamicJsonDocument doc(1024);
+      PooledJsonDocument doc(1024);
       ChannelConfig *config = &LMANConfig::instance->channelConfigs[i];
       doc["~"] = config->getBaseTopic();
       doc["name"] = config->name.c_str();
@@ -225,25 +642,15 @@ void registerToMqtt()
       doc["schema"] = "json";
       doc["uniq_id"] = config->getUniqueName();
       doc["brightness"] = true;
+      if (config->fine)
+      {
+        doc["bri_scl"] = 65535;
+      }
+      addColorDiscovery(doc, 1 << config->type);
+      addEffectDiscovery(doc);
       doc["avty_t"] = config->getAvailabilityTopic();
 
-      // Device information
-      std::string device_configuration_url = "http://";
-      device_configuration_url.append(WiFi.localIP().toString().c_str());
-
-      JsonObject device = doc.createNestedObject("device");
-      device["cu"] = device_configuration_url.c_str();
-      device["name"] = LMANConfig::instance->wifi_hostname;
-      device["mf"] = "Tim P";
-      device["mdl"] = "DMX512 Controller";
-      device["sw_version"] = DMX512_SW_VERSION;
-      JsonArray connections = device.createNestedArray("cns");
-      JsonArray mac_address = connections.createNestedArray();
-      mac_address.add("mac");
-      mac_address.add(WiFi.macAddress());
-      JsonArray ip_address = connections.createNestedArray();
-      ip_address.add("ip");
-      ip_address.add(WiFi.localIP().toString());
+      addDeviceDiscovery(doc);
 
       char buffer[1024];
       size_t length = serializeJson(doc, buffer);
@@ -257,83 +664,239 @@ void registerToMqtt()
       }
     }
   }
+
+  for (int i = 0; i < sizeof(LMANConfig::instance->sceneConfigs) / sizeof(SceneConfig); i++)
+  {
+    SceneConfig *scene = &LMANConfig::instance->sceneConfigs[i];
+    if (!scene->enabled)
+    {
+      continue;
+    }
+    std::string cmdTopic = scene->getCmdTopic(i);
+    LOG_DEBUG("Subscribing to ", LOG_BOLD, cmdTopic.c_str());
+    mqttClient.subscribe(cmdTopic.c_str());
+
+    // Register scene to home assistant
+    PooledJsonDocument doc(1024);
+    doc["~"] = scene->getBaseTopic(i);
+    doc["name"] = scene->name.c_str();
+    doc["cmd_t"] = "~/cmd";
+    doc["pl_on"] = "ON";
+    doc["uniq_id"] = scene->getUniqueName(i);
+    doc["avty_t"] = LMANConfig::instance->channelConfigs[0].getAvailabilityTopic();
+    addDeviceDiscovery(doc);
+
+    char buffer[1024];
+    size_t length = serializeJson(doc, buffer);
+    if (!mqttClient.publish(scene->getCfgTopic(i).c_str(), (uint8_t *)buffer, length, false))
+    {
+      LOG_ERROR("Failed to register scene ", LOG_BOLD, scene->name.c_str());
+    }
+    else
+    {
+      LOG_INFO("Registered scene to ", LOG_BOLD, scene->getCfgTopic(i).c_str());
+    }
+  }
+
+  for (int i = 0; i < sizeof(LMANConfig::instance->groupConfigs) / sizeof(GroupConfig); i++)
+  {
+    GroupConfig *group = &LMANConfig::instance->groupConfigs[i];
+    if (!group->enabled)
+    {
+      continue;
+    }
+    std::string cmdTopic = group->getCmdTopic(i);
+    LOG_DEBUG("Subscribing to ", LOG_BOLD, cmdTopic.c_str());
+    mqttClient.subscribe(cmdTopic.c_str());
+
+    // Register group to home assistant as one light
+    PooledJsonDocument doc(1024);
+    doc["~"] = group->getBaseTopic(i);
+    doc["name"] = group->name.c_str();
+    doc["cmd_t"] = "~/cmd";
+    doc["stat_t"] = "~/state";
+    doc["schema"] = "json";
+    doc["uniq_id"] = group->getUniqueName(i);
+    doc["brightness"] = true;
+    uint8_t fixtureTypes = 0;
+    for (int c = 0; c < sizeof(LMANConfig::instance->channelConfigs) / sizeof(ChannelConfig); c++)
+    {
+      ChannelConfig &member = LMANConfig::instance->channelConfigs[c];
+      if ((group->channels & (1 << c)) && member.enabled)
+      {
+        fixtureTypes |= 1 << member.type;
+      }
+    }
+    addColorDiscovery(doc, fixtureTypes);
+    addEffectDiscovery(doc);
+    doc["avty_t"] = LMANConfig::instance->channelConfigs[0].getAvailabilityTopic();
+    addDeviceDiscovery(doc);
+
+    char buffer[1024];
+    size_t length = serializeJson(doc, buffer);
+    if (!mqttClient.publish(group->getCfgTopic(i).c_str(), (uint8_t *)buffer, length, false))
+    {
+      LOG_ERROR("Failed to register group ", LOG_BOLD, group->name.c_str());
+    }
+    else
+    {
+      LOG_INFO("Registered group to ", LOG_BOLD, group->getCfgTopic(i).c_str());
+    }
+    // Send the state again once registered
+    groupStates[i].sent = false;
+  }
 }
 
-void taskWiFiMqttHandler(void *param)
+/// @brief Remove topics that are no longer in use after a config change and register all channels again
+void resubscribeToMqtt()
 {
-  LOG_INFO("taskWiFiMqttHandler started!");
-  if (!LMANConfig::instance->wifi_ssid.empty())
+  // The channel topics may have changed, they are rebuilt here as only this task uses them
+  for (ChannelConfig &channel : LMANConfig::instance->channelConfigs)
   {
-    for (;;)
+    channel.clearTopicCache();
+  }
+  if (!mqttClient.connected())
+  {
+    // All topics will be subscribed to when connected
+    return;
+  }
+
+  std::list<std::string> staleCmdTopics;
+  std::list<std::string> staleCfgTopics;
+  webMan.takeStaleTopics(staleCmdTopics, staleCfgTopics);
+  for (std::string &topic : staleCmdTopics)
+  {
+    LOG_DEBUG("Unsubscribing from ", LOG_BOLD, topic.c_str());
+    mqttClient.unsubscribe(topic.c_str());
+  }
+  for (std::string &topic : staleCfgTopics)
+  {
+    // An empty config removes the entity from Home Assistant
+    LOG_DEBUG("Removing Home Assistant entity at ", LOG_BOLD, topic.c_str());
+    mqttClient.publish(topic.c_str(), "", false);
+  }
+  registerToMqtt();
+}
+
+/// @brief Connect to WiFi and the MQTT server if not connected, blocks until connected
+void connectWiFiMqtt()
+{
+  if (!WiFi.isConnected() && !config.wifi_ssid.empty())
+  {
+    LOG_ERROR("WiFi not connected!");
+    WiFi.mode(WIFI_STA);
+    WiFi.setHostname(config.wifi_hostname.c_str());
+    while (!WiFi.isConnected())
     {
-      if (!WiFi.isConnected() && !config.wifi_ssid.empty())
+      WiFi.begin(config.wifi_ssid.c_str(), config.wifi_psk.c_str());
+      LOG_INFO("Connecting to WiFi ", LOG_BOLD, config.wifi_ssid.c_str());
+      // Association takes a few seconds, calling begin() again before it is done starts over
+      unsigned long connectStart = millis();
+      while (!WiFi.isConnected() && millis() - connectStart < WIFI_CONNECT_TIMEOUT)
       {
-        LOG_ERROR("WiFi not connected!");
-        WiFi.mode(WIFI_STA);
-        WiFi.setHostname(config.wifi_hostname.c_str());
-        while (!WiFi.isConnected())
+        vTaskDelay(WIFI_CONNECT_POLL / portTICK_PERIOD_MS);
+      }
+      if (WiFi.isConnected())
+      {
+        markBootStage(BOOT_WIFI);
+        LOG_INFO("Connected to WiFi ", LOG_BOLD, config.wifi_ssid.c_str());
+        LOG_INFO("IP Address: ", LOG_BOLD, WiFi.localIP());
+        LOG_INFO("Netmask:    ", LOG_BOLD, WiFi.subnetMask());
+        LOG_INFO("Gateway:    ", LOG_BOLD, WiFi.gatewayIP());
+        // Start web server
+        // webMan.init(&webServer);
+        webMan.init(&mqttClient);
+        markBootStage(BOOT_WEB);
+        if (config.artnet_enabled)
         {
-          WiFi.begin(config.wifi_ssid.c_str(), config.wifi_psk.c_str());
-          LOG_INFO("Connecting to WiFi ", LOG_BOLD, config.wifi_ssid.c_str());
-          vTaskDelay(1000 / portTICK_PERIOD_MS);
-          if (WiFi.isConnected())
-          {
-            LOG_INFO("Connected to WiFi ", LOG_BOLD, config.wifi_ssid.c_str());
-            LOG_INFO("IP Address: ", LOG_BOLD, WiFi.localIP());
-            LOG_INFO("Netmask:    ", LOG_BOLD, WiFi.subnetMask());
-            LOG_INFO("Gateway:    ", LOG_BOLD, WiFi.gatewayIP());
-            // Start web server
-            // webMan.init(&webServer);
-            webMan.init(&mqttClient);
-          }
-          else
-          {
-            LOG_ERROR("Failed to connect to WiFi. Will try again in 10 seconds");
-          }
+          artNet.init();
+        }
+        if (config.e131_enabled)
+        {
+          e131.init();
         }
+        mqttRaw.init();
+        scheduler.startTimeSync();
       }
-      else if (config.wifi_ssid.empty())
+      else
       {
-        LOG_ERROR("No WiFi SSID configured!");
+        LOG_ERROR("Failed to connect to WiFi. Will try again in 10 seconds");
       }
+    }
+  }
+  else if (config.wifi_ssid.empty())
+  {
+    LOG_ERROR("No WiFi SSID configured!");
+  }
 
-      if (WiFi.isConnected() && !mqttClient.connected() && !config.mqtt_server.empty())
+  if (WiFi.isConnected() && !mqttClient.connected() && !config.mqtt_server.empty())
+  {
+    LOG_ERROR("MQTT not connected!");
+    while (WiFi.isConnected() && !mqttClient.connected())
+    {
+      mqttClient.setServer(config.mqtt_server.c_str(), config.mqtt_port);
+      mqttClient.setCallback(mqttCallback);
+      mqttClient.setBufferSize(2048);
+      LOG_INFO("Connecting to MQTT server ", LOG_BOLD, config.mqtt_server.c_str());
+      // mqttClient.connect(config.wifi_hostname.c_str(), config.mqtt_username.c_str(), config.mqtt_password.c_str());
+      // Blocks until connected or failed
+      mqttClient.connect(config.wifi_hostname.c_str(), config.mqtt_username.c_str(), config.mqtt_password.c_str(), LMANConfig::instance->channelConfigs[0].getAvailabilityTopic().c_str(), 1, 1, "offline");
+      if (mqttClient.connected())
       {
-        LOG_ERROR("MQTT not connected!");
-        while (WiFi.isConnected() && !mqttClient.connected())
+        markBootStage(BOOT_MQTT);
+        LOG_INFO("Connected to MQTT server ", LOG_BOLD, config.mqtt_server.c_str());
+        mqttClient.subscribe(LMANConfig::instance->home_assistant_base_topic.c_str());
+        mqttClient.publish(LMANConfig::instance->channelConfigs[0].getAvailabilityTopic().c_str(), "online", true);
+        registerToMqtt();
+        markBootStage(BOOT_DISCOVERY);
+        if (!bootReported)
         {
-          mqttClient.setServer(config.mqtt_server.c_str(), config.mqtt_port);
-          mqttClient.setCallback(mqttCallback);
-          mqttClient.setBufferSize(2048);
-          LOG_INFO("Connecting to MQTT server ", LOG_BOLD, config.mqtt_server.c_str());
-          // mqttClient.connect(config.wifi_hostname.c_str(), config.mqtt_username.c_str(), config.mqtt_password.c_str());
-          mqttClient.connect(config.wifi_hostname.c_str(), config.mqtt_username.c_str(), config.mqtt_password.c_str(), LMANConfig::instance->channelConfigs[0].getAvailabilityTopic().c_str(), 1, 1, "offline");
-          vTaskDelay(1000 / portTICK_PERIOD_MS);
-          if (mqttClient.connected())
-          {
-            LOG_INFO("Connected to MQTT server ", LOG_BOLD, config.mqtt_server.c_str());
-            mqttClient.subscribe(LMANConfig::instance->home_assistant_base_topic.c_str());
-            mqttClient.publish(LMANConfig::instance->channelConfigs[0].getAvailabilityTopic().c_str(), "online", true);
-            registerToMqtt();
-          }
-          else
-          {
-            LOG_ERROR("Failed to connect to MQTT. Will try again in 10 seconds");
-          }
+          char buffer[256];
+          size_t length = getBootJson(buffer, sizeof(buffer));
+          bootReported = length > 0 && mqttClient.publish(getBootTopic().c_str(), (uint8_t *)buffer, length, true);
         }
       }
-      else if (config.mqtt_server.empty())
+      else
       {
-        LOG_ERROR("No MQTT server configured!");
+        LOG_ERROR("Failed to connect to MQTT. Will try again in 1 second");
+        vTaskDelay(1000 / portTICK_PERIOD_MS);
       }
+    }
+  }
+  else if (config.mqtt_server.empty())
+  {
+    LOG_ERROR("No MQTT server configured!");
+  }
+}
 
-      if (WiFi.isConnected() && mqttClient.connected() && !homeAssistantStateChangeHandled && millis() - lastHomeAssistantStateChange >= LMANConfig::instance->home_assistant_state_change_wait)
+void taskWiFiMqttHandler(void *param)
+{
+  LOG_INFO("taskWiFiMqttHandler started!");
+  if (!LMANConfig::instance->wifi_ssid.empty())
+  {
+    unsigned long lastConnectionCheck = 0;
+    for (;;)
+    {
+      if (lastConnectionCheck == 0 || millis() - lastConnectionCheck >= CONNECTION_CHECK_INTERVAL)
+      {
+        connectWiFiMqtt();
+        lastConnectionCheck = millis();
+      }
+      // This task is the only user of mqttClient, PubSubClient is not thread safe
+      mqttClient.loop();
+      sendMqttStatusUpdate();
+      sendMqttGroupUpdate();
+      if (webMan.doMqttResubscribe())
+      {
+        resubscribeToMqtt();
+      }
+      if (mqttClient.connected() && !homeAssistantStateChangeHandled && millis() - lastHomeAssistantStateChange >= LMANConfig::instance->home_assistant_state_change_wait)
       {
         LOG_INFO("Wait time is up. Registring to Home Assistant via MQTT.");
         registerToMqtt();
         homeAssistantStateChangeHandled = true;
       }
-      vTaskDelay(10000 / portTICK_PERIOD_MS);
+      vTaskDelay(MQTT_LOOP_INTERVAL / portTICK_PERIOD_MS);
     }
   }
   else
@@ -368,22 +931,55 @@ void taskWiFiMqttHandler(void *param)
   }
 }
 
+/// @brief Frame scheduler of one universe, param is the index into dmx and dmxMerger.
+/// The UARTs send in parallel, each task only blocks on its own output.
 void taskSendDMXData(void *param)
 {
-  LOG_INFO("Starting taskSendDMXData");
+  uint8_t index = (uintptr_t)param;
+  LOG_INFO("Starting taskSendDMXData for universe ", LOG_BOLD, index + 1);
+  bool rdmOutput = rdm.getUniverse() == index + 1;
   for (;;)
   {
-    ulTaskNotifyTake(pdTRUE, 1000 / portTICK_PERIOD_MS); // Wait 1000ms or until notified to send DMX data.
-    dmx.update();
+    // Wait until notified to send DMX data, resend the last frame to keep the minimum frame rate. Pending RDM requests are sent between back to back frames.
+    ulTaskNotifyTake(pdTRUE, (rdmOutput && rdm.isBusy()) ? 0 : dmx[index].getKeepaliveTime() / portTICK_PERIOD_MS);
+    takeDmxFrameLatency(index);
+    uint32_t frameStart = micros();
+    dmxMerger[index].checkNetworkTimeout();
+    dmx[index].update();
+    taskTimings[TIMING_DMX_FRAME_1 + index].add(micros() - frameStart);
+    if (rdmOutput)
+    {
+      rdm.afterFrame();
+    }
+  }
+}
+
+/// @brief Add channels for the devices found by RDM, the channel table is only changed from here
+void applyRdmChannels()
+{
+  if (!rdm.hasChannelChanges())
+  {
+    return;
+  }
+  LMANConfig previous = *LMANConfig::instance;
+  std::list<std::string> previousCmdTopics;
+  std::list<std::string> previousCfgTopics;
+  WebManager::collectTopics(previousCmdTopics, previousCfgTopics);
+  if (rdm.updateChannelTable())
+  {
+    // Channel changes never need a reboot
+    webMan.saveAndApplyConfig(previous, previousCmdTopics, previousCfgTopics);
   }
 }
 
 void loop()
 {
-  mqttClient.loop();
-  sendMqttStatusUpdate();
-  if (webMan.doReboot())
+  applyRdmChannels();
+  stateJournal.loop();
+  if (webMan.doReboot() || updateMan.doReboot())
   {
+    // Write what changed since the last record, the journal is not written during the settle time
+    stateJournal.flush();
     ESP.restart();
   }
 
@@ -396,54 +992,84 @@ void loop()
   {
     LOG_WARNING("Performing factory reset at user request!");
     LMANConfig::instance->factoryReset();
+    stateJournal.clear();
     ESP.restart();
   }
 
   lastResetButtonState = currentResetButtonState;
+
+  if (millis() - lastHeapStatusLog > JSON_POOL_LOG_INTERVAL)
+  {
+    lastHeapStatusLog = millis();
+    JsonPool::logStatus();
+  }
   vTaskDelay(100 / portTICK_PERIOD_MS);
 }
 
 void setup()
 {
   Serial.begin(115200);
+  logSink.init();
   logger.init();
-  logger.SetSerial(&Serial);
+  // Log through the sink so that logging never blocks on the UART
+  logger.SetSerial(&logSink);
   logger.SetLogLevel(ArduLogLevel::Debug);
   logger.SetUseDecorations(true);
-  delay(50);
 
+  // Stage one: everything the lights and buttons need, from the binary config. Nothing here waits for the network.
   pinMode(PIN_FACTORY_RESET, INPUT_PULLUP);
 
+  JsonPool::init();
   config.init();
   config.loadFromLittleFS();
+  logSink.applyConfig();
+  markBootStage(BOOT_CONFIG);
 
-  // Find highest DMX-channel in use.
-  uint16_t higestDMXChannel = 0;
-  for (int i = 0; i < sizeof(LMANConfig::instance->channelConfigs) / sizeof(ChannelConfig); i++)
+  // The outputs are sized to the channels in use as they are initialized below
+  for (uint8_t i = 0; i < DMX_OUTPUT_COUNT; i++)
   {
-    if (LMANConfig::instance->channelConfigs[i].enabled && LMANConfig::instance->channelConfigs[i].channel > higestDMXChannel)
-    {
-      higestDMXChannel = LMANConfig::instance->channelConfigs[i].channel + 1;
-    }
+    dmx[i].init(i + 1, DMX_OUTPUT_PORTS[i], DMX_OUTPUT_PINS[i]);
+  }
+#ifdef PIN_DMX_DIRECTION
+  // RDM needs a line driver that can be turned around, only boards that have one define the pins
+  if (dmx[0].initRdm(PIN_DMX_DIRECTION, PIN_DMX_RX))
+  {
+    rdm.init(&dmx[0], 1);
   }
-  LOG_INFO("Initializing DMX-library with ", LOG_BOLD, higestDMXChannel, LOG_RESET_DECORATIONS " channels");
-  // Init with highest DMX-channel+1
-  dmx.init(&Serial2, higestDMXChannel, 0);
+#endif
 
   pinMode(PIN_ERROR_LED, OUTPUT);
-  xTaskCreatePinnedToCore(taskHandleErrorLed, "taskErrorLed", 5000, NULL, 1, &taskHandleErrorLedHandle, CONFIG_ARDUINO_RUNNING_CORE);
-  xTaskCreatePinnedToCore(taskSendDMXData, "taskSendDMXData", 5000, NULL, 2, &taskHandleSendDMXData, CONFIG_ARDUINO_RUNNING_CORE);
-  xTaskCreatePinnedToCore(taskWiFiMqttHandler, "taskWiFiMqttHandler", 5000, NULL, 0, NULL, CONFIG_ARDUINO_RUNNING_CORE);
+  createTask(TASK_ERROR_LED, taskHandleErrorLed, &taskHandleErrorLedHandle);
+  for (uint8_t i = 0; i < DMX_OUTPUT_COUNT; i++)
+  {
+    createTask((LMANTask)(TASK_SEND_DMX_1 + i), taskSendDMXData, &taskHandleSendDMXData[i], (void *)(uintptr_t)i);
+  }
 
-  lMan.init(&taskHandleSendDMXData, &dmx);
+  // Universe 1 first, it receives the network levels
+  for (uint8_t i = 0; i < DMX_OUTPUT_COUNT; i++)
+  {
+    dmxMerger[i].init(&dmx[i], &taskHandleSendDMXData[i]);
+  }
+  markBootStage(BOOT_DMX);
+  lMan.init(dmxMerger);
 
   lMan.initDMXChannel(&LMANConfig::instance->channelConfigs[0]);
   lMan.initDMXChannel(&LMANConfig::instance->channelConfigs[1]);
   lMan.initDMXChannel(&LMANConfig::instance->channelConfigs[2]);
   lMan.initDMXChannel(&LMANConfig::instance->channelConfigs[3]);
+  // The lights come back as they were before the reboot, without waiting for WiFi or Home Assistant
+  stateJournal.restore();
+  markBootStage(BOOT_CHANNELS);
 
   lMan.initButton(PIN_BUTTON_1, &LMANConfig::instance->buttonConfigs[0]);
   lMan.initButton(PIN_BUTTON_2, &LMANConfig::instance->buttonConfigs[1]);
   lMan.initButton(PIN_BUTTON_3, &LMANConfig::instance->buttonConfigs[2]);
   lMan.initButton(PIN_BUTTON_4, &LMANConfig::instance->buttonConfigs[3]);
+  markBootStage(BOOT_BUTTONS);
+  // Schedules run without the network once the clock is set
+  scheduler.init();
+
+  // Stage two: updates, WiFi, web server, MQTT and Home Assistant discovery, in the background
+  updateMan.init();
+  createTask(TASK_WIFI_MQTT_HANDLER, taskWiFiMqttHandler, NULL);
 }
\ No newline at end of file
@@ -0,0 +1,34 @@
+#ifndef LMAN_TEST_ARDULOG
+#define LMAN_TEST_ARDULOG
+
+// Host replacement of ArduLog for the native tests, logging is compiled out by LMAN_LOG_LEVEL=0
+
+#include <Arduino.h>
+
+#define LOG_BOLD "\e[1m"
+#define LOG_RESET_DECORATIONS "\e[0m"
+
+enum ArduLogLevel
+{
+    LOG_LEVEL_NONE,
+    LOG_LEVEL_ERROR,
+    LOG_LEVEL_WARNING,
+    LOG_LEVEL_INFO,
+    LOG_LEVEL_DEBUG,
+    LOG_LEVEL_TRACE,
+};
+
+class ArduLog
+{
+public:
+    static ArduLog *getInstance()
+    {
+        static ArduLog instance;
+        return &instance;
+    }
+    void SetLogLevel(ArduLogLevel level)
+    {
+    }
+};
+
+#endif
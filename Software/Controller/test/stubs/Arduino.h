@@ -0,0 +1,172 @@
+#ifndef LMAN_TEST_ARDUINO
+#define LMAN_TEST_ARDUINO
+
+// Host replacement of the Arduino core for the native tests. Only what the libraries under test use.
+// The clock does not run by itself, tests move it with hostAdvance() so that timing is deterministic.
+
+#include <stdarg.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <sys/time.h>
+#include <algorithm>
+#include <string>
+#include <freertos/FreeRTOS.h>
+#include <freertos/task.h>
+#include <freertos/semphr.h>
+
+#define IRAM_ATTR
+#define HIGH 1
+#define LOW 0
+#define INPUT 1
+#define OUTPUT 3
+#define INPUT_PULLUP 5
+#define CHANGE 3
+#define PI 3.1415926535897932384626433832795
+#define DEG_TO_RAD 0.017453292519943295769236907684886
+#define RAD_TO_DEG 57.295779513082320876798154814105
+
+typedef uint8_t byte;
+
+using std::max;
+using std::min;
+
+/// @brief The fake time since boot in us, read by millis() and micros()
+inline uint64_t hostMicros = 0;
+
+/// @brief Move the fake clock forward
+/// @param ms The time in ms
+inline void hostAdvance(uint32_t ms)
+{
+    hostMicros += (uint64_t)ms * 1000;
+}
+
+inline unsigned long millis()
+{
+    return (unsigned long)(hostMicros / 1000);
+}
+
+inline unsigned long micros()
+{
+    return (unsigned long)hostMicros;
+}
+
+inline void delay(uint32_t ms)
+{
+    hostAdvance(ms);
+}
+
+inline void delayMicroseconds(uint32_t us)
+{
+    hostMicros += us;
+}
+
+/// @brief Levels of the GPIOs, written by digitalWrite()
+inline uint8_t hostPins[40] = {0};
+
+inline void pinMode(uint8_t pin, uint8_t mode)
+{
+}
+
+inline void digitalWrite(uint8_t pin, uint8_t value)
+{
+    hostPins[pin] = value;
+}
+
+inline int digitalRead(uint8_t pin)
+{
+    return hostPins[pin];
+}
+
+/// @brief Interrupts are not raised on the host, the tests call the handlers
+inline void attachInterrupt(uint8_t pin, void (*handler)(void), int mode)
+{
+}
+
+inline void detachInterrupt(uint8_t pin)
+{
+}
+
+inline uint32_t esp_random()
+{
+    return (uint32_t)rand();
+}
+
+inline void configTzTime(const char *tz, const char *server1, const char *server2 = nullptr, const char *server3 = nullptr)
+{
+    setenv("TZ", tz, 1);
+    tzset();
+}
+
+class Print
+{
+public:
+    virtual ~Print() = default;
+    virtual size_t write(uint8_t value) = 0;
+    virtual size_t write(const uint8_t *buffer, size_t size)
+    {
+        size_t written = 0;
+        while (written < size && this->write(buffer[written]))
+        {
+            written++;
+        }
+        return written;
+    }
+    size_t print(const char *text)
+    {
+        return this->write((const uint8_t *)text, strlen(text));
+    }
+    size_t printf(const char *format, ...)
+    {
+        char buffer[256];
+        va_list args;
+        va_start(args, format);
+        int length = vsnprintf(buffer, sizeof(buffer), format, args);
+        va_end(args);
+        return length > 0 ? this->write((const uint8_t *)buffer, std::min((size_t)length, sizeof(buffer) - 1)) : 0;
+    }
+};
+
+class Stream : public Print
+{
+public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+};
+
+/// @brief Heap numbers reported by ESP, set by the tests that check them
+class EspClass
+{
+public:
+    uint32_t freeHeap = 0;
+    uint32_t minFreeHeap = 0;
+    uint32_t maxAllocHeap = 0;
+    uint64_t efuseMac = 0;
+    uint32_t getFreeHeap()
+    {
+        return this->freeHeap;
+    }
+    uint32_t getMinFreeHeap()
+    {
+        return this->minFreeHeap;
+    }
+    uint32_t getMaxAllocHeap()
+    {
+        return this->maxAllocHeap;
+    }
+    uint64_t getEfuseMac()
+    {
+        return this->efuseMac;
+    }
+    void restart()
+    {
+    }
+};
+
+inline EspClass ESP;
+
+#endif
@@ -0,0 +1,88 @@
+#ifndef LMAN_TEST_ASYNC_UDP
+#define LMAN_TEST_ASYNC_UDP
+
+#include <Arduino.h>
+#include <functional>
+#include <string>
+
+class IPAddress
+{
+public:
+    IPAddress(uint8_t a = 0, uint8_t b = 0, uint8_t c = 0, uint8_t d = 0) : _address{a, b, c, d}
+    {
+    }
+    uint8_t operator[](int index) const
+    {
+        return this->_address[index];
+    }
+    std::string toString() const
+    {
+        return std::to_string(this->_address[0]) + "." + std::to_string(this->_address[1]) + "." +
+               std::to_string(this->_address[2]) + "." + std::to_string(this->_address[3]);
+    }
+
+private:
+    uint8_t _address[4];
+};
+
+/// @brief A received datagram over a buffer of the test
+class AsyncUDPPacket : public Stream
+{
+public:
+    AsyncUDPPacket(uint8_t *data, size_t length) : _data(data), _length(length)
+    {
+    }
+    uint8_t *data()
+    {
+        return this->_data;
+    }
+    size_t length()
+    {
+        return this->_length;
+    }
+    int available() override
+    {
+        return this->_length - this->_read;
+    }
+    int read() override
+    {
+        return this->_read < this->_length ? this->_data[this->_read++] : -1;
+    }
+    size_t write(uint8_t value) override
+    {
+        return 0;
+    }
+
+private:
+    uint8_t *_data;
+    size_t _length;
+    size_t _read = 0;
+};
+
+typedef std::function<void(AsyncUDPPacket &packet)> AuPacketHandlerFunction;
+
+class AsyncUDP;
+/// @brief The socket that joined a multicast group last, the tests deliver packets to its handler
+inline AsyncUDP *hostUdp = nullptr;
+
+/// @brief Records the joined group and the packet handler
+class AsyncUDP
+{
+public:
+    IPAddress group;
+    uint16_t port = 0;
+    AuPacketHandlerFunction handler;
+    bool listenMulticast(const IPAddress &address, uint16_t port, uint8_t ttl = 1)
+    {
+        this->group = address;
+        this->port = port;
+        hostUdp = this;
+        return true;
+    }
+    void onPacket(AuPacketHandlerFunction callback)
+    {
+        this->handler = callback;
+    }
+};
+
+#endif
@@ -0,0 +1,121 @@
+#ifndef LMAN_TEST_FS
+#define LMAN_TEST_FS
+
+// Host replacement of the Arduino file system, files are kept in memory.
+// Every write is counted, the tests use the counts as the flash wear.
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <map>
+#include <string>
+#include <vector>
+
+/// @brief The content of all files by path
+inline std::map<std::string, std::vector<uint8_t>> hostFiles;
+/// @brief The number of writes to files, renames and removes not included
+inline uint32_t hostFlashWrites = 0;
+/// @brief The number of bytes written to files
+inline uint32_t hostFlashBytes = 0;
+
+namespace fs
+{
+    class File
+    {
+    public:
+        File() = default;
+        File(const std::string &path, size_t position) : _path(path), _position(position), _open(true) {}
+
+        explicit operator bool() const
+        {
+            return this->_open;
+        }
+
+        size_t size()
+        {
+            return this->_open ? hostFiles[this->_path].size() : 0;
+        }
+
+        size_t read(uint8_t *buffer, size_t size)
+        {
+            if (!this->_open)
+            {
+                return 0;
+            }
+            std::vector<uint8_t> &data = hostFiles[this->_path];
+            size_t length = this->_position < data.size() ? std::min(size, data.size() - this->_position) : 0;
+            memcpy(buffer, data.data() + this->_position, length);
+            this->_position += length;
+            return length;
+        }
+
+        size_t write(const uint8_t *buffer, size_t size)
+        {
+            if (!this->_open)
+            {
+                return 0;
+            }
+            std::vector<uint8_t> &data = hostFiles[this->_path];
+            data.insert(data.end(), buffer, buffer + size);
+            this->_position = data.size();
+            hostFlashWrites++;
+            hostFlashBytes += size;
+            return size;
+        }
+
+        void close()
+        {
+            this->_open = false;
+        }
+
+    private:
+        std::string _path;
+        size_t _position = 0;
+        bool _open = false;
+    };
+
+    class FS
+    {
+    public:
+        /// @brief Open a file, "r" only opens existing files, "w" truncates and "a" appends
+        File open(const char *path, const char *mode = "r")
+        {
+            if (mode[0] == 'r')
+            {
+                return hostFiles.count(path) ? File(path, 0) : File();
+            }
+            std::vector<uint8_t> &data = hostFiles[path];
+            if (mode[0] == 'w')
+            {
+                data.clear();
+            }
+            return File(path, data.size());
+        }
+
+        bool exists(const char *path)
+        {
+            return hostFiles.count(path) != 0;
+        }
+
+        bool remove(const char *path)
+        {
+            return hostFiles.erase(path) != 0;
+        }
+
+        bool rename(const char *from, const char *to)
+        {
+            if (!hostFiles.count(from))
+            {
+                return false;
+            }
+            hostFiles[to] = hostFiles[from];
+            hostFiles.erase(from);
+            return true;
+        }
+    };
+}
+
+using fs::File;
+using fs::FS;
+
+#endif
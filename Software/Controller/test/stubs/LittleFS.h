@@ -0,0 +1,20 @@
+#ifndef LMAN_TEST_LITTLEFS
+#define LMAN_TEST_LITTLEFS
+
+#include <FS.h>
+
+namespace fs
+{
+    class LittleFSFS : public FS
+    {
+    public:
+        bool begin(bool formatOnFail = false)
+        {
+            return true;
+        }
+    };
+}
+
+inline fs::LittleFSFS LittleFS;
+
+#endif
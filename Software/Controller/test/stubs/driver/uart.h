@@ -0,0 +1,150 @@
+#ifndef LMAN_TEST_UART
+#define LMAN_TEST_UART
+
+// Host replacement of the ESP-IDF UART driver. Records what is sent on each port instead of sending it.
+
+#include <freertos/FreeRTOS.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+typedef int esp_err_t;
+#define ESP_OK 0
+#define ESP_FAIL -1
+
+typedef int uart_port_t;
+#define UART_NUM_0 0
+#define UART_NUM_1 1
+#define UART_NUM_2 2
+#define UART_NUM_MAX 3
+#define UART_PIN_NO_CHANGE (-1)
+#define UART_SIGNAL_INV_DISABLE 0
+#define UART_SIGNAL_TXD_INV (1 << 5)
+
+typedef enum
+{
+    UART_DATA_8_BITS = 3
+} uart_word_length_t;
+typedef enum
+{
+    UART_PARITY_DISABLE = 0
+} uart_parity_t;
+typedef enum
+{
+    UART_STOP_BITS_1 = 1,
+    UART_STOP_BITS_2 = 3
+} uart_stop_bits_t;
+typedef enum
+{
+    UART_HW_FLOWCTRL_DISABLE = 0
+} uart_hw_flowcontrol_t;
+typedef enum
+{
+    UART_SCLK_APB = 0
+} uart_sclk_t;
+
+typedef struct
+{
+    int baud_rate;
+    uart_word_length_t data_bits;
+    uart_parity_t parity;
+    uart_stop_bits_t stop_bits;
+    uart_hw_flowcontrol_t flow_ctrl;
+    uint8_t rx_flow_ctrl_thresh;
+    uart_sclk_t source_clk;
+} uart_config_t;
+
+/// @brief What was configured and last sent on a port
+struct HostUart
+{
+    uart_config_t config;
+    bool installed;
+    int txPin;
+    int rxPin;
+    uint16_t idleBits;
+    uint8_t data[600];
+    size_t length;
+    int breakBits;
+    uint32_t frames;
+};
+
+inline HostUart hostUarts[UART_NUM_MAX];
+
+inline esp_err_t uart_param_config(uart_port_t port, const uart_config_t *config)
+{
+    hostUarts[port].config = *config;
+    return ESP_OK;
+}
+
+inline esp_err_t uart_set_pin(uart_port_t port, int txPin, int rxPin, int rtsPin, int ctsPin)
+{
+    if (txPin != UART_PIN_NO_CHANGE)
+    {
+        hostUarts[port].txPin = txPin;
+    }
+    if (rxPin != UART_PIN_NO_CHANGE)
+    {
+        hostUarts[port].rxPin = rxPin;
+    }
+    return ESP_OK;
+}
+
+inline esp_err_t uart_driver_install(uart_port_t port, int rxBufferSize, int txBufferSize, int queueSize, QueueHandle_t *queue, int flags)
+{
+    hostUarts[port].installed = true;
+    return ESP_OK;
+}
+
+inline esp_err_t uart_driver_delete(uart_port_t port)
+{
+    hostUarts[port].installed = false;
+    return ESP_OK;
+}
+
+inline esp_err_t uart_set_tx_idle_num(uart_port_t port, uint16_t idleBits)
+{
+    hostUarts[port].idleBits = idleBits;
+    return ESP_OK;
+}
+
+inline int uart_write_bytes_with_break(uart_port_t port, const void *data, size_t length, int breakBits)
+{
+    HostUart &uart = hostUarts[port];
+    uart.length = length < sizeof(uart.data) ? length : sizeof(uart.data);
+    memcpy(uart.data, data, uart.length);
+    uart.breakBits = breakBits;
+    uart.frames++;
+    return length;
+}
+
+inline int uart_write_bytes(uart_port_t port, const void *data, size_t length)
+{
+    return uart_write_bytes_with_break(port, data, length, 0);
+}
+
+inline esp_err_t uart_wait_tx_done(uart_port_t port, TickType_t ticks)
+{
+    return ESP_OK;
+}
+
+inline int uart_read_bytes(uart_port_t port, void *buffer, uint32_t length, TickType_t ticks)
+{
+    return 0;
+}
+
+inline esp_err_t uart_flush_input(uart_port_t port)
+{
+    return ESP_OK;
+}
+
+inline esp_err_t uart_set_line_inverse(uart_port_t port, uint32_t mask)
+{
+    return ESP_OK;
+}
+
+inline const char *esp_err_to_name(esp_err_t err)
+{
+    return err == ESP_OK ? "ESP_OK" : "ESP_FAIL";
+}
+
+#endif
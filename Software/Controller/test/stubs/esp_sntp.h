@@ -0,0 +1,16 @@
+#ifndef LMAN_TEST_ESP_SNTP
+#define LMAN_TEST_ESP_SNTP
+
+#include <sys/time.h>
+
+typedef void (*sntp_sync_time_cb_t)(struct timeval *tv);
+
+/// @brief The callback SNTP calls after setting the clock, the tests call it to simulate a sync
+inline sntp_sync_time_cb_t hostSntpCallback = nullptr;
+
+inline void sntp_set_time_sync_notification_cb(sntp_sync_time_cb_t callback)
+{
+    hostSntpCallback = callback;
+}
+
+#endif
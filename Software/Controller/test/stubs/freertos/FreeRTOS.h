@@ -0,0 +1,52 @@
+#ifndef LMAN_TEST_FREERTOS
+#define LMAN_TEST_FREERTOS
+
+// Host replacement of FreeRTOS for the native tests. Tasks are never started, ticks are ms of the fake clock.
+
+#include <stdint.h>
+#include <atomic>
+
+typedef void *TaskHandle_t;
+typedef void *QueueHandle_t;
+typedef void *SemaphoreHandle_t;
+typedef uint32_t TickType_t;
+typedef int BaseType_t;
+typedef unsigned int UBaseType_t;
+
+#define portTICK_PERIOD_MS 1
+#define portMAX_DELAY 0xFFFFFFFF
+#define pdTRUE 1
+#define pdFALSE 0
+#define pdPASS 1
+#define pdFAIL 0
+#define pdMS_TO_TICKS(ms) ((TickType_t)(ms))
+
+/// @brief A real spinlock, the pool tests take it from several threads
+typedef std::atomic_flag portMUX_TYPE;
+#define portMUX_INITIALIZER_UNLOCKED ATOMIC_FLAG_INIT
+
+inline void portENTER_CRITICAL(portMUX_TYPE *mux)
+{
+    while (mux->test_and_set(std::memory_order_acquire))
+    {
+    }
+}
+
+inline void portEXIT_CRITICAL(portMUX_TYPE *mux)
+{
+    mux->clear(std::memory_order_release);
+}
+
+inline void portENTER_CRITICAL_ISR(portMUX_TYPE *mux)
+{
+    portENTER_CRITICAL(mux);
+}
+
+inline void portEXIT_CRITICAL_ISR(portMUX_TYPE *mux)
+{
+    portEXIT_CRITICAL(mux);
+}
+
+#define portYIELD_FROM_ISR()
+
+#endif
@@ -0,0 +1,65 @@
+#ifndef LMAN_TEST_FREERTOS_TASK
+#define LMAN_TEST_FREERTOS_TASK
+
+#include <freertos/FreeRTOS.h>
+
+typedef void (*TaskFunction_t)(void *);
+
+void hostAdvance(uint32_t ms);
+unsigned long millis();
+
+/// @brief The number of task notifications given, over all tasks
+inline uint32_t hostTaskNotifications = 0;
+
+/// @brief Tasks are not run on the host, the handle only has to be set
+inline BaseType_t xTaskCreatePinnedToCore(TaskFunction_t function, const char *name, uint32_t stackSize, void *param, UBaseType_t priority, TaskHandle_t *handle, BaseType_t core)
+{
+    static uint8_t task;
+    if (handle)
+    {
+        *handle = &task;
+    }
+    return pdPASS;
+}
+
+inline void vTaskDelay(TickType_t ticks)
+{
+    hostAdvance(ticks);
+}
+
+inline TickType_t xTaskGetTickCount()
+{
+    return (TickType_t)millis();
+}
+
+inline void vTaskDelayUntil(TickType_t *previous, TickType_t ticks)
+{
+    *previous += ticks;
+    if ((int32_t)(*previous - xTaskGetTickCount()) > 0)
+    {
+        hostAdvance(*previous - xTaskGetTickCount());
+    }
+}
+
+inline BaseType_t xTaskNotifyGive(TaskHandle_t task)
+{
+    hostTaskNotifications++;
+    return pdPASS;
+}
+
+inline void vTaskNotifyGiveFromISR(TaskHandle_t task, BaseType_t *woken)
+{
+    hostTaskNotifications++;
+}
+
+inline uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t ticks)
+{
+    return 0;
+}
+
+inline UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task)
+{
+    return 0;
+}
+
+#endif
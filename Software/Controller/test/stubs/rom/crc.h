@@ -0,0 +1,21 @@
+#ifndef LMAN_TEST_ROM_CRC
+#define LMAN_TEST_ROM_CRC
+
+#include <stdint.h>
+
+/// @brief The CRC-32 of the ESP32 ROM, the one of zlib. Pass 0 as crc to start.
+inline uint32_t crc32_le(uint32_t crc, const uint8_t *buffer, uint32_t length)
+{
+    crc = ~crc;
+    for (uint32_t i = 0; i < length; i++)
+    {
+        crc ^= buffer[i];
+        for (uint8_t bit = 0; bit < 8; bit++)
+        {
+            crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+        }
+    }
+    return ~crc;
+}
+
+#endif
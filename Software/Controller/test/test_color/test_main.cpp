@@ -0,0 +1,212 @@
+#include <unity.h>
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include "../../lib/Color/Color.cpp"
+
+/// @brief Hue of blue, 240 degrees
+#define HUE_BLUE 43690
+/// @brief Fixtures in the bench, more than a controller drives
+#define BENCH_FIXTURES 32
+#define BENCH_FRAMES 20000
+
+/// @brief Difference between two hues in degrees, the shorter way around
+static double hueDistance(uint16_t a, uint16_t b)
+{
+    return abs((int16_t)(a - b)) * 360.0 / 65536;
+}
+
+static Color hsColor(uint16_t hue, uint8_t saturation)
+{
+    Color color;
+    color.hue = hue;
+    color.saturation = saturation;
+    return color;
+}
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+void test_primaries()
+{
+    uint8_t rgb[3];
+    colorToRgb(hsColor(0, 255), rgb);
+    TEST_ASSERT_EQUAL_UINT8(255, rgb[0]);
+    TEST_ASSERT_EQUAL_UINT8(0, rgb[1]);
+    TEST_ASSERT_EQUAL_UINT8(0, rgb[2]);
+    colorToRgb(hsColor(HUE_BLUE, 255), rgb);
+    TEST_ASSERT_EQUAL_UINT8(0, rgb[0]);
+    TEST_ASSERT_EQUAL_UINT8(0, rgb[1]);
+    TEST_ASSERT_EQUAL_UINT8(255, rgb[2]);
+    // No saturation is white at full brightness
+    colorToRgb(hsColor(12345, 0), rgb);
+    TEST_ASSERT_EQUAL_UINT8(255, rgb[0]);
+    TEST_ASSERT_EQUAL_UINT8(255, rgb[1]);
+    TEST_ASSERT_EQUAL_UINT8(255, rgb[2]);
+}
+
+void test_hs_round_trip()
+{
+    double worstHue = 0;
+    for (uint32_t hue = 0; hue < 65536; hue += 97)
+    {
+        for (uint16_t saturation = 1; saturation < 256; saturation += 17)
+        {
+            uint8_t rgb[3];
+            uint16_t hueBack;
+            uint8_t saturationBack;
+            colorToRgb(hsColor(hue, saturation), rgb);
+            colorRgbToHs(rgb, hueBack, saturationBack);
+            TEST_ASSERT_UINT8_WITHIN(3, saturation, saturationBack);
+            // The hue of a nearly white color is not kept in 8 bit RGB
+            if (saturation >= 64)
+            {
+                double distance = hueDistance(hue, hueBack);
+                worstHue = distance > worstHue ? distance : worstHue;
+            }
+        }
+    }
+    char message[64];
+    snprintf(message, sizeof(message), "Worst hue error %.2f degrees", worstHue);
+    TEST_MESSAGE(message);
+    TEST_ASSERT_TRUE(worstHue < 1.5);
+}
+
+void test_hue_takes_shorter_way()
+{
+    // Red to blue goes through magenta, not green
+    Color middle = colorInterpolate(hsColor(0, 255), hsColor(HUE_BLUE, 255), 32768);
+    TEST_ASSERT_TRUE(hueDistance(middle.hue, 54613) < 1);
+    uint8_t rgb[3];
+    colorToRgb(middle, rgb);
+    TEST_ASSERT_EQUAL_UINT8(255, rgb[0]);
+    TEST_ASSERT_EQUAL_UINT8(0, rgb[1]);
+    TEST_ASSERT_EQUAL_UINT8(255, rgb[2]);
+
+    // Across 0 degrees: 350 to 10 stays near red
+    uint16_t from = 350 * 65536 / 360;
+    uint16_t to = 10 * 65536 / 360;
+    for (uint32_t position = 0; position <= 65535; position += 4096)
+    {
+        Color color = colorInterpolate(hsColor(from, 255), hsColor(to, 255), position);
+        TEST_ASSERT_TRUE(hueDistance(color.hue, 0) <= 10.01);
+    }
+    TEST_ASSERT_TRUE(hueDistance(colorInterpolate(hsColor(from, 255), hsColor(to, 255), 32768).hue, 0) < 0.1);
+}
+
+void test_from_white_does_not_sweep()
+{
+    // White has no hue, only the saturation fades
+    Color white;
+    Color middle = colorInterpolate(white, hsColor(0, 255), 32768);
+    TEST_ASSERT_EQUAL_UINT16(0, middle.hue);
+    TEST_ASSERT_UINT8_WITHIN(1, 127, middle.saturation);
+}
+
+void test_color_temperature()
+{
+    Color color;
+    color.mode = COLOR_MODE_COLOR_TEMP;
+    uint8_t types[1] = {FIXTURE_CCT};
+    uint16_t levels[1] = {65535};
+    uint8_t slots[FIXTURE_MAX_SLOTS];
+    color.mireds = FIXTURE_WARM_MIREDS;
+    colorRender(&color, types, levels, slots, 1);
+    TEST_ASSERT_EQUAL_UINT8(255, slots[0]);
+    TEST_ASSERT_EQUAL_UINT8(0, slots[1]);
+    color.mireds = FIXTURE_COLD_MIREDS;
+    colorRender(&color, types, levels, slots, 1);
+    TEST_ASSERT_EQUAL_UINT8(0, slots[0]);
+    TEST_ASSERT_EQUAL_UINT8(255, slots[1]);
+
+    // Blended in mireds
+    Color warm = color;
+    warm.mireds = FIXTURE_WARM_MIREDS;
+    Color middle = colorInterpolate(warm, color, 32768);
+    TEST_ASSERT_UINT16_WITHIN(1, (FIXTURE_WARM_MIREDS + FIXTURE_COLD_MIREDS) / 2, middle.mireds);
+}
+
+void test_white_extraction()
+{
+    // The white part of pink is moved to the white LEDs, at half brightness
+    Color pink;
+    pink.mode = COLOR_MODE_RGB;
+    pink.rgbw[0] = 255;
+    pink.rgbw[1] = 128;
+    pink.rgbw[2] = 128;
+    uint8_t types[1] = {FIXTURE_RGBW};
+    uint16_t levels[1] = {32768};
+    uint8_t slots[FIXTURE_MAX_SLOTS];
+    colorRender(&pink, types, levels, slots, 1);
+    TEST_ASSERT_EQUAL_UINT8(64, slots[0]);
+    TEST_ASSERT_EQUAL_UINT8(0, slots[1]);
+    TEST_ASSERT_EQUAL_UINT8(0, slots[2]);
+    TEST_ASSERT_EQUAL_UINT8(64, slots[3]);
+
+    // An RGB fixture shows the same pink without white
+    types[0] = FIXTURE_RGB;
+    levels[0] = 65535;
+    colorRender(&pink, types, levels, slots, 1);
+    TEST_ASSERT_EQUAL_UINT8(255, slots[0]);
+    TEST_ASSERT_EQUAL_UINT8(128, slots[1]);
+    TEST_ASSERT_EQUAL_UINT8(128, slots[2]);
+}
+
+/// @brief CPU time of a color fade frame: interpolate and render mixed fixtures, as _taskColor does
+void test_render_bench()
+{
+    Color from[BENCH_FIXTURES];
+    Color to[BENCH_FIXTURES];
+    Color colors[BENCH_FIXTURES];
+    uint8_t types[BENCH_FIXTURES];
+    uint16_t levels[BENCH_FIXTURES];
+    uint8_t slots[BENCH_FIXTURES * FIXTURE_MAX_SLOTS];
+    for (uint8_t i = 0; i < BENCH_FIXTURES; i++)
+    {
+        types[i] = FIXTURE_RGB + i % 3;
+        levels[i] = 1000 * i;
+        from[i] = hsColor(i * 2000, 200);
+        to[i].mode = types[i] == FIXTURE_CCT ? COLOR_MODE_COLOR_TEMP : COLOR_MODE_RGB;
+        from[i].mode = types[i] == FIXTURE_CCT ? COLOR_MODE_COLOR_TEMP : COLOR_MODE_HS;
+        to[i].rgbw[0] = i * 7;
+        to[i].rgbw[1] = 255;
+    }
+
+    uint32_t sum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t frame = 0; frame < BENCH_FRAMES; frame++)
+    {
+        uint16_t position = frame * 331;
+        for (uint8_t i = 0; i < BENCH_FIXTURES; i++)
+        {
+            colors[i] = colorInterpolate(from[i], to[i], position);
+        }
+        colorRender(colors, types, levels, slots, BENCH_FIXTURES);
+        sum += slots[frame % sizeof(slots)];
+    }
+    double perFrame = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / BENCH_FRAMES;
+
+    char message[96];
+    snprintf(message, sizeof(message), "%.2f us per frame of %d fading fixtures (%u)", perFrame, BENCH_FIXTURES, sum);
+    TEST_MESSAGE(message);
+    // Far below the 23 ms of a full DMX frame even on a slow host
+    TEST_ASSERT_TRUE(perFrame < 100);
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_primaries);
+    RUN_TEST(test_hs_round_trip);
+    RUN_TEST(test_hue_takes_shorter_way);
+    RUN_TEST(test_from_white_does_not_sweep);
+    RUN_TEST(test_color_temperature);
+    RUN_TEST(test_white_extraction);
+    RUN_TEST(test_render_bench);
+    return UNITY_END();
+}
@@ -0,0 +1,96 @@
+#include <unity.h>
+#include "../../lib/DMXOutput/DMXFrame.cpp"
+
+/// @brief Shortest break a DMX512-A transmitter may send in us
+#define DMX512A_MIN_BREAK 92
+/// @brief Shortest mark after break a DMX512-A transmitter may send in us
+#define DMX512A_MIN_MAB 12
+/// @brief Shortest time from break to break in us
+#define DMX512A_MIN_FRAME 1204
+
+static DMXFrame frame;
+
+void setUp()
+{
+    frame = DMXFrame();
+}
+
+void tearDown()
+{
+}
+
+void test_line_timing()
+{
+    // 250 kbaud, 8N2
+    TEST_ASSERT_EQUAL_UINT32(1000000 / DMX_BAUD_RATE, DMX_BIT_TIME);
+    TEST_ASSERT_EQUAL_UINT32(44, DMX_SLOT_TIME);
+    TEST_ASSERT_EQUAL_UINT32(100, DMX_BREAK_BITS * DMX_BIT_TIME);
+    TEST_ASSERT_EQUAL_UINT32(16, DMX_MAB_BITS * DMX_BIT_TIME);
+    TEST_ASSERT_GREATER_OR_EQUAL(DMX512A_MIN_BREAK, DMX_BREAK_BITS * DMX_BIT_TIME);
+    TEST_ASSERT_GREATER_OR_EQUAL(DMX512A_MIN_MAB, DMX_MAB_BITS * DMX_BIT_TIME);
+}
+
+void test_full_universe()
+{
+    frame.setSlotCount(DMX_UNIVERSE_SIZE);
+    TEST_ASSERT_EQUAL_UINT16(DMX_UNIVERSE_SIZE + 1, frame.length());
+    // Break, MAB, start code and 512 slots
+    TEST_ASSERT_EQUAL_UINT32(100 + 16 + 513 * 44, frame.getFrameTime());
+    TEST_ASSERT_EQUAL_UINT32(22688, frame.getFrameTime());
+    TEST_ASSERT_EQUAL_UINT16(44, frame.getMaxFrameRate());
+}
+
+void test_short_frame_padded()
+{
+    frame.setSlotCount(5);
+    TEST_ASSERT_EQUAL_UINT16(DMX_MIN_SLOTS, frame.getSlotCount());
+    TEST_ASSERT_EQUAL_UINT16(DMX_MIN_SLOTS + 1, frame.length());
+    // The padding keeps the shortest frame within DMX512-A
+    TEST_ASSERT_GREATER_OR_EQUAL(DMX512A_MIN_FRAME, frame.getFrameTime());
+    TEST_ASSERT_EQUAL_UINT32(1216, frame.getFrameTime());
+    TEST_ASSERT_EQUAL_UINT16(822, frame.getMaxFrameRate());
+
+    frame.setSlotCount(0);
+    TEST_ASSERT_EQUAL_UINT16(DMX_MIN_SLOTS, frame.getSlotCount());
+    frame.setSlotCount(600);
+    TEST_ASSERT_EQUAL_UINT16(DMX_UNIVERSE_SIZE, frame.getSlotCount());
+}
+
+void test_frame_time_per_slot()
+{
+    for (uint16_t slots = DMX_MIN_SLOTS; slots < DMX_UNIVERSE_SIZE; slots++)
+    {
+        frame.setSlotCount(slots);
+        uint32_t time = frame.getFrameTime();
+        frame.setSlotCount(slots + 1);
+        TEST_ASSERT_EQUAL_UINT32(DMX_SLOT_TIME, frame.getFrameTime() - time);
+    }
+}
+
+void test_slots()
+{
+    frame.write(1, 9);
+    frame.write(512, 7);
+    frame.write(0, 1);
+    frame.write(513, 1);
+    TEST_ASSERT_EQUAL_UINT8(DMX_START_CODE, frame.data()[0]);
+    TEST_ASSERT_EQUAL_UINT8(9, frame.data()[1]);
+    TEST_ASSERT_EQUAL_UINT8(9, frame.read(1));
+    TEST_ASSERT_EQUAL_UINT8(0, frame.read(0));
+    TEST_ASSERT_EQUAL_UINT8(0, frame.read(513));
+    // Kept past the slot count and sent once the frame grows
+    TEST_ASSERT_EQUAL_UINT8(7, frame.read(512));
+    frame.setSlotCount(DMX_UNIVERSE_SIZE);
+    TEST_ASSERT_EQUAL_UINT8(7, frame.data()[512]);
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_line_timing);
+    RUN_TEST(test_full_universe);
+    RUN_TEST(test_short_frame_padded);
+    RUN_TEST(test_frame_time_per_slot);
+    RUN_TEST(test_slots);
+    return UNITY_END();
+}
@@ -0,0 +1,168 @@
+#include <unity.h>
+#include "../../lib/DMXOutput/DMXFrame.cpp"
+#include "../../lib/DMXOutput/DMXOutput.cpp"
+#include "../../lib/DMXMerger/DMXMerger.cpp"
+#include "../../lib/LMANTasks/LMANTasks.cpp"
+#include "../../lib/E131/E131.cpp"
+
+#define TEST_UNIVERSE 7
+/// @brief Interval (in ms) of the packets of a source, E1.31 keep-alive is at most 1 s
+#define SEND_INTERVAL 1000
+
+LMANConfig *LMANConfig::instance;
+
+static LMANConfig config;
+static DMXOutput *output;
+static DMXMerger *merger;
+static E131Receiver *receiver;
+static TaskHandle_t sendTask;
+
+/// @brief A sender of the test universe
+struct TestSource
+{
+    uint8_t cid;
+    uint8_t priority;
+    uint8_t sequence;
+};
+
+static TestSource primary = {1, 150, 0};
+static TestSource backup = {2, 100, 0};
+
+/// @brief Deliver a data packet with every slot set to level
+static void send(TestSource &source, uint8_t level, uint16_t slots = 16, uint8_t options = 0)
+{
+    static uint8_t packet[E131_START_CODE_OFFSET + 1 + 512];
+    memset(packet, 0, sizeof(packet));
+    memcpy(packet + E131_ACN_ID_OFFSET, E131_ACN_ID, sizeof(E131_ACN_ID));
+    packet[E131_ROOT_VECTOR_OFFSET + 3] = E131_VECTOR_ROOT_DATA;
+    memset(packet + E131_CID_OFFSET, source.cid, 16);
+    packet[E131_FRAMING_VECTOR_OFFSET + 3] = E131_VECTOR_DATA_PACKET;
+    packet[E131_PRIORITY_OFFSET] = source.priority;
+    packet[E131_SEQUENCE_OFFSET] = ++source.sequence;
+    packet[E131_OPTIONS_OFFSET] = options;
+    packet[E131_UNIVERSE_OFFSET] = TEST_UNIVERSE >> 8;
+    packet[E131_UNIVERSE_OFFSET + 1] = TEST_UNIVERSE & 0xFF;
+    packet[E131_DMP_VECTOR_OFFSET] = E131_VECTOR_DMP_SET_PROPERTY;
+    packet[E131_PROPERTY_COUNT_OFFSET] = (slots + 1) >> 8;
+    packet[E131_PROPERTY_COUNT_OFFSET + 1] = (slots + 1) & 0xFF;
+    memset(packet + E131_START_CODE_OFFSET + 1, level, slots);
+    AsyncUDPPacket udpPacket(packet, E131_START_CODE_OFFSET + 1 + slots);
+    hostUdp->handler(udpPacket);
+}
+
+void setUp()
+{
+    LMANConfig::instance = &config;
+    config.dmx_merge_mode = DMX_MERGE_HTP;
+    config.dmx_min_frame_rate = 2;
+    config.e131_universe = TEST_UNIVERSE;
+    memset(hostUarts, 0, sizeof(hostUarts));
+    DMXMerger::instance = nullptr;
+    output = new DMXOutput[1];
+    merger = new DMXMerger[1];
+    receiver = new E131Receiver();
+    xTaskCreatePinnedToCore(nullptr, "", 0, nullptr, 0, &sendTask, 0);
+    TEST_ASSERT_TRUE(output->init(1, UART_NUM_2, 17));
+    merger->init(output, &sendTask);
+    TEST_ASSERT_TRUE(receiver->init());
+    primary.sequence = 0;
+    backup.sequence = 0;
+}
+
+void tearDown()
+{
+    delete receiver;
+    delete[] merger;
+    delete[] output;
+}
+
+void test_joins_universe_group()
+{
+    TEST_ASSERT_EQUAL_UINT16(E131_PORT, hostUdp->port);
+    TEST_ASSERT_EQUAL_STRING("239.255.0.7", hostUdp->group.toString().c_str());
+}
+
+void test_highest_priority_wins()
+{
+    send(backup, 10);
+    send(primary, 200);
+    TEST_ASSERT_EQUAL_UINT8(200, output->read(1));
+    // Lower priority data does not change the output
+    send(backup, 20);
+    TEST_ASSERT_EQUAL_UINT8(200, output->read(16));
+    // Same priority is merged HTP
+    TestSource second = {3, 150, 0};
+    send(second, 220, 8);
+    TEST_ASSERT_EQUAL_UINT8(220, output->read(8));
+    TEST_ASSERT_EQUAL_UINT8(200, output->read(9));
+}
+
+void test_backup_takes_over_when_primary_goes_silent()
+{
+    // The backup is stored first, the primary after it
+    send(backup, 10);
+    send(primary, 200);
+    for (uint8_t i = 0; i < 3; i++)
+    {
+        hostAdvance(SEND_INTERVAL);
+        send(primary, 200);
+        send(backup, 10);
+        TEST_ASSERT_EQUAL_UINT8(200, output->read(1));
+    }
+
+    // Only the backup keeps sending
+    hostAdvance(SEND_INTERVAL);
+    send(backup, 10);
+    TEST_ASSERT_EQUAL_UINT8(200, output->read(1));
+    hostAdvance(SEND_INTERVAL);
+    send(backup, 10);
+    TEST_ASSERT_EQUAL_UINT8(200, output->read(1));
+    hostAdvance(SEND_INTERVAL);
+    send(backup, 10);
+    TEST_ASSERT_EQUAL_UINT8(10, output->read(1));
+    TEST_ASSERT_EQUAL_UINT8(10, output->read(16));
+    char status[256];
+    receiver->getStatusJson(status, sizeof(status));
+    TEST_ASSERT_NOT_NULL(strstr(status, "\"sources\":1,\"priority\":100"));
+
+    // The primary is back
+    send(primary, 200);
+    TEST_ASSERT_EQUAL_UINT8(200, output->read(1));
+}
+
+void test_terminated_stream_fails_over_at_once()
+{
+    send(backup, 10);
+    send(primary, 200);
+    send(primary, 200, 16, E131_OPTION_STREAM_TERMINATED);
+    TEST_ASSERT_EQUAL_UINT8(10, output->read(1));
+}
+
+void test_invalid_packets_dropped()
+{
+    TestSource other = {4, 100, 0};
+    send(other, 50);
+    TEST_ASSERT_EQUAL_UINT8(50, output->read(1));
+    config.e131_universe = TEST_UNIVERSE + 1;
+    send(other, 60);
+    TEST_ASSERT_EQUAL_UINT8(50, output->read(1));
+    config.e131_universe = TEST_UNIVERSE;
+    // Out of order
+    other.sequence -= 2;
+    send(other, 70);
+    TEST_ASSERT_EQUAL_UINT8(50, output->read(1));
+    char status[256];
+    receiver->getStatusJson(status, sizeof(status));
+    TEST_ASSERT_NOT_NULL(strstr(status, "\"packets\":1,\"out_of_order\":1,\"invalid\":1"));
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_joins_universe_group);
+    RUN_TEST(test_highest_priority_wins);
+    RUN_TEST(test_backup_takes_over_when_primary_goes_silent);
+    RUN_TEST(test_terminated_stream_fails_over_at_once);
+    RUN_TEST(test_invalid_packets_dropped);
+    return UNITY_END();
+}
@@ -0,0 +1,148 @@
+#include <unity.h>
+#include <algorithm>
+#include <chrono>
+#include <stdio.h>
+#include "../../lib/Effects/Effects.cpp"
+
+/// @brief Channels in one rendered universe
+#define BENCH_CHANNELS 512
+/// @brief Frames rendered by the bench, about 8 minutes of effects
+#define BENCH_FRAMES 20000
+
+static EffectState states[BENCH_CHANNELS];
+static uint16_t levels[BENCH_CHANNELS];
+static uint16_t output[BENCH_CHANNELS];
+
+void setUp()
+{
+    for (uint16_t i = 0; i < BENCH_CHANNELS; i++)
+    {
+        effectStart(states[i], EFFECT_BREATHE + i % (EFFECT_COUNT - 1), 0, i * 2654435761UL);
+        states[i].chaseIndex = i % 8;
+        states[i].chaseCount = 8;
+        levels[i] = i * 128;
+    }
+}
+
+void tearDown()
+{
+}
+
+/// @brief CPU time of one effect frame over a full universe with all effects mixed
+void test_render_universe()
+{
+    uint32_t sum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t frame = 0; frame < BENCH_FRAMES; frame++)
+    {
+        effectRender(states, levels, output, BENCH_CHANNELS, EFFECT_FRAME_TIME);
+        sum += output[frame % BENCH_CHANNELS];
+    }
+    double perFrame = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - start).count() / BENCH_FRAMES;
+
+    char message[96];
+    snprintf(message, sizeof(message), "%.2f us per frame of %d channels (%u)", perFrame, BENCH_CHANNELS, sum);
+    TEST_MESSAGE(message);
+    // Far below the frame time even on a slow host, the ESP32 is about 10-20 times slower
+    TEST_ASSERT_LESS_THAN(EFFECT_FRAME_TIME * 1000 / 20, perFrame);
+}
+
+void test_render_matches_step()
+{
+    EffectState copies[BENCH_CHANNELS];
+    memcpy(copies, states, sizeof(states));
+    effectRender(states, levels, output, BENCH_CHANNELS, EFFECT_FRAME_TIME);
+    for (uint16_t i = 0; i < BENCH_CHANNELS; i++)
+    {
+        TEST_ASSERT_EQUAL_UINT16(effectStep(copies[i], levels[i], EFFECT_FRAME_TIME), output[i]);
+    }
+}
+
+void test_breathe()
+{
+    EffectState state;
+    effectStart(state, EFFECT_BREATHE, 4000, 1);
+    TEST_ASSERT_UINT16_WITHIN(256, 65535, effectStep(state, 65535, 0));
+    uint16_t lowest = 65535;
+    uint16_t previous = 65535;
+    for (uint16_t t = 0; t < 4000; t += 20)
+    {
+        uint16_t level = effectStep(state, 65535, 20);
+        // Smooth, no step larger than a few 8 bit steps per frame
+        TEST_ASSERT_UINT16_WITHIN(1024, previous, level);
+        lowest = std::min(lowest, level);
+        previous = level;
+    }
+    // Dips EFFECT_BREATHE_DEPTH/255 of the level
+    TEST_ASSERT_UINT16_WITHIN(512, 65535 - 65535 * EFFECT_BREATHE_DEPTH / 255, lowest);
+}
+
+void test_strobe()
+{
+    EffectState state;
+    effectStart(state, EFFECT_STROBE, 100, 1);
+    uint8_t on = 0;
+    for (uint8_t t = 0; t < 100; t++)
+    {
+        uint16_t level = effectStep(state, 40000, 1);
+        TEST_ASSERT_TRUE(level == 0 || level == 40000);
+        on += level > 0;
+    }
+    // EFFECT_STROBE_DUTY of 256 of the period
+    TEST_ASSERT_INT_WITHIN(1, 100 * EFFECT_STROBE_DUTY / 256, on);
+}
+
+void test_chase()
+{
+    EffectState chase[3];
+    for (uint8_t i = 0; i < 3; i++)
+    {
+        effectStart(chase[i], EFFECT_CHASE, 3000, 1);
+        chase[i].chaseIndex = i;
+        chase[i].chaseCount = 3;
+    }
+    // One channel on at a time, moving one step per third of the period
+    for (uint8_t step = 0; step < 6; step++)
+    {
+        uint8_t onCount = 0;
+        for (uint8_t i = 0; i < 3; i++)
+        {
+            bool on = effectStep(chase[i], 1000, step == 0 ? 500 : 1000) > 0;
+            onCount += on;
+            if (on)
+            {
+                TEST_ASSERT_EQUAL_UINT8(step % 3, i);
+            }
+        }
+        TEST_ASSERT_EQUAL_UINT8(1, onCount);
+    }
+}
+
+void test_candle()
+{
+    EffectState state;
+    effectStart(state, EFFECT_CANDLE, 0, 1234);
+    uint16_t lowest = 65535;
+    uint16_t highest = 0;
+    for (uint16_t frame = 0; frame < 1000; frame++)
+    {
+        uint16_t level = effectStep(state, 65535, EFFECT_FRAME_TIME);
+        lowest = std::min(lowest, level);
+        highest = std::max(highest, level);
+    }
+    // Flickers, but never deeper than EFFECT_CANDLE_DEPTH/256
+    TEST_ASSERT_GREATER_THAN(lowest, highest);
+    TEST_ASSERT_GREATER_OR_EQUAL(65535 - 65535 * EFFECT_CANDLE_DEPTH / 256 - 256, lowest);
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_render_universe);
+    RUN_TEST(test_render_matches_step);
+    RUN_TEST(test_breathe);
+    RUN_TEST(test_strobe);
+    RUN_TEST(test_chase);
+    RUN_TEST(test_candle);
+    return UNITY_END();
+}
@@ -0,0 +1,177 @@
+#include <unity.h>
+#include <math.h>
+#include <stdio.h>
+#include <LightManager.h>
+#include "../../lib/Effects/Effects.cpp"
+
+/// @brief Resolution of the simulated dimmer, a 12 bit PWM with a quadratic curve like most LED dimmers
+#define DIMMER_PWM_TOP 4095
+/// @brief Length of the simulated fades in ms
+#define FADE_TIME 10000
+#define FADE_STEPS (FADE_TIME / SCENE_FADE_STEP)
+
+/// @brief What a dimmer outputs for a DMX level, in PWM steps
+static int dimmerPwm(uint16_t level, bool fine)
+{
+    double value = fine ? level / 65535.0 : (level >> 8) / 255.0;
+    return (int)lround(value * value * DIMMER_PWM_TOP);
+}
+
+/// @brief How smooth a series of dimmer outputs is
+struct Smoothness
+{
+    uint16_t distinct = 1;
+    /// @brief The most frames in a row without a change
+    uint16_t longestHold = 0;
+    int largestJump = 0;
+};
+
+static Smoothness measure(const int *pwm, uint16_t count)
+{
+    Smoothness result;
+    uint16_t hold = 0;
+    for (uint16_t i = 1; i < count; i++)
+    {
+        if (pwm[i] == pwm[i - 1])
+        {
+            hold++;
+            continue;
+        }
+        result.distinct++;
+        result.longestHold = hold > result.longestHold ? hold : result.longestHold;
+        result.largestJump = abs(pwm[i] - pwm[i - 1]) > result.largestJump ? abs(pwm[i] - pwm[i - 1]) : result.largestJump;
+        hold = 0;
+    }
+    result.longestHold = hold > result.longestHold ? hold : result.longestHold;
+    return result;
+}
+
+static void report(const char *name, Smoothness &smoothness)
+{
+    char message[128];
+    snprintf(message, sizeof(message), "%s: %u distinct outputs, longest hold %u frames, largest jump %d", name, smoothness.distinct, smoothness.longestHold, smoothness.largestJump);
+    TEST_MESSAGE(message);
+}
+
+/// @brief Step a fade the way _taskSceneFade does
+static void runFade(uint16_t from, uint16_t to, uint16_t *levels)
+{
+    for (uint16_t i = 0; i < FADE_STEPS; i++)
+    {
+        levels[i] = levelInterpolate(from, to, i * SCENE_FADE_STEP, FADE_TIME);
+    }
+    levels[FADE_STEPS] = to;
+}
+
+void setUp()
+{
+}
+
+void tearDown()
+{
+}
+
+void test_8_bit_levels_round_trip()
+{
+    for (uint16_t level = 0; level < 256; level++)
+    {
+        TEST_ASSERT_EQUAL_UINT16(level, (level * LEVEL_SCALE) >> 8);
+    }
+    TEST_ASSERT_EQUAL_UINT16(65535, 255 * LEVEL_SCALE);
+}
+
+void test_scene_fade_steps()
+{
+    uint16_t levels[FADE_STEPS + 1];
+    uint16_t from = 1 * LEVEL_SCALE;
+    uint16_t to = 40 * LEVEL_SCALE;
+    runFade(from, to, levels);
+    TEST_ASSERT_EQUAL_UINT16(from, levels[0]);
+    // Even steps, never backwards
+    uint16_t step = (to - from) * SCENE_FADE_STEP / FADE_TIME;
+    for (uint16_t i = 1; i <= FADE_STEPS; i++)
+    {
+        TEST_ASSERT_GREATER_OR_EQUAL(levels[i - 1], levels[i]);
+        TEST_ASSERT_UINT16_WITHIN(1, step, levels[i] - levels[i - 1]);
+    }
+
+    // Down as well
+    runFade(to, from, levels);
+    for (uint16_t i = 1; i <= FADE_STEPS; i++)
+    {
+        TEST_ASSERT_LESS_OR_EQUAL(levels[i - 1], levels[i]);
+    }
+    TEST_ASSERT_EQUAL_UINT16(from, levels[FADE_STEPS]);
+}
+
+void test_long_fade_does_not_overflow()
+{
+    // An hour over the full range, 32 bits overflow after 32 s
+    const uint32_t hour = 3600000;
+    TEST_ASSERT_EQUAL_UINT16(32768, levelInterpolate(65535, 0, hour / 2, hour));
+    TEST_ASSERT_EQUAL_UINT16(65535 - 65535ULL * 3000000 / hour, levelInterpolate(65535, 0, 3000000, hour));
+    TEST_ASSERT_EQUAL_UINT16(1, levelInterpolate(0, 65535, hour / 65535 + 1, hour));
+    uint16_t previous = 0;
+    for (uint32_t elapsed = 0; elapsed < hour; elapsed += 997)
+    {
+        uint16_t level = levelInterpolate(0, 65535, elapsed, hour);
+        TEST_ASSERT_GREATER_OR_EQUAL(previous, level);
+        previous = level;
+    }
+}
+
+/// @brief A slow fade at low brightness, where 8 bit channels step visibly
+void test_low_fade_on_dimmer()
+{
+    uint16_t levels[FADE_STEPS + 1];
+    runFade(1 * LEVEL_SCALE, 40 * LEVEL_SCALE, levels);
+    int coarse[FADE_STEPS + 1];
+    int fine[FADE_STEPS + 1];
+    for (uint16_t i = 0; i <= FADE_STEPS; i++)
+    {
+        coarse[i] = dimmerPwm(levels[i], false);
+        fine[i] = dimmerPwm(levels[i], true);
+    }
+    Smoothness coarseSmoothness = measure(coarse, FADE_STEPS + 1);
+    Smoothness fineSmoothness = measure(fine, FADE_STEPS + 1);
+    report("Fade 1-40, 8 bit", coarseSmoothness);
+    report("Fade 1-40, 16 bit", fineSmoothness);
+    // Every PWM step on the way is used, none is skipped
+    TEST_ASSERT_EQUAL_INT(fine[FADE_STEPS] - fine[0] + 1, fineSmoothness.distinct);
+    TEST_ASSERT_EQUAL_INT(1, fineSmoothness.largestJump);
+    TEST_ASSERT_GREATER_THAN(coarseSmoothness.distinct, fineSmoothness.distinct);
+    TEST_ASSERT_LESS_THAN(coarseSmoothness.largestJump, fineSmoothness.largestJump);
+}
+
+void test_breathe_on_dimmer()
+{
+    EffectState coarseState;
+    EffectState fineState;
+    effectStart(coarseState, EFFECT_BREATHE, 0, 1);
+    effectStart(fineState, EFFECT_BREATHE, 0, 1);
+    const uint16_t frames = 4000 / EFFECT_FRAME_TIME;
+    int coarse[frames];
+    int fine[frames];
+    for (uint16_t i = 0; i < frames; i++)
+    {
+        coarse[i] = dimmerPwm(effectStep(coarseState, 60 * LEVEL_SCALE, EFFECT_FRAME_TIME), false);
+        fine[i] = dimmerPwm(effectStep(fineState, 60 * LEVEL_SCALE, EFFECT_FRAME_TIME), true);
+    }
+    Smoothness coarseSmoothness = measure(coarse, frames);
+    Smoothness fineSmoothness = measure(fine, frames);
+    report("Breathe at 60, 8 bit", coarseSmoothness);
+    report("Breathe at 60, 16 bit", fineSmoothness);
+    TEST_ASSERT_GREATER_OR_EQUAL(coarseSmoothness.distinct, fineSmoothness.distinct);
+    TEST_ASSERT_LESS_OR_EQUAL(coarseSmoothness.largestJump, fineSmoothness.largestJump);
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_8_bit_levels_round_trip);
+    RUN_TEST(test_scene_fade_steps);
+    RUN_TEST(test_long_fade_does_not_overflow);
+    RUN_TEST(test_low_fade_on_dimmer);
+    RUN_TEST(test_breathe_on_dimmer);
+    return UNITY_END();
+}
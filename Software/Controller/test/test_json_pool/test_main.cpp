@@ -0,0 +1,376 @@
+#include <unity.h>
+#include <atomic>
+#include <deque>
+#include <random>
+#include <thread>
+#include <vector>
+#include "../../lib/JsonPool/JsonPool.cpp"
+
+/// @brief Free heap of the simulated heap, about what is left on the ESP32 with WiFi and MQTT running
+#define SIM_HEAP_SIZE 96000
+/// @brief Allocations are rounded up to this, like the ESP-IDF heap
+#define SIM_HEAP_ALIGN 8
+/// @brief Events handled in the fragmentation runs
+#define SIM_EVENTS 20000
+#define SOAK_ROUNDS 200000
+
+/// @brief First-fit heap over offsets, to compare the fragmentation of a workload with and without the pool
+class SimHeap
+{
+public:
+    SimHeap()
+    {
+        this->_blocks.push_back({0, SIM_HEAP_SIZE, true});
+    }
+
+    /// @return The offset of the allocation, -1 if no free block is large enough
+    int32_t allocate(uint32_t size)
+    {
+        size = (size + SIM_HEAP_ALIGN - 1) & ~(SIM_HEAP_ALIGN - 1);
+        for (size_t i = 0; i < this->_blocks.size(); i++)
+        {
+            Block &block = this->_blocks[i];
+            if (block.free && block.size >= size)
+            {
+                uint32_t offset = block.offset;
+                if (block.size > size)
+                {
+                    this->_blocks.insert(this->_blocks.begin() + i + 1, {offset + size, block.size - size, true});
+                }
+                this->_blocks[i] = {offset, size, false};
+                return offset;
+            }
+        }
+        return -1;
+    }
+
+    void deallocate(int32_t offset)
+    {
+        for (size_t i = 0; i < this->_blocks.size(); i++)
+        {
+            if (this->_blocks[i].offset == (uint32_t)offset)
+            {
+                this->_blocks[i].free = true;
+                if (i + 1 < this->_blocks.size() && this->_blocks[i + 1].free)
+                {
+                    this->_blocks[i].size += this->_blocks[i + 1].size;
+                    this->_blocks.erase(this->_blocks.begin() + i + 1);
+                }
+                if (i > 0 && this->_blocks[i - 1].free)
+                {
+                    this->_blocks[i - 1].size += this->_blocks[i].size;
+                    this->_blocks.erase(this->_blocks.begin() + i);
+                }
+                return;
+            }
+        }
+        TEST_FAIL_MESSAGE("Freeing an unknown offset");
+    }
+
+    uint32_t getFree()
+    {
+        uint32_t free = 0;
+        for (Block &block : this->_blocks)
+        {
+            free += block.free ? block.size : 0;
+        }
+        return free;
+    }
+
+    uint32_t getLargestFree()
+    {
+        uint32_t largest = 0;
+        for (Block &block : this->_blocks)
+        {
+            largest = block.free && block.size > largest ? block.size : largest;
+        }
+        return largest;
+    }
+
+private:
+    struct Block
+    {
+        uint32_t offset;
+        uint32_t size;
+        bool free;
+    };
+    std::vector<Block> _blocks;
+};
+
+/// @brief A block size of the pool as reported by JsonPool::getStatusJson
+struct PoolClassStatus
+{
+    unsigned size;
+    unsigned count;
+    unsigned inUse;
+    unsigned peak;
+};
+
+static void readClasses(PoolClassStatus *classes)
+{
+    char status[512];
+    TEST_ASSERT_GREATER_THAN(0, JsonPool::getStatusJson(status, sizeof(status)));
+    const char *position = strstr(status, "\"classes\":[");
+    TEST_ASSERT_NOT_NULL(position);
+    for (uint8_t i = 0; i < JSON_POOL_CLASS_COUNT; i++)
+    {
+        position = strstr(position, "{\"size\":");
+        TEST_ASSERT_NOT_NULL(position);
+        TEST_ASSERT_EQUAL_INT(4, sscanf(position, "{\"size\":%u,\"count\":%u,\"in_use\":%u,\"peak\":%u", &classes[i].size, &classes[i].count, &classes[i].inUse, &classes[i].peak));
+        position++;
+    }
+}
+
+/// @brief The document capacities each task of the controller uses, a task holds one document at a time
+static const size_t MQTT_DOCUMENTS[] = {256, 256, 256, 1024};
+static const size_t WEB_DOCUMENTS[] = {256, 1024, CONFIG_JSON_SIZE};
+static const size_t UPDATE_DOCUMENTS[] = {1024};
+
+struct TaskDocuments
+{
+    const size_t *sizes;
+    uint8_t count;
+};
+
+static const TaskDocuments TASKS[] = {
+    {MQTT_DOCUMENTS, sizeof(MQTT_DOCUMENTS) / sizeof(size_t)},
+    {WEB_DOCUMENTS, sizeof(WEB_DOCUMENTS) / sizeof(size_t)},
+    {UPDATE_DOCUMENTS, sizeof(UPDATE_DOCUMENTS) / sizeof(size_t)},
+};
+#define TASK_COUNT (sizeof(TASKS) / sizeof(TaskDocuments))
+
+/// @brief Worst heap numbers seen during a run
+struct HeapResult
+{
+    uint32_t worstFragmentation = 0;
+    uint32_t smallestLargestBlock = SIM_HEAP_SIZE;
+    uint32_t failures = 0;
+};
+
+/// @brief The same fragmentation as JsonPool reports
+static uint32_t fragmentation(SimHeap &heap)
+{
+    uint32_t free = heap.getFree();
+    return free ? 100 - (heap.getLargestFree() * 100) / free : 0;
+}
+
+/// @brief Run the tasks that use JSON documents side by side. Each event is one document of one task: the MQTT
+/// client parses commands and sends discovery, the web server answers requests and sends the config, the updater
+/// reads a manifest. Strings with a random lifetime are allocated while a document is in use, like the MQTT client,
+/// the web server and the TCP stack do.
+/// @param usePool Take the documents from the JsonPool, its blocks are allocated first like at boot
+static HeapResult runWorkload(bool usePool)
+{
+    SimHeap heap;
+    HeapResult result;
+    std::mt19937 random(1);
+    std::deque<std::pair<uint32_t, int32_t>> strings;
+    /// The document each task holds, freed at its next event
+    void *documents[TASK_COUNT] = {};
+    int32_t offsets[TASK_COUNT];
+    std::fill(offsets, offsets + TASK_COUNT, -1);
+    if (usePool)
+    {
+        PoolClassStatus classes[JSON_POOL_CLASS_COUNT];
+        readClasses(classes);
+        for (PoolClassStatus &poolClass : classes)
+        {
+            TEST_ASSERT_GREATER_OR_EQUAL(0, heap.allocate(poolClass.size * poolClass.count));
+        }
+    }
+
+    for (uint32_t event = 0; event < SIM_EVENTS; event++)
+    {
+        // Mostly MQTT, then the web server, rarely the updater
+        uint32_t pick = random() % 100;
+        uint8_t task = pick < 70 ? 0 : pick < 98 ? 1 : 2;
+        if (documents[task])
+        {
+            JsonPool::deallocate(documents[task]);
+            documents[task] = nullptr;
+        }
+        if (offsets[task] >= 0)
+        {
+            heap.deallocate(offsets[task]);
+            offsets[task] = -1;
+        }
+
+        uint32_t size = TASKS[task].sizes[random() % TASKS[task].count];
+        if (usePool)
+        {
+            uint32_t fallbacks = JsonPool::getFallbacks();
+            documents[task] = JsonPool::allocate(size);
+            if (JsonPool::getFallbacks() != fallbacks)
+            {
+                offsets[task] = heap.allocate(size);
+                result.failures += offsets[task] < 0;
+            }
+        }
+        else
+        {
+            offsets[task] = heap.allocate(size);
+            result.failures += offsets[task] < 0;
+        }
+
+        // Strings allocated while the document is in use, freed some events later
+        for (uint32_t i = random() % 3; i > 0; i--)
+        {
+            int32_t string = heap.allocate(16 + random() % 300);
+            if (string < 0)
+            {
+                result.failures++;
+                continue;
+            }
+            strings.push_back({event + 20 + random() % 180, string});
+        }
+        std::sort(strings.begin(), strings.end());
+        while (!strings.empty() && strings.front().first <= event)
+        {
+            heap.deallocate(strings.front().second);
+            strings.pop_front();
+        }
+
+        result.worstFragmentation = std::max(result.worstFragmentation, fragmentation(heap));
+        result.smallestLargestBlock = std::min(result.smallestLargestBlock, heap.getLargestFree());
+    }
+    for (uint8_t task = 0; task < TASK_COUNT; task++)
+    {
+        if (documents[task])
+        {
+            JsonPool::deallocate(documents[task]);
+        }
+    }
+
+    // Report the end state the way the device does
+    ESP.freeHeap = heap.getFree();
+    ESP.maxAllocHeap = heap.getLargestFree();
+    return result;
+}
+
+void setUp()
+{
+    JsonPool::init();
+}
+
+void tearDown()
+{
+}
+
+/// @brief Each thread allocates, fills, verifies and frees the documents of one task. Blocks must never be handed
+/// out twice, and as many documents as the tasks hold at once always fit the pool.
+void test_soak_threads()
+{
+    std::atomic<uint32_t> corruptions{0};
+    std::vector<std::thread> threads;
+    uint32_t fallbacks = JsonPool::getFallbacks();
+    for (uint8_t t = 0; t < TASK_COUNT; t++)
+    {
+        threads.emplace_back([t, &corruptions]
+                             {
+            std::mt19937 random(t);
+            for (uint32_t i = 0; i < SOAK_ROUNDS; i++)
+            {
+                size_t size = TASKS[t].sizes[random() % TASKS[t].count];
+                uint8_t *block = (uint8_t *)JsonPool::allocate(size);
+                memset(block, t + 1, size);
+                std::this_thread::yield();
+                for (size_t j = 0; j < size; j += 61)
+                {
+                    corruptions += block[j] != t + 1;
+                }
+                JsonPool::deallocate(block);
+            } });
+    }
+    for (std::thread &thread : threads)
+    {
+        thread.join();
+    }
+
+    TEST_ASSERT_EQUAL_UINT32(0, corruptions.load());
+    TEST_ASSERT_EQUAL_UINT32(fallbacks, JsonPool::getFallbacks());
+    PoolClassStatus classes[JSON_POOL_CLASS_COUNT];
+    readClasses(classes);
+    for (PoolClassStatus &poolClass : classes)
+    {
+        TEST_ASSERT_EQUAL_UINT(0, poolClass.inUse);
+        TEST_ASSERT_LESS_OR_EQUAL(poolClass.count, poolClass.peak);
+    }
+}
+
+void test_full_pool_falls_back()
+{
+    PoolClassStatus classes[JSON_POOL_CLASS_COUNT];
+    readClasses(classes);
+    // Take every block, smaller requests move on to the next size
+    std::vector<void *> blocks;
+    for (PoolClassStatus &poolClass : classes)
+    {
+        for (unsigned i = 0; i < poolClass.count; i++)
+        {
+            blocks.push_back(JsonPool::allocate(poolClass.size));
+        }
+    }
+    uint32_t fallbacks = JsonPool::getFallbacks();
+    void *extra = JsonPool::allocate(100);
+    TEST_ASSERT_NOT_NULL(extra);
+    TEST_ASSERT_EQUAL_UINT32(fallbacks + 1, JsonPool::getFallbacks());
+    JsonPool::deallocate(extra);
+    for (void *block : blocks)
+    {
+        JsonPool::deallocate(block);
+    }
+    readClasses(classes);
+    for (PoolClassStatus &poolClass : classes)
+    {
+        TEST_ASSERT_EQUAL_UINT(0, poolClass.inUse);
+    }
+}
+
+void test_reallocate_keeps_content()
+{
+    uint8_t *block = (uint8_t *)JsonPool::allocate(200);
+    memset(block, 0x5A, 200);
+    uint8_t *larger = (uint8_t *)JsonPool::reallocate(block, 800);
+    TEST_ASSERT_TRUE(larger != block);
+    for (uint16_t i = 0; i < 200; i++)
+    {
+        TEST_ASSERT_EQUAL_UINT8(0x5A, larger[i]);
+    }
+    // Shrinking keeps the block
+    TEST_ASSERT_TRUE(JsonPool::reallocate(larger, 100) == larger);
+    JsonPool::deallocate(larger);
+}
+
+/// @brief The fragmentation of the same workload with documents from the heap and from the pool
+void test_fragmentation()
+{
+    HeapResult heap = runWorkload(false);
+    uint32_t fallbacks = JsonPool::getFallbacks();
+    HeapResult pool = runWorkload(true);
+
+    char message[160];
+    snprintf(message, sizeof(message), "heap: worst fragmentation %u%%, smallest largest block %u B; pool: worst fragmentation %u%%, smallest largest block %u B",
+             (unsigned)heap.worstFragmentation, (unsigned)heap.smallestLargestBlock, (unsigned)pool.worstFragmentation, (unsigned)pool.smallestLargestBlock);
+    TEST_MESSAGE(message);
+    TEST_ASSERT_EQUAL_UINT32(0, heap.failures);
+    TEST_ASSERT_EQUAL_UINT32(0, pool.failures);
+    // The documents of all tasks fit the pool
+    TEST_ASSERT_EQUAL_UINT32(fallbacks, JsonPool::getFallbacks());
+    TEST_ASSERT_LESS_THAN(heap.worstFragmentation, pool.worstFragmentation);
+
+    // The status reports the simulated heap of the last run
+    char status[512];
+    TEST_ASSERT_GREATER_THAN(0, JsonPool::getStatusJson(status, sizeof(status)));
+    snprintf(message, sizeof(message), "\"largest_block\":%u,\"fragmentation\":%u}", (unsigned)ESP.maxAllocHeap, (unsigned)(100 - ESP.maxAllocHeap * 100 / ESP.freeHeap));
+    TEST_ASSERT_NOT_NULL(strstr(status, message));
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_soak_threads);
+    RUN_TEST(test_full_pool_falls_back);
+    RUN_TEST(test_reallocate_keeps_content);
+    RUN_TEST(test_fragmentation);
+    return UNITY_END();
+}
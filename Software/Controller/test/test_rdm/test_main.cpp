@@ -0,0 +1,416 @@
+#include <unity.h>
+#include <vector>
+#include "../../lib/RDM/RDM.cpp"
+#include "../../lib/DMXOutput/DMXFrame.cpp"
+#include "../../lib/DMXOutput/DMXOutput.cpp"
+#include "../../lib/LMANTasks/LMANTasks.cpp"
+#include "../../lib/RDMManager/RDMManager.cpp"
+
+LMANConfig *LMANConfig::instance;
+
+#define CONTROLLER_UID 0x7FF012345678ULL
+/// @brief Steps a full discovery of the test lines takes at most
+#define MAX_STEPS 2000
+
+static LMANConfig config;
+
+/// @brief A responder on the fake line
+struct FakeDevice
+{
+    RDMUid uid;
+    uint16_t startAddress;
+    uint16_t footprint;
+    bool muted;
+};
+
+static RDMUid uidAt(const uint8_t *data)
+{
+    RDMUid uid = 0;
+    for (int i = 0; i < 6; i++)
+    {
+        uid = (uid << 8) | data[i];
+    }
+    return uid;
+}
+
+/// @brief The responders on a DMX line, answering like E1.20 responders do. Discovery responses of several
+/// responders overlay each other.
+class FakeLine : public RDMTransport
+{
+public:
+    std::vector<FakeDevice> devices;
+    /// @brief The DISC_UNIQUE_BRANCH ranges in the order they were searched
+    std::vector<std::pair<RDMUid, RDMUid>> branches;
+
+    size_t transact(const uint8_t *request, size_t length, uint8_t *response, size_t size) override
+    {
+        RDMPacket packet;
+        TEST_ASSERT_TRUE(rdmParsePacket(request, length, packet));
+        TEST_ASSERT_TRUE(packet.source == CONTROLLER_UID);
+        TEST_ASSERT_TRUE(size >= RDM_MAX_PACKET_SIZE);
+        if (packet.parameter == RDM_PID_DISC_UNIQUE_BRANCH)
+        {
+            TEST_ASSERT_EQUAL_UINT8(12, packet.dataLength);
+            RDMUid lower = uidAt(packet.data);
+            RDMUid upper = uidAt(packet.data + 6);
+            this->branches.push_back({lower, upper});
+            size_t received = 0;
+            memset(response, 0, RDM_DISCOVERY_RESPONSE_SIZE);
+            for (FakeDevice &device : this->devices)
+            {
+                if (device.muted || device.uid < lower || device.uid > upper)
+                {
+                    continue;
+                }
+                uint8_t encoded[RDM_DISCOVERY_RESPONSE_SIZE];
+                received = rdmEncodeDiscoveryResponse(encoded, device.uid);
+                for (size_t i = 0; i < received; i++)
+                {
+                    response[i] |= encoded[i];
+                }
+            }
+            return received;
+        }
+        if (packet.destination == RDM_UID_BROADCAST)
+        {
+            if (packet.parameter == RDM_PID_DISC_UN_MUTE)
+            {
+                for (FakeDevice &device : this->devices)
+                {
+                    device.muted = false;
+                }
+            }
+            return 0;
+        }
+
+        FakeDevice *device = this->find(packet.destination);
+        if (device == nullptr)
+        {
+            return 0;
+        }
+        uint8_t data[19] = {0};
+        uint8_t dataLength = 0;
+        if (packet.parameter == RDM_PID_DISC_MUTE)
+        {
+            device->muted = true;
+            // Control field
+            dataLength = 2;
+        }
+        else if (packet.parameter == RDM_PID_DEVICE_INFO && packet.commandClass == RDM_GET_COMMAND)
+        {
+            data[0] = 0x01;
+            data[3] = 0x42; // Model
+            data[10] = device->footprint >> 8;
+            data[11] = device->footprint;
+            data[14] = device->startAddress >> 8;
+            data[15] = device->startAddress;
+            dataLength = 19;
+        }
+        else if (packet.parameter == RDM_PID_DMX_START_ADDRESS && packet.commandClass == RDM_GET_COMMAND)
+        {
+            data[0] = device->startAddress >> 8;
+            data[1] = device->startAddress;
+            dataLength = 2;
+        }
+        else if (packet.parameter == RDM_PID_DMX_START_ADDRESS && packet.commandClass == RDM_SET_COMMAND)
+        {
+            TEST_ASSERT_EQUAL_UINT8(2, packet.dataLength);
+            device->startAddress = (packet.data[0] << 8) | packet.data[1];
+        }
+        else
+        {
+            return 0;
+        }
+        return rdmBuildPacket(response, packet.source, device->uid, packet.transaction, RDM_RESPONSE_ACK,
+                              packet.commandClass + 1, packet.parameter, data, dataLength);
+    }
+
+    FakeDevice *find(RDMUid uid)
+    {
+        for (FakeDevice &device : this->devices)
+        {
+            if (device.uid == uid)
+            {
+                return &device;
+            }
+        }
+        return nullptr;
+    }
+};
+
+/// @brief A DMX output with the fake line connected, for RDMManager
+class FakeOutput : public DMXOutput
+{
+public:
+    FakeLine line;
+
+    size_t transact(const uint8_t *request, size_t length, uint8_t *response, size_t size) override
+    {
+        return this->line.transact(request, length, response, size);
+    }
+};
+
+static void runController(RDMController &controller, FakeLine &line)
+{
+    for (int i = 0; i < MAX_STEPS && controller.isBusy(); i++)
+    {
+        controller.step(line);
+    }
+    TEST_ASSERT_FALSE(controller.isBusy());
+}
+
+static void runManager(RDMManager &manager)
+{
+    for (int i = 0; i < MAX_STEPS && manager.isBusy(); i++)
+    {
+        manager.afterFrame();
+    }
+    TEST_ASSERT_FALSE(manager.isBusy());
+}
+
+static RDMDevice *findDevice(RDMController &controller, RDMUid uid)
+{
+    for (uint8_t i = 0; i < controller.deviceCount; i++)
+    {
+        if (controller.devices[i].uid == uid)
+        {
+            return &controller.devices[i];
+        }
+    }
+    return nullptr;
+}
+
+static ChannelConfig *findChannel(const char *name)
+{
+    for (ChannelConfig &channel : config.channelConfigs)
+    {
+        if (channel.name == name)
+        {
+            return &channel;
+        }
+    }
+    return nullptr;
+}
+
+void setUp()
+{
+    config = LMANConfig();
+    config.dmx_min_frame_rate = 44;
+    LMANConfig::instance = &config;
+}
+
+void tearDown()
+{
+}
+
+void test_packet_checksum()
+{
+    uint8_t data[2] = {0x01, 0x2C};
+    uint8_t packet[RDM_MAX_PACKET_SIZE];
+    size_t length = rdmBuildPacket(packet, 0x123456789ABCULL, CONTROLLER_UID, 7, 1, RDM_SET_COMMAND, RDM_PID_DMX_START_ADDRESS, data, 2);
+    TEST_ASSERT_EQUAL_UINT32(RDM_HEADER_SIZE + 2 + 2, length);
+    TEST_ASSERT_EQUAL_UINT8(RDM_HEADER_SIZE + 2, packet[2]);
+    // The checksum is the 16 bit sum of all bytes from the start code to the parameter data
+    uint16_t sum = 0;
+    for (size_t i = 0; i < length - 2; i++)
+    {
+        sum += packet[i];
+    }
+    TEST_ASSERT_EQUAL_UINT16(sum, (packet[length - 2] << 8) | packet[length - 1]);
+
+    RDMPacket parsed;
+    TEST_ASSERT_TRUE(rdmParsePacket(packet, length, parsed));
+    TEST_ASSERT_TRUE(parsed.destination == 0x123456789ABCULL);
+    TEST_ASSERT_TRUE(parsed.source == CONTROLLER_UID);
+    TEST_ASSERT_EQUAL_UINT8(7, parsed.transaction);
+    TEST_ASSERT_EQUAL_UINT8(RDM_SET_COMMAND, parsed.commandClass);
+    TEST_ASSERT_EQUAL_UINT16(RDM_PID_DMX_START_ADDRESS, parsed.parameter);
+    TEST_ASSERT_EQUAL_UINT8(2, parsed.dataLength);
+    TEST_ASSERT_EQUAL_UINT8(0x2C, parsed.data[1]);
+
+    // A changed byte, a changed checksum and a cut off packet are all rejected
+    packet[RDM_HEADER_SIZE + 1] ^= 0x10;
+    TEST_ASSERT_FALSE(rdmParsePacket(packet, length, parsed));
+    packet[RDM_HEADER_SIZE + 1] ^= 0x10;
+    packet[length - 1]++;
+    TEST_ASSERT_FALSE(rdmParsePacket(packet, length, parsed));
+    packet[length - 1]--;
+    TEST_ASSERT_FALSE(rdmParsePacket(packet, length - 1, parsed));
+    TEST_ASSERT_TRUE(rdmParsePacket(packet, length, parsed));
+}
+
+void test_discovery_response_encode_decode()
+{
+    const RDMUid uid = 0x7FF0A1B2C3D4ULL;
+    uint8_t response[RDM_DISCOVERY_RESPONSE_SIZE];
+    TEST_ASSERT_EQUAL_UINT32(RDM_DISCOVERY_RESPONSE_SIZE, rdmEncodeDiscoveryResponse(response, uid));
+    for (int i = 0; i < 7; i++)
+    {
+        TEST_ASSERT_EQUAL_HEX8(0xFE, response[i]);
+    }
+    TEST_ASSERT_EQUAL_HEX8(0xAA, response[7]);
+    // Every byte goes out twice, once with the odd and once with the even bits forced high
+    TEST_ASSERT_EQUAL_HEX8(0x7F | 0xAA, response[8]);
+    TEST_ASSERT_EQUAL_HEX8(0x7F | 0x55, response[9]);
+
+    RDMUid decoded = 0;
+    TEST_ASSERT_TRUE(rdmDecodeDiscoveryResponse(response, sizeof(response), decoded));
+    TEST_ASSERT_TRUE(decoded == uid);
+    // Responders may send fewer preamble bytes
+    decoded = 0;
+    TEST_ASSERT_TRUE(rdmDecodeDiscoveryResponse(response + 5, sizeof(response) - 5, decoded));
+    TEST_ASSERT_TRUE(decoded == uid);
+
+    response[12] ^= 0x04;
+    TEST_ASSERT_FALSE(rdmDecodeDiscoveryResponse(response, sizeof(response), decoded));
+    TEST_ASSERT_FALSE(rdmDecodeDiscoveryResponse(response, 12, decoded));
+}
+
+void test_colliding_responses_not_decoded()
+{
+    uint8_t first[RDM_DISCOVERY_RESPONSE_SIZE];
+    uint8_t second[RDM_DISCOVERY_RESPONSE_SIZE];
+    rdmEncodeDiscoveryResponse(first, 0x7FF000000010ULL);
+    rdmEncodeDiscoveryResponse(second, 0x7FF000000011ULL);
+    for (int i = 0; i < RDM_DISCOVERY_RESPONSE_SIZE; i++)
+    {
+        first[i] |= second[i];
+    }
+    RDMUid decoded;
+    TEST_ASSERT_FALSE(rdmDecodeDiscoveryResponse(first, sizeof(first), decoded));
+}
+
+void test_discovery_finds_all_devices()
+{
+    FakeLine line;
+    line.devices = {
+        {0x000000000001ULL, 1, 1, false},
+        {0x7FF000000020ULL, 17, 2, false},
+        {0x7FF0FFFF0000ULL, 100, 1, false},
+        {0x4C5400001234ULL, 200, 3, false},
+        {RDM_UID_MAX, 512, 1, true},
+    };
+    RDMController controller;
+    controller.init(CONTROLLER_UID);
+    controller.startDiscovery();
+    runController(controller, line);
+
+    // Discovery un-mutes all devices first, so the one muted before is found too
+    TEST_ASSERT_EQUAL_UINT8(line.devices.size(), controller.deviceCount);
+    for (FakeDevice &fake : line.devices)
+    {
+        RDMDevice *device = findDevice(controller, fake.uid);
+        TEST_ASSERT_NOT_NULL(device);
+        TEST_ASSERT_TRUE(fake.muted);
+        // Read from DEVICE_INFO
+        TEST_ASSERT_EQUAL_UINT16(0x42, device->model);
+        TEST_ASSERT_EQUAL_UINT16(fake.footprint, device->footprint);
+        TEST_ASSERT_EQUAL_UINT16(fake.startAddress, device->startAddress);
+    }
+    TEST_ASSERT_TRUE(line.branches.front().first == 0 && line.branches.front().second == RDM_UID_MAX);
+    // A binary search, not a walk through the UIDs
+    TEST_ASSERT_LESS_THAN(5 * 2 * 48, line.branches.size());
+
+    // Nothing is found twice
+    size_t branches = line.branches.size();
+    controller.startDiscovery();
+    runController(controller, line);
+    TEST_ASSERT_EQUAL_UINT8(line.devices.size(), controller.deviceCount);
+    TEST_ASSERT_GREATER_THAN(branches, line.branches.size());
+}
+
+void test_collision_splits_branch()
+{
+    // The UIDs only differ in the last bit, the search has to go down to single UIDs to tell them apart
+    FakeLine line;
+    line.devices = {
+        {0x7FF000000010ULL, 1, 1, false},
+        {0x7FF000000011ULL, 2, 1, false},
+    };
+    RDMController controller;
+    controller.init(CONTROLLER_UID);
+    controller.startDiscovery();
+    runController(controller, line);
+
+    TEST_ASSERT_EQUAL_UINT8(2, controller.deviceCount);
+    TEST_ASSERT_NOT_NULL(findDevice(controller, 0x7FF000000010ULL));
+    TEST_ASSERT_NOT_NULL(findDevice(controller, 0x7FF000000011ULL));
+    // The whole range collides and is searched again as its lower and upper half, the lower first
+    const RDMUid middle = RDM_UID_MAX / 2;
+    TEST_ASSERT_TRUE(line.branches[1].first == 0 && line.branches[1].second == middle);
+    bool upperSearched = false;
+    bool singleSearched = false;
+    for (auto &branch : line.branches)
+    {
+        upperSearched |= branch.first == middle + 1 && branch.second == RDM_UID_MAX;
+        singleSearched |= branch.first == branch.second;
+    }
+    TEST_ASSERT_TRUE(upperSearched);
+    TEST_ASSERT_TRUE(singleSearched);
+}
+
+void test_channel_table()
+{
+    config.channelConfigs[0].name = "hall";
+    config.channelConfigs[0].channel = 5;
+    config.channelConfigs[0].enabled = true;
+
+    FakeOutput *output = new FakeOutput[1];
+    output->line.devices = {
+        {0x7FF000000001ULL, 10, 1, false},
+        // Above the 8 bit channels
+        {0x7FF000000002ULL, 300, 1, false},
+        // On the slot of the configured channel
+        {0x7FF000000003ULL, 5, 1, false},
+        {0x7FF000000004ULL, 20, 1, false},
+    };
+    // The MAC bytes in the order they are written are 00:00:12:34:56:78, the UID ends in the last four
+    ESP.efuseMac = 0x785634120000ULL;
+    RDMManager manager;
+    manager.init(output, 1);
+    runManager(manager);
+    TEST_ASSERT_TRUE(manager.hasChannelChanges());
+    TEST_ASSERT_TRUE(manager.updateChannelTable());
+    TEST_ASSERT_FALSE(manager.hasChannelChanges());
+
+    TEST_ASSERT_EQUAL_UINT8(5, config.channelConfigs[0].channel);
+    ChannelConfig *first = findChannel("rdm_7ff0_00000001");
+    TEST_ASSERT_NOT_NULL(first);
+    TEST_ASSERT_TRUE(first->enabled);
+    TEST_ASSERT_EQUAL_UINT8(10, first->channel);
+    TEST_ASSERT_EQUAL_UINT8(1, first->universe);
+    ChannelConfig *fourth = findChannel("rdm_7ff0_00000004");
+    TEST_ASSERT_NOT_NULL(fourth);
+    TEST_ASSERT_EQUAL_UINT8(20, fourth->channel);
+    TEST_ASSERT_NULL(findChannel("rdm_7ff0_00000002"));
+    TEST_ASSERT_NULL(findChannel("rdm_7ff0_00000003"));
+    TEST_ASSERT_FALSE(manager.updateChannelTable());
+
+    // Moving a device moves its channel instead of adding another one
+    TEST_ASSERT_TRUE(manager.setStartAddress(0x7FF000000001ULL, 30));
+    runManager(manager);
+    TEST_ASSERT_EQUAL_UINT16(30, output->line.find(0x7FF000000001ULL)->startAddress);
+    TEST_ASSERT_TRUE(manager.hasChannelChanges());
+    TEST_ASSERT_TRUE(manager.updateChannelTable());
+    TEST_ASSERT_TRUE(findChannel("rdm_7ff0_00000001") == first);
+    TEST_ASSERT_EQUAL_UINT8(30, first->channel);
+    uint8_t enabled = 0;
+    for (ChannelConfig &channel : config.channelConfigs)
+    {
+        enabled += channel.enabled;
+    }
+    TEST_ASSERT_EQUAL_UINT8(3, enabled);
+    delete[] output;
+}
+
+int main(int argc, char **argv)
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_packet_checksum);
+    RUN_TEST(test_discovery_response_encode_decode);
+    RUN_TEST(test_colliding_responses_not_decoded);
+    RUN_TEST(test_discovery_finds_all_devices);
+    RUN_TEST(test_collision_splits_branch);
+    RUN_TEST(test_channel_table);
+    return UNITY_END();
+}
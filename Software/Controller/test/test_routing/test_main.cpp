@@ -0,0 +1,188 @@
+#include <unity.h>
+#include <atomic>
+#include <thread>
+#include "../../lib/DMXOutput/DMXFrame.cpp"
+#include "../../lib/DMXOutput/DMXOutput.cpp"
+#include "../../lib/DMXMerger/DMXMerger.cpp"
+#include "../../lib/LMANTasks/LMANTasks.cpp"
+
+LMANConfig *LMANConfig::instance;
+
+static const uart_port_t PORTS[DMX_OUTPUT_COUNT] = {UART_NUM_2, UART_NUM_1};
+static LMANConfig config;
+static DMXOutput *outputs;
+static DMXMerger *mergers;
+static TaskHandle_t sendTasks[DMX_OUTPUT_COUNT];
+
+void setUp()
+{
+    LMANConfig::instance = &config;
+    config.dmx_merge_mode = DMX_MERGE_HTP;
+    config.dmx_min_frame_rate = 2;
+    memset(hostUarts, 0, sizeof(hostUarts));
+    DMXMerger::instance = nullptr;
+    outputs = new DMXOutput[DMX_OUTPUT_COUNT];
+    mergers = new DMXMerger[DMX_OUTPUT_COUNT];
+    for (uint8_t i = 0; i < DMX_OUTPUT_COUNT; i++)
+    {
+        xTaskCreatePinnedToCore(nullptr, "", 0, nullptr, 0, &sendTasks[i], 0);
+        TEST_ASSERT_TRUE(outputs[i].init(i + 1, PORTS[i], 17 - i));
+        mergers[i].init(&outputs[i], &sendTasks[i]);
+    }
+    resetTaskTimings();
+}
+
+void tearDown()
+{
+    delete[] outputs;
+    delete[] mergers;
+}
+
+void test_outputs_configured()
+{
+    TEST_ASSERT_TRUE(DMXMerger::instance == &mergers[0]);
+    for (uint8_t i = 0; i < DMX_OUTPUT_COUNT; i++)
+    {
+        HostUart &uart = hostUarts[PORTS[i]];
+        TEST_ASSERT_TRUE(DMXOutput::instances[i] == &outputs[i]);
+        TEST_ASSERT_TRUE(uart.installed);
+        TEST_ASSERT_EQUAL_INT(17 - i, uart.txPin);
+        TEST_ASSERT_EQUAL_INT(DMX_BAUD_RATE, uart.config.baud_rate);
+        TEST_ASSERT_EQUAL_INT(UART_STOP_BITS_2, uart.config.stop_bits);
+        // The break ends each frame, the idle time after it is the mark after break
+        TEST_ASSERT_EQUAL_UINT16(DMX_MAB_BITS, uart.idleBits);
+        TEST_ASSERT_EQUAL_INT(DMX_BREAK_BITS, uart.breakBits);
+        // init() sends a first frame
+        TEST_ASSERT_EQUAL_UINT32(1, uart.frames);
+    }
+    TEST_ASSERT_FALSE(hostUarts[UART_NUM_0].installed);
+}
+
+void test_local_slots_routed_per_universe()
+{
+    mergers[0].setLocalSlotCount(5);
+    mergers[1].setLocalSlotCount(300);
+    mergers[0].writeLocal(5, 100);
+    mergers[1].writeLocal(5, 200);
+    mergers[1].writeLocal(300, 7);
+    TEST_ASSERT_EQUAL_UINT8(100, outputs[0].read(5));
+    TEST_ASSERT_EQUAL_UINT8(200, outputs[1].read(5));
+    TEST_ASSERT_EQUAL_UINT8(7, outputs[1].read(300));
+    TEST_ASSERT_EQUAL_UINT8(0, outputs[0].read(300));
+
+    outputs[0].update();
+    outputs[1].update();
+    HostUart &universe1 = hostUarts[PORTS[0]];
+    HostUart &universe2 = hostUarts[PORTS[1]];
+    // Each frame is sized to its own universe, short ones padded
+    TEST_ASSERT_EQUAL_UINT32(DMX_MIN_SLOTS + 1, universe1.length);
+    TEST_ASSERT_EQUAL_UINT32(301, universe2.length);
+    TEST_ASSERT_EQUAL_UINT8(DMX_START_CODE, universe1.data[0]);
+    TEST_ASSERT_EQUAL_UINT8(100, universe1.data[5]);
+    TEST_ASSERT_EQUAL_UINT8(200, universe2.data[5]);
+    TEST_ASSERT_EQUAL_UINT8(7, universe2.data[300]);
+}
+
+void test_fixture_slots()
+{
+    const uint8_t rgbw[4] = {1, 2, 3, 4};
+    mergers[1].setLocalSlotCount(104);
+    mergers[1].writeLocalSlots(101, rgbw, 4);
+    mergers[0].writeLocal16(1, 0x1234);
+    outputs[1].update();
+    TEST_ASSERT_EQUAL_UINT8_ARRAY(rgbw, &hostUarts[PORTS[1]].data[101], 4);
+    TEST_ASSERT_EQUAL_UINT8(0, outputs[0].read(101));
+    TEST_ASSERT_EQUAL_UINT8(0x12, outputs[0].read(1));
+    TEST_ASSERT_EQUAL_UINT8(0x34, outputs[0].read(2));
+    TEST_ASSERT_EQUAL_UINT8(0, outputs[1].read(1));
+}
+
+void test_network_levels_merged()
+{
+    mergers[0].setLocalSlotCount(10);
+    mergers[0].writeLocal(1, 50);
+    mergers[0].writeLocal(2, 50);
+    uint8_t network[40] = {0};
+    network[0] = 80;
+    network[1] = 20;
+    network[39] = 9;
+    mergers[0].writeNetwork(network, sizeof(network), 1000);
+    // Grows to the received levels, only on its own universe
+    TEST_ASSERT_EQUAL_UINT16(40, outputs[0].getSlotCount());
+    TEST_ASSERT_EQUAL_UINT8(9, outputs[0].read(40));
+    TEST_ASSERT_EQUAL_UINT8(0, outputs[1].read(40));
+    // Highest takes precedence
+    TEST_ASSERT_EQUAL_UINT8(80, outputs[0].read(1));
+    TEST_ASSERT_EQUAL_UINT8(50, outputs[0].read(2));
+
+    // Back to the local levels once the source is gone
+    hostAdvance(1001);
+    mergers[0].checkNetworkTimeout();
+    TEST_ASSERT_FALSE(mergers[0].isNetworkActive());
+    TEST_ASSERT_EQUAL_UINT8(50, outputs[0].read(1));
+    TEST_ASSERT_EQUAL_UINT8(0, outputs[0].read(40));
+}
+
+void test_timing_per_output()
+{
+    hostAdvance(1);
+    markDmxFrameReady();
+    hostAdvance(2);
+    takeDmxFrameLatency(0);
+    hostAdvance(5);
+    takeDmxFrameLatency(1);
+    // Taken once per mark
+    takeDmxFrameLatency(1);
+
+    char buffer[2048];
+    TEST_ASSERT_GREATER_THAN(0, getTasksJson(buffer, sizeof(buffer)));
+    // The mark is odd so that 0 means none, it can be 1 us late
+    unsigned count;
+    unsigned latency;
+    const char *timing = strstr(buffer, "\"dmx_latency_1\":");
+    TEST_ASSERT_NOT_NULL(timing);
+    TEST_ASSERT_EQUAL_INT(2, sscanf(timing, "\"dmx_latency_1\":{\"count\":%u,\"min\":%u", &count, &latency));
+    TEST_ASSERT_EQUAL_UINT32(1, count);
+    TEST_ASSERT_UINT32_WITHIN(1, 2000, latency);
+    timing = strstr(buffer, "\"dmx_latency_2\":");
+    TEST_ASSERT_NOT_NULL(timing);
+    TEST_ASSERT_EQUAL_INT(2, sscanf(timing, "\"dmx_latency_2\":{\"count\":%u,\"min\":%u", &count, &latency));
+    TEST_ASSERT_EQUAL_UINT32(1, count);
+    TEST_ASSERT_UINT32_WITHIN(1, 7000, latency);
+    TEST_ASSERT_NOT_NULL(strstr(buffer, "\"dmx_frame_2\":{\"count\":0,"));
+}
+
+/// @brief 16 bit levels written from another core while frames are sent, the coarse and fine level go out together
+void test_16_bit_level_sent_in_one_frame()
+{
+    std::atomic<bool> done{false};
+    std::thread writer([&done]
+                       {
+        for (uint32_t i = 0; !done.load(); i++)
+        {
+            // Both bytes change between the two levels
+            mergers[0].writeLocal16(1, i & 1 ? 0x01FF : 0x0200);
+        } });
+    uint32_t torn = 0;
+    for (uint32_t frame = 0; frame < 100000; frame++)
+    {
+        outputs[0].update();
+        uint16_t level = (hostUarts[PORTS[0]].data[1] << 8) | hostUarts[PORTS[0]].data[2];
+        torn += level != 0 && level != 0x01FF && level != 0x0200;
+    }
+    done.store(true);
+    writer.join();
+    TEST_ASSERT_EQUAL_UINT32(0, torn);
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_outputs_configured);
+    RUN_TEST(test_local_slots_routed_per_universe);
+    RUN_TEST(test_fixture_slots);
+    RUN_TEST(test_network_levels_merged);
+    RUN_TEST(test_timing_per_output);
+    RUN_TEST(test_16_bit_level_sent_in_one_frame);
+    return UNITY_END();
+}
@@ -0,0 +1,334 @@
+#include <unity.h>
+#include <random>
+#include "../../lib/Color/Color.cpp"
+#include "../../lib/DMXOutput/DMXFrame.cpp"
+#include "../../lib/DMXOutput/DMXOutput.cpp"
+#include "../../lib/DMXMerger/DMXMerger.cpp"
+#include "../../lib/Effects/Effects.cpp"
+#include "../../lib/JsonPool/JsonPool.cpp"
+#include "../../lib/LMANConfig/LMANConfig.cpp"
+#include "../../lib/LMANTasks/LMANTasks.cpp"
+#include "../../lib/LightManager/LightManager.cpp"
+#include "../../lib/Scheduler/Scheduler.cpp"
+
+/// @brief Stockholm, with the EU daylight saving rules
+#define TEST_TIME_ZONE "CET-1CEST,M3.5.0,M10.5.0/3"
+#define TEST_LATITUDE 5933
+#define TEST_LONGITUDE 1807
+/// @brief Bits of ScheduleConfig::days for Monday to Friday
+#define WEEKDAYS 0x3E
+
+/// @brief Reaches the heap, the sun table and the fire time search of a scheduler
+struct SchedulerTest
+{
+    static void clearHeap(Scheduler &scheduler)
+    {
+        scheduler._heapSize = 0;
+    }
+    static uint8_t heapSize(Scheduler &scheduler)
+    {
+        return scheduler._heapSize;
+    }
+    static void push(Scheduler &scheduler, const ScheduleEvent &event)
+    {
+        scheduler._push(event);
+    }
+    static ScheduleEvent pop(Scheduler &scheduler)
+    {
+        return scheduler._pop();
+    }
+    static void buildSunTable(Scheduler &scheduler)
+    {
+        scheduler._buildSunTable();
+    }
+    static int16_t sunrise(Scheduler &scheduler, uint16_t day)
+    {
+        return scheduler._sunrise[day];
+    }
+    static int16_t sunset(Scheduler &scheduler, uint16_t day)
+    {
+        return scheduler._sunset[day];
+    }
+    static bool fireTimeOnDay(Scheduler &scheduler, const ScheduleConfig &schedule, const struct tm &day, time_t &fireAt)
+    {
+        return scheduler._fireTimeOnDay(schedule, day, fireAt);
+    }
+    static bool nextFireTime(Scheduler &scheduler, uint8_t schedule, time_t after, time_t &fireAt)
+    {
+        return scheduler._nextFireTime(schedule, after, fireAt);
+    }
+    static void rebuild(Scheduler &scheduler, time_t now, bool catchUp)
+    {
+        scheduler._rebuild(now, catchUp);
+    }
+    static void fire(Scheduler &scheduler, uint8_t schedule, time_t fireAt, time_t now)
+    {
+        scheduler._fire(schedule, fireAt, now);
+    }
+};
+
+static const uart_port_t PORTS[DMX_OUTPUT_COUNT] = {UART_NUM_2, UART_NUM_1};
+static LMANConfig config;
+static DMXOutput *outputs = nullptr;
+static DMXMerger *mergers = nullptr;
+static TaskHandle_t sendTasks[DMX_OUTPUT_COUNT];
+static LightManager *lightManager = nullptr;
+static DMXChannel *channels[sizeof(LMANConfig::channelConfigs) / sizeof(ChannelConfig)];
+
+/// @brief A local time in TEST_TIME_ZONE
+static time_t localTime(int year, int month, int day, int hour, int minute)
+{
+    struct tm local = {};
+    local.tm_year = year - 1900;
+    local.tm_mon = month - 1;
+    local.tm_mday = day;
+    local.tm_hour = hour;
+    local.tm_min = minute;
+    local.tm_isdst = -1;
+    return mktime(&local);
+}
+
+static void assertLocalTime(int year, int month, int day, int hour, int minute, time_t time)
+{
+    struct tm local;
+    localtime_r(&time, &local);
+    char expected[20];
+    char actual[20];
+    snprintf(expected, sizeof(expected), "%04d-%02d-%02d %02d:%02d", year, month, day, hour, minute);
+    strftime(actual, sizeof(actual), "%Y-%m-%d %H:%M", &local);
+    TEST_ASSERT_EQUAL_STRING(expected, actual);
+}
+
+/// @brief The sunrise or sunset of a day in local minutes after midnight
+static int sunTime(Scheduler &scheduler, uint8_t trigger, int year, int month, int day)
+{
+    ScheduleConfig schedule;
+    schedule.trigger = trigger;
+    time_t noon = localTime(year, month, day, 12, 0);
+    struct tm local;
+    localtime_r(&noon, &local);
+    time_t fireAt;
+    TEST_ASSERT_TRUE(SchedulerTest::fireTimeOnDay(scheduler, schedule, local, fireAt));
+    localtime_r(&fireAt, &local);
+    return local.tm_hour * 60 + local.tm_min;
+}
+
+void setUp()
+{
+    config = LMANConfig();
+    LMANConfig::instance = &config;
+    config.time_zone = TEST_TIME_ZONE;
+    config.latitude = TEST_LATITUDE;
+    config.longitude = TEST_LONGITUDE;
+    setenv("TZ", TEST_TIME_ZONE, 1);
+    tzset();
+
+    // Wake-up ramp on weekdays
+    ScheduleConfig &wake = config.scheduleConfigs[0];
+    wake.name = "wake";
+    wake.enabled = true;
+    wake.trigger = SCHEDULE_TRIGGER_TIME;
+    wake.time = 6 * 60 + 30;
+    wake.days = WEEKDAYS;
+    wake.channels = 0x03;
+    wake.level = 200;
+    wake.fadeTime = 1800;
+    // Lights on before dark
+    ScheduleConfig &evening = config.scheduleConfigs[1];
+    evening.name = "evening";
+    evening.enabled = true;
+    evening.trigger = SCHEDULE_TRIGGER_SUNSET;
+    evening.offset = -15;
+    evening.channels = 0x01;
+    evening.level = 80;
+    evening.fadeTime = 600;
+
+    // The channels the schedules fade, set up like main.cpp does
+    DMXMerger::instance = nullptr;
+    outputs = new DMXOutput[DMX_OUTPUT_COUNT];
+    mergers = new DMXMerger[DMX_OUTPUT_COUNT];
+    for (uint8_t i = 0; i < DMX_OUTPUT_COUNT; i++)
+    {
+        xTaskCreatePinnedToCore(nullptr, "", 0, nullptr, 0, &sendTasks[i], 0);
+        TEST_ASSERT_TRUE(outputs[i].init(i + 1, PORTS[i], 17 - i));
+        mergers[i].init(&outputs[i], &sendTasks[i]);
+    }
+    lightManager = new LightManager();
+    lightManager->init(mergers);
+    for (uint8_t i = 0; i < sizeof(channels) / sizeof(DMXChannel *); i++)
+    {
+        config.channelConfigs[i].channel = i + 1;
+        config.channelConfigs[i].enabled = true;
+        channels[i] = lightManager->initDMXChannel(&config.channelConfigs[i]);
+    }
+}
+
+void tearDown()
+{
+    delete lightManager;
+    delete[] mergers;
+    delete[] outputs;
+}
+
+void test_heap_pops_in_time_order()
+{
+    static Scheduler scheduler;
+    std::mt19937 random(1);
+    for (uint8_t round = 0; round < 100; round++)
+    {
+        SchedulerTest::clearHeap(scheduler);
+        // One more than fits, the last push is dropped
+        for (uint8_t i = 0; i <= SCHEDULER_COUNT; i++)
+        {
+            SchedulerTest::push(scheduler, {(time_t)(random() % 1000), i});
+        }
+        TEST_ASSERT_EQUAL_UINT8(SCHEDULER_COUNT, SchedulerTest::heapSize(scheduler));
+        time_t previous = 0;
+        uint8_t seen = 0;
+        while (SchedulerTest::heapSize(scheduler) > 0)
+        {
+            ScheduleEvent event = SchedulerTest::pop(scheduler);
+            TEST_ASSERT_GREATER_OR_EQUAL(previous, event.time);
+            TEST_ASSERT_LESS_THAN(SCHEDULER_COUNT, event.schedule);
+            seen |= 1 << event.schedule;
+            previous = event.time;
+        }
+        TEST_ASSERT_EQUAL_UINT8(0xFF, seen);
+    }
+}
+
+void test_sun_table_stockholm()
+{
+    static Scheduler scheduler;
+    SchedulerTest::buildSunTable(scheduler);
+    // Published times for Stockholm, within the 1-2 minutes of the approximation
+    TEST_ASSERT_INT_WITHIN(2, 7 * 60 + 33, sunTime(scheduler, SCHEDULE_TRIGGER_SUNRISE, 2026, 10, 19));
+    TEST_ASSERT_INT_WITHIN(2, 17 * 60 + 32, sunTime(scheduler, SCHEDULE_TRIGGER_SUNSET, 2026, 10, 19));
+    TEST_ASSERT_INT_WITHIN(2, 3 * 60 + 31, sunTime(scheduler, SCHEDULE_TRIGGER_SUNRISE, 2026, 6, 21));
+    TEST_ASSERT_INT_WITHIN(2, 22 * 60 + 8, sunTime(scheduler, SCHEDULE_TRIGGER_SUNSET, 2026, 6, 21));
+    for (uint16_t day = 0; day < 366; day++)
+    {
+        TEST_ASSERT_NOT_EQUAL(SUN_NONE, SchedulerTest::sunrise(scheduler, day));
+        TEST_ASSERT_LESS_THAN(SchedulerTest::sunset(scheduler, day), SchedulerTest::sunrise(scheduler, day));
+    }
+}
+
+void test_sun_table_polar()
+{
+    static Scheduler scheduler;
+    config.latitude = 7800;
+    SchedulerTest::buildSunTable(scheduler);
+    uint16_t withoutSunrise = 0;
+    for (uint16_t day = 0; day < 366; day++)
+    {
+        withoutSunrise += SchedulerTest::sunrise(scheduler, day) == SUN_NONE;
+    }
+    // Polar night and midnight sun on Svalbard
+    TEST_ASSERT_INT_WITHIN(3, 239, withoutSunrise);
+
+    // In the polar night the next sunrise is months away, but within the search
+    config.scheduleConfigs[1].trigger = SCHEDULE_TRIGGER_SUNRISE;
+    config.scheduleConfigs[1].offset = 0;
+    time_t fireAt;
+    TEST_ASSERT_TRUE(SchedulerTest::nextFireTime(scheduler, 1, localTime(2026, 12, 1, 12, 0), fireAt));
+    struct tm local;
+    localtime_r(&fireAt, &local);
+    TEST_ASSERT_EQUAL_INT(2027 - 1900, local.tm_year);
+    TEST_ASSERT_EQUAL_INT(1, local.tm_mon);
+}
+
+void test_weekdays_are_skipped()
+{
+    static Scheduler scheduler;
+    SchedulerTest::buildSunTable(scheduler);
+    time_t fireAt;
+    // Thursday after the ramp: Friday, still summer time
+    TEST_ASSERT_TRUE(SchedulerTest::nextFireTime(scheduler, 0, localTime(2026, 10, 22, 6, 40), fireAt));
+    assertLocalTime(2026, 10, 23, 6, 30, fireAt);
+    time_t friday = fireAt;
+    // Friday after the ramp: Monday, the weekend and the end of summer time in between
+    TEST_ASSERT_TRUE(SchedulerTest::nextFireTime(scheduler, 0, friday, fireAt));
+    assertLocalTime(2026, 10, 26, 6, 30, fireAt);
+    TEST_ASSERT_EQUAL_INT(3 * 86400 + 3600, fireAt - friday);
+
+    // A schedule without days never fires
+    config.scheduleConfigs[0].days = 0;
+    TEST_ASSERT_FALSE(SchedulerTest::nextFireTime(scheduler, 0, friday, fireAt));
+}
+
+void test_local_time_across_dst()
+{
+    static Scheduler scheduler;
+    SchedulerTest::buildSunTable(scheduler);
+    config.scheduleConfigs[0].days = 0x7F;
+    // Every morning at 06:30 local, the day of a change is 23 or 25 hours long
+    time_t fireAt = localTime(2026, 3, 27, 7, 0);
+    time_t previous = 0;
+    for (uint8_t day = 0; day < 4; day++)
+    {
+        TEST_ASSERT_TRUE(SchedulerTest::nextFireTime(scheduler, 0, fireAt, fireAt));
+        assertLocalTime(2026, 3, 28 + day, 6, 30, fireAt);
+        if (previous)
+        {
+            TEST_ASSERT_EQUAL_INT(day == 1 ? 23 * 3600 : 24 * 3600, fireAt - previous);
+        }
+        previous = fireAt;
+    }
+    fireAt = localTime(2026, 10, 23, 7, 0);
+    TEST_ASSERT_TRUE(SchedulerTest::nextFireTime(scheduler, 0, fireAt, fireAt));
+    previous = fireAt;
+    TEST_ASSERT_TRUE(SchedulerTest::nextFireTime(scheduler, 0, fireAt, fireAt));
+    assertLocalTime(2026, 10, 25, 6, 30, fireAt);
+    TEST_ASSERT_EQUAL_INT(25 * 3600, fireAt - previous);
+
+    // Sunset moves an hour on the clock with the change, not with the sun
+    int before = sunTime(scheduler, SCHEDULE_TRIGGER_SUNSET, 2026, 10, 24);
+    int after = sunTime(scheduler, SCHEDULE_TRIGGER_SUNSET, 2026, 10, 26);
+    TEST_ASSERT_INT_WITHIN(10, 60, before - after);
+}
+
+void test_catch_up_after_boot()
+{
+    static Scheduler scheduler;
+    // The clock is set at 06:40 on a Monday, ten minutes into the wake-up ramp
+    time_t now = localTime(2026, 10, 19, 6, 40);
+    SchedulerTest::rebuild(scheduler, now, true);
+    TEST_ASSERT_EQUAL_UINT8(2, SchedulerTest::heapSize(scheduler));
+    ScheduleEvent event = SchedulerTest::pop(scheduler);
+    TEST_ASSERT_EQUAL_UINT8(0, event.schedule);
+    assertLocalTime(2026, 10, 19, 6, 30, event.time);
+    SchedulerTest::fire(scheduler, event.schedule, event.time, now);
+    // The ramp picks up with the 20 minutes that are left, on the two channels of the schedule
+    for (uint8_t i = 0; i < 2; i++)
+    {
+        TEST_ASSERT_TRUE(channels[i]->isSceneFading);
+        TEST_ASSERT_TRUE(channels[i]->state);
+        TEST_ASSERT_EQUAL_UINT32(1200000, channels[i]->sceneFadeTime);
+        TEST_ASSERT_EQUAL_UINT16(200 * LEVEL_SCALE, channels[i]->sceneFadeTo);
+    }
+    TEST_ASSERT_FALSE(channels[2]->isSceneFading);
+    // Then sunset less 15 minutes
+    event = SchedulerTest::pop(scheduler);
+    TEST_ASSERT_EQUAL_UINT8(1, event.schedule);
+    int evening = sunTime(scheduler, SCHEDULE_TRIGGER_SUNSET, 2026, 10, 19) - 15;
+    assertLocalTime(2026, 10, 19, evening / 60, evening % 60, event.time);
+
+    // Later syncs do not catch up, and a ramp that is over is not repeated at boot
+    SchedulerTest::rebuild(scheduler, now, false);
+    TEST_ASSERT_EQUAL_UINT8(1, SchedulerTest::pop(scheduler).schedule);
+    assertLocalTime(2026, 10, 20, 6, 30, SchedulerTest::pop(scheduler).time);
+    SchedulerTest::rebuild(scheduler, localTime(2026, 10, 19, 7, 10), true);
+    TEST_ASSERT_EQUAL_UINT8(1, SchedulerTest::pop(scheduler).schedule);
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_heap_pops_in_time_order);
+    RUN_TEST(test_sun_table_stockholm);
+    RUN_TEST(test_sun_table_polar);
+    RUN_TEST(test_weekdays_are_skipped);
+    RUN_TEST(test_local_time_across_dst);
+    RUN_TEST(test_catch_up_after_boot);
+    return UNITY_END();
+}
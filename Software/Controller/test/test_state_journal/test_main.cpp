@@ -0,0 +1,331 @@
+#include <unity.h>
+#include <algorithm>
+#include <random>
+#include <vector>
+#include "../../lib/Color/Color.cpp"
+#include "../../lib/DMXOutput/DMXFrame.cpp"
+#include "../../lib/DMXOutput/DMXOutput.cpp"
+#include "../../lib/DMXMerger/DMXMerger.cpp"
+#include "../../lib/Effects/Effects.cpp"
+#include "../../lib/JsonPool/JsonPool.cpp"
+#include "../../lib/LMANConfig/LMANConfig.cpp"
+#include "../../lib/LMANTasks/LMANTasks.cpp"
+#include "../../lib/LightManager/LightManager.cpp"
+#include "../../lib/StateJournal/StateJournal.cpp"
+
+/// @brief Time in ms between calls to StateJournal::loop(), the main loop runs about this often
+#define LOOP_INTERVAL 10
+#define DAY (24UL * 3600 * 1000)
+/// @brief Times the lights are touched in a simulated day
+#define DAY_INTERACTIONS 40
+
+static const uart_port_t PORTS[DMX_OUTPUT_COUNT] = {UART_NUM_2, UART_NUM_1};
+static LMANConfig config;
+static DMXOutput *outputs = nullptr;
+static DMXMerger *mergers = nullptr;
+static TaskHandle_t sendTasks[DMX_OUTPUT_COUNT];
+static LightManager *lightManager = nullptr;
+static DMXChannel *channels[STATE_JOURNAL_CHANNELS];
+
+/// @brief A level change as a button, a scene or Home Assistant makes it, one level step every stepTime ms
+struct SimFade
+{
+    unsigned long start;
+    uint8_t channel;
+    uint16_t from;
+    uint16_t to;
+    uint32_t duration;
+    uint32_t stepTime;
+};
+
+/// @brief A counter from StateJournal::getStatusJson
+static uint32_t readStatus(StateJournal &journal, const char *key)
+{
+    char status[256];
+    TEST_ASSERT_GREATER_THAN(0, journal.getStatusJson(status, sizeof(status)));
+    char pattern[32];
+    snprintf(pattern, sizeof(pattern), "\"%s\":", key);
+    const char *value = strstr(status, pattern);
+    TEST_ASSERT_NOT_NULL(value);
+    return strtoul(value + strlen(pattern), nullptr, 10);
+}
+
+static void powerOff()
+{
+    delete lightManager;
+    delete[] mergers;
+    delete[] outputs;
+    lightManager = nullptr;
+    mergers = nullptr;
+    outputs = nullptr;
+}
+
+/// @brief Power on and set up the outputs and the channels like main.cpp does, the channels come up off at their
+/// max level
+static void boot()
+{
+    powerOff();
+    DMXMerger::instance = nullptr;
+    outputs = new DMXOutput[DMX_OUTPUT_COUNT];
+    mergers = new DMXMerger[DMX_OUTPUT_COUNT];
+    for (uint8_t i = 0; i < DMX_OUTPUT_COUNT; i++)
+    {
+        xTaskCreatePinnedToCore(nullptr, "", 0, nullptr, 0, &sendTasks[i], 0);
+        TEST_ASSERT_TRUE(outputs[i].init(i + 1, PORTS[i], 17 - i));
+        mergers[i].init(&outputs[i], &sendTasks[i]);
+    }
+    lightManager = new LightManager();
+    lightManager->init(mergers);
+    for (uint8_t i = 0; i < STATE_JOURNAL_CHANNELS; i++)
+    {
+        channels[i] = lightManager->initDMXChannel(&config.channelConfigs[i]);
+    }
+}
+
+/// @brief Call loop() as the main loop does until the clock reaches a time
+static void runUntil(StateJournal &journal, unsigned long time)
+{
+    while (millis() < time)
+    {
+        hostAdvance(LOOP_INTERVAL);
+        journal.loop();
+    }
+}
+
+void setUp()
+{
+    hostMicros = 0;
+    hostFiles.clear();
+    hostFlashWrites = 0;
+    hostFlashBytes = 0;
+    config = LMANConfig();
+    LMANConfig::instance = &config;
+    config.dmx_merge_mode = DMX_MERGE_HTP;
+    config.dmx_min_frame_rate = 2;
+    for (uint8_t i = 0; i < STATE_JOURNAL_CHANNELS; i++)
+    {
+        config.channelConfigs[i].channel = i + 1;
+        config.channelConfigs[i].enabled = true;
+    }
+    boot();
+}
+
+void tearDown()
+{
+    powerOff();
+}
+
+void test_fade_is_written_once_settled()
+{
+    StateJournal journal;
+    TEST_ASSERT_FALSE(journal.restore());
+    hostAdvance(1000);
+    // A 2 s fade in 20 ms steps
+    channels[0]->state = true;
+    for (uint16_t step = 1; step <= 100; step++)
+    {
+        channels[0]->level = 65535 - step * 300;
+        hostAdvance(20);
+        journal.loop();
+    }
+    unsigned long fadeEnd = millis();
+    runUntil(journal, fadeEnd + STATE_JOURNAL_SETTLE_TIME - LOOP_INTERVAL);
+    TEST_ASSERT_EQUAL_UINT32(0, hostFlashWrites);
+    runUntil(journal, fadeEnd + STATE_JOURNAL_SETTLE_TIME + LOOP_INTERVAL);
+    TEST_ASSERT_EQUAL_UINT32(1, hostFlashWrites);
+    TEST_ASSERT_EQUAL_UINT32(STATE_JOURNAL_RECORD_SIZE, hostFiles[STATE_JOURNAL_FILE].size());
+    // Nothing changes, nothing more is written
+    runUntil(journal, millis() + 60000);
+    TEST_ASSERT_EQUAL_UINT32(1, hostFlashWrites);
+}
+
+void test_changes_are_coalesced_to_min_interval()
+{
+    StateJournal journal;
+    journal.restore();
+    channels[0]->state = true;
+    while (hostFlashWrites == 0)
+    {
+        hostAdvance(LOOP_INTERVAL);
+        journal.loop();
+    }
+    unsigned long firstWrite = millis();
+    // Settled changes within the min interval wait for it, and are written as one record
+    channels[1]->state = true;
+    runUntil(journal, firstWrite + 10000);
+    channels[2]->state = true;
+    runUntil(journal, firstWrite + STATE_JOURNAL_MIN_INTERVAL - LOOP_INTERVAL);
+    TEST_ASSERT_EQUAL_UINT32(1, readStatus(journal, "writes"));
+    runUntil(journal, firstWrite + STATE_JOURNAL_MIN_INTERVAL + LOOP_INTERVAL);
+    TEST_ASSERT_EQUAL_UINT32(2, readStatus(journal, "writes"));
+}
+
+void test_restore_after_reboot()
+{
+    StateJournal journal;
+    journal.restore();
+    channels[1]->state = true;
+    channels[1]->level = 100 * LEVEL_SCALE;
+    channels[2]->effect.type = EFFECT_BREATHE;
+    journal.flush();
+
+    boot();
+    StateJournal rebooted;
+    TEST_ASSERT_TRUE(rebooted.restore());
+    TEST_ASSERT_FALSE(channels[0]->state);
+    TEST_ASSERT_TRUE(channels[1]->state);
+    TEST_ASSERT_EQUAL_UINT16(100 * LEVEL_SCALE, channels[1]->level);
+    TEST_ASSERT_EQUAL_UINT8(EFFECT_BREATHE, channels[2]->effect.type);
+    TEST_ASSERT_EQUAL_UINT32(1, readStatus(rebooted, "sequence"));
+}
+
+void test_record_cut_short_by_power_loss()
+{
+    StateJournal journal;
+    journal.restore();
+    channels[0]->state = true;
+    journal.flush();
+    channels[0]->level = 10 * LEVEL_SCALE;
+    journal.flush();
+    // Power lost while the second record was written
+    hostFiles[STATE_JOURNAL_FILE].resize(STATE_JOURNAL_RECORD_SIZE + 20);
+
+    boot();
+    StateJournal rebooted;
+    TEST_ASSERT_TRUE(rebooted.restore());
+    TEST_ASSERT_TRUE(channels[0]->state);
+    TEST_ASSERT_EQUAL_UINT16(channels[0]->getMaxLevel(), channels[0]->level);
+    // The next write replaces the file instead of appending after the partial record
+    channels[0]->level = 20 * LEVEL_SCALE;
+    rebooted.flush();
+    TEST_ASSERT_EQUAL_UINT32(STATE_JOURNAL_RECORD_SIZE, hostFiles[STATE_JOURNAL_FILE].size());
+    TEST_ASSERT_EQUAL_UINT32(1, readStatus(rebooted, "compactions"));
+    TEST_ASSERT_FALSE(hostFiles.count(STATE_JOURNAL_FILE_TMP));
+}
+
+void test_file_is_compacted_when_full()
+{
+    StateJournal journal;
+    journal.restore();
+    const uint16_t records = STATE_JOURNAL_MAX_SIZE / STATE_JOURNAL_RECORD_SIZE * 2 + 1;
+    for (uint16_t i = 0; i < records; i++)
+    {
+        channels[0]->level = i;
+        journal.flush();
+        TEST_ASSERT_LESS_OR_EQUAL(STATE_JOURNAL_MAX_SIZE, hostFiles[STATE_JOURNAL_FILE].size());
+    }
+    TEST_ASSERT_EQUAL_UINT32(records, readStatus(journal, "writes"));
+    TEST_ASSERT_EQUAL_UINT32(2, readStatus(journal, "compactions"));
+    TEST_ASSERT_EQUAL_UINT32(0, readStatus(journal, "failures"));
+}
+
+/// @brief A day of use: lights are dimmed with the buttons, faded by scenes and Home Assistant and switched by auto
+/// dimming, often with a second tweak shortly after. Counts what is written to flash.
+void test_simulated_day()
+{
+    std::mt19937 random(1);
+    std::vector<SimFade> fades;
+    uint16_t levels[STATE_JOURNAL_CHANNELS];
+    std::fill(levels, levels + STATE_JOURNAL_CHANNELS, 255 * LEVEL_SCALE);
+    std::vector<unsigned long> interactions;
+    for (uint8_t i = 0; i < DAY_INTERACTIONS; i++)
+    {
+        interactions.push_back(6 * 3600000UL + random() % (17 * 3600000UL));
+    }
+    std::sort(interactions.begin(), interactions.end());
+    uint32_t levelSteps = 0;
+    uint32_t tweaks = 0;
+    for (unsigned long start : interactions)
+    {
+        uint8_t kind = random() % 4;
+        uint8_t first = random() % STATE_JOURNAL_CHANNELS;
+        // Scenes change several channels, the rest one
+        uint8_t count = kind == 0 ? 1 + random() % STATE_JOURNAL_CHANNELS : 1;
+        for (uint8_t c = 0; c < count; c++)
+        {
+            uint8_t channel = (first + c) % STATE_JOURNAL_CHANNELS;
+            uint16_t to = random() % 256 * LEVEL_SCALE;
+            // Scene fade, button hold at one 8 bit step per 12 ms, Home Assistant transition, auto dimming
+            static const uint32_t durations[] = {1000, 3000, 2000, 1000};
+            static const uint32_t stepTimes[] = {SCENE_FADE_STEP, 12, SCENE_FADE_STEP, 10};
+            fades.push_back({start, channel, levels[channel], to, durations[kind], stepTimes[kind]});
+            levels[channel] = to;
+            levelSteps += durations[kind] / stepTimes[kind];
+        }
+        if (random() % 2)
+        {
+            uint16_t to = random() % 256 * LEVEL_SCALE;
+            fades.push_back({start + 2000 + random() % 18000, first, levels[first], to, 1000, SCENE_FADE_STEP});
+            levels[first] = to;
+            levelSteps += 1000 / SCENE_FADE_STEP;
+            tweaks++;
+        }
+    }
+    std::stable_sort(fades.begin(), fades.end(), [](const SimFade &a, const SimFade &b)
+                     { return a.start < b.start; });
+
+    StateJournal journal;
+    journal.restore();
+    size_t next = 0;
+    std::vector<SimFade> active;
+    while (millis() < DAY)
+    {
+        hostAdvance(LOOP_INTERVAL);
+        unsigned long now = millis();
+        while (next < fades.size() && fades[next].start <= now)
+        {
+            active.push_back(fades[next++]);
+        }
+        for (size_t i = 0; i < active.size();)
+        {
+            SimFade &fade = active[i];
+            uint32_t steps = fade.duration / fade.stepTime;
+            uint32_t step = std::min((uint32_t)(now - fade.start) / fade.stepTime, steps);
+            DMXChannel &channel = *channels[fade.channel];
+            channel.level = fade.from + ((int32_t)fade.to - fade.from) * (int32_t)step / (int32_t)steps;
+            channel.state = channel.level != 0;
+            if (step == steps)
+            {
+                active.erase(active.begin() + i);
+                continue;
+            }
+            i++;
+        }
+        journal.loop();
+    }
+
+    char message[160];
+    snprintf(message, sizeof(message), "%u changes and %u level steps a day, %u records written, %u bytes, %u compactions",
+             (unsigned)(DAY_INTERACTIONS + tweaks), (unsigned)levelSteps, (unsigned)hostFlashWrites, (unsigned)hostFlashBytes, (unsigned)readStatus(journal, "compactions"));
+    TEST_MESSAGE(message);
+    // One write per record, at most one record per interaction and its tweak
+    TEST_ASSERT_EQUAL_UINT32(readStatus(journal, "writes"), hostFlashWrites);
+    TEST_ASSERT_EQUAL_UINT32(readStatus(journal, "bytes_written"), hostFlashBytes);
+    TEST_ASSERT_GREATER_THAN(0, hostFlashWrites);
+    TEST_ASSERT_LESS_OR_EQUAL(DAY_INTERACTIONS + tweaks, hostFlashWrites);
+    TEST_ASSERT_LESS_THAN(levelSteps / 100, hostFlashWrites);
+    TEST_ASSERT_LESS_OR_EQUAL(STATE_JOURNAL_MAX_SIZE, hostFiles[STATE_JOURNAL_FILE].size());
+    TEST_ASSERT_EQUAL_UINT32(0, readStatus(journal, "failures"));
+
+    // Everything is written by the end of the day and comes back after a reboot
+    boot();
+    StateJournal rebooted;
+    TEST_ASSERT_TRUE(rebooted.restore());
+    for (uint8_t i = 0; i < STATE_JOURNAL_CHANNELS; i++)
+    {
+        TEST_ASSERT_EQUAL_UINT16(levels[i], channels[i]->level);
+        TEST_ASSERT_EQUAL(levels[i] != 0, channels[i]->state);
+    }
+}
+
+int main()
+{
+    UNITY_BEGIN();
+    RUN_TEST(test_fade_is_written_once_settled);
+    RUN_TEST(test_changes_are_coalesced_to_min_interval);
+    RUN_TEST(test_restore_after_reboot);
+    RUN_TEST(test_record_cut_short_by_power_loss);
+    RUN_TEST(test_file_is_compacted_when_full);
+    RUN_TEST(test_simulated_day);
+    return UNITY_END();
+}
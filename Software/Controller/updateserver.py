@@ -0,0 +1,67 @@
+#!/usr/bin/env python
+# Local update server for pulled OTA updates.
+#
+# Serves the images from a PlatformIO build directory together with a
+# manifest.json describing them. Point the "Update manifest URL" of the
+# controllers to http://<this host>:<port>/manifest.json and either let them
+# poll or publish to <base topic>light/update (all controllers) or
+# <base topic>light/<hostname>/update (one controller) to start an update.
+#
+# Build the images first with "pio run" and "pio run -t buildfs".
+import argparse
+import functools
+import hashlib
+import http.server
+import json
+import os
+import subprocess
+
+IMAGES = {
+    "firmware": "firmware.bin",
+    "littlefs": "littlefs.bin",
+}
+
+
+def sha256_of(path):
+    with open(path, "rb") as f:
+        return hashlib.sha256(f.read()).hexdigest()
+
+
+def build_manifest(image_dir, version):
+    manifest = {}
+    for image, filename in IMAGES.items():
+        path = os.path.join(image_dir, filename)
+        if not os.path.isfile(path):
+            continue
+        manifest[image] = {
+            "url": filename,
+            "size": os.path.getsize(path),
+            "sha256": sha256_of(path),
+        }
+    if "firmware" in manifest:
+        # Same version string as setVersion.py writes to include/version.h
+        manifest["firmware"]["version"] = version
+    return manifest
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Serve firmware and LittleFS images to the controllers.")
+    parser.add_argument("--port", type=int, default=8000)
+    parser.add_argument("--dir", default=os.path.join(".pio", "build", "esp32"), help="Directory with firmware.bin and littlefs.bin")
+    parser.add_argument("--version", help="Firmware version, defaults to the current git short hash")
+    args = parser.parse_args()
+
+    version = args.version or subprocess.check_output(['git', 'rev-parse', '--short', 'HEAD']).decode('ascii').strip()
+    manifest = build_manifest(args.dir, version)
+    with open(os.path.join(args.dir, "manifest.json"), "w") as f:
+        json.dump(manifest, f, indent=4)
+    print(json.dumps(manifest, indent=4))
+
+    handler = functools.partial(http.server.SimpleHTTPRequestHandler, directory=args.dir)
+    server = http.server.ThreadingHTTPServer(("", args.port), handler)
+    print("Serving %s on port %d" % (args.dir, args.port))
+    server.serve_forever()
+
+
+if __name__ == "__main__":
+    main()
@@ -1,5 +1,12 @@
 #include <Arduino.h>
+// Build with -D DMX_RDM (env:uno_rdm) for a minimal RDM responder: the controller finds the driver, reads its
+// device info and sets its DMX start address, which is kept in EEPROM. The DIP switches are not used then.
+// Needs DE and /RE of the RS485 driver on a GPIO, as on the CC LED driver board.
+#ifdef DMX_RDM
+#include <DMXSerial2.h>
+#else
 #include <DMXSerial.h>
+#endif
 
 // Set DMX receive timeout to 10 seconds by default.
 // This value can be trimmed down to start dimming down the lights faster after connection error
@@ -15,6 +22,31 @@
 #define CHANNEL_PIN_B2 7
 #define CHANNEL_PIN_B3 8
 #define CHANNEL_PIN_B4 9
+// DE and /RE of the RS485 driver, low while receiving
+#define RS485_DIRECTION_PIN A2
+
+// Build with -D DMX_16BIT (env:uno_16bit) for controller channels set to 16 bit. The level is then
+// read as coarse byte on the set channel and fine byte on the next one.
+#ifdef DMX_16BIT
+#define DMX_LEVEL_MAX 65535
+#else
+#define DMX_LEVEL_MAX 255
+#endif
+
+#ifdef DMX_RDM
+// The answers to DEVICE_INFO, the UID is made up by DMXSerial2 on the first start and kept in EEPROM
+struct RDMINIT rdmInit = {
+  "LMAN",            // Manufacturer label
+  1,                 // Device model ID
+  "LMAN LED driver", // Device model label
+#ifdef DMX_16BIT
+  2,                 // Footprint, coarse and fine level
+#else
+  1,                 // Footprint
+#endif
+  0, NULL            // No parameters beyond the ones DMXSerial2 answers itself
+};
+#endif
 
 int dimLevel = 0;
 int currentChannel = 0;
@@ -27,10 +59,17 @@ unsigned long lastLightDimmingEvent = 0;
 // const unsigned int TOP = 0x7FFF; // 15-bit resolution.   488 Hz PWM
 // const unsigned int TOP = 0x3FFF; // 14-bit resolution.   976 Hz PWM
 // const unsigned int TOP = 0x1FFF; // 13-bit resolution.  1953 Hz PWM
+#ifdef DMX_16BIT
+// With 9 bits the PWM steps are coarser than 8 bit levels at low brightness, a 16 bit level needs more resolution to be seen.
+const unsigned int TOP = 0x0FFF; // 12-bit resolution.  3906 Hz PWM
+#else
 // const unsigned int TOP = 0x0FFF; // 12-bit resolution.  3906 Hz PWM
 // const unsigned int TOP = 0x07FF; // 11-bit resolution.  7812 Hz PWM
 // const unsigned int TOP = 0x03FF; // 10-bit resolution. 15624 Hz PWM
 const unsigned int TOP = 0x01FF; // 9-bit resolution. 31248 Hz PWM
+#endif
+// PWM counts per dimming step, so that dimming takes as long at any resolution as at 9 bits
+const unsigned int DIM_STEP = (TOP + 1) / 512;
 
 void PWM16Begin()
 {
@@ -81,7 +120,24 @@ inline void PWM16B(unsigned int PWMValue)
   OCR1B = constrain(PWMValue, 0, TOP);
 }
 
+// Read the level of the set channel, 0-DMX_LEVEL_MAX
+unsigned int readLevel() {
+#if defined(DMX_RDM) && defined(DMX_16BIT)
+  return ((unsigned int)DMXSerial2.readRelative(0) << 8) | DMXSerial2.readRelative(1);
+#elif defined(DMX_RDM)
+  return DMXSerial2.readRelative(0);
+#elif defined(DMX_16BIT)
+  return ((unsigned int)DMXSerial.read(currentChannel) << 8) | DMXSerial.read(currentChannel + 1);
+#else
+  return DMXSerial.read(currentChannel);
+#endif
+}
+
 void readCurrentChannelSwitches() {
+#ifdef DMX_RDM
+  // Set over RDM instead
+  int channel = DMXSerial2.getStartAddress();
+#else
   int channel = 0;
 
   if(digitalRead(CHANNEL_PIN_B1) == LOW) {
@@ -96,18 +152,32 @@ void readCurrentChannelSwitches() {
   if(digitalRead(CHANNEL_PIN_B4) == LOW) {
     channel = (1 << 3) | channel;
   }
+#endif
   // Add +1 to read the correct register in the DMX library
   currentChannel = channel;
   lastCurrentChannelRead = millis();
 }
 
 
+#ifdef DMX_RDM
+// Every parameter the responder supports is answered by DMXSerial2
+bool8 processCommand(struct RDMDATA *rdm, uint16_t *nackReason) {
+  *nackReason = E120_NR_UNKNOWN_PID;
+  return false;
+}
+#endif
+
 void setup() {
+#ifdef DMX_RDM
+  // Receives DMX and answers RDM requests, turning the RS485 driver around for the responses
+  DMXSerial2.init(&rdmInit, processCommand, RS485_DIRECTION_PIN);
+#else
   DMXSerial.init(DMXReceiver); // Init DMX as receiver
   // Set default values for all channels
-  for(int i = 0; i < 15; i++) {
+  for(int i = 0; i < 16; i++) {
     DMXSerial.write(i + 1, 0);
   }
+#endif
   pinMode(RS485_ERROR_PIN, OUTPUT);
   pinMode(STATUS_PIN, OUTPUT);
   digitalWrite(STATUS_PIN, HIGH);
@@ -119,7 +189,7 @@ void setup() {
   pinMode(CHANNEL_PIN_B4, INPUT_PULLUP);
   readCurrentChannelSwitches();
 
-  pwm_multiplication_val = sqrt(TOP) / 255;
+  pwm_multiplication_val = sqrt(TOP) / DMX_LEVEL_MAX;
 
   // Start PWM
   PWM16B(0);
@@ -135,17 +205,27 @@ void loop() {
 
   if(currentChannel > 0) {
     // Calculate how long since the last DMX data was received.
+#ifdef DMX_RDM
+    unsigned long lastPacket = DMXSerial2.noDataSince();
+#else
     unsigned long lastPacket = DMXSerial.noDataSince();
+#endif
 
     // If the last packet we received was less than the timeout value ago, set the value received
     // otherwise, start dimming down current dimming level every 100ms
+#ifdef DMX_RDM
+    if (DMXSerial2.isIdentifyMode()) {
+      // RDM identify, blink the light so it can be found
+      dimLevel = (millis() / 250) % 2 == 0 ? TOP : 0;
+    } else
+#endif
     if (lastPacket < DMX_TIMEOUT_MS) {
       // Convert sent value with a curve to the high value corresponding to the bit-mode of the PWM
       //dimLevel = round(pow((DMXSerial.read(currentChannel) * 0.25), 2));  // Convert to 12-bit
-      dimLevel = round(pow((DMXSerial.read(currentChannel) * pwm_multiplication_val), 2));  // Convert to 10-bit
+      dimLevel = round(pow((readLevel() * pwm_multiplication_val), 2));  // Convert to the PWM resolution
     } else if (dimLevel > 0) {
       if(millis() - lastLightDimmingEvent > 100) {
-        dimLevel--;
+        dimLevel = dimLevel > DIM_STEP ? dimLevel - DIM_STEP : 0;
         lastLightDimmingEvent = millis();
       }
     }
@@ -159,12 +239,16 @@ void loop() {
 
     // Blink the status LED to show that it is running (this can be disabled by not bridging the jumper)
     digitalWrite(STATUS_PIN, (millis() / 1000) % 2 == 0 ? HIGH : LOW);
+#ifdef DMX_RDM
+    // Answer the RDM requests received since the last loop
+    DMXSerial2.tick();
+#endif
   } else {
     // Show an error as no channel has been set.
     digitalWrite(STATUS_PIN, HIGH);
 
     // Dim light up and down until a channel is selected.
-    for(dimLevel = 0; dimLevel < TOP && currentChannel == 0; dimLevel++) {
+    for(dimLevel = 0; dimLevel < TOP && currentChannel == 0; dimLevel += DIM_STEP) {
       readCurrentChannelSwitches();
       PWM16B(dimLevel);
       // Blink RS485-error led fast to show that no channel has been set.
@@ -172,7 +256,7 @@ void loop() {
       delay(20);
     }
 
-    for(dimLevel = TOP; dimLevel > 0 && currentChannel == 0; dimLevel--) {
+    for(dimLevel = TOP; dimLevel > 0 && currentChannel == 0; dimLevel -= DIM_STEP) {
       readCurrentChannelSwitches();
       PWM16B(dimLevel);
       // Blink RS485-error led fast to show that no channel has been set.